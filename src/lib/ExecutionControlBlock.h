@@ -19,4 +19,8 @@ struct ExecutionControlBlock
 	// Values set by the executing code
 	void *stackrestore;
 	uint64_t retvalue;
+	uint64_t trapaddr;	// the jitted instruction that trapped, only valid after a failed execution
+
+	class WasmContext *pctxtInstance;
+	// The instance's globals follow in memory, jitted code reaches them at [rbp + sizeof(ExecutionControlBlock) + idx*8]
 };
\ No newline at end of file
@@ -53,6 +53,27 @@ value_type ParseTypeString(const std::string &strType)
 	return value_type::none;
 }
 
+// parses "nan:0x..." (optionally signed) into the raw bits of a float with cbitMantissa mantissa bits, the C library
+//	would give back the default NaN and lose the payload
+static bool FParseNanPayload(const std::string &strVal, int cbitMantissa, int cbitExponent, uint64_t *pbits)
+{
+	size_t ich = 0;
+	bool fNegative = false;
+	if (strVal[0] == '-' || strVal[0] == '+')
+	{
+		fNegative = strVal[0] == '-';
+		++ich;
+	}
+	if (strVal.compare(ich, 6, "nan:0x") != 0)
+		return false;
+	uint64_t payload = std::stoull(strVal.substr(ich + 6), nullptr, 16);
+	Verify(payload != 0 && payload < (uint64_t(1) << cbitMantissa));
+	*pbits = (((uint64_t(1) << cbitExponent) - 1) << cbitMantissa) | payload;
+	if (fNegative)
+		*pbits |= uint64_t(1) << (cbitMantissa + cbitExponent);
+	return true;
+}
+
 size_t ExpressionService::CchEatExpression(const char *sz, size_t cch, _Out_ Variant *pvalOut)
 {
 	// eat expressions such as (i32.const 123)
@@ -132,12 +153,16 @@ size_t ExpressionService::CchEatExpression(const char *sz, size_t cch, _Out_ Var
 				}
 				case value_type::f32:
 				{
+					if (FParseNanPayload(strVal, 23, 8, &pvalOut->val))
+						break;
 					float valT = std::stof(strVal);
 					pvalOut->val = *reinterpret_cast<uint32_t*>(&valT);
 					break;
 				}
 				case value_type::f64:
 				{
+					if (FParseNanPayload(strVal, 52, 11, &pvalOut->val))
+						break;
 					double valT = std::stod(strVal);
 					pvalOut->val = *reinterpret_cast<int64_t*>(&valT);
 					break;
@@ -3,21 +3,52 @@
 #include "Exceptions.h"
 #include "safe_access.h"
 #include "JitWriter.h"
+#include "SsaFunction.h"
 #include "WasmContext.h"
+#include "WasmModule.h"
 #include "ExecutionControlBlock.h"
 #include "numeric_cast.h"
+#include <atomic>
+#include <thread>
 
 extern "C" void WasmToC();
 extern "C" void CallIndirectShim();
-extern "C" void BranchTable();
 extern "C" void U64ToF32();
 extern "C" void U64ToF64();
 extern "C" void GrowMemoryOp();
 extern "C" void F32ToU64Trunc();
 extern "C" void F64ToU64Trunc();
+extern "C" void F32Round();
+extern "C" void F64Round();
+extern "C" void TierUpStub();
+extern "C" void LazyCompileShim();
+extern "C" void TrapFault();
+
+// An instance's globals follow its ExecutionControlBlock, which rbp points at in jitted code, so the code doesn't depend
+//	on which instance of the module it runs for
+static int32_t DispGlobal(uint32_t idx)
+{
+	return numeric_cast<int32_t>(sizeof(ExecutionControlBlock) + size_t(idx) * sizeof(uint64_t));
+}
+
+// The function table and code that other threads may be running are only changed with single aligned stores, so they
+//	see the old value or the new one and never a mix.  Everything a new table entry leads to is written before it.
+template<typename T>
+static void StoreShared(T *pv, T val)
+{
+	static_assert(sizeof(std::atomic<T>) == sizeof(T), "must be stored as a plain value");
+	Verify(reinterpret_cast<uintptr_t>(pv) % sizeof(T) == 0);
+	reinterpret_cast<std::atomic<T>*>(pv)->store(val, std::memory_order_release);
+}
+
+template<typename T>
+static T LoadShared(T *pv)
+{
+	return reinterpret_cast<std::atomic<T>*>(pv)->load(std::memory_order_acquire);
+}
 
-JitWriter::JitWriter(WasmContext *pctxt, size_t cfn, size_t cglbls)
-	: m_pctxt(pctxt), m_pexecPlane(nullptr), m_cfn(cfn)
+JitWriter::JitWriter(WasmModule *pmodule, size_t cfn, bool fAllowSSE41, int32_t cTierUpThreshold)
+	: m_pmodule(pmodule), m_pexecPlane(nullptr), m_cfn(cfn)
 {
 	const size_t cbExec = 0x40000000; 	// 1Gb
 #ifdef _DEBUG
@@ -25,8 +56,17 @@ JitWriter::JitWriter(WasmContext *pctxt, size_t cfn, size_t cglbls)
 #else
 	const void *pvBase = nullptr;
 #endif
-	m_spapbExecPlane = layer::ReservePages(pvBase, cbExec);
-	ProtectRange(*m_spapbExecPlane, 0, cbExec, layer::PAGE_PROTECTION::ReadWrite);
+	m_spapbExecPlane = layer::ReserveDualMappedPages(pvBase, cbExec);
+	if (m_spapbExecPlane != nullptr)
+	{
+		// Code is written through the ReadWrite alias so the code range never changes protection, see ProtectForRuntime
+		m_dbWrite = (uint8_t*)m_spapbExecPlane->PvWriteAddr() - (uint8_t*)m_spapbExecPlane->PvBaseAddr();
+	}
+	else
+	{
+		m_spapbExecPlane = layer::ReservePages(pvBase, cbExec);
+		ProtectRange(*m_spapbExecPlane, 0, cbExec, layer::PAGE_PROTECTION::ReadWrite);
+	}
 	m_pexecPlane = (uint8_t*)m_spapbExecPlane->PvBaseAddr();
 	m_pexecPlaneCur = m_pexecPlane;
 	m_pexecPlaneMax = m_pexecPlaneCur + m_spapbExecPlane->Cb();
@@ -36,35 +76,88 @@ JitWriter::JitWriter(WasmContext *pctxt, size_t cfn, size_t cglbls)
 	m_pexecPlaneCur += sizeof(void*) * cfn;	// allocate the function table, ensuring its within 32-bits of all our code
 	
 	m_pfnCallIndirectShim = (void**)m_pexecPlaneCur;
-	m_pfnBranchTable = ((void**)m_pexecPlaneCur) + 1;
-	m_pfnU64ToF32 = ((void**)m_pexecPlaneCur) + 2;
-	m_pfnU64ToF64 = ((void**)m_pexecPlaneCur) + 3;
-	m_pfnGrowMemoryOp = ((void**)m_pexecPlaneCur) + 4;
-	m_pfnF32ToU64Trunc = ((void**)m_pexecPlaneCur) + 5;
-	m_pfnF64ToU64Trunc = ((void**)m_pexecPlaneCur) + 6;
-	m_pexecPlaneCur += sizeof(*m_pfnCallIndirectShim) * 7;
+	m_pfnU64ToF32 = ((void**)m_pexecPlaneCur) + 1;
+	m_pfnU64ToF64 = ((void**)m_pexecPlaneCur) + 2;
+	m_pfnGrowMemoryOp = ((void**)m_pexecPlaneCur) + 3;
+	m_pfnF32ToU64Trunc = ((void**)m_pexecPlaneCur) + 4;
+	m_pfnF64ToU64Trunc = ((void**)m_pexecPlaneCur) + 5;
+	m_pfnF32Round = ((void**)m_pexecPlaneCur) + 6;
+	m_pfnF64Round = ((void**)m_pexecPlaneCur) + 7;
+	m_pfnTierUpStub = ((void**)m_pexecPlaneCur) + 8;
+	m_pfnLazyCompileShim = ((void**)m_pexecPlaneCur) + 9;
+	m_pexecPlaneCur += sizeof(*m_pfnCallIndirectShim) * 10;
+	static_assert(sizeof(*m_rgcTierUp) == sizeof(int32_t), "jitted code decrements the counters in place");
+	m_rgcTierUp = (std::atomic<int32_t>*)m_pexecPlaneCur;
+	m_pexecPlaneCur += sizeof(*m_rgcTierUp) * cfn;
 
-	m_pexecPlaneCur += (4096 - reinterpret_cast<uint64_t>(m_pexecPlaneCur)) % 4096;
-	m_pGlobalsStart = (uint64_t*)m_pexecPlaneCur;
-	m_pexecPlaneCur += (sizeof(uint64_t) * cglbls);
 	m_pexecPlaneCur += (4096 - reinterpret_cast<uint64_t>(m_pexecPlaneCur)) % 4096;
 	m_pcodeStart = m_pexecPlaneCur;
+	if (m_dbWrite != 0)
+		layer::ProtectRange(*m_spapbExecPlane, m_pexecPlane, m_pcodeStart - m_pexecPlane, layer::PAGE_PROTECTION::ReadWrite);	// jitted code writes the tier up counters
 	memset(pvZeroStart, 0, m_pexecPlaneCur - pvZeroStart);	// these areas should be initialized to zero
 
-	for (size_t iimportfn = 0; iimportfn < m_pctxt->m_vecimports.size(); ++iimportfn)
+	for (size_t iimportfn = 0; iimportfn < m_pmodule->m_vecimports.size(); ++iimportfn)
 		reinterpret_cast<void**>(m_pexecPlane)[iimportfn] = (void*)WasmToC;
 	*m_pfnCallIndirectShim = (void*)CallIndirectShim;
-	*m_pfnBranchTable = (void*)BranchTable;
 	*m_pfnU64ToF32 = (void*)U64ToF32;
 	*m_pfnU64ToF64 = (void*)U64ToF64;
 	*m_pfnGrowMemoryOp = (void*)GrowMemoryOp;
 	*m_pfnF32ToU64Trunc = (void*)F32ToU64Trunc;
 	*m_pfnF64ToU64Trunc = (void*)F64ToU64Trunc;
-
-	for (size_t iglbl = 0; iglbl < cglbls; ++iglbl)
+	*m_pfnF32Round = (void*)F32Round;
+	*m_pfnF64Round = (void*)F64Round;
+	*m_pfnTierUpStub = (void*)TierUpStub;
+	*m_pfnLazyCompileShim = (void*)LazyCompileShim;
+
+	// Nothing is compiled until it is first called, direct calls go through the callee's compile stub until then
+	m_pbCompileStubs = m_pexecPlaneCur;
+	for (size_t ifn = m_pmodule->m_vecimports.size(); ifn < cfn; ++ifn)
 	{
-		m_pGlobalsStart[iglbl] = pctxt->m_vecglbls[iglbl].val;
+		// mov ecx, ifn						{ 0xB9, imm32 }
+		// jmp [rip + LazyCompileShim]		{ 0xFF, 0x25, rel32 }
+		SafePushCode(uint8_t(0xB9));
+		SafePushCode(uint32_t(ifn));
+		static const uint8_t rgcodeJmp[] = { 0xFF, 0x25 };
+		SafePushCode(rgcodeJmp);
+		SafePushCode(numeric_cast<int32_t>(reinterpret_cast<uint8_t*>(m_pfnLazyCompileShim) - (m_pexecPlaneCur + sizeof(int32_t))));
 	}
+	m_fSSE41 = fAllowSSE41 && layer::FCpuSupportsSSE41();
+	Verify(cTierUpThreshold >= 0);
+	m_cTierUpThreshold = cTierUpThreshold;
+	m_vecvecpbCallFixups.resize(cfn);
+	m_vecpbRegisterEntry.resize(cfn, nullptr);
+	m_vecstateTierUp.resize(cfn, TierUpState::Baseline);
+	m_vecvecpairOsrEntry.resize(cfn);
+}
+
+// A JitWriter for one of CompileAll's threads.  It shares our exec plane and tables but emits into [pbCode, pbCodeMax)
+//	and keeps its own entry points, call fixups and code map until CompileAll merges them.
+JitWriter::JitWriter(const JitWriter &jitwShared, uint8_t *pbCode, uint8_t *pbCodeMax)
+	: m_pmodule(jitwShared.m_pmodule), m_pexecPlane(jitwShared.m_pexecPlane), m_cfn(jitwShared.m_cfn)
+{
+	m_pcodeStart = jitwShared.m_pcodeStart;
+	m_pexecPlaneCur = pbCode;
+	m_pexecPlaneMax = pbCodeMax;
+	m_dbWrite = jitwShared.m_dbWrite;
+	m_pfnCallIndirectShim = jitwShared.m_pfnCallIndirectShim;
+	m_pfnU64ToF32 = jitwShared.m_pfnU64ToF32;
+	m_pfnU64ToF64 = jitwShared.m_pfnU64ToF64;
+	m_pfnGrowMemoryOp = jitwShared.m_pfnGrowMemoryOp;
+	m_pfnF32ToU64Trunc = jitwShared.m_pfnF32ToU64Trunc;
+	m_pfnF64ToU64Trunc = jitwShared.m_pfnF64ToU64Trunc;
+	m_pfnF32Round = jitwShared.m_pfnF32Round;
+	m_pfnF64Round = jitwShared.m_pfnF64Round;
+	m_pfnTierUpStub = jitwShared.m_pfnTierUpStub;
+	m_pfnLazyCompileShim = jitwShared.m_pfnLazyCompileShim;
+	m_pbCompileStubs = jitwShared.m_pbCompileStubs;
+	m_rgcTierUp = jitwShared.m_rgcTierUp;
+	m_fSSE41 = jitwShared.m_fSSE41;
+	m_cTierUpThreshold = jitwShared.m_cTierUpThreshold;
+	m_fWorker = true;
+	m_vecvecpbCallFixups.resize(m_cfn);
+	m_vecpbRegisterEntry.resize(m_cfn, nullptr);
+	m_vecstateTierUp.resize(m_cfn, TierUpState::Baseline);
+	m_vecvecpairOsrEntry.resize(m_cfn);
 }
 
 JitWriter::~JitWriter()
@@ -75,54 +168,330 @@ void JitWriter::SafePushCode(const void *pv, size_t cb)
 {
 	if (m_pexecPlaneCur + cb > m_pexecPlaneMax)
 		throw RuntimeException("No room to compile function");
-	memcpy(m_pexecPlaneCur, pv, cb);
+	memcpy(PWritable(m_pexecPlaneCur), pv, cb);
 	m_pexecPlaneCur += cb;
 }
 
 void JitWriter::_PushExpandStack()
 {
-	// RAX -> stack
-	// mov [rdi], rax		{ 0x48, 0x89, 0x07 }
-	// add rdi, 8			{ 0x48, 0x83, 0xC7, 0x08 }
-	static const uint8_t rgcode[] = { 0x48, 0x89, 0x07, 0x48, 0x83, 0xC7, 0x08 };
-	SafePushCode(rgcode, _countof(rgcode));
+	// RAX -> stack (or xmm0 when the top is a float still held there)
+	//	The value is parked in a cache register of the same kind, only the bottom of the cache is written to [rdi] once we run out
+	static const Register rgregCache[] = { Register::r8, Register::r9, Register::r10, Register::r11 };
+	static const Register rgregCacheXmm[] = { Register::xmm4, Register::xmm5, Register::xmm6, Register::xmm7 };
+	const bool fXmm = m_fTopInXmm;
+	auto FFreeReg = [&](Register *preg)
+	{
+		for (Register regT : (fXmm ? rgregCacheXmm : rgregCache))
+		{
+			if (std::find(m_vecregStackCache.begin(), m_vecregStackCache.end(), regT) == m_vecregStackCache.end())
+			{
+				*preg = regT;
+				return true;
+			}
+		}
+		return false;
+	};
+	Register reg;
+	while (!FFreeReg(&reg))
+	{
+		// The stack order must be kept so registers are only freed from the bottom of the cache
+		Register regSpill = m_vecregStackCache.front();
+		if (FXmmRegister(regSpill))
+		{
+			// movq [rdi], xmm
+			const uint8_t rgcodeSpill[] = { 0x66, 0x0F, 0xD6, uint8_t(0x07 | ((uint8_t(regSpill) & 7) << 3)) };
+			SafePushCode(rgcodeSpill);
+		}
+		else
+		{
+			// mov [rdi], reg
+			const uint8_t rgcodeSpill[] = { 0x4C, 0x89, uint8_t(0x07 | ((uint8_t(regSpill) & 7) << 3)) };
+			SafePushCode(rgcodeSpill);
+		}
+		// lea rdi, [rdi + 8]
+		static const uint8_t rgcodeLea[] = { 0x48, 0x8D, 0x7F, 0x08 };
+		SafePushCode(rgcodeLea);
+		++m_cslotStack;
+		m_vecregStackCache.erase(m_vecregStackCache.begin());
+	}
+	if (fXmm)
+	{
+		// movaps xmm, xmm0
+		const uint8_t rgcode[] = { 0x0F, 0x28, uint8_t(0xC0 | ((uint8_t(reg) & 7) << 3)) };
+		SafePushCode(rgcode);
+		m_fTopInXmm = false;
+	}
+	else
+	{
+		// mov reg, rax
+		const uint8_t rgcode[] = { 0x49, 0x89, uint8_t(0xC0 | (uint8_t(reg) & 7)) };
+		SafePushCode(rgcode);
+	}
+	m_vecregStackCache.push_back(reg);
 }
 
 // NOTE: Must not affect flags
 void JitWriter::_PopContractStack()
 {
+	m_fTopInXmm = false;	// the old top is discarded
+	if (!m_vecregStackCache.empty())
+	{
+		Register reg = m_vecregStackCache.back();
+		m_vecregStackCache.pop_back();
+		if (FXmmRegister(reg))
+		{
+			// movq rax, xmm
+			const uint8_t rgcode[] = { 0x66, 0x48, 0x0F, 0x7E, uint8_t(0xC0 | ((uint8_t(reg) & 7) << 3)) };
+			SafePushCode(rgcode);
+			return;
+		}
+		// mov rax, reg
+		const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0xC0 | ((uint8_t(reg) & 7) << 3)) };
+		SafePushCode(rgcode);
+		return;
+	}
 	// mov rax, [rdi - 8]	{ 0x48, 0x8b, 0x47, 0xf8 }
 	// lea rdi, [rdi - 8]	{ 0x48, 0x8D, 0x7F, 0xF8 }
 	static const uint8_t rgcode[] = { 0x48, 0x8B, 0x47, 0xF8, 0x48, 0x8D, 0x7F, 0xF8 };
 	SafePushCode(rgcode, _countof(rgcode));
+	--m_cslotStack;
 }
 
+// NOTE: Must not affect flags
 void JitWriter::_PopSecondParam(bool fSwapParams)
 {
+	if (!m_vecregStackCache.empty())
+	{
+		Register reg = m_vecregStackCache.back();
+		m_vecregStackCache.pop_back();
+		uint8_t regDst = 1;	// rcx
+		if (fSwapParams)
+		{
+			// mov rcx, rax
+			static const uint8_t rgcodeSwap[] = { 0x48, 0x89, 0xC1 };
+			SafePushCode(rgcodeSwap);
+			regDst = 0;	// rax
+		}
+		if (FXmmRegister(reg))
+		{
+			// movq rcx/rax, xmm
+			const uint8_t rgcode[] = { 0x66, 0x48, 0x0F, 0x7E, uint8_t(0xC0 | ((uint8_t(reg) & 7) << 3) | regDst) };
+			SafePushCode(rgcode);
+		}
+		else
+		{
+			// mov rcx/rax, reg
+			const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0xC0 | ((uint8_t(reg) & 7) << 3) | regDst) };
+			SafePushCode(rgcode);
+		}
+		return;
+	}
+
 	if (fSwapParams)
 	{
 		// mov rcx, rax
 		// mov rax, [rdi - 8]
-		// sub rdi, 8
-		static const uint8_t rgcode[] = { 0x48, 0x89, 0xC1, 0x48, 0x8B, 0x47, 0xF8, 0x48, 0x83, 0xEF, 0x08 };
+		// lea rdi, [rdi - 8]
+		static const uint8_t rgcode[] = { 0x48, 0x89, 0xC1, 0x48, 0x8B, 0x47, 0xF8, 0x48, 0x8D, 0x7F, 0xF8 };
 		SafePushCode(rgcode, _countof(rgcode));
 	}
 	else
 	{
 		// mov rcx, [rdi - 8]
-		// sub rdi, 8
-		static const uint8_t rgcode[] = { 0x48, 0x8B, 0x4F, 0xF8, 0x48, 0x83, 0xEF, 0x08 };
+		// lea rdi, [rdi - 8]
+		static const uint8_t rgcode[] = { 0x48, 0x8B, 0x4F, 0xF8, 0x48, 0x8D, 0x7F, 0xF8 };
 		SafePushCode(rgcode, _countof(rgcode));
 	}
+	--m_cslotStack;
+}
+
+// Write the cached operands out to [rdi] so the machine stack is in its canonical form (only rax is held in a register)
+// NOTE: Must not affect flags
+void JitWriter::_FlushStack()
+{
+	if (m_vecregStackCache.empty())
+		return;
+	uint8_t disp = 0;
+	for (Register reg : m_vecregStackCache)
+	{
+		if (FXmmRegister(reg))
+		{
+			// movq [rdi + disp], xmm
+			const uint8_t rgcode[] = { 0x66, 0x0F, 0xD6, uint8_t(0x47 | ((uint8_t(reg) & 7) << 3)), disp };
+			SafePushCode(rgcode);
+		}
+		else
+		{
+			// mov [rdi + disp], reg
+			const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0x47 | ((uint8_t(reg) & 7) << 3)), disp };
+			SafePushCode(rgcode);
+		}
+		disp += sizeof(uint64_t);
+	}
+	// lea rdi, [rdi + disp]
+	const uint8_t rgcodeLea[] = { 0x48, 0x8D, 0x7F, disp };
+	SafePushCode(rgcodeLea);
+	m_cslotStack += numeric_cast<int32_t>(m_vecregStackCache.size());
+	m_vecregStackCache.clear();
+}
+
+// Flush the stack and push rax to [rdi] as well, used when the current stack must be saved in memory (block entry and calls)
+void JitWriter::_SpillStack()
+{
+	_FlushStack();
+	// mov [rdi], rax		{ 0x48, 0x89, 0x07 }
+	// add rdi, 8			{ 0x48, 0x83, 0xC7, 0x08 }
+	static const uint8_t rgcode[] = { 0x48, 0x89, 0x07, 0x48, 0x83, 0xC7, 0x08 };
+	SafePushCode(rgcode, _countof(rgcode));
+	++m_cslotStack;
 }
 
+// Cached operands above a block's stack height are dropped when we restore rdi on the way out
+void JitWriter::_DiscardStackCache()
+{
+	m_vecregStackCache.clear();
+}
 
-void JitWriter::LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbSrc, bool fSignExtend)
+// Float results stay in xmm0 while the following ops can consume them there, everything else gets them in rax
+bool JitWriter::FXmmOperandOp(opcode op)
 {
-	// add eax, offset	; note this implicitly ands with 0xffffffff ensuring that when referenced as rax it will always be a positive number between 0 and 2^32 - 1
-	static const uint8_t rgcodeAdd[] = { 0x05 };
-	SafePushCode(rgcodeAdd);
+	switch (op)
+	{
+	case opcode::get_local:
+	case opcode::get_global:
+	case opcode::i32_const:
+	case opcode::i64_const:
+	case opcode::f32_const:
+	case opcode::f64_const:
+	case opcode::drop:
+	case opcode::f32_demote_f64:
+	case opcode::f64_promote_f32:
+		return true;	// pushes move xmm0 into the cache, drop discards it
+	default:
+		return (op >= opcode::f32_eq && op <= opcode::f64_ge)
+			|| (op >= opcode::f32_ceil && op <= opcode::f32_max)
+			|| (op >= opcode::f64_ceil && op <= opcode::f64_max)
+			|| (op >= opcode::i32_trunc_s_f32 && op <= opcode::i32_trunc_u_f64)
+			|| (op >= opcode::i64_trunc_s_f32 && op <= opcode::i64_trunc_u_f64);
+	}
+}
+
+void JitWriter::_MaterializeFloat()
+{
+	if (!m_fTopInXmm)
+		return;
+	// movq rax, xmm0
+	static const uint8_t rgcode[] = { 0x66, 0x48, 0x0F, 0x7E, 0xC0 };
+	SafePushCode(rgcode);
+	m_fTopInXmm = false;
+}
+
+// Make sure the float on top of the stack is in xmm0, the op's result replaces it
+void JitWriter::_LoadFloatTop(bool fDouble)
+{
+	if (m_fTopInXmm)
+		return;
+	if (fDouble)
+	{
+		// movq xmm0, rax
+		static const uint8_t rgcode[] = { 0x66, 0x48, 0x0F, 0x6E, 0xC0 };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		// movd xmm0, eax
+		static const uint8_t rgcode[] = { 0x66, 0x0F, 0x6E, 0xC0 };
+		SafePushCode(rgcode);
+	}
+}
+
+// Pop the float below the top of the stack, returns the xmm register it is in (xmm1 unless it was already cached in one)
+JitWriter::Register JitWriter::_PopFloatSecond(bool fDouble)
+{
+	if (!m_vecregStackCache.empty())
+	{
+		Register reg = m_vecregStackCache.back();
+		m_vecregStackCache.pop_back();
+		if (FXmmRegister(reg))
+			return reg;
+		// movq xmm1, reg / movd xmm1, reg
+		const uint8_t rgcode[] = { 0x66, uint8_t(fDouble ? 0x49 : 0x41), 0x0F, 0x6E, uint8_t(0xC8 | (uint8_t(reg) & 7)) };
+		SafePushCode(rgcode);
+		return Register::xmm1;
+	}
+	if (fDouble)
+	{
+		// movq xmm1, [rdi - 8]
+		static const uint8_t rgcode[] = { 0xF3, 0x0F, 0x7E, 0x4F, 0xF8 };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		// movd xmm1, [rdi - 8]
+		static const uint8_t rgcode[] = { 0x66, 0x0F, 0x6E, 0x4F, 0xF8 };
+		SafePushCode(rgcode);
+	}
+	// lea rdi, [rdi - 8]
+	static const uint8_t rgcodeLea[] = { 0x48, 0x8D, 0x7F, 0xF8 };
+	SafePushCode(rgcodeLea);
+	--m_cslotStack;
+	return Register::xmm1;
+}
+
+// The effective address of a wasm access is the zero extended 32-bit address plus the 32-bit offset.  This
+//	is at most 33 bits which stays inside the 8GB heap reservation so it can be formed directly by the address mode.
+// Expects the address zero extended in rcx, returns the displacement left for _HeapOperand
+uint32_t JitWriter::_PrepareHeapIndex(uint32_t offset)
+{
+	if (offset <= INT32_MAX)
+		return offset;
+	// disp32 is sign extended so large offsets are added to the index instead
+	// mov edx, offset
+	// add rcx, rdx
+	SafePushCode(uint8_t(0xBA));
 	SafePushCode(offset);
+	static const uint8_t rgcodeAdd[] = { 0x48, 0x01, 0xD1 };
+	SafePushCode(rgcodeAdd);
+	return 0;
+}
+
+// Emit the ModRM/SIB/disp bytes for eax/rax and [rsi + rcx + disp]
+void JitWriter::_HeapOperand(uint32_t disp)
+{
+	Verify(disp <= INT32_MAX);
+	if (disp == 0)
+	{
+		static const uint8_t rgcode[] = { 0x04, 0x0E };
+		SafePushCode(rgcode);
+	}
+	else if (disp < 0x80)
+	{
+		const uint8_t rgcode[] = { 0x44, 0x0E, uint8_t(disp) };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		static const uint8_t rgcode[] = { 0x84, 0x0E };
+		SafePushCode(rgcode);
+		SafePushCode(disp);
+	}
+}
+
+void JitWriter::LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbSrc, bool fSignExtend)
+{
+	if (m_fAddrPending)
+	{
+		// the address was computed straight into rcx so it was never pushed
+		m_fAddrPending = false;
+		_PushExpandStack();
+	}
+	else
+	{
+		// mov ecx, eax		; zero extend the address
+		static const uint8_t rgcodeMov[] = { 0x89, 0xC1 };
+		SafePushCode(rgcodeMov);
+	}
+	uint32_t disp = _PrepareHeapIndex(offset);
 
 	const char *szCode = nullptr;
 	if (fSignExtend)
@@ -136,18 +505,18 @@ void JitWriter::LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbS
 				break;
 
 			case 1:
-				// movsx rax, byte ptr [rsi+rax]
-				szCode = "\x48\x0F\xBE\x04\x06";
+				// movsx rax, byte ptr [rsi + rcx + offset]
+				szCode = "\x48\x0F\xBE";
 				break;
 
 			case 2:
-				// movsx rax, word ptr [rsi+rax]
-				szCode = "\x48\x0F\xBF\x04\x06";
+				// movsx rax, word ptr [rsi + rcx + offset]
+				szCode = "\x48\x0F\xBF";
 				break;
 
 			case 4:
-				// movsx rax, dword ptr [rsi+rax]
-				szCode = "\x48\x63\x04\x06";
+				// movsx rax, dword ptr [rsi + rcx + offset]
+				szCode = "\x48\x63";
 				break;
 			}
 		}
@@ -160,13 +529,13 @@ void JitWriter::LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbS
 				break;
 
 			case 1:
-				// movsx eax, byte ptr [rsi + rax]
-				szCode = "\x0F\xBE\x04\x06";
+				// movsx eax, byte ptr [rsi + rcx + offset]
+				szCode = "\x0F\xBE";
 				break;
 
 			case 2:
-				// movsx eax, word ptr [rsi + rax]
-				szCode = "\x0F\xBF\x04\x06";
+				// movsx eax, word ptr [rsi + rcx + offset]
+				szCode = "\x0F\xBF";
 			}
 		}
 	}
@@ -175,24 +544,24 @@ void JitWriter::LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbS
 		switch (cbSrc)
 		{
 		case 1:
-			// movzx eax, byte ptr [rsi+rax]
-			szCode = "\x0F\xB6\x04\x06";
+			// movzx eax, byte ptr [rsi + rcx + offset]
+			szCode = "\x0F\xB6";
 			break;
 
 		case 2:
-			// movzx eax, word ptr [rsi + rax]
-			szCode = "\x0F\xB7\x04\x06";
+			// movzx eax, word ptr [rsi + rcx + offset]
+			szCode = "\x0F\xB7";
 			break;
 
 		case 4:
-			// mov eax, dword ptr [rsi + rax]
-			szCode = "\x8B\x04\x06";
+			// mov eax, dword ptr [rsi + rcx + offset]
+			szCode = "\x8B";
 			break;
 
 		case 8:
 			Verify(f64Dst);
-			// mov rax, qword ptr [rsi + rax]
-			szCode = "\x48\x8B\x04\x06";
+			// mov rax, qword ptr [rsi + rcx + offset]
+			szCode = "\x48\x8B";
 			break;
 
 		default:
@@ -201,14 +570,16 @@ void JitWriter::LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbS
 	}
 	Verify(szCode != nullptr);
 	SafePushCode(szCode, strlen(szCode));
+	_HeapOperand(disp);
 }
+
 void JitWriter::StoreMem(uint32_t offset, uint32_t cbDst)
 {
 	_PopSecondParam();
-	// add ecx, offset	; note this implicitly ands with 0xffffffff ensuring that when referenced as rax it will always be a positive number between 0 and 2^32 - 1
-	static const uint8_t rgcodeAdd[] = { 0x81, 0xC1 };
-	SafePushCode(rgcodeAdd);
-	SafePushCode(offset);
+	// mov ecx, ecx		; zero extend the address
+	static const uint8_t rgcodeMov[] = { 0x89, 0xC9 };
+	SafePushCode(rgcodeMov);
+	uint32_t disp = _PrepareHeapIndex(offset);
 
 	const char *szCode = nullptr;
 	switch (cbDst)
@@ -218,31 +589,199 @@ void JitWriter::StoreMem(uint32_t offset, uint32_t cbDst)
 		break;
 
 	case 1:
-		// mov [rsi + rcx], al
-		szCode = "\x88\x04\x0E";
+		// mov [rsi + rcx + offset], al
+		szCode = "\x88";
 		break;
 
 	case 2:
-		// mov [rsi + rcx], ax
-		szCode = "\x66\x89\x04\x0E";
+		// mov [rsi + rcx + offset], ax
+		szCode = "\x66\x89";
 		break;
 
 	case 4:
-		// mov [rsi + rcx], eax
-		szCode = "\x89\x04\x0E";
+		// mov [rsi + rcx + offset], eax
+		szCode = "\x89";
 		break;
 
 	case 8:
-		// mov [rsi + rcx], rax
-		szCode = "\x48\x89\x04\x0E";
+		// mov [rsi + rcx + offset], rax
+		szCode = "\x48\x89";
 		break;
 	}
 	Verify(szCode != nullptr);
 	SafePushCode(szCode, strlen(szCode));
+	_HeapOperand(disp);
+}
+
+// mov reg32, local	; the upper half of the register is zeroed
+void JitWriter::_LoadLocal32(Register regDst, uint32_t idx)
+{
+	uint8_t regT = uint8_t(regDst) & 7;
+	Register regLocal;
+	if (_FPinnedLocal(idx, &regLocal))
+	{
+		// mov regDst32, regLocal32
+		uint8_t rex = 0x40 | ((uint8_t(regLocal) >> 3) << 2) | (uint8_t(regDst) >> 3);
+		if (rex != 0x40)
+			SafePushCode(rex);
+		const uint8_t rgcode[] = { 0x89, uint8_t(0xC0 | ((uint8_t(regLocal) & 7) << 3) | regT) };
+		SafePushCode(rgcode);
+		return;
+	}
+	// mov regDst32, [rbx+idx]
+	if (uint8_t(regDst) >= 8)
+		SafePushCode(uint8_t(0x44));
+	const uint8_t rgcode[] = { 0x8B, uint8_t(0x83 | (regT << 3)) };
+	SafePushCode(rgcode);
+	SafePushCode(uint32_t(idx * sizeof(uint64_t)));
+}
+
+// Look for an address computed purely from locals that feeds straight into a load:
+//		get_local p								; load				-> [rsi + p + offset]
+//		get_local p  i32.const K  i32.add			; load				-> lea ecx, [p + K]
+//		get_local p  get_local i  i32.const S  i32.shl  i32.add	; load	-> lea ecx, [p + i*2^S]
+//	The address is built in ecx with 32-bit arithmetic so wraparound is exactly the same as the wasm ops we replace.
+//	On success the ops are consumed and LoadMem picks the address up from rcx.
+//	The locals in the bytecode are offset by ilocalBase (non zero for the body of an inlined callee).
+bool JitWriter::FFoldLocalAddress(uint32_t idx, uint32_t ilocalBase, uint32_t clocals, const uint8_t **ppop, size_t *pcb)
+{
+	const uint8_t *pop = *ppop;
+	size_t cb = *pcb;
+	auto FIsLoad = [](opcode op) { return op >= opcode::i32_load && op <= opcode::i64_load32_u; };
+	auto OpNext = [&]() { return (cb > 0) ? opcode(*pop) : opcode::unreachable; };
+	auto FConsume = [&](opcode op) {
+		if (OpNext() != op)
+			return false;
+		safe_read_buffer<opcode>(&pop, &cb);
+		return true;
+	};
+
+	if (FIsLoad(OpNext()))
+	{
+		_LoadLocal32(Register::rcx, idx);
+	}
+	else if (FConsume(opcode::i32_const))
+	{
+		int32_t c = safe_read_buffer<varint32>(&pop, &cb);
+		if (!FConsume(opcode::i32_add) || !FIsLoad(OpNext()))
+			return false;
+		Register regBase;
+		if (_FPinnedLocal(idx, &regBase))
+		{
+			// lea ecx, [regBase + c]
+			const uint8_t rgcode[] = { 0x41, 0x8D, uint8_t(0x88 | (uint8_t(regBase) & 7)) };
+			SafePushCode(rgcode);
+			if ((uint8_t(regBase) & 7) == 4)
+				SafePushCode(uint8_t(0x24));	// r12 needs a SIB byte
+		}
+		else
+		{
+			_LoadLocal32(Register::rcx, idx);
+			// lea ecx, [rcx + c]
+			static const uint8_t rgcode[] = { 0x8D, 0x89 };
+			SafePushCode(rgcode);
+		}
+		SafePushCode(c);
+	}
+	else if (FConsume(opcode::get_local))
+	{
+		uint32_t idxIndex = safe_read_buffer<varuint32>(&pop, &cb);
+		if (idxIndex >= clocals || !FConsume(opcode::i32_const))
+			return false;
+		idxIndex += ilocalBase;
+		int32_t shift = safe_read_buffer<varint32>(&pop, &cb);
+		if (shift < 1 || shift > 3 || !FConsume(opcode::i32_shl) || !FConsume(opcode::i32_add) || !FIsLoad(OpNext()))
+			return false;
+		Register regBase = Register::rcx;
+		Register regIndex = Register::rdx;
+		if (!_FPinnedLocal(idx, &regBase))
+			_LoadLocal32(Register::rcx, idx);
+		if (!_FPinnedLocal(idxIndex, &regIndex))
+			_LoadLocal32(Register::rdx, idxIndex);
+		// lea ecx, [regBase + regIndex * 2^shift]		; r13 can't be a SIB base without a displacement
+		bool fDisp8 = (uint8_t(regBase) & 7) == 5;
+		uint8_t rex = 0x40 | ((uint8_t(regIndex) >> 3) << 1) | (uint8_t(regBase) >> 3);
+		if (rex != 0x40)
+			SafePushCode(rex);
+		const uint8_t rgcode[] = { 0x8D, uint8_t(fDisp8 ? 0x4C : 0x0C), uint8_t((shift << 6) | ((uint8_t(regIndex) & 7) << 3) | (uint8_t(regBase) & 7)) };
+		SafePushCode(rgcode);
+		if (fDisp8)
+			SafePushCode(uint8_t(0));
+	}
+	else
+	{
+		return false;
+	}
+
+#ifdef PRINT_DISASSEMBLY
+	printf("\t(address folded into the load)\n");
+#endif
+	m_fAddrPending = true;
+	*ppop = pop;
+	*pcb = cb;
+	return true;
+}
+
+// Can a constant pushed just before opNext be folded into it as an immediate
+bool JitWriter::FConstFoldable(opcode opNext, int64_t c, bool f64)
+{
+	// Division by a constant becomes a multiply, except for the divisors that have to trap
+	if (f64 ? (opNext >= opcode::i64_div_s && opNext <= opcode::i64_rem_u) : (opNext >= opcode::i32_div_s && opNext <= opcode::i32_rem_u))
+		return c != 0 && !(c == -1 && (opNext == opcode::i32_div_s || opNext == opcode::i64_div_s));
+
+	if (f64)
+	{
+		if (c != int32_t(c))
+			return false;	// x64 only has sign extended 32-bit immediates
+		return (opNext >= opcode::i64_eq && opNext <= opcode::i64_ge_u)
+			|| (opNext >= opcode::i64_add && opNext <= opcode::i64_mul)
+			|| (opNext >= opcode::i64_and && opNext <= opcode::i64_rotr);
+	}
+	return (opNext >= opcode::i32_eq && opNext <= opcode::i32_ge_u)
+		|| (opNext >= opcode::i32_add && opNext <= opcode::i32_mul)
+		|| (opNext >= opcode::i32_and && opNext <= opcode::i32_rotr);
+}
+
+// op rax, imm (opext is the /digit of the 0x81/0x83 group)
+void JitWriter::_ArithImmPending(uint8_t opext, bool f64)
+{
+	Verify(m_fConstPending);
+	m_fConstPending = false;
+	if (f64)
+		SafePushCode(uint8_t(0x48));
+	if (m_constPending == int8_t(m_constPending))
+	{
+		// op eax, imm8
+		const uint8_t rgcode[] = { 0x83, uint8_t(0xC0 | (opext << 3)), uint8_t(m_constPending) };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		// op eax, imm32
+		const uint8_t rgcode[] = { 0x81, uint8_t(0xC0 | (opext << 3)) };
+		SafePushCode(rgcode);
+		SafePushCode(int32_t(m_constPending));
+	}
+}
+
+// shift rax, imm8 (opext is the /digit of the 0xC1 group)
+void JitWriter::_ShiftImmPending(uint8_t opext, bool f64)
+{
+	Verify(m_fConstPending);
+	m_fConstPending = false;
+	if (f64)
+		SafePushCode(uint8_t(0x48));
+	const uint8_t rgcode[] = { 0xC1, uint8_t(0xC0 | (opext << 3)), uint8_t(m_constPending & (f64 ? 63 : 31)) };
+	SafePushCode(rgcode);
 }
 
 void JitWriter::Sub32()
 {
+	if (m_fConstPending)
+	{
+		_ArithImmPending(5, false /*f64*/);	// sub eax, imm
+		return;
+	}
 	_PopSecondParam(true);
 	// sub eax, ecx
 	static const uint8_t rgcode[] = { 0x29, 0xC8 };
@@ -251,6 +790,11 @@ void JitWriter::Sub32()
 
 void JitWriter::Add32()
 {
+	if (m_fConstPending)
+	{
+		_ArithImmPending(0, false /*f64*/);	// add eax, imm
+		return;
+	}
 	_PopSecondParam();
 	// add eax, ecx
 	static const uint8_t rgcode[] = { 0x01, 0xC8 };
@@ -259,6 +803,11 @@ void JitWriter::Add32()
 
 void JitWriter::Add64()
 {
+	if (m_fConstPending)
+	{
+		_ArithImmPending(0, true /*f64*/);	// add rax, imm
+		return;
+	}
 	_PopSecondParam();
 	// add rax, rcx
 	static const uint8_t rgcode[] = { 0x48, 0x01, 0xC8 };
@@ -267,6 +816,11 @@ void JitWriter::Add64()
 
 void JitWriter::Sub64()
 {
+	if (m_fConstPending)
+	{
+		_ArithImmPending(5, true /*f64*/);	// sub rax, imm
+		return;
+	}
 	_PopSecondParam(true);
 	// sub rax, rcx
 	static const uint8_t rgcode[] = { 0x48, 0x29, 0xC8 };
@@ -339,18 +893,69 @@ void JitWriter::PushF64(double val)
 
 void JitWriter::Ud2()
 {
-	// NYI: ud2
+	// ud2 - the trap handler turns this into a wasm trap
 	static const uint8_t rgcode[] = { 0x0F, 0x0B };
 	SafePushCode(rgcode, _countof(rgcode));
 }
 
-void JitWriter::SetLocal(uint32_t idx, bool fPop)
+bool JitWriter::_FPinnedLocal(uint32_t idx, Register *preg) const
+{
+	for (auto &pairLocalReg : m_vecpairLocalReg)
+	{
+		if (pairLocalReg.first == idx)
+		{
+			*preg = pairLocalReg.second;
+			return true;
+		}
+	}
+	return false;
+}
+
+void JitWriter::_StoreLocalMem(uint32_t idx)
 {
 	// mov [rbx+idx], rax
 	static const uint8_t rgcode[] = { 0x48, 0x89, 0x83 };
 	SafePushCode(rgcode, _countof(rgcode));
 	idx *= sizeof(uint64_t);
 	SafePushCode(&idx, sizeof(idx));
+}
+
+// Write the pinned locals back to the locals array, the callee will use the same registers for its own locals
+void JitWriter::_SpillPinnedLocals()
+{
+	for (auto &pairLocalReg : m_vecpairLocalReg)
+	{
+		// mov [rbx+idx], reg
+		const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0x83 | ((uint8_t(pairLocalReg.second) & 7) << 3)) };
+		SafePushCode(rgcode);
+		SafePushCode(uint32_t(pairLocalReg.first * sizeof(uint64_t)));
+	}
+}
+
+void JitWriter::_ReloadPinnedLocals()
+{
+	for (auto &pairLocalReg : m_vecpairLocalReg)
+	{
+		// mov reg, [rbx+idx]
+		const uint8_t rgcode[] = { 0x4C, 0x8B, uint8_t(0x83 | ((uint8_t(pairLocalReg.second) & 7) << 3)) };
+		SafePushCode(rgcode);
+		SafePushCode(uint32_t(pairLocalReg.first * sizeof(uint64_t)));
+	}
+}
+
+void JitWriter::SetLocal(uint32_t idx, bool fPop)
+{
+	Register reg;
+	if (_FPinnedLocal(idx, &reg))
+	{
+		// mov reg, rax
+		const uint8_t rgcode[] = { 0x49, 0x89, uint8_t(0xC0 | (uint8_t(reg) & 7)) };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		_StoreLocalMem(idx);
+	}
 	if (fPop)
 		_PopContractStack();
 }
@@ -358,6 +963,14 @@ void JitWriter::SetLocal(uint32_t idx, bool fPop)
 void JitWriter::GetLocal(uint32_t idx)
 {
 	_PushExpandStack();
+	Register reg;
+	if (_FPinnedLocal(idx, &reg))
+	{
+		// mov rax, reg
+		const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0xC0 | ((uint8_t(reg) & 7) << 3)) };
+		SafePushCode(rgcode);
+		return;
+	}
 	// mov rax, [rbx+idx]
 	static const uint8_t rgcode[] = { 0x48, 0x8B, 0x83 };
 	idx *= sizeof(uint64_t);
@@ -367,128 +980,182 @@ void JitWriter::GetLocal(uint32_t idx)
 
 void JitWriter::EnterBlock()
 {
-	_PushExpandStack();	// backup rax
-	// push rdi
-	static const uint8_t rgcode[] = { 0x57 };
-	SafePushCode(rgcode, _countof(rgcode));
+	_SpillStack();	// backup rax
+	m_veccslotBlock.push_back(m_cslotStack);
 }
 
 int32_t *JitWriter::EnterIF()
 {
-	// sub rdi, 8
-	// test rax, rax
-	// mov rax, [rdi]
-	static const uint8_t rgcodeTest[] = { 0x48, 0x83, 0xEF, 0x08, 0x48, 0x85, 0xC0, 0x48, 0x8B, 0x07 };
-	SafePushCode(rgcodeTest);
-	// jz rel32
-	static const uint8_t rgcodeJz[] = {0x0F, 0x84};
-	SafePushCode(rgcodeJz);
+	ConditionCode cond = _PopCondition();
+	_FlushStack();			// the else path must see the same stack we do
+	// jcc rel32			; jump to the else when the condition is false
+	const uint8_t rgcodeJcc[] = { 0x0F, uint8_t(0x80 | (uint8_t(cond) ^ 1)) };
+	SafePushCode(rgcodeJcc);
 	int32_t *prel32Ret = (int32_t*)m_pexecPlaneCur;
 	SafePushCode(int32_t(0));	// placeholder
 
-	_PushExpandStack();	// backup rax
-
-	// push rdi
-	static const uint8_t rgcode[] = { 0x57 };
-	SafePushCode(rgcode);
+	_SpillStack();	// backup rax
+	m_veccslotBlock.push_back(m_cslotStack);
 
 	return prel32Ret;
 }
 
-void JitWriter::LeaveBlock(bool fHasReturn)
+// Put rdi back where it was when the block depth levels out was entered, the block's value (if any) stays in rax.
+//	Otherwise rax is reloaded with the operand the block entry spilled, which is the top of the stack again.
+// NOTE: Must not affect flags
+void JitWriter::LeaveBlock(uint32_t depth, bool fHasReturn)
 {
-	// pop rdi
-	static const uint8_t rgcode[] = { 0x5F };
-	SafePushCode(rgcode, _countof(rgcode));
+	_DiscardStackCache();
+	m_fTopInXmm = false;
+	int32_t cslotTarget = *(m_veccslotBlock.rbegin() + depth);
 	if (!fHasReturn)
-		_PopContractStack();
+	{
+		--cslotTarget;
+		// mov rax, [rdi + disp]
+		_RdiModRM(0x8B, 0, cslotTarget - m_cslotStack);
+	}
+	_SetStackHeight(cslotTarget);
+}
+
+// Branches to a loop go back to its head and carry no value, everything else carries the block's value
+bool JitWriter::FBranchValue(const std::pair<value_type, void*> &pairBlock)
+{
+	return pairBlock.second == nullptr && pairBlock.first != value_type::empty_block;
+}
+
+// Emit op with a ModRM for [rdi + cslot*8] and a 64-bit reg (the shortest displacement that fits)
+void JitWriter::_RdiModRM(uint8_t op, uint8_t reg, int32_t cslot)
+{
+	int32_t disp = cslot * int32_t(sizeof(uint64_t));
+	bool fDisp8 = (disp == int8_t(disp));
+	const uint8_t rgcode[] = { 0x48, op, uint8_t((fDisp8 ? 0x47 : 0x87) | (reg << 3)) };
+	SafePushCode(rgcode);
+	if (fDisp8)
+		SafePushCode(int8_t(disp));
+	else
+		SafePushCode(disp);
+}
+
+// Move rdi to the statically known height cslot
+// NOTE: Must not affect flags
+void JitWriter::_SetStackHeight(int32_t cslot)
+{
+	if (cslot != m_cslotStack)
+	{
+		// lea rdi, [rdi + disp]
+		_RdiModRM(0x8D, 7, cslot - m_cslotStack);
+	}
+	m_cslotStack = cslot;
+}
+
+// Comparisons leave their result in the flags, it is only turned into a 0/1 value if the next op isn't a branch or select
+void JitWriter::_SetCondPending(ConditionCode cond)
+{
+	m_fCondPending = true;
+	m_condPending = cond;
+}
+
+void JitWriter::_MaterializeCond()
+{
+	if (!m_fCondPending)
+		return;
+	// setcc al
+	// movzx eax, al
+	const uint8_t rgcode[] = { 0x0F, uint8_t(0x90 | uint8_t(m_condPending)), 0xC0, 0x0F, 0xB6, 0xC0 };
+	SafePushCode(rgcode);
+	m_fCondPending = false;
+}
+
+// Pop the boolean on top of the stack into the flags, returns the condition code that is set when it was true
+// NOTE: Must not affect flags after the test
+JitWriter::ConditionCode JitWriter::_PopCondition()
+{
+	ConditionCode cond = ConditionCode::NotEqual;
+	if (m_fCondPending)
+	{
+		cond = m_condPending;
+		m_fCondPending = false;
+	}
+	else
+	{
+		// test eax, eax
+		static const uint8_t rgcodeTest[] = { 0x85, 0xC0 };
+		SafePushCode(rgcodeTest);
+	}
+	_PopContractStack();	// does not affect flags
+	return cond;
 }
 
 void JitWriter::Eqz32()
 {
+	if (m_fCondPending)
+	{
+		// eqz of a comparison is just the inverse comparison
+		m_condPending = ConditionCode(uint8_t(m_condPending) ^ 1);
+		return;
+	}
 	//	test eax, eax		{ 0x85, 0xC0 }
-	//	mov eax, 1			{ 0xb8, 0x01, 0x00, 0x00, 0x00}
-	//  jz  Lz				{ 0x74, 0x02 }
-	//	xor eax, eax		{ 0x31, 0xC0 }
-	// Lz:
-	static const uint8_t rgcode[] = { 0x85, 0xC0, 0xB8, 0x01, 0x00, 0x00, 0x00, 0x74, 0x02, 0x31, 0xC0 };
+	static const uint8_t rgcode[] = { 0x85, 0xC0 };
 	SafePushCode(rgcode, _countof(rgcode));
+	_SetCondPending(ConditionCode::Equal);
 }
 
 void JitWriter::Eqz64()
 {
 	//	test rax, rax		{ 0x48, 0x85, 0xC0 }
-	//	mov eax, 1			{ 0xb8, 0x01, 0x00, 0x00, 0x00}
-	//  jz  Lz				{ 0x74, 0x02 }
-	//	xor eax, eax		{ 0x31, 0xC0 }
-	// Lz:
-	static const uint8_t rgcode[] = { 0x48, 0x85, 0xC0, 0xB8, 0x01, 0x00, 0x00, 0x00, 0x74, 0x02, 0x31, 0xC0 };
+	static const uint8_t rgcode[] = { 0x48, 0x85, 0xC0 };
 	SafePushCode(rgcode, _countof(rgcode));
+	_SetCondPending(ConditionCode::Equal);
 }
 
 void JitWriter::Compare(CompareType type, bool fSigned, bool f64)
 {
-	_PopSecondParam();
-	//		cmp rcx, rax		{ 0x48, 0x39, 0xc1 }			// yes the order is reversed... this is by the spec
-	//		mov eax, 1			{ b8 01 00 00 00}
-	//		jcc LTrue			{ XX, 0x02 }	2-byte forward rel jump
-	//		xor eax, eax		{ 31 c0 }
-	// LTrue:
-	static const uint8_t rgcodeCmp64[] = { 0x48, 0x39, 0xc1 };
-	static const uint8_t rgcodeCmp32[] = { 0x39, 0xC1 };
-	static const uint8_t rgcodePre[] = { 0xb8, 0x01, 0x00, 0x00, 0x00 };
-	static const uint8_t rgcodePost[] = { 0x02, 0x31, 0xc0 };
-
-	if (f64)
-		SafePushCode(rgcodeCmp64, _countof(rgcodeCmp64));
+	if (m_fConstPending)
+	{
+		_ArithImmPending(7, f64);	// cmp rax, imm
+	}
 	else
-		SafePushCode(rgcodeCmp32, _countof(rgcodeCmp32));
+	{
+		_PopSecondParam();
+		//		cmp rcx, rax		{ 0x48, 0x39, 0xc1 }			// yes the order is reversed... this is by the spec
+		static const uint8_t rgcodeCmp64[] = { 0x48, 0x39, 0xc1 };
+		static const uint8_t rgcodeCmp32[] = { 0x39, 0xC1 };
+
+		if (f64)
+			SafePushCode(rgcodeCmp64, _countof(rgcodeCmp64));
+		else
+			SafePushCode(rgcodeCmp32, _countof(rgcodeCmp32));
+	}
 
-	SafePushCode(rgcodePre, _countof(rgcodePre));
-	uint8_t cmpOp = 0xCC;	// int3 BUG
 	switch (type)
 	{
 	case CompareType::LessThan:
-		if (fSigned)
-			cmpOp = 0x7C;	// JL  rel8
-		else
-			cmpOp = 0x72;	// JB  rel8
+		_SetCondPending(fSigned ? ConditionCode::Less : ConditionCode::Below);
 		break;
 
 	case CompareType::LessThanEqual:
-		if (fSigned)
-			cmpOp = 0x7E;	// JLE rel8
-		else
-			cmpOp = 0x76;	// JBE rel8
+		_SetCondPending(fSigned ? ConditionCode::LessEqual : ConditionCode::BelowEqual);
 		break;
 
 	case CompareType::Equal:
-		cmpOp = 0x74;		// JE rel8
+		_SetCondPending(ConditionCode::Equal);
 		break;
 
 	case CompareType::NotEqual:
-		cmpOp = 0x75;		// JNE rel8
+		_SetCondPending(ConditionCode::NotEqual);
 		break;
 
 	case CompareType::GreaterThanEqual:
-		if (fSigned)
-			cmpOp = 0x7D;	// JGE rel8
-		else
-			cmpOp = 0x73;	// JAE rel8
+		_SetCondPending(fSigned ? ConditionCode::GreaterEqual : ConditionCode::AboveEqual);
 		break;
 
 	case CompareType::GreaterThan:
-		if (fSigned)
-			cmpOp = 0x7F;	// JG rel8
-		else
-			cmpOp = 0x77;	// JA rel8
+		_SetCondPending(fSigned ? ConditionCode::Greater : ConditionCode::Above);
 		break;
 
 	default:
 		Verify(false);
 	}
-	SafePushCode(&cmpOp, sizeof(cmpOp));
-	SafePushCode(rgcodePost, _countof(rgcodePost));
 }
 
 void JitWriter::CallAsmOp(void **pfn)
@@ -509,34 +1176,50 @@ void JitWriter::Convert(value_type typeDst, value_type typeSrc, bool fSigned)
 		switch (typeSrc)
 		{
 		case value_type::f32:
+			// Out of range and NaN inputs trap.  Converting to 64-bits makes those the only results outside the 32-bit range
+			//	so one compare is enough, and the ud2 is picked up by the trap handler.
+			_LoadFloatTop(false /*fDouble*/);
 			if (fSigned)
 			{
-				// movd xmm0, eax
-				// CVTTSS2SI eax, xmm0
-				szConv = "\x66\x0F\x6E\xC0\xF3\x0F\x2C\xC0";
+				// CVTTSS2SI rax, xmm0
+				// movsxd rcx, eax
+				// cmp rcx, rax
+				// je $+2
+				// ud2
+				// mov eax, eax
+				szConv = "\xF3\x48\x0F\x2C\xC0\x48\x63\xC8\x48\x39\xC1\x74\x02\x0F\x0B\x89\xC0";
 			}
 			else
 			{
-				// movd xmm0, eax
 				// CVTTSS2SI rax, xmm0
-				// mov eax, eax
-				szConv = "\x66\x0F\x6E\xC0\xF3\x48\x0F\x2C\xC0\x89\xC0";
+				// mov rcx, rax
+				// shr rcx, 32
+				// jz $+2
+				// ud2
+				szConv = "\xF3\x48\x0F\x2C\xC0\x48\x89\xC1\x48\xC1\xE9\x20\x74\x02\x0F\x0B";
 			}
 			break;
 
 		case value_type::f64:
+			_LoadFloatTop(true /*fDouble*/);
 			if (fSigned)
 			{
-				// movq xmm0, rax
-				// CVTTSD2SI eax, xmm0
-				szConv = "\x66\x48\x0F\x6E\xC0\xF2\x0F\x2C\xC0";
+				// CVTTSD2SI rax, xmm0
+				// movsxd rcx, eax
+				// cmp rcx, rax
+				// je $+2
+				// ud2
+				// mov eax, eax
+				szConv = "\xF2\x48\x0F\x2C\xC0\x48\x63\xC8\x48\x39\xC1\x74\x02\x0F\x0B\x89\xC0";
 			}
 			else
 			{
-				// movq xmm0, rax
 				// CVTTSD2SI rax, xmm0
-				// mov eax, eax
-				szConv = "\x66\x48\x0F\x6E\xC0\xF2\x48\x0F\x2C\xC0\x89\xC0";
+				// mov rcx, rax
+				// shr rcx, 32
+				// jz $+2
+				// ud2
+				szConv = "\xF2\x48\x0F\x2C\xC0\x48\x89\xC1\x48\xC1\xE9\x20\x74\x02\x0F\x0B";
 			}
 			break;
 		}
@@ -548,12 +1231,26 @@ void JitWriter::Convert(value_type typeDst, value_type typeSrc, bool fSigned)
 		case value_type::f32:
 			if (fSigned)
 			{
-				// movd xmm0, eax
-				// CVTTSS2SI rax, xmm0
-				szConv = "\x66\x0F\x6E\xC0\xF3\x48\x0F\x2C\xC0";
+				// Invalid inputs give 0x8000000000000000 which is also the correct result for exactly -2^63, only then look at the input
+				_LoadFloatTop(false /*fDouble*/);
+				static const uint8_t rgcode[] = {
+					0xF3, 0x48, 0x0F, 0x2C, 0xC0,			// cvttss2si rax, xmm0
+					0x48, 0x83, 0xF8, 0x01,					// cmp rax, 1		; only overflows for 0x8000000000000000
+					0x71, 0x12,								// jno LDone
+					0xB9, 0x00, 0x00, 0x00, 0xDF,			// mov ecx, -2^63f
+					0x66, 0x0F, 0x6E, 0xC9,					// movd xmm1, ecx
+					0x0F, 0x2E, 0xC1,						// ucomiss xmm0, xmm1
+					0x7A, 0x02,								// jp LTrap
+					0x74, 0x02,								// je LDone
+					0x0F, 0x0B,								// LTrap: ud2
+				};											// LDone:
+				SafePushCode(rgcode);
+				m_fTopInXmm = false;
+				return;
 			}
 			else
 			{
+				_MaterializeFloat();
 				CallAsmOp(m_pfnF32ToU64Trunc);
 				return;
 			}
@@ -562,42 +1259,58 @@ void JitWriter::Convert(value_type typeDst, value_type typeSrc, bool fSigned)
 		case value_type::f64:
 			if (fSigned)
 			{
-				// movq xmm0, rax
-				// cvttsd2si rax, xmm0
-				szConv = "\x66\x48\x0F\x6E\xC0\xF2\x48\x0F\x2C\xC0";
+				// Invalid inputs give 0x8000000000000000 which is also the correct result for exactly -2^63, only then look at the input
+				_LoadFloatTop(true /*fDouble*/);
+				static const uint8_t rgcode[] = {
+					0xF2, 0x48, 0x0F, 0x2C, 0xC0,			// cvttsd2si rax, xmm0
+					0x48, 0x83, 0xF8, 0x01,					// cmp rax, 1		; only overflows for 0x8000000000000000
+					0x71, 0x19,								// jno LDone
+					0x48, 0xB9, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xE0, 0xC3,	// mov rcx, -2^63
+					0x66, 0x48, 0x0F, 0x6E, 0xC9,			// movq xmm1, rcx
+					0x66, 0x0F, 0x2E, 0xC1,					// ucomisd xmm0, xmm1
+					0x7A, 0x02,								// jp LTrap
+					0x74, 0x02,								// je LDone
+					0x0F, 0x0B,								// LTrap: ud2
+				};											// LDone:
+				SafePushCode(rgcode);
+				m_fTopInXmm = false;
+				return;
 			}
 			else
 			{
+				_MaterializeFloat();
 				CallAsmOp(m_pfnF64ToU64Trunc);
 				return;
 			}
 		}
 		break;
 
+	// Float results are left in xmm0 for the next float op.  cvtsi2ss/cvtsd2ss only write the low lanes so the
+	//	destination is zeroed first, that breaks the dependency on its old value and keeps bits 32-63 of an f32 clear.
 	case value_type::f32:
 		switch (typeSrc)
 		{
 		case value_type::i32:
 			if (fSigned)
 			{
+				// xorps xmm0, xmm0
 				// cvtsi2ss xmm0, eax
-				// movd eax, xmm0
-				szConv = "\xF3\x0F\x2A\xC0\x66\x0F\x7E\xC0";
+				szConv = "\x0F\x57\xC0\xF3\x0F\x2A\xC0";
 			}
 			else
 			{
+				// xorps xmm0, xmm0
 				// cvtsi2ss xmm0, rax
-				// movd eax, xmm0
-				szConv = "\xF3\x48\x0F\x2A\xC0\x66\x0F\x7E\xC0";
+				szConv = "\x0F\x57\xC0\xF3\x48\x0F\x2A\xC0";
 			}
 			break;
 
 		case value_type::i64:
 			if (fSigned)
 			{
+				// xorps xmm0, xmm0
 				// cvtsi2ss xmm0, rax
-				// movd eax, xmm0
-				szConv = "\xF3\x48\x0F\x2A\xC0\x66\x0F\x7E\xC0";
+				szConv = "\x0F\x57\xC0\xF3\x48\x0F\x2A\xC0";
 			}
 			else
 			{
@@ -607,10 +1320,11 @@ void JitWriter::Convert(value_type typeDst, value_type typeSrc, bool fSigned)
 			break;
 
 		case value_type::f64:
-			// movq xmm0, rax
-			// cvtsd2ss xmm0, xmm0
-			// movd eax, xmm0
-			szConv = "\x66\x48\x0F\x6E\xC0\xF2\x0F\x5A\xC0\x66\x0F\x7E\xC0";
+			_LoadFloatTop(true /*fDouble*/);
+			// xorps xmm1, xmm1
+			// cvtsd2ss xmm1, xmm0
+			// movaps xmm0, xmm1
+			szConv = "\x0F\x57\xC9\xF2\x0F\x5A\xC8\x0F\x28\xC1";
 			break;
 		}
 		break;
@@ -621,15 +1335,15 @@ void JitWriter::Convert(value_type typeDst, value_type typeSrc, bool fSigned)
 		case value_type::i32:
 			if (!fSigned)
 			{
+				// xorps xmm0, xmm0
 				// cvtsi2sd xmm0, rax
-				// movq rax, xmm0
-				szConv = "\xF2\x48\x0F\x2A\xC0\x66\x48\x0F\x7E\xC0";
+				szConv = "\x0F\x57\xC0\xF2\x48\x0F\x2A\xC0";
 			}
 			else
 			{
+				// xorps xmm0, xmm0
 				// cvtsi2sd xmm0, eax
-				// movq rax, xmm0
-				szConv = "\xF2\x0F\x2A\xC0\x66\x48\x0F\x7E\xC0";
+				szConv = "\x0F\x57\xC0\xF2\x0F\x2A\xC0";
 			}
 			break;
 		case value_type::i64:
@@ -641,149 +1355,113 @@ void JitWriter::Convert(value_type typeDst, value_type typeSrc, bool fSigned)
 			}
 			else
 			{
+				// xorps xmm0, xmm0
 				// cvtsi2sd xmm0, rax
-				// movq rax, xmm0
-				szConv = "\xF2\x48\x0F\x2A\xC0\x66\x48\x0F\x7E\xC0";
+				szConv = "\x0F\x57\xC0\xF2\x48\x0F\x2A\xC0";
 			}
 			break;
 		case value_type::f32:
-			// movd xmm0, eax
+			_LoadFloatTop(false /*fDouble*/);
 			// cvtss2sd xmm0, xmm0
-			// movq rax, xmm0
-			szConv = "\x66\x0F\x6E\xC0\xF3\x0F\x5A\xC0\x66\x48\x0F\x7E\xC0";
+			szConv = "\xF3\x0F\x5A\xC0";
 			break;
 		}
 		break;
 	}
 	Verify(szConv != nullptr);
 	SafePushCode(szConv, strlen(szConv));
+	m_fTopInXmm = (typeDst == value_type::f32 || typeDst == value_type::f64);
 }
 
 void JitWriter::FloatCompare(CompareType type)
 {
-	// Note: Because cmpss only does less than compares we may swap the operands
-	bool fSwap = false;
-	switch (type)
-	{
-	case CompareType::GreaterThan:
-	case CompareType::GreaterThanEqual:
-		fSwap = true;
-	}
-
-	// sub rdi, 8 (for the variable we're about to pop)
-	static const uint8_t rgcodeFixRdi[] = { 0x48, 0x83, 0xEF, 0x08 };
-	SafePushCode(rgcodeFixRdi);
-
-	if (fSwap)
-	{
-		// movd xmm0, eax
-		// movd xmm1, [rdi]
-		static const uint8_t rgcodeMov[] = { 0x66, 0x0F, 0x6E, 0xC0, 0x66, 0x0F, 0x6E, 0x0F };
-		SafePushCode(rgcodeMov);
-	}
-	else
-	{
-		// movd xmm1, eax		; second operand
-		// movd xmm0, [rdi]		; first operand
-		static const uint8_t rgcodeMov[] = { 0x66, 0x0F, 0x6E, 0xC8, 0x66, 0x0F, 0x6E, 0x07 };
-		SafePushCode(rgcodeMov);
-	}
+	_LoadFloatTop(false /*fDouble*/);						// xmm0 = second operand
+	uint8_t regFirst = uint8_t(_PopFloatSecond(false /*fDouble*/)) & 7;
+	m_fTopInXmm = false;
 
-	uint8_t cmpssImm;
+	// Note: ucomiss sets ZF, PF and CF when unordered so "above" and "above or equal" are false for NaNs.
+	//	Equality needs both ZF and PF so it can't be expressed as a single condition code, use cmpss for it.
 	switch (type)
 	{
 	default:
 		Verify(false);
 
 	case CompareType::LessThan:
-	case CompareType::GreaterThan:
-		cmpssImm = 1;
+	case CompareType::LessThanEqual:
+	{
+		// ucomiss xmm0, first
+		const uint8_t rgcodeUcomiss[] = { 0x0F, 0x2E, uint8_t(0xC0 | regFirst) };
+		SafePushCode(rgcodeUcomiss);
+		_SetCondPending((type == CompareType::LessThan) ? ConditionCode::Above : ConditionCode::AboveEqual);
 		break;
+	}
 
-	case CompareType::LessThanEqual:
+	case CompareType::GreaterThan:
 	case CompareType::GreaterThanEqual:
-		cmpssImm = 2;
+	{
+		// ucomiss first, xmm0
+		const uint8_t rgcodeUcomiss[] = { 0x0F, 0x2E, uint8_t(0xC0 | (regFirst << 3)) };
+		SafePushCode(rgcodeUcomiss);
+		_SetCondPending((type == CompareType::GreaterThan) ? ConditionCode::Above : ConditionCode::AboveEqual);
 		break;
+	}
 
 	case CompareType::Equal:
-		cmpssImm = 0;
-		break;
-
 	case CompareType::NotEqual:
-		cmpssImm = 4;
+	{
+		// cmpss first, xmm0, imm8
+		// movd eax, first
+		// and eax, 1
+		const uint8_t rgcodeCmpss[] = { 0xF3, 0x0F, 0xC2, uint8_t(0xC0 | (regFirst << 3)), uint8_t((type == CompareType::Equal) ? 0 : 4), 0x66, 0x0F, 0x7E, uint8_t(0xC0 | (regFirst << 3)), 0x83, 0xE0, 0x01 };
+		SafePushCode(rgcodeCmpss);
 		break;
 	}
-	// cmpss xmm0, xmm1, imm8
-	static const uint8_t rgcodeCmpss[] = { 0xF3, 0x0F, 0xC2, 0xC1 };
-	SafePushCode(rgcodeCmpss);
-	SafePushCode(uint8_t(cmpssImm));
-
-	// movd eax, xmm0
-	// and eax, 1
-	static const uint8_t rgcodeReduceFlag[] = { 0x66, 0x0F, 0x7E, 0xC0, 0x83, 0xE0, 0x01 };
-	SafePushCode(rgcodeReduceFlag);
+	}
 }
 
 void JitWriter::DoubleCompare(CompareType type)
 {
-	// Note: Because cmpsd only does less than compares we may swap the operands
-	bool fSwap = false;
-	switch (type)
-	{
-	case CompareType::GreaterThan:
-	case CompareType::GreaterThanEqual:
-		fSwap = true;
-	}
-
-	if (fSwap)
-	{
-		// movq xmm0, rax
-		// movq xmm1, [rdi]
-		static const uint8_t rgcodeMov[] = { 0x66, 0x48, 0x0F, 0x6E, 0xC0, 0xF3, 0x0F, 0x7E, 0x0F };
-		SafePushCode(rgcodeMov);
-	}
-	else
-	{
-		// movq xmm1, rax		; second operand
-		// movq xmm0, [rdi]		; first operand
-		static const uint8_t rgcodeMov[] = { 0x66, 0x48, 0x0F, 0x6E, 0xC8, 0xF3, 0x0F, 0x7E, 0x07 };
-		SafePushCode(rgcodeMov);
-	}
+	_LoadFloatTop(true /*fDouble*/);						// xmm0 = second operand
+	uint8_t regFirst = uint8_t(_PopFloatSecond(true /*fDouble*/)) & 7;
+	m_fTopInXmm = false;
 
-	uint8_t cmpsdImm;
+	// Note: see FloatCompare for why equality doesn't use ucomisd
 	switch (type)
 	{
 	default:
 		Verify(false);
 
 	case CompareType::LessThan:
-	case CompareType::GreaterThan:
-		cmpsdImm = 1;
+	case CompareType::LessThanEqual:
+	{
+		// ucomisd xmm0, first
+		const uint8_t rgcodeUcomisd[] = { 0x66, 0x0F, 0x2E, uint8_t(0xC0 | regFirst) };
+		SafePushCode(rgcodeUcomisd);
+		_SetCondPending((type == CompareType::LessThan) ? ConditionCode::Above : ConditionCode::AboveEqual);
 		break;
+	}
 
-	case CompareType::LessThanEqual:
+	case CompareType::GreaterThan:
 	case CompareType::GreaterThanEqual:
-		cmpsdImm = 2;
+	{
+		// ucomisd first, xmm0
+		const uint8_t rgcodeUcomisd[] = { 0x66, 0x0F, 0x2E, uint8_t(0xC0 | (regFirst << 3)) };
+		SafePushCode(rgcodeUcomisd);
+		_SetCondPending((type == CompareType::GreaterThan) ? ConditionCode::Above : ConditionCode::AboveEqual);
 		break;
+	}
 
 	case CompareType::Equal:
-		cmpsdImm = 0;
-		break;
-
 	case CompareType::NotEqual:
-		cmpsdImm = 4;
+	{
+		// cmpsd first, xmm0, imm8
+		// movd eax, first
+		// and eax, 1
+		const uint8_t rgcodeCmpsd[] = { 0xF2, 0x0F, 0xC2, uint8_t(0xC0 | (regFirst << 3)), uint8_t((type == CompareType::Equal) ? 0 : 4), 0x66, 0x0F, 0x7E, uint8_t(0xC0 | (regFirst << 3)), 0x83, 0xE0, 0x01 };
+		SafePushCode(rgcodeCmpsd);
 		break;
 	}
-	// sub rdi, 8			; fixup stack for the op we just loaded
-	// cmpsd xmm0, xmm1, imm8
-	static const uint8_t rgcodeCmpss[] = { 0x48, 0x83, 0xEF, 0x08, 0xF2, 0x0F, 0xC2, 0xC1 };
-	SafePushCode(rgcodeCmpss);
-	SafePushCode(uint8_t(cmpsdImm));
-
-	// movd eax, xmm0
-	// and eax, 1
-	static const uint8_t rgcodeReduceFlag[] = { 0x66, 0x0F, 0x7E, 0xC0, 0x83, 0xE0, 0x01 };
-	SafePushCode(rgcodeReduceFlag);
+	}
 }
 
 void JitWriter::FloatNeg(bool f64)
@@ -805,13 +1483,144 @@ void JitWriter::FloatNeg(bool f64)
 	}
 }
 
+void JitWriter::FloatUnary(FloatUnaryOperation op, bool fDouble)
+{
+	switch (op)
+	{
+	case FloatUnaryOperation::Abs:
+		// clear the sign bit
+		if (fDouble)
+		{
+			// btr rax, 63
+			static const uint8_t rgcode[] = { 0x48, 0x0F, 0xBA, 0xF0, 0x3F };
+			SafePushCode(rgcode);
+		}
+		else
+		{
+			// and eax, 7FFFFFFFh
+			static const uint8_t rgcode[] = { 0x25, 0xFF, 0xFF, 0xFF, 0x7F };
+			SafePushCode(rgcode);
+		}
+		return;
+
+	case FloatUnaryOperation::Ceil:
+	case FloatUnaryOperation::Floor:
+	case FloatUnaryOperation::Trunc:
+	case FloatUnaryOperation::Nearest:
+	{
+		// rounding mode as encoded in the roundss immediate
+		uint8_t mode = 0;
+		switch (op)
+		{
+		case FloatUnaryOperation::Nearest: mode = 0; break;
+		case FloatUnaryOperation::Floor: mode = 1; break;
+		case FloatUnaryOperation::Ceil: mode = 2; break;
+		case FloatUnaryOperation::Trunc: mode = 3; break;
+		default: Verify(false);
+		}
+
+		if (!m_fSSE41)
+		{
+			_MaterializeFloat();	// the helpers take the value in rax
+			// mov ecx, mode
+			// call [m_pfnF32Round / m_pfnF64Round]
+			const uint8_t rgcode[] = { 0xB9, mode, 0x00, 0x00, 0x00 };
+			SafePushCode(rgcode);
+			CallAsmOp(fDouble ? m_pfnF64Round : m_pfnF32Round);
+			return;
+		}
+
+		_LoadFloatTop(fDouble);
+		// roundss/roundsd xmm0, xmm0, mode
+		const uint8_t rgcode[] = { 0x66, 0x0F, 0x3A, uint8_t(fDouble ? 0x0B : 0x0A), 0xC0, mode };
+		SafePushCode(rgcode);
+		m_fTopInXmm = true;
+		return;
+	}
+
+	case FloatUnaryOperation::Sqrt:
+	{
+		_LoadFloatTop(fDouble);
+		// sqrtss/sqrtsd xmm0, xmm0
+		const uint8_t rgcode[] = { uint8_t(fDouble ? 0xF2 : 0xF3), 0x0F, 0x51, 0xC0 };
+		SafePushCode(rgcode);
+		m_fTopInXmm = true;
+		return;
+	}
+	}
+	Verify(false);
+}
+
+void JitWriter::FloatMinMax(bool fMax, bool fDouble)
+{
+	// The sequences below give the same result whichever way round the operands are
+	_LoadFloatTop(fDouble);
+	Register regFirst = _PopFloatSecond(fDouble);
+	if (regFirst != Register::xmm1)
+	{
+		// movaps xmm1, first
+		const uint8_t rgcodeMov[] = { 0x0F, 0x28, uint8_t(0xC8 | (uint8_t(regFirst) & 7)) };
+		SafePushCode(rgcodeMov);
+	}
+
+	// minss/maxss return their second operand when either input is NaN or both are zero.  Doing the op both ways round
+	//	and merging the results fixes the zero case: OR-ing for min gives -0, AND-ing for max gives +0.  Any NaN input is
+	//	then replaced by the canonical NaN built from the unordered mask shifted up into the exponent and quiet bit.
+	const uint8_t prefixScalar = fDouble ? 0xF2 : 0xF3;
+	const uint8_t prefixPacked = fDouble ? 0x66 : 0x00;	// the packed single forms have no prefix
+	auto PushSse = [&](uint8_t prefix, std::initializer_list<uint8_t> ilcode)
+	{
+		if (prefix != 0)
+			SafePushCode(prefix);
+		SafePushCode(ilcode.begin(), ilcode.size());
+	};
+	const uint8_t opMinMax = fMax ? 0x5F : 0x5D;
+	PushSse(prefixPacked, { 0x0F, 0x28, 0xD8 });			// movaps xmm3, xmm0
+	PushSse(prefixScalar, { 0x0F, 0xC2, 0xD9, 0x03 });	// cmpunordss xmm3, xmm1
+	PushSse(prefixPacked, { 0x0F, 0x28, 0xD0 });			// movaps xmm2, xmm0
+	PushSse(prefixScalar, { 0x0F, opMinMax, 0xD1 });		// min/maxss xmm2, xmm1
+	PushSse(prefixScalar, { 0x0F, opMinMax, 0xC8 });		// min/maxss xmm1, xmm0
+	if (fMax)
+		PushSse(prefixPacked, { 0x0F, 0x54, 0xD1 });		// andps xmm2, xmm1
+	else
+		PushSse(prefixPacked, { 0x0F, 0x56, 0xD1 });		// orps xmm2, xmm1
+	PushSse(prefixPacked, { 0x0F, 0x28, 0xC3 });			// movaps xmm0, xmm3
+	PushSse(prefixPacked, { 0x0F, 0x55, 0xC2 });			// andnps xmm0, xmm2
+	if (fDouble)
+		PushSse(0x66, { 0x0F, 0x73, 0xF3, 51 });			// psllq xmm3, 51
+	else
+		PushSse(0x66, { 0x0F, 0x72, 0xF3, 22 });			// pslld xmm3, 22
+	PushSse(prefixPacked, { 0x0F, 0x56, 0xC3 });			// orps xmm0, xmm3
+	m_fTopInXmm = true;
+}
+
+void JitWriter::FloatCopySign(bool fDouble)
+{
+	// Pure bit manipulation: magnitude of the first operand, sign of the second
+	_PopSecondParam();	// rcx = magnitude, rax = sign
+	if (fDouble)
+	{
+		// btr rcx, 63
+		// shr rax, 63
+		// shl rax, 63
+		// or rax, rcx
+		static const uint8_t rgcode[] = { 0x48, 0x0F, 0xBA, 0xF1, 0x3F, 0x48, 0xC1, 0xE8, 0x3F, 0x48, 0xC1, 0xE0, 0x3F, 0x48, 0x09, 0xC8 };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		// and eax, 80000000h
+		// and ecx, 7FFFFFFFh
+		// or eax, ecx
+		static const uint8_t rgcode[] = { 0x25, 0x00, 0x00, 0x00, 0x80, 0x81, 0xE1, 0xFF, 0xFF, 0xFF, 0x7F, 0x09, 0xC8 };
+		SafePushCode(rgcode);
+	}
+}
+
 int32_t *JitWriter::JumpNIf(void *pvJmp)
 {
 	int32_t offset = -6;
-	// test rax, rax { 0x48, 0x85, 0xC0 }
-	static const uint8_t rgcodeTest[] = { 0x48, 0x85, 0xC0 };
-	SafePushCode(rgcodeTest, _countof(rgcodeTest));
-	_PopContractStack();		// does not affect flags
+	ConditionCode cond = _PopCondition();
 
 	if (pvJmp != nullptr)
 	{
@@ -819,8 +1628,8 @@ int32_t *JitWriter::JumpNIf(void *pvJmp)
 		offset = static_cast<int32_t>(offset64);
 		Verify(offset64 == offset);
 	}
-	// JZ rel32	{ 0x0F, 0x84, REL32 }
-	static const uint8_t rgcodeJRel[] = { 0x0F, 0x84 };
+	// Jcc rel32	{ 0x0F, 0x80 | !cc, REL32 }
+	const uint8_t rgcodeJRel[] = { 0x0F, uint8_t(0x80 | (uint8_t(cond) ^ 1)) };
 	SafePushCode(rgcodeJRel, _countof(rgcodeJRel));
 	int32_t *poffsetRet = (int32_t*)m_pexecPlaneCur;
 	SafePushCode(&offset, sizeof(offset));
@@ -847,6 +1656,8 @@ int32_t *JitWriter::Jump(void *pvJmp)
 
 void JitWriter::CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCallee, bool fReturnValue, bool fIndirect)
 {
+	_SpillPinnedLocals();
+
 	// Stage 1: Push arguments
 	//	add	 rbx, (clocalsCaller * sizeof(uint64_t))
 	static const uint8_t rgcodeAllocLocals[] = { 0x48, 0x81, 0xC3 };
@@ -863,14 +1674,27 @@ void JitWriter::CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCall
 		_PopContractStack();
 	}
 
-	// pop arguments into the newly allocated local variable region
+	// pop arguments into the newly allocated local variable region, direct calls pass the first few in registers instead
+	//	(the caller's pinned locals were spilled above so they are free)
+	const bool fRegisterArgs = !fIndirect && ifn >= m_pmodule->m_vecimports.size();
 	while (cargsCallee > 0)
 	{
-		SetLocal(cargsCallee - 1, true);
+		uint32_t iarg = cargsCallee - 1;
+		if (fRegisterArgs && iarg < cargRegister)
+		{
+			// mov reg, rax
+			const uint8_t rgcode[] = { 0x49, 0x89, uint8_t(0xC0 | (uint8_t(RegArgument(iarg)) & 7)) };
+			SafePushCode(rgcode);
+		}
+		else
+		{
+			_StoreLocalMem(iarg);	// the callee loads its own pinned locals in its prologue
+		}
+		_PopContractStack();
 		--cargsCallee;
 	}
 	
-	_PushExpandStack();	// put the top of the stack into RAM so we can recover it
+	_SpillStack();	// put the stack into RAM so we can recover it, the callee is free to use our cache registers
 	//  push rdi		; backup the operand stack
 	static const uint8_t rgcode[] = { 0x57 };
 	SafePushCode(rgcode, _countof(rgcode));
@@ -891,7 +1715,7 @@ void JitWriter::CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCall
 	}
 	else
 	{
-		if (ifn < m_pctxt->m_vecimports.size())
+		if (ifn < m_pmodule->m_vecimports.size())
 		{
 			// mov ecx ifn ; so we know the function
 			static const uint8_t rgcodeFnNum[] = { 0xB9 };
@@ -900,11 +1724,29 @@ void JitWriter::CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCall
 		}
 
 		// Stage 2, call the actual function
-		// call [rip - PfnVector]
-		static const uint8_t rgcodeCall[] = { 0xFF, 0x15 };
-		int32_t offset = RelAddrPfnVector(ifn, 6);
-		SafePushCode(rgcodeCall, _countof(rgcodeCall));
-		SafePushCode(&offset, sizeof(offset));
+		if (ifn >= m_pmodule->m_vecimports.size())
+		{
+			uint8_t *pbCallee = m_vecpbRegisterEntry.at(ifn);
+			if (pbCallee == nullptr)
+			{
+				// retargeted once the callee is compiled, while other threads may be making the call (see _PatchCallSites)
+				while (reinterpret_cast<uintptr_t>(m_pexecPlaneCur + 1) % sizeof(int32_t) != 0)
+					SafePushCode(uint8_t(0x90));	// nop
+				m_vecvecpbCallFixups.at(ifn).push_back(m_pexecPlaneCur);
+				pbCallee = PbCompileStub(ifn);
+			}
+			// call rel32
+			SafePushCode(uint8_t(0xE8));
+			SafePushCode(numeric_cast<int32_t>(pbCallee - (m_pexecPlaneCur + sizeof(int32_t))));
+		}
+		else
+		{
+			// call [rip - PfnVector]
+			static const uint8_t rgcodeCall[] = { 0xFF, 0x15 };
+			int32_t offset = RelAddrPfnVector(ifn, 6);
+			SafePushCode(rgcodeCall, _countof(rgcodeCall));
+			SafePushCode(&offset, sizeof(offset));
+		}
 	}
 
 	// Stage 3, on return cleanup the stack
@@ -913,6 +1755,7 @@ void JitWriter::CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCall
 	static const uint8_t rgcodeCleanup[] = { 0x5F, 0x48, 0x81, 0xEB };
 	SafePushCode(rgcodeCleanup, _countof(rgcodeCleanup));
 	SafePushCode(&cbLocals, sizeof(cbLocals));
+	_ReloadPinnedLocals();
 
 	// Stage 4, if there was no return value then place our last operand back in rax
 	if (!fReturnValue)
@@ -921,8 +1764,145 @@ void JitWriter::CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCall
 	}
 }
 
-void JitWriter::FnPrologue(uint32_t clocals, uint32_t cargs)
+uint8_t *JitWriter::PbCompileStub(uint32_t ifn) const
+{
+	return m_pbCompileStubs + (ifn - m_pmodule->m_vecimports.size()) * cbCompileStub;
+}
+
+// Calls emitted before ifn was compiled went to its compile stub, now that its address is known they can call it directly.
+//	Their rel32 is aligned (see CallIfn) so a thread making the call meanwhile goes to one or the other.
+void JitWriter::_PatchCallSites(uint32_t ifn)
+{
+	uint8_t *pbCallee = m_vecpbRegisterEntry.at(ifn);
+	for (uint8_t *pbCall : m_vecvecpbCallFixups.at(ifn))
+	{
+		// call rel32
+		Verify(pbCall[0] == 0xE8);
+		int32_t rel = numeric_cast<int32_t>(pbCallee - (pbCall + 5));
+		StoreShared(reinterpret_cast<int32_t*>(PWritable(pbCall + 1)), rel);
+	}
+	std::vector<uint8_t*>().swap(m_vecvecpbCallFixups.at(ifn));
+}
+
+// The bytes from the start of a tier up check to the end of its call to TierUpStub
+static const size_t cbTierUpCheckCall = 26;
+
+// Count down ifn's tier up counter and continue in the optimized code once it runs out (rax is preserved but the
+//	operand stack cache must be empty).  ibLoop is the loop we are at the head of or ibTierUpEntry.
+void JitWriter::_TierUpCheck(uint32_t ifn, uint32_t ibLoop)
+{
+	// The check starts 2 byte aligned so _DisableTierUpCheck can replace its first instruction with a single store
+	if (reinterpret_cast<uintptr_t>(m_pexecPlaneCur) % 2 != 0)
+		SafePushCode(uint8_t(0x90));	// nop
+	uint8_t *pbCheck = m_pexecPlaneCur;
+	// lock sub dword ptr [rip+counter], 1		; instances on other threads count down the same counter
+	static const uint8_t rgcodeSub[] = { 0xF0, 0x83, 0x2D };
+	SafePushCode(rgcodeSub);
+	SafePushCode(numeric_cast<int32_t>(reinterpret_cast<uint8_t*>(m_rgcTierUp + ifn) - (m_pexecPlaneCur + sizeof(int32_t) + 1)));
+	SafePushCode(uint8_t(1));
+	// jns skip
+	static const uint8_t rgcodeJns[] = { 0x79, 0x00 };
+	SafePushCode(rgcodeJns);
+	uint8_t *prel8NotYet = m_pexecPlaneCur - 1;
+
+	// mov ecx, ifn
+	// mov edx, ibLoop
+	// call [TierUpStub]		; rcx is where to continue or null
+	SafePushCode(uint8_t(0xB9));
+	SafePushCode(ifn);
+	SafePushCode(uint8_t(0xBA));
+	SafePushCode(ibLoop);
+	CallAsmOp(m_pfnTierUpStub);
+	Verify(size_t(m_pexecPlaneCur - pbCheck) == cbTierUpCheckCall);
+	// test rcx, rcx
+	// jz skip
+	static const uint8_t rgcodeTest[] = { 0x48, 0x85, 0xC9, 0x74, 0x00 };
+	SafePushCode(rgcodeTest);
+	uint8_t *prel8Stay = m_pexecPlaneCur - 1;
+	_SpillPinnedLocals();	// the optimized code reloads its own
+	// jmp rcx
+	static const uint8_t rgcodeJmp[] = { 0xFF, 0xE1 };
+	SafePushCode(rgcodeJmp);
+
+	for (uint8_t *prel8 : { prel8NotYet, prel8Stay })
+	{
+		ptrdiff_t rel = m_pexecPlaneCur - (prel8 + 1);
+		Verify(rel <= INT8_MAX);
+		*PWritable(prel8) = uint8_t(rel);
+	}
+	Verify(m_pexecPlaneCur - (pbCheck + 2) <= INT8_MAX);	// _DisableTierUpCheck jumps here from the start
+}
+
+// Turns the tier up check whose call returns to pbReturn into a jump past it, it never counts down or calls TierUp again
+void JitWriter::_DisableTierUpCheck(uint8_t *pbReturn)
 {
+	uint8_t *pbCheck = pbReturn - cbTierUpCheckCall;
+	// lock sub dword ptr [rip+counter], 1		{ 0xF0, 0x83, 0x2D, rel32, 1 }
+	// jns skip									{ 0x79, rel8 }
+	Verify(pbCheck[0] == 0xF0 && pbCheck[1] == 0x83 && pbCheck[8] == 0x79);
+	// jmp skip
+	uint8_t rgcode[] = { 0xEB, uint8_t(pbCheck[9] + 8) };
+	uint16_t code;
+	memcpy(&code, rgcode, sizeof(code));
+	StoreShared(reinterpret_cast<uint16_t*>(PWritable(pbCheck)), code);
+}
+
+// Returns the entry point for direct calls, which pass the first cargRegister arguments in registers.  The function
+//	vector points at the code in front of it that loads them from the locals array for everyone else.
+uint8_t *JitWriter::FnPrologue(uint32_t ifn, uint32_t clocals, uint32_t cargs)
+{
+	const uint32_t cargsRegister = (cargs < cargRegister) ? cargs : cargRegister;
+	uint32_t cargsSpill = 0;
+	for (uint32_t iarg = 0; iarg < cargsRegister; ++iarg)
+	{
+		Register reg;
+		if (_FPinnedLocal(iarg, &reg))
+		{
+			// mov reg, [rbx+idx]
+			Verify(reg == RegArgument(iarg));
+			const uint8_t rgcode[] = { 0x4C, 0x8B, uint8_t(0x83 | ((uint8_t(reg) & 7) << 3)) };
+			SafePushCode(rgcode);
+			SafePushCode(uint32_t(iarg * sizeof(uint64_t)));
+		}
+		else
+		{
+			++cargsSpill;
+		}
+	}
+	uint8_t *prel8Spills = nullptr;
+	if (cargsSpill > 0)
+	{
+		// jmp short past the register entry's spills
+		static const uint8_t rgcodeJmp[] = { 0xEB, 0x00 };
+		SafePushCode(rgcodeJmp);
+		prel8Spills = m_pexecPlaneCur - 1;
+	}
+
+	// TierUp replaces the nop at the register entry with a jmp rel32 to the optimized code, it is 8 byte aligned so that
+	//	is a single store even with other threads running the function
+	while (reinterpret_cast<uintptr_t>(m_pexecPlaneCur) % sizeof(uint64_t) != 0)
+		SafePushCode(uint8_t(0x90));	// nop
+	uint8_t *pbRegisterEntry = m_pexecPlaneCur;
+	static const uint8_t rgcodeNop[] = { 0x0F, 0x1F, 0x44, 0x00, 0x00 };	// nop dword ptr [rax+rax]
+	SafePushCode(rgcodeNop);
+	for (uint32_t iarg = 0; iarg < cargsRegister; ++iarg)
+	{
+		Register reg;
+		if (!_FPinnedLocal(iarg, &reg))
+		{
+			// mov [rbx+idx], reg
+			const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0x83 | ((uint8_t(RegArgument(iarg)) & 7) << 3)) };
+			SafePushCode(rgcode);
+			SafePushCode(uint32_t(iarg * sizeof(uint64_t)));
+		}
+	}
+	if (prel8Spills != nullptr)
+	{
+		ptrdiff_t rel = m_pexecPlaneCur - (prel8Spills + 1);
+		Verify(rel <= INT8_MAX);
+		*PWritable(prel8Spills) = uint8_t(rel);
+	}
+
 	// memset local variables to zero
 	// ZeroMemory(rbx + (cargs * sizeof(uint64_t)), (clocals - cargs) * sizeof(uint64_t))
 	uint32_t clocalsNoArgs = clocals - cargs;
@@ -955,42 +1935,104 @@ void JitWriter::FnPrologue(uint32_t clocals, uint32_t cargs)
 		static const uint8_t rgcodeRestoreRdi[] = { 0x48, 0x89, 0xD7 };
 		SafePushCode(rgcodeRestoreRdi);
 	}
-	_PushExpandStack();
-	// push rdi
-	SafePushCode(uint8_t(0x57));
-}
 
-void JitWriter::LogicOp(LogicOperation op)
-{
-	bool fSwapParams = false;
-	switch (op)
+	for (auto &pairLocalReg : m_vecpairLocalReg)
 	{
-	case LogicOperation::ShiftLeft:
-	case LogicOperation::ShiftRight:
-	case LogicOperation::ShiftRightUnsigned:
-	case LogicOperation::RotateLeft:
-	case LogicOperation::RotateRight:
-		fSwapParams = true;
+		uint8_t regT = uint8_t(pairLocalReg.second) & 7;
+		if (pairLocalReg.first < cargsRegister)
+		{
+			continue;	// already in place
+		}
+		else if (pairLocalReg.first < cargs)
+		{
+			// mov reg, [rbx+idx]
+			const uint8_t rgcode[] = { 0x4C, 0x8B, uint8_t(0x83 | (regT << 3)) };
+			SafePushCode(rgcode);
+			SafePushCode(uint32_t(pairLocalReg.first * sizeof(uint64_t)));
+		}
+		else
+		{
+			// xor reg32, reg32
+			const uint8_t rgcode[] = { 0x45, 0x31, uint8_t(0xC0 | (regT << 3) | regT) };
+			SafePushCode(rgcode);
+		}
 	}
-	_PopSecondParam(fSwapParams);
-	const char *rgcode = nullptr;
+	if (!m_fOptimizing)
+		_TierUpCheck(ifn, ibTierUpEntry);
+	_SpillStack();
+	m_veccslotBlock.push_back(m_cslotStack);	// the function body is the outermost block
+	return pbRegisterEntry;
+}
+
+void JitWriter::_LogicOpImmPending(LogicOperation op, bool f64)
+{
 	switch (op)
 	{
 	case LogicOperation::And:
-		// and eax, ecx
-		rgcode = "\x21\xC8";
+		_ArithImmPending(4, f64);	// and eax, imm
 		break;
 	case LogicOperation::Or:
-		// or eax, ecx
-		rgcode = "\x09\xC8";
+		_ArithImmPending(1, f64);	// or eax, imm
 		break;
 	case LogicOperation::Xor:
-		// xor eax, ecx
-		rgcode = "\x31\xC8";
+		_ArithImmPending(6, f64);	// xor eax, imm
 		break;
 	case LogicOperation::ShiftLeft:
-		// shl eax, cl
-		rgcode = "\xD3\xE0";
+		_ShiftImmPending(4, f64);	// shl eax, imm8
+		break;
+	case LogicOperation::ShiftRight:
+		_ShiftImmPending(7, f64);	// sar eax, imm8
+		break;
+	case LogicOperation::ShiftRightUnsigned:
+		_ShiftImmPending(5, f64);	// shr eax, imm8
+		break;
+	case LogicOperation::RotateLeft:
+		_ShiftImmPending(0, f64);	// rol eax, imm8
+		break;
+	case LogicOperation::RotateRight:
+		_ShiftImmPending(1, f64);	// ror eax, imm8
+		break;
+	default:
+		Verify(false);
+	}
+}
+
+void JitWriter::LogicOp(LogicOperation op)
+{
+	if (m_fConstPending)
+	{
+		_LogicOpImmPending(op, false /*f64*/);
+		return;
+	}
+	bool fSwapParams = false;
+	switch (op)
+	{
+	case LogicOperation::ShiftLeft:
+	case LogicOperation::ShiftRight:
+	case LogicOperation::ShiftRightUnsigned:
+	case LogicOperation::RotateLeft:
+	case LogicOperation::RotateRight:
+		fSwapParams = true;
+	}
+	_PopSecondParam(fSwapParams);
+	const char *rgcode = nullptr;
+	switch (op)
+	{
+	case LogicOperation::And:
+		// and eax, ecx
+		rgcode = "\x21\xC8";
+		break;
+	case LogicOperation::Or:
+		// or eax, ecx
+		rgcode = "\x09\xC8";
+		break;
+	case LogicOperation::Xor:
+		// xor eax, ecx
+		rgcode = "\x31\xC8";
+		break;
+	case LogicOperation::ShiftLeft:
+		// shl eax, cl
+		rgcode = "\xD3\xE0";
 		break;
 	case LogicOperation::ShiftRight:
 		// sar eax, cl
@@ -1017,6 +2059,11 @@ void JitWriter::LogicOp(LogicOperation op)
 
 void JitWriter::LogicOp64(LogicOperation op)
 {
+	if (m_fConstPending)
+	{
+		_LogicOpImmPending(op, true /*f64*/);
+		return;
+	}
 	bool fSwapParams = false;
 	switch (op)
 	{
@@ -1069,27 +2116,31 @@ void JitWriter::LogicOp64(LogicOperation op)
 
 void JitWriter::Select()
 {
-	//	sub rdi, 16			; pop 2 vals from stack
-	//	xor rcx, rcx		; zero our index
-	//	test eax, eax		; test the conditional
-	//	jnz FirstArg		; jump if index should be zero
-	//	add rcx, 8			; else index should be 8 (bytes)
-	// FirstArg:
-	//	mov rax, [rdi+rcx]	; load the value
-	static const uint8_t rgcode[] = { 0x48, 0x83, 0xEF, 0x10, 0x48, 0x31, 0xC9, 0x85, 0xC0, 0x75, 0x04, 0x48, 0x83, 0xC1, 0x08, 0x48, 0x8B, 0x04, 0x0F };
+	ConditionCode cond = _PopCondition();
+	_PopSecondParam();	// does not affect flags
+	//	cmovcc rax, rcx		; rcx is the first value, chosen if the condition is true
+	const uint8_t rgcode[] = { 0x48, 0x0F, uint8_t(0x40 | uint8_t(cond)), 0xC1 };
 	SafePushCode(rgcode, _countof(rgcode));
 }
 
+// The end of an if converted IF, the stack holds the condition then the values of both arms
+void JitWriter::IfConvertedSelect()
+{
+	_PopSecondParam();	// rcx is the then value, rax the else value
+	// mov rdx, rax
+	static const uint8_t rgcodeMov[] = { 0x48, 0x89, 0xC2 };
+	SafePushCode(rgcodeMov);
+	_PopContractStack();
+	// test eax, eax
+	// mov rax, rdx
+	// cmovnz rax, rcx
+	static const uint8_t rgcodeSelect[] = { 0x85, 0xC0, 0x48, 0x89, 0xD0, 0x48, 0x0F, 0x45, 0xC1 };
+	SafePushCode(rgcodeSelect);
+}
+
 void JitWriter::FnEpilogue(bool /*fRetVal*/)
 {
-#if 0	// now that we push rdi in the prologue we don't need this
-	if (fRetVal)
-	{
-		// sub rdi, 8
-		static const uint8_t rgcodeSub[] = { 0x48, 0x83, 0xEF, 0x08 };
-		SafePushCode(rgcodeSub);
-	}
-#endif
+	_SetStackHeight(0);	// hand the operand stack back the way we got it
 	// ret
 	static const uint8_t rgcode[] = { 0xC3 };
 	SafePushCode(rgcode, _countof(rgcode));
@@ -1105,23 +2156,57 @@ void JitWriter::_SetDbgReg(uint32_t op)
 
 void JitWriter::Mul32()
 {
-	// mul dword ptr [rdi-8]		; note: clobbers edx
-	// sub rdi, 8
-	static const uint8_t rgcode[] = { 0xF7, 0x67, 0xF8, 0x48, 0x83, 0xEF, 0x08 };
+	if (m_fConstPending)
+	{
+		_MulImmPending(false /*f64*/);
+		return;
+	}
+	_PopSecondParam();
+	// imul eax, ecx
+	static const uint8_t rgcode[] = { 0x0F, 0xAF, 0xC1 };
 	SafePushCode(rgcode);
 }
 
 
+void JitWriter::_MulImmPending(bool f64)
+{
+	Verify(m_fConstPending);
+	m_fConstPending = false;
+	if (f64)
+		SafePushCode(uint8_t(0x48));
+	if (m_constPending == int8_t(m_constPending))
+	{
+		// imul eax, eax, imm8
+		const uint8_t rgcode[] = { 0x6B, 0xC0, uint8_t(m_constPending) };
+		SafePushCode(rgcode);
+	}
+	else
+	{
+		// imul eax, eax, imm32
+		const uint8_t rgcode[] = { 0x69, 0xC0 };
+		SafePushCode(rgcode);
+		SafePushCode(int32_t(m_constPending));
+	}
+}
+
 void JitWriter::Mul64()
 {
-	// mul qword ptr [rdi-8]		; note: clobbers rdx
-	// sub rdi, 8
-	static const uint8_t rgcode[] = { 0x48, 0xF7, 0x67, 0xF8, 0x48, 0x83, 0xEF, 0x08 };
+	if (m_fConstPending)
+	{
+		_MulImmPending(true /*f64*/);
+		return;
+	}
+	_PopSecondParam();
+	// imul rax, rcx
+	static const uint8_t rgcode[] = { 0x48, 0x0F, 0xAF, 0xC1 };
 	SafePushCode(rgcode);
 }
 
 
-void JitWriter::BranchTableParse(const uint8_t **ppoperand, size_t *pcbOperand, const std::vector<std::pair<value_type, void*>> &stackBlockTypeAddr, std::vector<std::vector<int32_t*>> &stackVecFixups, std::vector<std::vector<void**>> &stackVecFixupsAbsolute)
+// br_table is lowered inline.  Every distinct target depth gets a stub that restores the target's stack and jumps to
+//	the target, the index then picks a stub with a plain jump (single target), a compare tree (a few runs of equal
+//	targets) or a jump table of stub offsets relative to the table so the code stays position independent.
+void JitWriter::BranchTableParse(const uint8_t **ppoperand, size_t *pcbOperand, const std::vector<std::pair<value_type, void*>> &stackBlockTypeAddr, size_t cblockInline, std::vector<std::vector<int32_t*>> &stackVecFixups)
 {
 	uint32_t target_count = safe_read_buffer<varuint32>(ppoperand, pcbOperand);
 	std::vector<uint32_t> vectargets;
@@ -1129,128 +2214,182 @@ void JitWriter::BranchTableParse(const uint8_t **ppoperand, size_t *pcbOperand,
 	for (uint32_t itarget = 0; itarget < target_count; ++itarget)
 	{
 		vectargets.push_back(safe_read_buffer<varuint32>(ppoperand, pcbOperand));
+		Verify(vectargets.back() < stackBlockTypeAddr.size() - cblockInline);
 	}
 	uint32_t default_target = safe_read_buffer<varuint32>(ppoperand, pcbOperand);
+	Verify(default_target < stackBlockTypeAddr.size() - cblockInline);
+	_FlushStack();	// the stubs expect the block values in memory, the index stays in eax
 
-	auto &pairBlockDft = *(stackBlockTypeAddr.rbegin() + default_target);
-	bool fRetVal = (pairBlockDft.first != value_type::empty_block);
-
-	// Setup the parameters and call thr BranchTable helper
-	//	rcx - table pointer
-	//
-	//	lea rcx, [rip+distance_to_branch_table]		{ 0x48, 0x8D, 0x0D, rel32 }
-	//	jmp [m_pfnBranchTable]						{ 0xFF, 0x25, rel32 }
-	int32_t branchtable_offset = 6;
-	static const uint8_t rgcodeLea[] = { 0x48, 0x8D, 0x0D };
-	SafePushCode(rgcodeLea);
-	SafePushCode(branchtable_offset);
-	
-	static const uint8_t rgcodeJmp[] = { 0xFF, 0x25 };
-	SafePushCode(rgcodeJmp);
-	ptrdiff_t diffFn = reinterpret_cast<ptrdiff_t>(m_pfnBranchTable) - reinterpret_cast<ptrdiff_t>(m_pexecPlaneCur + 4);
-	Verify(diffFn == static_cast<int32_t>(diffFn));
-	SafePushCode(static_cast<int32_t>(diffFn));
-
-	// Now write the branch table
-	/*
-	;	Table Format:
-	;		dword count
-	;		dword fReturnVal
-	;		--default_target--
-	;		qword distance (how many blocks we're jumping)
-	;		qword target_addr
-	;		--table_targets---
-	;		.... * count
-	*/
-	// Header
-	SafePushCode(target_count);
-	SafePushCode(int32_t(fRetVal));
-	// default target
-	SafePushCode(uint64_t(default_target));
-	SafePushCode(pairBlockDft.second);
-	if (pairBlockDft.second == nullptr)
-		(stackVecFixupsAbsolute.rbegin() + default_target)->push_back(reinterpret_cast<void**>(m_pexecPlaneCur) - 1);
-	// table targets
-	for (uint32_t itarget = 0; itarget < target_count; ++itarget)
+	// Runs of equal targets, the default covers every index from target_count up
+	struct Range
 	{
-		uint64_t target = vectargets[itarget];
-		SafePushCode(target);
-		auto &pairBlock = *(stackBlockTypeAddr.rbegin() + target);
-		SafePushCode(pairBlock.second);
-		if (pairBlock.second == nullptr)
-			(stackVecFixupsAbsolute.rbegin() + target)->push_back(reinterpret_cast<void**>(m_pexecPlaneCur) - 1);
+		uint32_t idxLow;
+		uint32_t target;
+	};
+	std::vector<Range> vecrange;
+	for (uint32_t itarget = 0; itarget <= target_count; ++itarget)
+	{
+		uint32_t target = (itarget < target_count) ? vectargets[itarget] : default_target;
+		if (vecrange.empty() || vecrange.back().target != target)
+			vecrange.push_back(Range{ itarget, target });
 	}
-}
 
-void JitWriter::FloatArithmetic(ArithmeticOperation op, bool fDouble)
-{
-	// sub rdi, 8
-	static const uint8_t rgcodeSubRdi[] = { 0x48, 0x83, 0xEF, 0x08 };
-	SafePushCode(rgcodeSubRdi);
-	if (fDouble)
+	// One stub per distinct target, jumps to a stub are patched once it is written
+	std::vector<uint32_t> vectargetStub;
+	std::vector<std::vector<int32_t*>> vecvecpStubFixups;
+	std::vector<std::vector<int32_t*>> vecvecpTableFixups;
+	auto IStub = [&](uint32_t target) -> size_t
+	{
+		for (size_t istubT = 0; istubT < vectargetStub.size(); ++istubT)
+		{
+			if (vectargetStub[istubT] == target)
+				return istubT;
+		}
+		vectargetStub.push_back(target);
+		vecvecpStubFixups.emplace_back();
+		vecvecpTableFixups.emplace_back();
+		return vectargetStub.size() - 1;
+	};
+
+	uint8_t *pbTable = nullptr;
+	if (vecrange.size() == 1)
 	{
-		// movq xmm1, rax
-		// movq xmm0, qword ptr [rdi]
-		static const uint8_t rgcodeSetup[] = { 0x66, 0x48, 0x0F, 0x6E, 0xC8, 0xF3, 0x0F, 0x7E, 0x07 };
-		SafePushCode(rgcodeSetup);
+#ifdef PRINT_DISASSEMBLY
+		printf("\t(single target)\n");
+#endif
+		IStub(default_target);	// the stub is emitted right here
+	}
+	else if (vecrange.size() <= 4)
+	{
+#ifdef PRINT_DISASSEMBLY
+		printf("\t(compare tree over %u ranges)\n", uint32_t(vecrange.size()));
+#endif
+		// Binary search on the range starts, the index is unsigned so anything past the table lands in the default.
+		//	Pending subtrees are (first range, end range, jae to patch when emitting them), left ones are emitted first.
+		std::vector<std::tuple<size_t, size_t, int32_t*>> vectupleTree;
+		vectupleTree.push_back(std::make_tuple(size_t(0), vecrange.size(), nullptr));
+		while (!vectupleTree.empty())
+		{
+			size_t irangeLow, irangeEnd;
+			int32_t *pdeltaFix;
+			std::tie(irangeLow, irangeEnd, pdeltaFix) = vectupleTree.back();
+			vectupleTree.pop_back();
+			if (pdeltaFix != nullptr)
+				*PWritable(pdeltaFix) = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(pdeltaFix) + sizeof(*pdeltaFix)));
+			if (irangeEnd - irangeLow == 1)
+			{
+				vecvecpStubFixups[IStub(vecrange[irangeLow].target)].push_back(Jump(nullptr));
+				continue;
+			}
+			size_t irangeMid = (irangeLow + irangeEnd) / 2;
+			// cmp eax, idxLow			{ 0x3D, imm32 }
+			// jae right				{ 0x0F, 0x83, rel32 }
+			static const uint8_t rgcodeCmp[] = { 0x3D };
+			SafePushCode(rgcodeCmp);
+			SafePushCode(vecrange[irangeMid].idxLow);
+			static const uint8_t rgcodeJae[] = { 0x0F, 0x83 };
+			SafePushCode(rgcodeJae);
+			int32_t *pdeltaRight = reinterpret_cast<int32_t*>(m_pexecPlaneCur);
+			SafePushCode(int32_t(-6));
+			if (irangeEnd - irangeMid == 1)
+				vecvecpStubFixups[IStub(vecrange[irangeMid].target)].push_back(pdeltaRight);
+			else
+				vectupleTree.push_back(std::make_tuple(irangeMid, irangeEnd, pdeltaRight));
+			vectupleTree.push_back(std::make_tuple(irangeLow, irangeMid, nullptr));
+		}
 	}
 	else
 	{
-		// movd xmm1, eax
-		// movd xmm0, dword ptr [rdi]
-		static const uint8_t rgcodeSetup[] = { 0x66, 0x0F, 0x6E, 0xC8, 0x66, 0x0F, 0x6E, 0x07 };
-		SafePushCode(rgcodeSetup);
+#ifdef PRINT_DISASSEMBLY
+		printf("\t(jump table of %u entries)\n", target_count);
+#endif
+		// mov eax, eax					{ 0x89, 0xC0 }
+		// cmp eax, target_count		{ 0x3D, imm32 }
+		// jae default					{ 0x0F, 0x83, rel32 }
+		static const uint8_t rgcodeCmp[] = { 0x89, 0xC0, 0x3D };
+		SafePushCode(rgcodeCmp);
+		SafePushCode(target_count);
+		static const uint8_t rgcodeJae[] = { 0x0F, 0x83 };
+		SafePushCode(rgcodeJae);
+		vecvecpStubFixups[IStub(default_target)].push_back(reinterpret_cast<int32_t*>(m_pexecPlaneCur));
+		SafePushCode(int32_t(-6));
+		// lea rcx, [rip + table]		{ 0x48, 0x8D, 0x0D, rel32 }
+		// movsxd rdx, [rcx + rax*4]	{ 0x48, 0x63, 0x14, 0x81 }
+		// add rdx, rcx					{ 0x48, 0x01, 0xCA }
+		// jmp rdx						{ 0xFF, 0xE2 }
+		static const uint8_t rgcodeLea[] = { 0x48, 0x8D, 0x0D };
+		SafePushCode(rgcodeLea);
+		SafePushCode(int32_t(9));
+		static const uint8_t rgcodeJmp[] = { 0x48, 0x63, 0x14, 0x81, 0x48, 0x01, 0xCA, 0xFF, 0xE2 };
+		SafePushCode(rgcodeJmp);
+		pbTable = m_pexecPlaneCur;
+		for (uint32_t itarget = 0; itarget < target_count; ++itarget)
+		{
+			vecvecpTableFixups[IStub(vectargets[itarget])].push_back(reinterpret_cast<int32_t*>(m_pexecPlaneCur));
+			SafePushCode(int32_t(0));
+		}
 	}
 
-	const char *szCode = nullptr;
+	const int32_t cslotStack = m_cslotStack;
+	for (size_t istubT = 0; istubT < vectargetStub.size(); ++istubT)
+	{
+		for (int32_t *pdelta : vecvecpStubFixups[istubT])
+			*PWritable(pdelta) = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(pdelta) + sizeof(*pdelta)));
+		for (int32_t *pdelta : vecvecpTableFixups[istubT])
+			*PWritable(pdelta) = numeric_cast<int32_t>(m_pexecPlaneCur - pbTable);
+
+		uint32_t target = vectargetStub[istubT];
+		auto &pairBlock = *(stackBlockTypeAddr.rbegin() + target);
+		bool fRetVal = FBranchValue(pairBlock);
+		m_cslotStack = cslotStack;
+		if (fRetVal)
+		{
+			// mov rax, [rdi - 8]	(the block value below the index)
+			static const uint8_t rgcodeRet[] = { 0x48, 0x8B, 0x47, 0xF8 };
+			SafePushCode(rgcodeRet);
+		}
+		LeaveBlock(target, fRetVal);
+		int32_t *pdeltaFix = Jump(pairBlock.second);
+		if (pairBlock.second == nullptr)
+			(stackVecFixups.rbegin() + target)->push_back(pdeltaFix);
+	}
+}
+
+void JitWriter::FloatArithmetic(ArithmeticOperation op, bool fDouble)
+{
+	_LoadFloatTop(fDouble);							// second operand
+	Register regFirst = _PopFloatSecond(fDouble);	// first operand, free to clobber once popped
+	uint8_t opSse = 0;
 	switch (op)
 	{
 	case ArithmeticOperation::Add:
-		if (fDouble)
-			szCode = "\xF2\x0F\x58\xC1";	// addsd xmm0, xmm1
-		else
-			szCode = "\xF3\x0F\x58\xC1";	// addss xmm0, xmm1
+		opSse = 0x58;	// addss/addsd
 		break;
 	case ArithmeticOperation::Sub:
-		if (fDouble)
-			szCode = "\xF2\x0F\x5C\xC1";	// subsd xmm0, xmm1
-		else
-			szCode = "\xF3\x0F\x5C\xC1";	// subss xmm0, xmm1
+		opSse = 0x5C;	// subss/subsd
 		break;
 	case ArithmeticOperation::Multiply:
-		if (fDouble)
-			szCode = "\xF2\x0F\x59\xC1";	// mulsd xmm0, xmm1
-		else
-			szCode = "\xF3\x0F\x59\xC1";	// mulss xmm0, xmm1
+		opSse = 0x59;	// mulss/mulsd
 		break;
 	case ArithmeticOperation::Divide:
-		if (fDouble)
-			szCode = "\xF2\x0F\x5E\xC1";	// divsd xmm0, xmm1
-		else
-			szCode = "\xF3\x0F\x5E\xC1";	// divss xmm0, xmm1
+		opSse = 0x5E;	// divss/divsd
 		break;
 	}
-	Verify(szCode != nullptr);
-	SafePushCode(szCode, strlen(szCode));
+	Verify(opSse != 0);
 
-	if (fDouble)
-	{
-		// movq rax, xmm0
-		static const uint8_t rgcode[] = { 0x66, 0x48, 0x0F, 0x7E, 0xC0 };
-		SafePushCode(rgcode);
-	}
-	else
-	{
-		// movd eax, xmm0
-		static const uint8_t rgcode[] = { 0x66, 0x0F, 0x7E, 0xC0 };
-		SafePushCode(rgcode);
-	}
+	// The result stays in xmm0 for the next float op
+	// op first, xmm0
+	// movaps xmm0, first
+	const uint8_t regFirstBits = uint8_t(regFirst) & 7;
+	const uint8_t rgcode[] = { uint8_t(fDouble ? 0xF2 : 0xF3), 0x0F, opSse, uint8_t(0xC0 | (regFirstBits << 3)), 0x0F, 0x28, uint8_t(0xC0 | regFirstBits) };
+	SafePushCode(rgcode);
+	m_fTopInXmm = true;
 }
 
 
 void JitWriter::GetGlobal(uint32_t idx)
 {
-	auto &glbl = m_pctxt->m_vecglbls.at(idx);
+	auto &glbl = m_pmodule->m_vecglbls.at(idx);
 
 	if (glbl.fMutable)
 	{
@@ -1260,25 +2399,21 @@ void JitWriter::GetGlobal(uint32_t idx)
 		{
 		case value_type::f32:
 		case value_type::i32:
-			// mov eax, [m_pGlobalsStart + idx*8] (rip relative)
-			szCode = "\x8B\x05";
+			// mov eax, [rbp + DispGlobal(idx)]
+			szCode = "\x8B\x85";
 			break;
 
 		case value_type::f64:
 		case value_type::i64:
-			// mov rax, [m_pGlobalsStart + idx*8] (rip relative)
-			szCode = "\x48\x8B\x05";
+			// mov rax, [rbp + DispGlobal(idx)]
+			szCode = "\x48\x8B\x85";
 			break;
 
 		default:
 			Verify(false);
 		}
 		SafePushCode(szCode, strlen(szCode));
-		// now push the address offset
-		int64_t offset64 = reinterpret_cast<uint8_t*>(m_pGlobalsStart + idx) - (m_pexecPlaneCur + 4);
-		int32_t offset = static_cast<int32_t>(offset64);
-		Verify(offset64 == offset);
-		SafePushCode(offset);
+		SafePushCode(DispGlobal(idx));
 	}
 	else
 	{
@@ -1300,7 +2435,7 @@ void JitWriter::GetGlobal(uint32_t idx)
 
 void JitWriter::SetGlobal(uint32_t idx)
 {
-	auto &glbl = m_pctxt->m_vecglbls.at(idx);
+	auto &glbl = m_pmodule->m_vecglbls.at(idx);
 
 	Verify(glbl.fMutable);
 	const char *szCode = nullptr;
@@ -1308,22 +2443,21 @@ void JitWriter::SetGlobal(uint32_t idx)
 	{
 	case value_type::f32:
 	case value_type::i32:
-		szCode = "\x89\x05";
+		// mov [rbp + DispGlobal(idx)], eax
+		szCode = "\x89\x85";
 		break;
 
 	case value_type::f64:
 	case value_type::i64:
-		szCode = "\x48\x89\x05";
+		// mov [rbp + DispGlobal(idx)], rax
+		szCode = "\x48\x89\x85";
 		break;
 
 	default:
 		Verify(false);
 	}
 	SafePushCode(szCode, strlen(szCode));
-	int64_t offset64 = reinterpret_cast<uint8_t*>(m_pGlobalsStart + idx) - (m_pexecPlaneCur + 4);
-	int32_t offset = static_cast<int32_t>(offset64);
-	Verify(offset64 == offset);
-	SafePushCode(offset);
+	SafePushCode(DispGlobal(idx));
 	_PopContractStack();
 }
 
@@ -1367,45 +2501,262 @@ void JitWriter::CountLeadingZeros(bool f64)
 	}
 }
 
-void JitWriter::Div(bool fSigned, bool fModulo, bool f64)
+// Hacker's Delight magic numbers for dividing by the constant d (d >= 2, not a power of 2) with a multiply-high.
+//	T is the unsigned type of the operation width.  Signed: q = mulhs(x, magic) [+ x if magic < 0] >> shift, plus one if negative.
+template<typename T>
+static void ComputeSignedMagic(T d, T *pmagic, unsigned *pshift)
 {
-	if (fSigned && fModulo)
+	const unsigned cbit = sizeof(T) * 8;
+	const T tTwoN1 = T(1) << (cbit - 1);
+	T anc = tTwoN1 - 1 - (tTwoN1 % d);	// absolute value of nc
+	unsigned p = cbit - 1;
+	T q1 = tTwoN1 / anc, r1 = tTwoN1 - q1 * anc;
+	T q2 = tTwoN1 / d, r2 = tTwoN1 - q2 * d;
+	T delta;
+	do
+	{
+		++p;
+		q1 *= 2; r1 *= 2;
+		if (r1 >= anc) { ++q1; r1 -= anc; }
+		q2 *= 2; r2 *= 2;
+		if (r2 >= d) { ++q2; r2 -= d; }
+		delta = d - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	*pmagic = q2 + 1;
+	*pshift = p - cbit;
+}
+
+// Unsigned: q = mulhu(x, magic) >> shift, or when fAdd is set the magic needs one more bit: q = (((x - t) >> 1) + t) >> (shift - 1) with t = mulhu(x, magic)
+template<typename T>
+static void ComputeUnsignedMagic(T d, T *pmagic, unsigned *pshift, bool *pfAdd)
+{
+	const unsigned cbit = sizeof(T) * 8;
+	const T tTwoN1 = T(1) << (cbit - 1);
+	bool fAdd = false;
+	T nc = T(-1) - T(T(0) - d) % d;
+	unsigned p = cbit - 1;
+	T q1 = tTwoN1 / nc, r1 = tTwoN1 - q1 * nc;
+	T q2 = (tTwoN1 - 1) / d, r2 = (tTwoN1 - 1) - q2 * d;
+	T delta;
+	do
 	{
-		// To satisify the wasm spec and prevent overflow exceptions convert the divisor to its absolute value
-		//  do this before the xchg below so the divisor is already in eax
+		++p;
+		if (r1 >= nc - r1) { q1 = 2 * q1 + 1; r1 = 2 * r1 - nc; }
+		else { q1 = 2 * q1; r1 = 2 * r1; }
+		if (r2 + 1 >= d - r2)
+		{
+			if (q2 >= tTwoN1 - 1) fAdd = true;
+			q2 = 2 * q2 + 1; r2 = 2 * r2 + 1 - d;
+		}
+		else
+		{
+			if (q2 >= tTwoN1) fAdd = true;
+			q2 = 2 * q2; r2 = 2 * r2 + 1;
+		}
+		delta = d - 1 - r2;
+	} while (p < 2 * cbit && (q1 < delta || (q1 == delta && r1 == 0)));
+	*pmagic = q2 + 1;
+	*pshift = p - cbit;
+	*pfAdd = fAdd;
+}
 
-		// Fancy branchless abs(eax):
-		//		cdq
-		//		xor eax, edx
-		//		sub eax, edx
+// Divide the dividend in rax by the pending constant without a div instruction.  FConstFoldable keeps out the divisors
+//	that must trap (0 and -1 for div_s) so those still go through the hardware.
+void JitWriter::_DivImmPending(bool fSigned, bool fModulo, bool f64)
+{
+	Verify(m_fConstPending);
+	m_fConstPending = false;
+	const uint8_t cbit = f64 ? 64 : 32;
+	auto PushOp = [&](std::initializer_list<uint8_t> ilcode)
+	{
 		if (f64)
+			SafePushCode(uint8_t(0x48));	// REX.W, the encodings below are the 32-bit forms
+		SafePushCode(ilcode.begin(), ilcode.size());
+	};
+
+	uint64_t d = f64 ? uint64_t(m_constPending) : uint64_t(uint32_t(m_constPending));
+	bool fNegative = fSigned && (f64 ? (int64_t(d) < 0) : (int32_t(d) < 0));
+	if (fNegative)
+		d = f64 ? (0 - d) : uint64_t(uint32_t(0 - uint32_t(d)));	// rem_s only depends on |d| and div_s negates the quotient at the end
+	Verify(d != 0);
+
+	if (d == 1)
+	{
+		if (fModulo)
+			PushOp({ 0x31, 0xC0 });		// xor eax, eax
+		return;
+	}
+
+	if ((d & (d - 1)) == 0)
+	{
+		uint8_t shift = 0;
+		while ((uint64_t(1) << shift) != d)
+			++shift;
+		if (!fSigned)
+		{
+			if (!fModulo)
+			{
+				PushOp({ 0xC1, 0xE8, shift });		// shr eax, shift
+			}
+			else if (shift < 32)
+			{
+				// and eax, d - 1
+				PushOp({ 0x25 });
+				SafePushCode(uint32_t(d - 1));
+			}
+			else if (shift == 32)
+			{
+				// mov eax, eax		; zero extending is the mask
+				static const uint8_t rgcode[] = { 0x89, 0xC0 };
+				SafePushCode(rgcode);
+			}
+			else
+			{
+				PushOp({ 0xC1, 0xE0, uint8_t(cbit - shift) });	// shl eax, bits - shift
+				PushOp({ 0xC1, 0xE8, uint8_t(cbit - shift) });	// shr eax, bits - shift
+			}
+			return;
+		}
+
+		// Round towards zero by biasing negative dividends by d - 1
+		PushOp({ 0x89, 0xC1 });						// mov ecx, eax
+		PushOp({ 0xC1, 0xF9, uint8_t(cbit - 1) });		// sar ecx, bits - 1
+		PushOp({ 0xC1, 0xE9, uint8_t(cbit - shift) });	// shr ecx, bits - shift
+		PushOp({ 0x01, 0xC1 });						// add ecx, eax
+		PushOp({ 0xC1, 0xF9, shift });					// sar ecx, shift
+		if (fModulo)
 		{
-			static const uint8_t rgcodeFancy[] = { 0x48, 0x99, 0x48, 0x31, 0xD0, 0x48, 0x29, 0xD0 };
-			SafePushCode(rgcodeFancy);
+			PushOp({ 0xC1, 0xE1, shift });				// shl ecx, shift	; x rounded towards zero to a multiple of d
+			PushOp({ 0x29, 0xC8 });					// sub eax, ecx
 		}
 		else
 		{
-			static const uint8_t rgcodeFancy[] = { 0x99, 0x31, 0xD0, 0x29, 0xD0 };
-			SafePushCode(rgcodeFancy);
+			PushOp({ 0x89, 0xC8 });					// mov eax, ecx
+			if (fNegative)
+				PushOp({ 0xF7, 0xD8 });				// neg eax
 		}
+		return;
 	}
 
-	// sub rdi, 8 - pop off one of our operands.  Do this early so we don't have to offset our memory accesses below
-	static const uint8_t rgcodeSubRdi[] = { 0x48, 0x83, 0xEF, 0x08 };
-	SafePushCode(rgcodeSubRdi);
+	uint64_t magic;
+	unsigned shift;
+	bool fAdd = false;
+	if (f64)
+	{
+		if (fSigned)
+			ComputeSignedMagic<uint64_t>(d, &magic, &shift);
+		else
+			ComputeUnsignedMagic<uint64_t>(d, &magic, &shift, &fAdd);
+	}
+	else
+	{
+		uint32_t magic32;
+		if (fSigned)
+			ComputeSignedMagic<uint32_t>(uint32_t(d), &magic32, &shift);
+		else
+			ComputeUnsignedMagic<uint32_t>(uint32_t(d), &magic32, &shift, &fAdd);
+		magic = magic32;
+	}
 
+	PushOp({ 0x89, 0xC1 });		// mov ecx, eax		; keep the dividend for the remainder
+	PushOp({ 0xB8 });			// mov eax, magic
 	if (f64)
+		SafePushCode(magic);
+	else
+		SafePushCode(uint32_t(magic));
+
+	if (fSigned)
 	{
-		//	xchg rax, qword ptr [rdi]		; operands in the wrong order
-		static const uint8_t rgcodeXchg[] = { 0x48, 0x87, 0x07 };
-		SafePushCode(rgcodeXchg);
+		PushOp({ 0xF7, 0xE9 });		// imul ecx		; edx = mulhs(x, magic)
+		if ((magic >> (cbit - 1)) & 1)
+			PushOp({ 0x01, 0xCA });	// add edx, ecx	; the magic number is really magic + 2^bits
+		if (shift > 0)
+			PushOp({ 0xC1, 0xFA, uint8_t(shift) });	// sar edx, shift
+		PushOp({ 0x89, 0xD0 });						// mov eax, edx
+		PushOp({ 0xC1, 0xE8, uint8_t(cbit - 1) });		// shr eax, bits - 1
+		PushOp({ 0x01, 0xD0 });						// add eax, edx		; round negative quotients towards zero
 	}
 	else
 	{
-		//	xchg eax, dword ptr [rdi]		; operands in the wrong order
-		static const uint8_t rgcodeXchg[] = { 0x87, 0x07 };
-		SafePushCode(rgcodeXchg);
+		PushOp({ 0xF7, 0xE1 });		// mul ecx		; edx = mulhu(x, magic)
+		if (fAdd)
+		{
+			PushOp({ 0x89, 0xC8 });						// mov eax, ecx
+			PushOp({ 0x29, 0xD0 });						// sub eax, edx
+			PushOp({ 0xD1, 0xE8 });						// shr eax, 1
+			PushOp({ 0x01, 0xD0 });						// add eax, edx
+			PushOp({ 0xC1, 0xE8, uint8_t(shift - 1) });	// shr eax, shift - 1
+		}
+		else
+		{
+			PushOp({ 0x89, 0xD0 });						// mov eax, edx
+			if (shift > 0)
+				PushOp({ 0xC1, 0xE8, uint8_t(shift) });	// shr eax, shift
+		}
+	}
+
+	if (fModulo)
+	{
+		if (!f64 || d == uint64_t(int32_t(d)))
+		{
+			// imul eax, eax, d
+			PushOp({ 0x69, 0xC0 });
+			SafePushCode(uint32_t(d));
+		}
+		else
+		{
+			// mov rdx, d
+			// imul rax, rdx
+			static const uint8_t rgcodeMov[] = { 0x48, 0xBA };
+			SafePushCode(rgcodeMov);
+			SafePushCode(d);
+			static const uint8_t rgcodeMul[] = { 0x48, 0x0F, 0xAF, 0xC2 };
+			SafePushCode(rgcodeMul);
+		}
+		PushOp({ 0x29, 0xC1 });		// sub ecx, eax
+		PushOp({ 0x89, 0xC8 });		// mov eax, ecx
+	}
+	else if (fNegative)
+	{
+		PushOp({ 0xF7, 0xD8 });		// neg eax
+	}
+}
+
+void JitWriter::Div(bool fSigned, bool fModulo, bool f64)
+{
+	if (m_fConstPending)
+	{
+		_DivImmPending(fSigned, fModulo, f64);
+		return;
+	}
+
+	_PopSecondParam(true /*fSwapParams*/);	// rax = dividend, rcx = divisor
+	_DivRcx(fSigned, fModulo, f64);
+}
+
+// rax = rax / rcx (or the remainder).  Division by zero and INT_MIN / -1 fault in the div itself, the trap handler
+//	turns that into a wasm trap.
+void JitWriter::_DivRcx(bool fSigned, bool fModulo, bool f64)
+{
+	if (fSigned && fModulo)
+	{
+		// The remainder only depends on the divisor's magnitude, taking its absolute value keeps INT_MIN % -1 from faulting
+		// mov edx, ecx
+		// sar edx, 31
+		// xor ecx, edx
+		// sub ecx, edx
+		if (f64)
+		{
+			static const uint8_t rgcodeAbs[] = { 0x48, 0x89, 0xCA, 0x48, 0xC1, 0xFA, 0x3F, 0x48, 0x31, 0xD1, 0x48, 0x29, 0xD1 };
+			SafePushCode(rgcodeAbs);
+		}
+		else
+		{
+			static const uint8_t rgcodeAbs[] = { 0x89, 0xCA, 0xC1, 0xFA, 0x1F, 0x31, 0xD1, 0x29, 0xD1 };
+			SafePushCode(rgcodeAbs);
+		}
 	}
+
 	if (fSigned)
 	{
 		if (f64)
@@ -1413,78 +2764,1231 @@ void JitWriter::Div(bool fSigned, bool fModulo, bool f64)
 			static const uint8_t rgcodeCqo[] = { 0x48, 0x99 };	// cqo to load rdx with the sign extension
 			SafePushCode(rgcodeCqo);
 		}
-		else
+		else
+		{
+			SafePushCode(uint8_t(0x99));	// cdq to load edx with the sign extension
+		}
+	}
+	else
+	{
+		// xor edx, edx { 0x31, 0xD2 }
+		static const uint8_t rgcodeClearEdx[] = { 0x31, 0xD2 };
+		SafePushCode(rgcodeClearEdx);
+	}
+
+	if (f64)
+		SafePushCode(uint8_t(0x48));	// rex prefix to make the following div instruction a 64-bit op
+	if (fSigned)
+	{
+		//  idiv ecx
+		static const uint8_t rgcodeDiv[] = { 0xF7, 0xF9 };
+		SafePushCode(rgcodeDiv);
+	}
+	else
+	{
+		// div ecx
+		static const uint8_t rgcodeDiv[] = { 0xF7, 0xF1 };
+		SafePushCode(rgcodeDiv);
+	}
+
+	if (fModulo)
+	{
+		if (f64)
+			SafePushCode(uint8_t(0x48));	// REX prefix to convert to 64-bit registers below
+		// take the remainder that's in edx
+		// mov eax, edx { 0x89, 0xD0 }
+		static const uint8_t rgcodeMovEaxEdx[] = { 0x89, 0xD0 };
+		SafePushCode(rgcodeMovEaxEdx);
+	}
+}
+
+// Advance past the immediates of op so the bytecode can be walked without compiling it
+static void SkipImmediates(opcode op, const uint8_t **ppop, size_t *pcb)
+{
+	switch (op)
+	{
+	case opcode::block:
+	case opcode::loop:
+	case opcode::IF:
+		safe_read_buffer<value_type>(ppop, pcb);
+		break;
+
+	case opcode::br:
+	case opcode::br_if:
+	case opcode::call:
+	case opcode::get_local:
+	case opcode::set_local:
+	case opcode::tee_local:
+	case opcode::get_global:
+	case opcode::set_global:
+		safe_read_buffer<varuint32>(ppop, pcb);
+		break;
+
+	case opcode::br_table:
+	{
+		uint32_t target_count = safe_read_buffer<varuint32>(ppop, pcb);
+		for (uint32_t itarget = 0; itarget <= target_count; ++itarget)	// <= for the default target
+			safe_read_buffer<varuint32>(ppop, pcb);
+		break;
+	}
+
+	case opcode::call_indirect:
+		safe_read_buffer<varuint32>(ppop, pcb);
+		safe_read_buffer<char>(ppop, pcb);	// reserved
+		break;
+
+	case opcode::current_memory:
+	case opcode::grow_memory:
+		safe_read_buffer<uint8_t>(ppop, pcb);	// reserved
+		break;
+
+	case opcode::i32_const:
+		safe_read_buffer<varint32>(ppop, pcb);
+		break;
+	case opcode::i64_const:
+		safe_read_buffer<varint64>(ppop, pcb);
+		break;
+	case opcode::f32_const:
+		safe_read_buffer<float>(ppop, pcb);
+		break;
+	case opcode::f64_const:
+		safe_read_buffer<double>(ppop, pcb);
+		break;
+
+	default:
+		if (op >= opcode::i32_load && op <= opcode::i64_store32)
+		{
+			safe_read_buffer<varuint32>(ppop, pcb);	// alignment
+			safe_read_buffer<varuint32>(ppop, pcb);	// offset
+		}
+		break;
+	}
+}
+
+// Small callees are compiled straight into their callers instead of being called, pfCalls is set if the body makes
+//	calls of its own (so inlining it doesn't save spilling the caller's pinned locals)
+bool JitWriter::FInlineCandidate(uint32_t ifn, bool *pfCalls) const
+{
+	if (ifn < m_pmodule->m_vecimports.size() || ifn >= m_cfn)
+		return false;
+	const FunctionCodeEntry *pfnc = m_pmodule->m_vecfn_code.at(ifn - m_pmodule->m_vecimports.size()).get();
+	const uint8_t *pop = pfnc->vecbytecode.data();
+	size_t cb = pfnc->vecbytecode.size();
+	if (cb > (m_fOptimizing ? cbInlineMaxOptimized : cbInlineMax))
+		return false;
+	*pfCalls = false;
+	while (cb > 0)
+	{
+		opcode op = safe_read_buffer<opcode>(&pop, &cb);
+		if (op == opcode::call || op == opcode::call_indirect)
+			*pfCalls = true;
+		SkipImmediates(op, &pop, &cb);
+	}
+	return true;
+}
+
+// A value IF whose arms are a handful of side effect free integer ops (pop points after its block type) is compiled
+//	without branches: both arms run and the condition picks the result with a cmov (see IfConvertedSelect)
+bool JitWriter::FIfConvertible(const uint8_t *pop, size_t cb)
+{
+	bool fElse = false;
+	uint32_t cop = 0;
+	int32_t cval = 0;	// operand stack height relative to the start of the arm
+	while (cb > 0)
+	{
+		opcode op = safe_read_buffer<opcode>(&pop, &cb);
+		int32_t cpop = 0;
+		int32_t cpush = 0;
+		if (op == opcode::ELSE || op == opcode::end)
+		{
+			if (cval != 1 || fElse != (op == opcode::end))
+				return false;
+			if (fElse)
+				return true;
+			fElse = true;
+			cop = 0;
+			cval = 0;
+			continue;
+		}
+		if (++cop > copIfConvertMax)
+			return false;
+		switch (op)
+		{
+		case opcode::nop:
+			break;
+		case opcode::get_local:
+		case opcode::get_global:
+		case opcode::i32_const:
+		case opcode::i64_const:
+			cpush = 1;
+			break;
+		case opcode::drop:
+			cpop = 1;
+			break;
+		case opcode::select:
+			cpop = 3;
+			cpush = 1;
+			break;
+		case opcode::i32_eqz:
+		case opcode::i64_eqz:
+		case opcode::i32_clz:
+		case opcode::i32_ctz:
+		case opcode::i32_popcnt:
+		case opcode::i64_clz:
+		case opcode::i64_ctz:
+		case opcode::i64_popcnt:
+		case opcode::i32_wrap_i64:
+		case opcode::i64_extend_s_i32:
+		case opcode::i64_extend_u_i32:
+			cpop = 1;
+			cpush = 1;
+			break;
+		default:
+			// comparisons and arithmetic that can't trap
+			if ((op >= opcode::i32_eq && op <= opcode::i64_ge_u)
+				|| (op >= opcode::i32_add && op <= opcode::i32_mul) || (op >= opcode::i32_and && op <= opcode::i32_rotr)
+				|| (op >= opcode::i64_add && op <= opcode::i64_mul) || (op >= opcode::i64_and && op <= opcode::i64_rotr))
+			{
+				cpop = 2;
+				cpush = 1;
+				break;
+			}
+			return false;
+		}
+		if (cval < cpop)
+			return false;	// uses a value from outside the arm
+		cval += cpush - cpop;
+		SkipImmediates(op, &pop, &cb);
+	}
+	return false;
+}
+
+// Pick the locals worth keeping in registers for the function body in pop.  Uses are weighted by loop depth
+//	and a local is only pinned if it is used more than it would be spilled and reloaded around calls
+void JitWriter::AllocateLocalRegisters(const uint8_t *pop, size_t cb, uint32_t clocals, uint32_t cargs)
+{
+#ifdef _DEBUG
+	static const Register rgregLocals[] = { Register::r13, Register::r14, Register::r15 };
+#else
+	static const Register rgregLocals[] = { Register::r13, Register::r14, Register::r15, Register::r12 };	// r12 holds the current opcode in debug builds
+#endif
+
+	m_vecpairLocalReg.clear();
+	std::vector<uint64_t> vecweightLocal(clocals, 0);
+	std::vector<bool> stackfLoop;
+	uint32_t cloopDepth = 0;
+	uint64_t weightCalls = 0;
+	while (cb > 0)
+	{
+		uint64_t weight = uint64_t(1) << (3 * std::min(cloopDepth, 6u));	// assume each loop runs ~8 times
+		opcode op = safe_read_buffer<opcode>(&pop, &cb);
+		switch (op)
+		{
+		case opcode::block:
+		case opcode::IF:
+		case opcode::loop:
+			stackfLoop.push_back(op == opcode::loop);
+			if (op == opcode::loop)
+				++cloopDepth;
+			break;
+		case opcode::end:
+			if (!stackfLoop.empty())
+			{
+				if (stackfLoop.back())
+					--cloopDepth;
+				stackfLoop.pop_back();
+			}
+			break;
+		case opcode::call:
+		{
+			const uint8_t *popT = pop;
+			size_t cbT = cb;
+			uint32_t ifn = safe_read_buffer<varuint32>(&popT, &cbT);
+			bool fCalls;
+			if (FInlineCandidate(ifn, &fCalls) && !fCalls)
+				break;	// compiled inline, nothing is spilled
+			weightCalls += weight;
+			break;
+		}
+		case opcode::call_indirect:
+			weightCalls += weight;
+			break;
+		case opcode::get_local:
+		case opcode::set_local:
+		case opcode::tee_local:
+		{
+			const uint8_t *popT = pop;
+			size_t cbT = cb;
+			uint32_t idx = safe_read_buffer<varuint32>(&popT, &cbT);
+			if (idx < clocals)
+				vecweightLocal[idx] += weight;
+			break;
+		}
+		default:
+			break;
+		}
+		SkipImmediates(op, &pop, &cb);
+	}
+
+	std::vector<uint32_t> vecidxPinned;
+	while (vecidxPinned.size() < _countof(rgregLocals))
+	{
+		auto itweightMax = std::max_element(vecweightLocal.begin(), vecweightLocal.end());
+		if (itweightMax == vecweightLocal.end() || *itweightMax <= weightCalls * 2)	// each call costs a spill and reload
+			break;
+		vecidxPinned.push_back(uint32_t(itweightMax - vecweightLocal.begin()));
+		*itweightMax = 0;
+	}
+
+	// Arguments passed in registers stay in the register they arrive in, the other locals get what is left
+	auto FRegisterArg = [&](uint32_t idx) { return idx < cargs && idx < cargRegister; };
+	for (uint32_t idx : vecidxPinned)
+	{
+		if (FRegisterArg(idx))
+			m_vecpairLocalReg.push_back(std::make_pair(idx, RegArgument(idx)));
+	}
+	for (uint32_t idx : vecidxPinned)
+	{
+		if (FRegisterArg(idx))
+			continue;
+		for (Register reg : rgregLocals)
+		{
+			auto FUsed = [reg](const std::pair<uint32_t, Register> &pairLocalReg) { return pairLocalReg.second == reg; };
+			if (std::none_of(m_vecpairLocalReg.begin(), m_vecpairLocalReg.end(), FUsed))
+			{
+				m_vecpairLocalReg.push_back(std::make_pair(idx, reg));
+				break;
+			}
+		}
+	}
+}
+
+bool JitWriter::FSameLoc(const SsaLoc &locA, const SsaLoc &locB)
+{
+	if (locA.kind != locB.kind)
+		return false;
+	switch (locA.kind)
+	{
+	case SsaLoc::Kind::Reg:
+		return locA.reg == locB.reg;
+	case SsaLoc::Kind::Mem:
+		return locA.disp == locB.disp;
+	default:
+		return locA.imm == locB.imm;
+	}
+}
+
+JitWriter::SsaLoc JitWriter::_SsaLocation(const SsaFunction &ssa, uint32_t ival) const
+{
+	const SsaFunction::Value &val = ssa.m_vecval[ival];
+	if (val.kind == SsaFunction::ValueKind::Const)
+		return LocImm(val.imm);
+	if (val.kind == SsaFunction::ValueKind::Param && val.iblock == SsaFunction::ivalNil)
+		return LocMem(numeric_cast<int32_t>(val.imm * sizeof(uint64_t)));	// a local as baseline code left it, see OSR entries
+	if (val.ireg >= 0)
+		return LocReg(Register(uint8_t(Register::r8) + val.ireg));
+	Verify(val.islot != SsaFunction::ivalNil);
+	// Spill slots follow the locals, which only OSR entries read
+	return LocMem(numeric_cast<int32_t>((ssa.m_vectypeLocal.size() + val.islot) * sizeof(uint64_t)));
+}
+
+// The location of ival as an operand of an instruction taking a register, memory or sign extended imm32 source,
+//	constants that don't fit are loaded into regScratch.  i32 constants are used sign extended as the high half is ignored.
+JitWriter::SsaLoc JitWriter::_SsaOperand(const SsaFunction &ssa, uint32_t ival, bool f64, Register regScratch)
+{
+	SsaLoc loc = _SsaLocation(ssa, ival);
+	if (loc.kind != SsaLoc::Kind::Imm)
+		return loc;
+	if (!f64)
+		loc.imm = int32_t(loc.imm);
+	if (loc.imm == int32_t(loc.imm))
+		return loc;
+	_SsaMovImm(regScratch, loc.imm);
+	return LocReg(regScratch);
+}
+
+// [prefix] [REX] opcode ModRM [disp32] with a register or [rbx + disp] as the r/m operand
+void JitWriter::_SsaModRM(uint8_t prefix, std::initializer_list<uint8_t> ilopcode, uint8_t regField, const SsaLoc &locRM, bool f64)
+{
+	Verify(locRM.kind != SsaLoc::Kind::Imm);
+	if (prefix != 0)
+		SafePushCode(prefix);
+	uint8_t rex = 0x40 | (f64 ? 0x08 : 0) | ((regField & 8) ? 0x04 : 0);
+	if (locRM.kind == SsaLoc::Kind::Reg && (uint8_t(locRM.reg) & 8))
+		rex |= 0x01;
+	if (rex != 0x40)
+		SafePushCode(rex);
+	SafePushCode(ilopcode.begin(), ilopcode.size());
+	if (locRM.kind == SsaLoc::Kind::Reg)
+	{
+		SafePushCode(uint8_t(0xC0 | ((regField & 7) << 3) | (uint8_t(locRM.reg) & 7)));
+	}
+	else
+	{
+		SafePushCode(uint8_t(0x80 | ((regField & 7) << 3) | 0x03));	// [rbx + disp32]
+		SafePushCode(locRM.disp);
+	}
+}
+
+// Like _SsaModRM with [rsi + addr + offset] as the memory operand.  Addresses are zero extended i32 values so they index
+//	the heap directly, rcx and rdx are used when the address has to be loaded or the offset doesn't fit a disp32.
+void JitWriter::_SsaHeapModRM(uint8_t prefix, std::initializer_list<uint8_t> ilopcode, uint8_t regField, bool f64, const SsaLoc &locAddr, uint32_t offset)
+{
+	bool fIndex = true;
+	Register regIndex = Register::rcx;
+	uint32_t disp = offset;
+	if (locAddr.kind == SsaLoc::Kind::Imm)
+	{
+		uint64_t addr = uint64_t(uint32_t(locAddr.imm)) + offset;
+		if (addr <= INT32_MAX)
+		{
+			fIndex = false;
+			disp = uint32_t(addr);
+		}
+		else
+		{
+			_SsaMovImm(Register::rcx, int64_t(addr));
+			disp = 0;
+		}
+	}
+	else if (offset > INT32_MAX)
+	{
+		_SsaModRM(0, { 0x8B }, uint8_t(Register::rcx), locAddr, false);	// mov ecx, addr
+		_SsaMovImm(Register::rdx, offset);
+		static const uint8_t rgcodeAdd[] = { 0x48, 0x01, 0xD1 };	// add rcx, rdx
+		SafePushCode(rgcodeAdd);
+		disp = 0;
+	}
+	else if (locAddr.kind == SsaLoc::Kind::Mem)
+	{
+		_SsaModRM(0, { 0x8B }, uint8_t(Register::rcx), locAddr, false);	// mov ecx, addr
+	}
+	else
+	{
+		regIndex = locAddr.reg;
+	}
+
+	if (prefix != 0)
+		SafePushCode(prefix);
+	uint8_t rex = 0x40 | (f64 ? 0x08 : 0) | ((regField & 8) ? 0x04 : 0) | ((fIndex && (uint8_t(regIndex) & 8)) ? 0x02 : 0);
+	if (rex != 0x40)
+		SafePushCode(rex);
+	SafePushCode(ilopcode.begin(), ilopcode.size());
+	uint8_t mod = (disp == 0) ? 0x00 : ((disp <= INT8_MAX) ? 0x40 : 0x80);
+	SafePushCode(uint8_t(mod | ((regField & 7) << 3) | 0x04));		// SIB follows
+	SafePushCode(uint8_t((fIndex ? ((uint8_t(regIndex) & 7) << 3) : 0x20) | 0x06));	// [rsi + index] or [rsi] (index 100 is none)
+	if (mod == 0x40)
+		SafePushCode(uint8_t(disp));
+	else if (mod == 0x80)
+		SafePushCode(disp);
+}
+
+// opcode with [rip + disp32] addressing pvTarget
+// op reg, [rbp + DispGlobal(idxGlobal)]
+void JitWriter::_SsaGlobalModRM(std::initializer_list<uint8_t> ilopcode, Register reg, bool f64, uint32_t idxGlobal)
+{
+	uint8_t rex = 0x40 | (f64 ? 0x08 : 0) | ((uint8_t(reg) & 8) ? 0x04 : 0);
+	if (rex != 0x40)
+		SafePushCode(rex);
+	SafePushCode(ilopcode.begin(), ilopcode.size());
+	SafePushCode(uint8_t(((uint8_t(reg) & 7) << 3) | 0x85));
+	SafePushCode(DispGlobal(idxGlobal));
+}
+
+// mov reg, imm using the shortest encoding, leaves the flags alone
+void JitWriter::_SsaMovImm(Register reg, int64_t imm)
+{
+	uint8_t rexB = (uint8_t(reg) & 8) ? 0x01 : 0;
+	if (uint64_t(imm) <= UINT32_MAX)
+	{
+		// mov r32, imm32		; zero extends
+		if (rexB)
+			SafePushCode(uint8_t(0x40 | rexB));
+		SafePushCode(uint8_t(0xB8 | (uint8_t(reg) & 7)));
+		SafePushCode(uint32_t(imm));
+	}
+	else if (imm == int32_t(imm))
+	{
+		// mov r64, simm32
+		const uint8_t rgcode[] = { uint8_t(0x48 | rexB), 0xC7, uint8_t(0xC0 | (uint8_t(reg) & 7)) };
+		SafePushCode(rgcode);
+		SafePushCode(int32_t(imm));
+	}
+	else
+	{
+		// mov r64, imm64
+		const uint8_t rgcode[] = { uint8_t(0x48 | rexB), uint8_t(0xB8 | (uint8_t(reg) & 7)) };
+		SafePushCode(rgcode);
+		SafePushCode(imm);
+	}
+}
+
+// 64-bit move between any two locations, memory to memory goes through rdx
+void JitWriter::_SsaMov(const SsaLoc &locDst, const SsaLoc &locSrc)
+{
+	Verify(locDst.kind != SsaLoc::Kind::Imm);
+	if (FSameLoc(locDst, locSrc))
+		return;
+	if (locDst.kind == SsaLoc::Kind::Reg)
+	{
+		if (locSrc.kind == SsaLoc::Kind::Imm)
+			_SsaMovImm(locDst.reg, locSrc.imm);
+		else if (locSrc.kind == SsaLoc::Kind::Reg)
+			_SsaModRM(0, { 0x89 }, uint8_t(locSrc.reg), locDst, true);	// mov dst, src
+		else
+			_SsaModRM(0, { 0x8B }, uint8_t(locDst.reg), locSrc, true);	// mov dst, [rbx + disp]
+		return;
+	}
+
+	if (locSrc.kind == SsaLoc::Kind::Reg)
+	{
+		_SsaModRM(0, { 0x89 }, uint8_t(locSrc.reg), locDst, true);		// mov [rbx + disp], src
+	}
+	else if (locSrc.kind == SsaLoc::Kind::Imm && locSrc.imm == int32_t(locSrc.imm))
+	{
+		_SsaModRM(0, { 0xC7 }, 0, locDst, true);						// mov qword [rbx + disp], simm32
+		SafePushCode(int32_t(locSrc.imm));
+	}
+	else
+	{
+		_SsaMov(LocReg(Register::rdx), locSrc);
+		_SsaModRM(0, { 0x89 }, uint8_t(Register::rdx), locDst, true);
+	}
+}
+
+// op regDst, src for the 0x01-0x3B ALU group (opext is the /digit of 0x81/0x83)
+void JitWriter::_SsaAluRM(uint8_t opext, Register regDst, const SsaLoc &locSrc, bool f64)
+{
+	if (locSrc.kind != SsaLoc::Kind::Imm)
+	{
+		_SsaModRM(0, { uint8_t((opext << 3) | 0x03) }, uint8_t(regDst), locSrc, f64);
+	}
+	else if (locSrc.imm == int8_t(locSrc.imm))
+	{
+		_SsaModRM(0, { 0x83 }, opext, LocReg(regDst), f64);
+		SafePushCode(int8_t(locSrc.imm));
+	}
+	else
+	{
+		Verify(locSrc.imm == int32_t(locSrc.imm));
+		_SsaModRM(0, { 0x81 }, opext, LocReg(regDst), f64);
+		SafePushCode(int32_t(locSrc.imm));
+	}
+}
+
+// Performs all the (dst, src) moves as if at once, cycles are broken through rax
+void JitWriter::_SsaParallelMove(std::vector<std::pair<SsaLoc, SsaLoc>> vecpairMove)
+{
+	vecpairMove.erase(std::remove_if(vecpairMove.begin(), vecpairMove.end(), [](const std::pair<SsaLoc, SsaLoc> &pair) { return FSameLoc(pair.first, pair.second); }), vecpairMove.end());
+	while (!vecpairMove.empty())
+	{
+		bool fProgress = false;
+		for (size_t imove = 0; imove < vecpairMove.size(); ++imove)
+		{
+			bool fBlocked = false;
+			for (size_t imoveOther = 0; imoveOther < vecpairMove.size() && !fBlocked; ++imoveOther)
+				fBlocked = (imoveOther != imove) && FSameLoc(vecpairMove[imoveOther].second, vecpairMove[imove].first);
+			if (fBlocked)
+				continue;
+			_SsaMov(vecpairMove[imove].first, vecpairMove[imove].second);
+			vecpairMove.erase(vecpairMove.begin() + imove);
+			fProgress = true;
+			break;
+		}
+		if (fProgress)
+			continue;
+
+		// Everything left is on a cycle, park the first destination's value in rax and read it from there instead
+		SsaLoc locCycle = vecpairMove.front().first;
+		_SsaMov(LocReg(Register::rax), locCycle);
+		for (auto &pairMove : vecpairMove)
+		{
+			if (FSameLoc(pairMove.second, locCycle))
+				pairMove.second = LocReg(Register::rax);
+		}
+	}
+}
+
+// The moves into iblockTo's phis along the edge from iblockFrom
+void JitWriter::_SsaEdgeMoves(const SsaFunction &ssa, uint32_t iblockFrom, uint32_t iblockTo, std::vector<std::pair<SsaLoc, SsaLoc>> *pvecpairMove)
+{
+	const SsaFunction::Block &blockTo = ssa.m_vecblock[iblockTo];
+	size_t ipred = std::find(blockTo.veciblockPred.begin(), blockTo.veciblockPred.end(), iblockFrom) - blockTo.veciblockPred.begin();
+	Verify(ipred < blockTo.veciblockPred.size());
+	for (uint32_t ival : blockTo.vecival)
+	{
+		const SsaFunction::Value &val = ssa.m_vecval[ival];
+		if (val.kind != SsaFunction::ValueKind::Phi)
+			break;
+		pvecpairMove->push_back(std::make_pair(_SsaLocation(ssa, ival), _SsaLocation(ssa, ssa.m_vecvecivalPhi[val.rgival[0]][ipred])));
+	}
+}
+
+// Sets the flags for the compare ival and returns the condition that holds when it is true
+JitWriter::ConditionCode JitWriter::_SsaCompare(const SsaFunction &ssa, uint32_t ival)
+{
+	const SsaFunction::Value &val = ssa.m_vecval[ival];
+	if (val.op == opcode::i32_eqz || val.op == opcode::i64_eqz)
+	{
+		SsaLoc loc = _SsaOperand(ssa, val.rgival[0], true, Register::rcx);
+		if (loc.kind == SsaLoc::Kind::Imm)
+		{
+			_SsaMovImm(Register::rcx, loc.imm);
+			loc = LocReg(Register::rcx);
+		}
+		if (loc.kind == SsaLoc::Kind::Reg)
+		{
+			_SsaModRM(0, { 0x85 }, uint8_t(loc.reg), loc, true);	// test reg, reg
+		}
+		else
+		{
+			_SsaModRM(0, { 0x83 }, 7, loc, true);	// cmp qword [rbx + disp], 0
+			SafePushCode(uint8_t(0));
+		}
+		return ConditionCode::Equal;
+	}
+
+	static const ConditionCode rgcond[] = { ConditionCode::Equal, ConditionCode::NotEqual, ConditionCode::Less, ConditionCode::Below, ConditionCode::Greater,
+		ConditionCode::Above, ConditionCode::LessEqual, ConditionCode::BelowEqual, ConditionCode::GreaterEqual, ConditionCode::AboveEqual };
+	bool f64 = (val.op >= opcode::i64_eq);
+	ConditionCode cond = rgcond[uint8_t(val.op) - uint8_t(f64 ? opcode::i64_eq : opcode::i32_eq)];
+	SsaLoc locA = _SsaOperand(ssa, val.rgival[0], f64, Register::rcx);
+	SsaLoc locB = _SsaOperand(ssa, val.rgival[1], f64, Register::rdx);
+	if (locA.kind == SsaLoc::Kind::Imm)
+	{
+		// compare the other way around
+		std::swap(locA, locB);
+		switch (cond)
+		{
+		case ConditionCode::Less: cond = ConditionCode::Greater; break;
+		case ConditionCode::Greater: cond = ConditionCode::Less; break;
+		case ConditionCode::LessEqual: cond = ConditionCode::GreaterEqual; break;
+		case ConditionCode::GreaterEqual: cond = ConditionCode::LessEqual; break;
+		case ConditionCode::Below: cond = ConditionCode::Above; break;
+		case ConditionCode::Above: cond = ConditionCode::Below; break;
+		case ConditionCode::BelowEqual: cond = ConditionCode::AboveEqual; break;
+		case ConditionCode::AboveEqual: cond = ConditionCode::BelowEqual; break;
+		default: break;
+		}
+	}
+	if (locA.kind == SsaLoc::Kind::Imm || (locA.kind == SsaLoc::Kind::Mem && locB.kind == SsaLoc::Kind::Mem))
+	{
+		_SsaMov(LocReg(Register::rcx), locA);
+		locA = LocReg(Register::rcx);
+	}
+
+	if (locB.kind == SsaLoc::Kind::Imm)
+	{
+		// cmp a, imm
+		if (locB.imm == int8_t(locB.imm))
+		{
+			_SsaModRM(0, { 0x83 }, 7, locA, f64);
+			SafePushCode(int8_t(locB.imm));
+		}
+		else
+		{
+			_SsaModRM(0, { 0x81 }, 7, locA, f64);
+			SafePushCode(int32_t(locB.imm));
+		}
+	}
+	else if (locB.kind == SsaLoc::Kind::Reg)
+	{
+		_SsaModRM(0, { 0x39 }, uint8_t(locB.reg), locA, f64);	// cmp a, b
+	}
+	else
+	{
+		_SsaModRM(0, { 0x3B }, uint8_t(locA.reg), locB, f64);	// cmp a, [rbx + disp]
+	}
+	return cond;
+}
+
+void JitWriter::_SsaLowerValue(const SsaFunction &ssa, uint32_t ival)
+{
+	const SsaFunction::Value &val = ssa.m_vecval[ival];
+	if (val.kind == SsaFunction::ValueKind::Phi || val.fFused)
+		return;	// phis are written by the moves on their incoming edges, fused compares by the branch using them
+
+	SsaLoc locDst = (val.type != value_type::none) ? _SsaLocation(ssa, ival) : LocReg(Register::rax);
+	Register regDst = (locDst.kind == SsaLoc::Kind::Reg) ? locDst.reg : Register::rax;
+	const bool f64 = (val.type == value_type::i64);
+
+	if (val.kind == SsaFunction::ValueKind::Param)
+	{
+		// mov dst, [rbx + idx*8]	; 32-bit for i32 so the high half is clear whatever the caller left there
+		_SsaModRM(0, { 0x8B }, uint8_t(regDst), LocMem(numeric_cast<int32_t>(val.imm * sizeof(uint64_t))), f64);
+	}
+	else
+	{
+		Verify(val.kind == SsaFunction::ValueKind::Op);
+		const opcode op = val.op;
+		switch (op)
+		{
+		case opcode::i32_add: case opcode::i64_add:
+		case opcode::i32_sub: case opcode::i64_sub:
+		case opcode::i32_and: case opcode::i64_and:
+		case opcode::i32_or: case opcode::i64_or:
+		case opcode::i32_xor: case opcode::i64_xor:
+		case opcode::i32_mul: case opcode::i64_mul:
+		{
+			const opcode opBase = f64 ? opcode(uint8_t(op) - uint8_t(opcode::i64_clz) + uint8_t(opcode::i32_clz)) : op;
+			uint8_t opext = 0;
+			switch (opBase)
+			{
+			case opcode::i32_add: opext = 0; break;
+			case opcode::i32_or: opext = 1; break;
+			case opcode::i32_and: opext = 4; break;
+			case opcode::i32_sub: opext = 5; break;
+			case opcode::i32_xor: opext = 6; break;
+			default: break;
+			}
+			SsaLoc locA = _SsaLocation(ssa, val.rgival[0]);
+			SsaLoc locB = _SsaOperand(ssa, val.rgival[1], f64, Register::rdx);
+			const bool fCommutative = (opBase != opcode::i32_sub);
+			if (fCommutative && locB.kind != SsaLoc::Kind::Imm && locA.kind == SsaLoc::Kind::Imm)
+			{
+				locB = _SsaOperand(ssa, val.rgival[0], f64, Register::rdx);
+				locA = _SsaLocation(ssa, val.rgival[1]);
+			}
+			if (locB.kind == SsaLoc::Kind::Reg && locB.reg == regDst && !(locA.kind == SsaLoc::Kind::Reg && locA.reg == regDst))
+			{
+				if (fCommutative)
+				{
+					std::swap(locA, locB);
+				}
+				else
+				{
+					// b already lives in the destination, compute in rax
+					_SsaMov(LocReg(Register::rax), locA);
+					_SsaAluRM(opext, Register::rax, locB, f64);
+					_SsaMov(LocReg(regDst), LocReg(Register::rax));
+					break;
+				}
+			}
+			if (opBase == opcode::i32_mul && locB.kind == SsaLoc::Kind::Imm)
+			{
+				// imul dst, a, imm
+				if (locA.kind == SsaLoc::Kind::Imm)
+				{
+					_SsaMovImm(regDst, locA.imm);
+					locA = LocReg(regDst);
+				}
+				if (locB.imm == int8_t(locB.imm))
+				{
+					_SsaModRM(0, { 0x6B }, uint8_t(regDst), locA, f64);
+					SafePushCode(int8_t(locB.imm));
+				}
+				else
+				{
+					_SsaModRM(0, { 0x69 }, uint8_t(regDst), locA, f64);
+					SafePushCode(int32_t(locB.imm));
+				}
+				break;
+			}
+			_SsaMov(LocReg(regDst), locA);
+			if (opBase == opcode::i32_mul)
+				_SsaModRM(0, { 0x0F, 0xAF }, uint8_t(regDst), locB, f64);	// imul dst, b
+			else
+				_SsaAluRM(opext, regDst, locB, f64);
+			break;
+		}
+
+		case opcode::i32_shl: case opcode::i64_shl:
+		case opcode::i32_shr_s: case opcode::i64_shr_s:
+		case opcode::i32_shr_u: case opcode::i64_shr_u:
+		case opcode::i32_rotl: case opcode::i64_rotl:
+		case opcode::i32_rotr: case opcode::i64_rotr:
+		{
+			const opcode opBase = f64 ? opcode(uint8_t(op) - uint8_t(opcode::i64_clz) + uint8_t(opcode::i32_clz)) : op;
+			uint8_t opext = 0;
+			switch (opBase)
+			{
+			case opcode::i32_rotl: opext = 0; break;
+			case opcode::i32_rotr: opext = 1; break;
+			case opcode::i32_shl: opext = 4; break;
+			case opcode::i32_shr_u: opext = 5; break;
+			case opcode::i32_shr_s: opext = 7; break;
+			default: break;
+			}
+			SsaLoc locCount = _SsaLocation(ssa, val.rgival[1]);
+			if (locCount.kind == SsaLoc::Kind::Imm)
+			{
+				// op dst, imm8
+				_SsaMov(LocReg(regDst), _SsaLocation(ssa, val.rgival[0]));
+				_SsaModRM(0, { 0xC1 }, opext, LocReg(regDst), f64);
+				SafePushCode(uint8_t(locCount.imm & (f64 ? 63 : 31)));
+			}
+			else
+			{
+				// mov ecx, count	; before the destination is written, it may be the count
+				// op dst, cl
+				_SsaMov(LocReg(Register::rcx), locCount);
+				_SsaMov(LocReg(regDst), _SsaLocation(ssa, val.rgival[0]));
+				_SsaModRM(0, { 0xD3 }, opext, LocReg(regDst), f64);
+			}
+			break;
+		}
+
+		case opcode::i32_div_s: case opcode::i64_div_s:
+		case opcode::i32_div_u: case opcode::i64_div_u:
+		case opcode::i32_rem_s: case opcode::i64_rem_s:
+		case opcode::i32_rem_u: case opcode::i64_rem_u:
+		{
+			const opcode opBase = f64 ? opcode(uint8_t(op) - uint8_t(opcode::i64_clz) + uint8_t(opcode::i32_clz)) : op;
+			const bool fSigned = (opBase == opcode::i32_div_s || opBase == opcode::i32_rem_s);
+			const bool fModulo = (opBase == opcode::i32_rem_s || opBase == opcode::i32_rem_u);
+			SsaLoc locDivisor = _SsaLocation(ssa, val.rgival[1]);
+			_SsaMov(LocReg(Register::rax), _SsaLocation(ssa, val.rgival[0]));
+			if (locDivisor.kind == SsaLoc::Kind::Imm && FConstFoldable(op, f64 ? locDivisor.imm : int32_t(locDivisor.imm), f64))
+			{
+				m_fConstPending = true;
+				m_constPending = f64 ? locDivisor.imm : int32_t(locDivisor.imm);
+				_DivImmPending(fSigned, fModulo, f64);
+			}
+			else
+			{
+				_SsaMov(LocReg(Register::rcx), locDivisor);
+				_DivRcx(fSigned, fModulo, f64);
+			}
+			_SsaMov(LocReg(regDst), LocReg(Register::rax));
+			break;
+		}
+
+		case opcode::i32_eqz: case opcode::i64_eqz:
+		case opcode::i32_eq: case opcode::i64_eq:
+		case opcode::i32_ne: case opcode::i64_ne:
+		case opcode::i32_lt_s: case opcode::i64_lt_s:
+		case opcode::i32_lt_u: case opcode::i64_lt_u:
+		case opcode::i32_gt_s: case opcode::i64_gt_s:
+		case opcode::i32_gt_u: case opcode::i64_gt_u:
+		case opcode::i32_le_s: case opcode::i64_le_s:
+		case opcode::i32_le_u: case opcode::i64_le_u:
+		case opcode::i32_ge_s: case opcode::i64_ge_s:
+		case opcode::i32_ge_u: case opcode::i64_ge_u:
+		{
+			// setcc al
+			// movzx dst, al
+			ConditionCode cond = _SsaCompare(ssa, ival);
+			const uint8_t rgcodeSet[] = { 0x0F, uint8_t(0x90 | uint8_t(cond)), 0xC0 };
+			SafePushCode(rgcodeSet);
+			_SsaModRM(0, { 0x0F, 0xB6 }, uint8_t(regDst), LocReg(Register::rax), false);
+			break;
+		}
+
+		case opcode::select:
+		{
+			// mov rax, b
+			// test c, c			; or the cmp of a fused compare
+			// cmovcc rax, a
+			_SsaMov(LocReg(Register::rax), _SsaLocation(ssa, val.rgival[1]));
+			ConditionCode cond = ConditionCode::NotEqual;
+			if (ssa.m_vecval[val.rgival[2]].fFused)
+			{
+				cond = _SsaCompare(ssa, val.rgival[2]);
+			}
+			else
+			{
+				SsaLoc locCond = _SsaLocation(ssa, val.rgival[2]);
+				if (locCond.kind == SsaLoc::Kind::Imm)
+				{
+					_SsaMovImm(Register::rcx, locCond.imm);
+					locCond = LocReg(Register::rcx);
+				}
+				if (locCond.kind == SsaLoc::Kind::Reg)
+				{
+					_SsaModRM(0, { 0x85 }, uint8_t(locCond.reg), locCond, true);
+				}
+				else
+				{
+					_SsaModRM(0, { 0x83 }, 7, locCond, true);	// cmp qword [rbx + disp], 0
+					SafePushCode(uint8_t(0));
+				}
+			}
+			// the compare is done with rcx and rdx, a constant can go in rdx now (mov leaves the flags alone)
+			SsaLoc locTrue = _SsaOperand(ssa, val.rgival[0], true, Register::rdx);
+			if (locTrue.kind == SsaLoc::Kind::Imm)
+			{
+				_SsaMovImm(Register::rdx, locTrue.imm);
+				locTrue = LocReg(Register::rdx);
+			}
+			_SsaModRM(0, { 0x0F, uint8_t(0x40 | uint8_t(cond)) }, uint8_t(Register::rax), locTrue, true);
+			_SsaMov(LocReg(regDst), LocReg(Register::rax));
+			break;
+		}
+
+		case opcode::i32_clz: case opcode::i64_clz:
+		case opcode::i32_ctz: case opcode::i64_ctz:
+		case opcode::i32_popcnt: case opcode::i64_popcnt:
+		{
+			// lzcnt/tzcnt/popcnt dst, a
+			uint8_t opcodeCount = (op == opcode::i32_clz || op == opcode::i64_clz) ? 0xBD : ((op == opcode::i32_ctz || op == opcode::i64_ctz) ? 0xBC : 0xB8);
+			SsaLoc locA = _SsaOperand(ssa, val.rgival[0], f64, Register::rcx);
+			if (locA.kind == SsaLoc::Kind::Imm)
+			{
+				_SsaMovImm(Register::rcx, locA.imm);
+				locA = LocReg(Register::rcx);
+			}
+			_SsaModRM(0xF3, { 0x0F, opcodeCount }, uint8_t(regDst), locA, f64);
+			break;
+		}
+
+		case opcode::i32_wrap_i64:
+		case opcode::i64_extend_u_i32:
+		case opcode::i64_extend_s_i32:
+		{
+			SsaLoc locA = _SsaLocation(ssa, val.rgival[0]);
+			if (locA.kind == SsaLoc::Kind::Imm)
+			{
+				_SsaMovImm(regDst, (op == opcode::i64_extend_s_i32) ? int64_t(int32_t(locA.imm)) : int64_t(uint32_t(locA.imm)));
+			}
+			else if (op == opcode::i64_extend_s_i32)
+			{
+				_SsaModRM(0, { 0x63 }, uint8_t(regDst), locA, true);	// movsxd dst, a
+			}
+			else
+			{
+				_SsaModRM(0, { 0x8B }, uint8_t(regDst), locA, false);	// mov dst32, a32
+			}
+			break;
+		}
+
+		case opcode::get_global:
+			// mov dst, [rbp + DispGlobal(idx)]
+			_SsaGlobalModRM({ 0x8B }, regDst, f64, uint32_t(val.imm));
+			break;
+
+		case opcode::set_global:
+		{
+			SsaLoc locVal = _SsaLocation(ssa, val.rgival[0]);
+			if (locVal.kind != SsaLoc::Kind::Reg)
+			{
+				_SsaMov(LocReg(Register::rax), locVal);
+				locVal = LocReg(Register::rax);
+			}
+			// mov [rbp + DispGlobal(idx)], val
+			_SsaGlobalModRM({ 0x89 }, locVal.reg, m_pmodule->m_vecglbls.at(size_t(val.imm)).type == value_type::i64, uint32_t(val.imm));
+			break;
+		}
+
+		case opcode::i32_load:
+		case opcode::i32_load8_s:
+		case opcode::i32_load8_u:
+		case opcode::i32_load16_s:
+		case opcode::i32_load16_u:
+		case opcode::i64_load:
+		case opcode::i64_load8_s:
+		case opcode::i64_load8_u:
+		case opcode::i64_load16_s:
+		case opcode::i64_load16_u:
+		case opcode::i64_load32_s:
+		case opcode::i64_load32_u:
+		{
+			SsaLoc locAddr = _SsaLocation(ssa, val.rgival[0]);
+			uint32_t offset = uint32_t(val.imm);
+			switch (op)
+			{
+			case opcode::i32_load:		_SsaHeapModRM(0, { 0x8B }, uint8_t(regDst), false, locAddr, offset); break;
+			case opcode::i64_load:		_SsaHeapModRM(0, { 0x8B }, uint8_t(regDst), true, locAddr, offset); break;
+			case opcode::i32_load8_s:	_SsaHeapModRM(0, { 0x0F, 0xBE }, uint8_t(regDst), false, locAddr, offset); break;
+			case opcode::i64_load8_s:	_SsaHeapModRM(0, { 0x0F, 0xBE }, uint8_t(regDst), true, locAddr, offset); break;
+			case opcode::i32_load8_u:
+			case opcode::i64_load8_u:	_SsaHeapModRM(0, { 0x0F, 0xB6 }, uint8_t(regDst), false, locAddr, offset); break;
+			case opcode::i32_load16_s:	_SsaHeapModRM(0, { 0x0F, 0xBF }, uint8_t(regDst), false, locAddr, offset); break;
+			case opcode::i64_load16_s:	_SsaHeapModRM(0, { 0x0F, 0xBF }, uint8_t(regDst), true, locAddr, offset); break;
+			case opcode::i32_load16_u:
+			case opcode::i64_load16_u:	_SsaHeapModRM(0, { 0x0F, 0xB7 }, uint8_t(regDst), false, locAddr, offset); break;
+			case opcode::i64_load32_s:	_SsaHeapModRM(0, { 0x63 }, uint8_t(regDst), true, locAddr, offset); break;
+			case opcode::i64_load32_u:	_SsaHeapModRM(0, { 0x8B }, uint8_t(regDst), false, locAddr, offset); break;
+			default: Verify(false);
+			}
+			break;
+		}
+
+		case opcode::i32_store:
+		case opcode::i64_store:
+		case opcode::i32_store8:
+		case opcode::i32_store16:
+		case opcode::i64_store8:
+		case opcode::i64_store16:
+		case opcode::i64_store32:
+		{
+			SsaLoc locVal = _SsaLocation(ssa, val.rgival[1]);
+			if (locVal.kind != SsaLoc::Kind::Reg)
+			{
+				_SsaMov(LocReg(Register::rax), locVal);
+				locVal = LocReg(Register::rax);
+			}
+			SsaLoc locAddr = _SsaLocation(ssa, val.rgival[0]);
+			uint32_t offset = uint32_t(val.imm);
+			switch (op)
+			{
+			case opcode::i32_store:
+			case opcode::i64_store32:	_SsaHeapModRM(0, { 0x89 }, uint8_t(locVal.reg), false, locAddr, offset); break;
+			case opcode::i64_store:		_SsaHeapModRM(0, { 0x89 }, uint8_t(locVal.reg), true, locAddr, offset); break;
+			case opcode::i32_store8:
+			case opcode::i64_store8:	_SsaHeapModRM(0, { 0x88 }, uint8_t(locVal.reg), false, locAddr, offset); break;
+			case opcode::i32_store16:
+			case opcode::i64_store16:	_SsaHeapModRM(0x66, { 0x89 }, uint8_t(locVal.reg), false, locAddr, offset); break;
+			default: Verify(false);
+			}
+			break;
+		}
+
+		default:
+			Verify(false, "opcode not supported by SsaFunction");
+		}
+	}
+
+	if (locDst.kind == SsaLoc::Kind::Mem)
+		_SsaMov(locDst, LocReg(Register::rax));
+}
+
+// Compiles ifn from SSA form for the optimizing tier.  Returns false without emitting anything if SsaFunction can't
+//	handle it.  The entry points and OSR entries match what CompileFn would have produced.
+bool JitWriter::FCompileFnSsa(uint32_t ifn)
+{
+	SsaFunction ssa;
+	if (!ssa.FBuild(m_pmodule, ifn))
+		return false;
+	ssa.Optimize();
+	if (!ssa.FAllocateRegisters())
+		return false;
+
+#ifdef PRINT_DISASSEMBLY
+	printf("Function %d (SSA):\n", ifn);
+#endif
+	uint8_t *pbEntry = m_pexecPlaneCur;	// goes in the vector table once we are done
+
+	// Parameters are read from the locals array, the register entry puts its arguments there first
+	const uint32_t cargsRegister = (ssa.m_cparams < cargRegister) ? ssa.m_cparams : cargRegister;
+	if (cargsRegister > 0)
+	{
+		// jmp short past the register entry's spills (4 bytes each)
+		const uint8_t rgcodeJmp[] = { 0xEB, uint8_t(cargsRegister * 4) };
+		SafePushCode(rgcodeJmp);
+	}
+	m_vecpbRegisterEntry.at(ifn) = m_pexecPlaneCur;
+	for (uint32_t iarg = 0; iarg < cargsRegister; ++iarg)
+	{
+		// mov [rbx+idx], reg
+		const uint8_t rgcode[] = { 0x4C, 0x89, uint8_t(0x43 | ((uint8_t(RegArgument(iarg)) & 7) << 3)), uint8_t(iarg * sizeof(uint64_t)) };
+		SafePushCode(rgcode);
+	}
+
+	std::vector<uint8_t*> vecpbBlock(ssa.m_vecblock.size(), nullptr);
+	std::vector<std::pair<int32_t*, uint32_t>> vecpairFixup;	// rel32 to patch, target block
+	auto JumpToBlock = [&](uint32_t iblock)
+	{
+		SafePushCode(uint8_t(0xE9));	// jmp rel32
+		vecpairFixup.push_back(std::make_pair(reinterpret_cast<int32_t*>(m_pexecPlaneCur), iblock));
+		SafePushCode(int32_t(0));
+	};
+	auto JccToBlock = [&](ConditionCode cond, uint32_t iblock)
+	{
+		const uint8_t rgcode[] = { 0x0F, uint8_t(0x80 | uint8_t(cond)) };	// jcc rel32
+		SafePushCode(rgcode);
+		vecpairFixup.push_back(std::make_pair(reinterpret_cast<int32_t*>(m_pexecPlaneCur), iblock));
+		SafePushCode(int32_t(0));
+	};
+	auto AddCodeMap = [&](uint32_t ibBytecode)
+	{
+		CodeMapEntry entryCode{ numeric_cast<uint32_t>(m_pexecPlaneCur - m_pexecPlane), ifn, ibBytecode };
+		if (!m_veccodemap.empty() && m_veccodemap.back().ibCode == entryCode.ibCode)
+			m_veccodemap.back() = entryCode;
+		else
+			m_veccodemap.push_back(entryCode);
+	};
+
+	for (uint32_t iblock = 0; iblock < ssa.m_vecblock.size(); ++iblock)
+	{
+		const SsaFunction::Block &block = ssa.m_vecblock[iblock];
+		vecpbBlock[iblock] = m_pexecPlaneCur;
+		for (uint32_t ival : block.vecival)
+		{
+			AddCodeMap(ssa.m_vecval[ival].ibBytecode);
+#ifdef PRINT_DISASSEMBLY
+			printf("%p:\tv%u = op %X\n", m_pexecPlaneCur, ival, uint32_t(ssa.m_vecval[ival].op));
+#endif
+			_SsaLowerValue(ssa, ival);
+		}
+
+		AddCodeMap(block.ibBytecodeExit);
+		const uint32_t iblockNext = iblock + 1;
+		switch (block.exit)
+		{
+		case SsaFunction::ExitKind::Jump:
+		{
+			std::vector<std::pair<SsaLoc, SsaLoc>> vecpairMove;
+			_SsaEdgeMoves(ssa, iblock, block.rgiblockSucc[0], &vecpairMove);
+			_SsaParallelMove(std::move(vecpairMove));
+			if (block.rgiblockSucc[0] != iblockNext)
+				JumpToBlock(block.rgiblockSucc[0]);
+			break;
+		}
+
+		case SsaFunction::ExitKind::Branch:
+		{
+			ConditionCode cond = ConditionCode::NotEqual;
+			if (ssa.m_vecval[block.ivalExit].fFused)
+			{
+				cond = _SsaCompare(ssa, block.ivalExit);
+			}
+			else
+			{
+				SsaLoc locCond = _SsaLocation(ssa, block.ivalExit);
+				if (locCond.kind == SsaLoc::Kind::Imm)
+				{
+					_SsaMovImm(Register::rcx, locCond.imm);
+					locCond = LocReg(Register::rcx);
+				}
+				if (locCond.kind == SsaLoc::Kind::Reg)
+				{
+					_SsaModRM(0, { 0x85 }, uint8_t(locCond.reg), locCond, true);	// test c, c
+				}
+				else
+				{
+					_SsaModRM(0, { 0x83 }, 7, locCond, true);	// cmp qword [rbx + disp], 0
+					SafePushCode(uint8_t(0));
+				}
+			}
+			const ConditionCode condNot = ConditionCode(uint8_t(cond) ^ 1);
+
+			uint32_t iblockTrue = block.rgiblockSucc[0];
+			uint32_t iblockFalse = block.rgiblockSucc[1];
+			std::vector<std::pair<SsaLoc, SsaLoc>> vecpairMoveTrue, vecpairMoveFalse;
+			_SsaEdgeMoves(ssa, iblock, iblockTrue, &vecpairMoveTrue);
+			_SsaEdgeMoves(ssa, iblock, iblockFalse, &vecpairMoveFalse);
+			if (vecpairMoveTrue.empty() && iblockTrue != iblockNext)
+			{
+				JccToBlock(cond, iblockTrue);
+				_SsaParallelMove(std::move(vecpairMoveFalse));
+				if (iblockFalse != iblockNext)
+					JumpToBlock(iblockFalse);
+			}
+			else if (vecpairMoveFalse.empty())
+			{
+				JccToBlock(condNot, iblockFalse);
+				_SsaParallelMove(std::move(vecpairMoveTrue));
+				if (iblockTrue != iblockNext)
+					JumpToBlock(iblockTrue);
+			}
+			else
+			{
+				// both edges need moves, the false edge's go after the true edge's
+				const uint8_t rgcode[] = { 0x0F, uint8_t(0x80 | uint8_t(condNot)) };	// jcc rel32
+				SafePushCode(rgcode);
+				int32_t *prelFalse = reinterpret_cast<int32_t*>(m_pexecPlaneCur);
+				SafePushCode(int32_t(0));
+				_SsaParallelMove(std::move(vecpairMoveTrue));
+				JumpToBlock(iblockTrue);
+				*PWritable(prelFalse) = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(prelFalse) + sizeof(*prelFalse)));
+				_SsaParallelMove(std::move(vecpairMoveFalse));
+				if (iblockFalse != iblockNext)
+					JumpToBlock(iblockFalse);
+			}
+			break;
+		}
+
+		case SsaFunction::ExitKind::Return:
+			if (block.ivalExit != SsaFunction::ivalNil)
+				_SsaMov(LocReg(Register::rax), _SsaLocation(ssa, block.ivalExit));
+			SafePushCode(uint8_t(0xC3));	// ret
+			break;
+
+		case SsaFunction::ExitKind::Trap:
 		{
-			SafePushCode(uint8_t(0x99));	// cdq to load edx with the sign extension
+			static const uint8_t rgcode[] = { 0x0F, 0x0B };	// ud2
+			SafePushCode(rgcode);
+			break;
+		}
 		}
-	}
-	else
-	{
-		// xor edx, edx { 0x31, 0xD2 }
-		static const uint8_t rgcodeClearEdx[] = { 0x31, 0xD2 };
-		SafePushCode(rgcodeClearEdx);
 	}
 
-	if (f64)
-		SafePushCode(uint8_t(0x48));	// rex prefix to make the following div instruction a 64-bit op
-	if (fSigned)
-	{
-		//  idiv dword ptr [rdi]
-		static const uint8_t rgcodeDiv[] = { 0xF7, 0x3F };
-		SafePushCode(rgcodeDiv);
-	}
-	else
-	{
-		// div dword ptr [rdi]
-		static const uint8_t rgcodeDiv[] = { 0xF7, 0x37 };
-		SafePushCode(rgcodeDiv);
-	}
+	for (auto &pairFixup : vecpairFixup)
+		*PWritable(pairFixup.first) = numeric_cast<int32_t>(vecpbBlock[pairFixup.second] - (reinterpret_cast<uint8_t*>(pairFixup.first) + sizeof(int32_t)));
 
-	if (fModulo)
+	// Baseline code arrives at a loop head with its pinned locals spilled, nothing on the machine stack but our return
+	//	address and rdi somewhere above its operand stack (our callers restore their own)
+	for (const SsaFunction::Loop &loop : ssa.m_vecloop)
 	{
-		if (f64)
-			SafePushCode(uint8_t(0x48));	// REX prefix to convert to 64-bit registers below
-		// take the remainder that's in edx
-		// mov eax, edx { 0x89, 0xD0 }
-		static const uint8_t rgcodeMovEaxEdx[] = { 0x89, 0xD0 };
-		SafePushCode(rgcodeMovEaxEdx);
+		if (!loop.fOsr)
+			continue;
+		m_vecvecpairOsrEntry.at(ifn).push_back(std::make_pair(loop.ibLoop, m_pexecPlaneCur));
+		AddCodeMap(loop.ibLoop);
+		for (uint32_t ival : loop.vecivalRecompute)
+			_SsaLowerValue(ssa, ival);
+		std::vector<std::pair<SsaLoc, SsaLoc>> vecpairMove;
+		for (auto &pairValueLocal : loop.vecpairValueLocal)
+			vecpairMove.push_back(std::make_pair(_SsaLocation(ssa, pairValueLocal.first), LocMem(numeric_cast<int32_t>(pairValueLocal.second * sizeof(uint64_t)))));
+		_SsaParallelMove(std::move(vecpairMove));
+		Jump(vecpbBlock[loop.iblockHeader]);
 	}
+
+	StoreShared(reinterpret_cast<void**>(m_pexecPlane) + ifn, static_cast<void*>(pbEntry));
+	_PatchCallSites(ifn);
+#ifdef PRINT_DISASSEMBLY
+	printf("\n\n");
+#endif
+	return true;
 }
 
-void JitWriter::CompileFn(uint32_t ifn)
+void JitWriter::CompileFn(uint32_t ifn, bool fOptimize)
 {
 	size_t cfnImports = 0;
-	Verify(ifn >= m_pctxt->m_vecimports.size(), "Attempt to compile an import");
-	FunctionCodeEntry *pfnc = m_pctxt->m_vecfn_code[ifn - m_pctxt->m_vecimports.size()].get();
+	Verify(ifn >= m_pmodule->m_vecimports.size(), "Attempt to compile an import");
+	if (fOptimize && FCompileFnSsa(ifn))
+		return;
+	FunctionCodeEntry *pfnc = m_pmodule->m_vecfn_code[ifn - m_pmodule->m_vecimports.size()].get();
 	const uint8_t *pop = pfnc->vecbytecode.data();
 	size_t cb = pfnc->vecbytecode.size();
 	std::vector<std::pair<value_type, void*>> stackBlockTypeAddr;
 	std::vector<std::vector<int32_t*>> stackVecFixupsRelative;
-	std::vector<std::vector<void**>> stackVecFixupsAbsolute;
 
-	reinterpret_cast<void**>(m_pexecPlane)[ifn] = m_pexecPlaneCur;	// set our entry in the vector table
+	uint8_t *pbEntry = m_pexecPlaneCur;	// goes in the vector table once we are done
 
-	size_t itype = m_pctxt->m_vecfn_entries[ifn];
-	uint32_t cparams = m_pctxt->m_vecfn_types[itype]->cparams;
+	size_t itype = m_pmodule->m_vecfn_entries[ifn];
+	uint32_t cparams = m_pmodule->m_vecfn_types[itype]->cparams;
 	uint32_t clocals = cparams;
 	for (size_t ilocalInfo = 0; ilocalInfo < pfnc->clocalVars; ++ilocalInfo)
 	{
 		clocals += pfnc->rglocals[ilocalInfo].count;
 	}
 
-	std::vector<uint32_t> vecifnCompile;
-
-	FnPrologue(clocals, cparams);
+	// While the body of an inlined callee is being compiled these describe it instead of ifn.  Its locals follow ours in
+	//	the locals array and its body is a block nested in ours, so returning is a branch to the end of that block.
+	const uint8_t *popInlineResume = nullptr;	// where our own body continues, nullptr when not inlining
+	size_t cbInlineResume = 0;
+	size_t cblockInline = 0;					// index of the inlined callee's block in stackBlockTypeAddr
+	uint32_t ibBytecodeInline = 0;				// the call being inlined, used for the code map
+	uint32_t ilocalBase = 0;
+	uint32_t clocalsCur = clocals;
+
+	// Our loops (bytecode offset, address) that baseline code for this function can be running when it tiers up
+	std::vector<std::pair<uint32_t, uint8_t*>> vecpairLoopOsr;
+
+	bool fIfConverted = false;	// inside the arms of an IF turned into a select, these never nest
+
+	m_vecregStackCache.clear();
+	m_cslotStack = 0;
+	m_veccslotBlock.clear();
+	m_fCondPending = false;
+	m_fTopInXmm = false;
+	m_fConstPending = false;
+	m_fAddrPending = false;
+	m_fOptimizing = fOptimize;
+	if (!fOptimize)
+		m_rgcTierUp[ifn] = m_cTierUpThreshold;
+	AllocateLocalRegisters(pop, cb, clocals, cparams);
+	m_vecpbRegisterEntry.at(ifn) = FnPrologue(ifn, clocals, cparams);
 
 #ifdef PRINT_DISASSEMBLY
 	const char *szFnName = nullptr;
-	for (size_t iexport = 0; iexport < m_pctxt->m_vecexports.size(); ++iexport)
+	for (size_t iexport = 0; iexport < m_pmodule->m_vecexports.size(); ++iexport)
 	{
-		if (m_pctxt->m_vecexports[iexport].kind == external_kind::Function)
+		if (m_pmodule->m_vecexports[iexport].kind == external_kind::Function)
 		{
-			if (m_pctxt->m_vecexports[iexport].index == ifn)
+			if (m_pmodule->m_vecexports[iexport].index == ifn)
 			{
-				szFnName = m_pctxt->m_vecexports[iexport].strName.c_str();
+				szFnName = m_pmodule->m_vecexports[iexport].strName.c_str();
 				break;
 			}
 		}
@@ -1498,12 +4002,32 @@ void JitWriter::CompileFn(uint32_t ifn)
 
 	stackBlockTypeAddr.push_back(std::make_pair(value_type::none, nullptr));	// nullptr means we need to fixup addrs
 	stackVecFixupsRelative.push_back(std::vector<int32_t*>());
-	stackVecFixupsAbsolute.push_back(std::vector<void**>());
 	while (cb > 0)
 	{
 		cb--;	// count *pop
 		++pop;
-		_SetDbgReg(*(pop - 1));
+		switch ((opcode)*(pop - 1))
+		{
+		case opcode::br_if:
+		case opcode::IF:
+		case opcode::select:
+		case opcode::i32_eqz:
+			break;	// these consume a pending comparison directly from the flags
+		default:
+			_MaterializeCond();
+		}
+		if (!FXmmOperandOp((opcode)*(pop - 1)))
+			_MaterializeFloat();
+		// Opcodes that emitted no code (nops, folded constants) share an address with the next one, keep only the last
+		uint32_t ibBytecode = (popInlineResume != nullptr) ? ibBytecodeInline : numeric_cast<uint32_t>((pop - 1) - pfnc->vecbytecode.data());
+		CodeMapEntry entryCode{ numeric_cast<uint32_t>(m_pexecPlaneCur - m_pexecPlane), ifn, ibBytecode };
+		if (!m_veccodemap.empty() && m_veccodemap.back().ibCode == entryCode.ibCode)
+			m_veccodemap.back() = entryCode;
+		else
+			m_veccodemap.push_back(entryCode);
+#ifdef _DEBUG
+		_SetDbgReg(*(pop - 1));	// handy in a debugger, traps and profilers use the code map instead
+#endif
 #ifdef PRINT_DISASSEMBLY
 		printf("%p (%X):\t", m_pexecPlaneCur, *(pop - 1));
 		for (size_t itab = 0; itab < stackBlockTypeAddr.size(); ++itab)
@@ -1536,7 +4060,6 @@ void JitWriter::CompileFn(uint32_t ifn)
 #endif
 			stackBlockTypeAddr.push_back(std::make_pair(type, nullptr));	// nullptr means we need to fixup addrs
 			stackVecFixupsRelative.push_back(std::vector<int32_t*>());
-			stackVecFixupsAbsolute.push_back(std::vector<void**>());
 			EnterBlock();
 			break;
 		}
@@ -1547,9 +4070,18 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("loop\n");
 #endif
-			stackBlockTypeAddr.push_back(std::make_pair(type, m_pexecPlaneCur));
+			_FlushStack();	// the back edge arrives with an empty cache so the loop label must too
+			uint8_t *pbLoop = m_pexecPlaneCur;
+			if (popInlineResume == nullptr)
+			{
+				uint32_t ibLoop = numeric_cast<uint32_t>((pop - 2) - pfnc->vecbytecode.data());
+				if (fOptimize)
+					vecpairLoopOsr.push_back(std::make_pair(ibLoop, pbLoop));
+				else
+					_TierUpCheck(ifn, ibLoop);
+			}
+			stackBlockTypeAddr.push_back(std::make_pair(type, pbLoop));
 			stackVecFixupsRelative.push_back(std::vector<int32_t*>());
-			stackVecFixupsAbsolute.push_back(std::vector<void**>());
 			EnterBlock();
 			break;
 		}
@@ -1560,9 +4092,17 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("if\n");
 #endif
+			if ((type == value_type::i32 || type == value_type::i64) && FIfConvertible(pop, cb))
+			{
+#ifdef PRINT_DISASSEMBLY
+				printf("\t(if converted)\n");
+#endif
+				_MaterializeCond();	// the arms clobber the flags, keep the condition as a value under theirs
+				fIfConverted = true;
+				break;
+			}
 			stackBlockTypeAddr.push_back(std::make_pair(type, nullptr));	// nullptr means we need to fixup addrs
 			stackVecFixupsRelative.push_back(std::vector<int32_t*>());
-			stackVecFixupsAbsolute.push_back(std::vector<void**>());
 			int32_t *pifFix = EnterIF();
 			(stackVecFixupsRelative.rbegin())->push_back(pifFix);
 			break;
@@ -1573,18 +4113,19 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("ELSE\n");
 #endif
+			if (fIfConverted)
+				break;	// the else value is computed on top of the then value
 			Verify(stackVecFixupsRelative.back().size() > 0);
-			LeaveBlock(true);
+			LeaveBlock(0, stackBlockTypeAddr.back().first != value_type::empty_block);
 			int32_t *prel32End = Jump(nullptr);	// if we got here its from the IF block above so jump to the end
 			(stackVecFixupsRelative.rbegin())->push_back(prel32End);
 			// Fixup the else pointer to go here (only the first, all others still branch to the end)
 			int32_t *poffsetFix = stackVecFixupsRelative.back().front();
 			stackVecFixupsRelative.back().erase(stackVecFixupsRelative.back().begin());	// remove it
-			*poffsetFix = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(poffsetFix) + sizeof(*poffsetFix)));
-			_PushExpandStack();
-			// push rdi
-			static const uint8_t rgcode[] = { 0x57 };
-			SafePushCode(rgcode);
+			*PWritable(poffsetFix) = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(poffsetFix) + sizeof(*poffsetFix)));
+			// The else arrives from EnterIF before it spilled rax
+			m_cslotStack = m_veccslotBlock.back() - 1;
+			_SpillStack();
 			break;
 		}
 
@@ -1594,16 +4135,10 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("br %u\n", depth);
 #endif
-			Verify(depth < stackBlockTypeAddr.size());
+			Verify(depth < stackBlockTypeAddr.size() - cblockInline);
 			auto &pairBlock = *(stackBlockTypeAddr.rbegin() + depth);
 
-			// leave intermediate blocks (lie that we have a return so we don't do useless stack operations)
-			for (uint32_t idepth = 0; idepth < depth; ++idepth)
-			{
-				LeaveBlock(true);
-			}
-			LeaveBlock(pairBlock.first != value_type::empty_block);
-
+			LeaveBlock(depth, FBranchValue(pairBlock));
 			int32_t *pdeltaFix = Jump(pairBlock.second);
 			if (pairBlock.second == nullptr)
 			{
@@ -1617,23 +4152,22 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("br_if %u\n", depth);
 #endif
-			Verify(depth < stackBlockTypeAddr.size());
+			Verify(depth < stackBlockTypeAddr.size() - cblockInline);
 			auto &pairBlock = *(stackBlockTypeAddr.rbegin() + depth);
 
 			int32_t *pdeltaNoJmp = JumpNIf(nullptr);	// skip everything if we won't jump
-			// leave intermediate blocks (lie that we have a return so we don't do useless stack operations)
-			for (uint32_t idepth = 0; idepth < depth; ++idepth)
-			{
-				LeaveBlock(true);
-			}
-			LeaveBlock(pairBlock.first != value_type::empty_block);
-
+			// leaving the blocks below discards the cache and moves rdi, but only on the jump path
+			std::vector<Register> vecregCacheNoJmp = m_vecregStackCache;
+			int32_t cslotNoJmp = m_cslotStack;
+			LeaveBlock(depth, FBranchValue(pairBlock));
 			int32_t *pdeltaFix = Jump(pairBlock.second);
 			if (pairBlock.second == nullptr)
 			{
 				(stackVecFixupsRelative.rbegin() + depth)->push_back(pdeltaFix);
 			}
-			*pdeltaNoJmp = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(pdeltaNoJmp) + sizeof(*pdeltaNoJmp)));
+			*PWritable(pdeltaNoJmp) = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(pdeltaNoJmp) + sizeof(*pdeltaNoJmp)));
+			m_vecregStackCache = vecregCacheNoJmp;
+			m_cslotStack = cslotNoJmp;
 			break;
 		}
 		case opcode::br_table:
@@ -1641,7 +4175,7 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("br_table\n");
 #endif
-			BranchTableParse(&pop, &cb, stackBlockTypeAddr, stackVecFixupsRelative, stackVecFixupsAbsolute);
+			BranchTableParse(&pop, &cb, stackBlockTypeAddr, cblockInline, stackVecFixupsRelative);
 			break;
 		}
 
@@ -1650,12 +4184,15 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("return\n");
 #endif
-			// add rsp, (cblock * 8)
-			static const uint8_t rgcode[] = { 0x48, 0x81, 0xC4 };
-			int32_t cbSub = numeric_cast<int32_t>(stackVecFixupsRelative.size() * 8);
-			SafePushCode(rgcode);
-			SafePushCode(cbSub);
-			FnEpilogue(m_pctxt->m_vecfn_types[itype]->fHasReturnValue);
+			if (popInlineResume != nullptr)
+			{
+				// branch to the end of the inlined callee's block
+				auto &pairBlock = stackBlockTypeAddr.at(cblockInline);
+				LeaveBlock(numeric_cast<uint32_t>(stackBlockTypeAddr.size() - 1 - cblockInline), pairBlock.first != value_type::empty_block);
+				stackVecFixupsRelative.at(cblockInline).push_back(Jump(nullptr));
+				break;
+			}
+			FnEpilogue(m_pmodule->m_vecfn_types[itype]->fHasReturnValue);
 			break;
 		}
 
@@ -1666,9 +4203,50 @@ void JitWriter::CompileFn(uint32_t ifn)
 			printf("call %d\n", idx);
 #endif
 			Verify(idx < m_cfn);
-			vecifnCompile.push_back(idx);
-			auto ptype = m_pctxt->m_vecfn_types.at(m_pctxt->m_vecfn_entries.at(idx)).get();
-			CallIfn(idx, clocals, ptype->cparams, ptype->fHasReturnValue, false /*fIndirect*/);
+			auto ptype = m_pmodule->m_vecfn_types.at(m_pmodule->m_vecfn_entries.at(idx)).get();
+			bool fCalls;
+			if (popInlineResume == nullptr && FInlineCandidate(idx, &fCalls))
+			{
+#ifdef PRINT_DISASSEMBLY
+				printf("\t(inlined)\n");
+#endif
+				FunctionCodeEntry *pfncInline = m_pmodule->m_vecfn_code.at(idx - m_pmodule->m_vecimports.size()).get();
+				ibBytecodeInline = numeric_cast<uint32_t>((pop - 1) - pfnc->vecbytecode.data());
+				ilocalBase = clocals;
+				clocalsCur = ptype->cparams;
+				for (size_t ilocalInfo = 0; ilocalInfo < pfncInline->clocalVars; ++ilocalInfo)
+				{
+					clocalsCur += pfncInline->rglocals[ilocalInfo].count;
+				}
+
+				// The arguments become the callee's first locals, the rest start at zero like they would in its prologue
+				for (uint32_t iarg = ptype->cparams; iarg > 0; --iarg)
+				{
+					_StoreLocalMem(ilocalBase + iarg - 1);
+					_PopContractStack();
+				}
+				for (uint32_t idxLocal = ptype->cparams; idxLocal < clocalsCur; ++idxLocal)
+				{
+					// mov qword ptr [rbx+idx], 0
+					static const uint8_t rgcodeZero[] = { 0x48, 0xC7, 0x83 };
+					SafePushCode(rgcodeZero);
+					SafePushCode(uint32_t((ilocalBase + idxLocal) * sizeof(uint64_t)));
+					SafePushCode(uint32_t(0));
+				}
+
+				cblockInline = stackBlockTypeAddr.size();
+				stackBlockTypeAddr.push_back(std::make_pair(ptype->fHasReturnValue ? ptype->return_type : value_type::empty_block, nullptr));
+				stackVecFixupsRelative.push_back(std::vector<int32_t*>());
+				EnterBlock();
+
+				// The callee's final end closes the block and switches back to our body
+				popInlineResume = pop;
+				cbInlineResume = cb;
+				pop = pfncInline->vecbytecode.data();
+				cb = pfncInline->vecbytecode.size();
+				break;
+			}
+			CallIfn(idx, ilocalBase + clocalsCur, ptype->cparams, ptype->fHasReturnValue, false /*fIndirect*/);
 			break;
 		}
 		case opcode::call_indirect:
@@ -1678,8 +4256,8 @@ void JitWriter::CompileFn(uint32_t ifn)
 #endif
 			uint32_t idx = safe_read_buffer<varuint32>(&pop, &cb);
 			safe_read_buffer<char>(&pop, &cb);	// reserved
-			auto ptype = m_pctxt->m_vecfn_types.at(idx).get();
-			CallIfn(m_pctxt->ITypeCanonicalFromIType(idx), clocals, ptype->cparams, ptype->fHasReturnValue, true /*fIndirect*/);
+			auto ptype = m_pmodule->m_vecfn_types.at(idx).get();
+			CallIfn(m_pmodule->ITypeCanonicalFromIType(idx), ilocalBase + clocalsCur, ptype->cparams, ptype->fHasReturnValue, true /*fIndirect*/);
 			break;
 		}
 
@@ -1706,6 +4284,13 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("i32.const %d\n", val);
 #endif
+			if (cb > 0 && FConstFoldable(opcode(*pop), int32_t(val), false /*f64*/))
+			{
+				// the next op takes us as an immediate
+				m_fConstPending = true;
+				m_constPending = int32_t(val);
+				break;
+			}
 			PushC32(val);
 			break;
 		}
@@ -1715,6 +4300,13 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("i64.const %llu\n", val);
 #endif
+			if (cb > 0 && FConstFoldable(opcode(*pop), int64_t(val), true /*f64*/))
+			{
+				// the next op takes us as an immediate
+				m_fConstPending = true;
+				m_constPending = int64_t(val);
+				break;
+			}
 			PushC64(val);
 			break;
 		}
@@ -1924,6 +4516,7 @@ void JitWriter::CompileFn(uint32_t ifn)
 			printf("f64.lt\n");
 #endif
 			DoubleCompare(CompareType::LessThan);
+			break;
 		case opcode::f64_gt:
 #ifdef PRINT_DISASSEMBLY
 			printf("f64.gt\n");
@@ -2061,7 +4654,10 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("get_local $%X\n", idx);
 #endif
-			Verify(idx < clocals);
+			Verify(idx < clocalsCur);
+			idx += ilocalBase;
+			if (FFoldLocalAddress(idx, ilocalBase, clocalsCur, &pop, &cb))
+				break;
 			GetLocal(idx);
 			break;
 		}
@@ -2071,8 +4667,8 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("set_local $%X\n", idx);
 #endif
-			Verify(idx < clocals);
-			SetLocal(idx, true /*fPop*/);
+			Verify(idx < clocalsCur);
+			SetLocal(ilocalBase + idx, true /*fPop*/);
 			break;
 		}
 		case opcode::tee_local:
@@ -2081,8 +4677,8 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("tee_local $%X\n", idx);
 #endif
-			Verify(idx < clocals);
-			SetLocal(idx, false /*fPop*/);
+			Verify(idx < clocalsCur);
+			SetLocal(ilocalBase + idx, false /*fPop*/);
 			break;
 		}
 		case opcode::get_global:
@@ -2402,14 +4998,58 @@ void JitWriter::CompileFn(uint32_t ifn)
 			FloatArithmetic(ArithmeticOperation::Divide, false /*fDouble*/);
 			break;
 		case opcode::f32_copysign:
-			Ud2();	// doesn't work
 #ifdef PRINT_DISASSEMBLY
 			printf("f32.copysign\n");
 #endif
-			// and eax, 8000'0000h
-			// xor [rdi - 8], eax
-			SafePushCode("\x25\x00\x00\x00\x80\x31\x47\xF8", 8);
-			_PopContractStack();
+			FloatCopySign(false /*fDouble*/);
+			break;
+		case opcode::f32_abs:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.abs\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Abs, false /*fDouble*/);
+			break;
+		case opcode::f32_ceil:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.ceil\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Ceil, false /*fDouble*/);
+			break;
+		case opcode::f32_floor:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.floor\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Floor, false /*fDouble*/);
+			break;
+		case opcode::f32_trunc:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.trunc\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Trunc, false /*fDouble*/);
+			break;
+		case opcode::f32_nearest:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.nearest\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Nearest, false /*fDouble*/);
+			break;
+		case opcode::f32_sqrt:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.sqrt\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Sqrt, false /*fDouble*/);
+			break;
+		case opcode::f32_min:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.min\n");
+#endif
+			FloatMinMax(false /*fMax*/, false /*fDouble*/);
+			break;
+		case opcode::f32_max:
+#ifdef PRINT_DISASSEMBLY
+			printf("f32.max\n");
+#endif
+			FloatMinMax(true /*fMax*/, false /*fDouble*/);
 			break;
 
 		case opcode::f64_neg:
@@ -2446,12 +5086,55 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("f64.copysign\n");
 #endif
-			Ud2();	// doesn't work
-			// mov rcx, 0x8000000000000000
-			// and rax, rcx
-			// xor[rdi - 8], rax
-			SafePushCode("\x48\xB9\x00\x00\x00\x00\x00\x00\x00\x80\x48\x21\xC8\x48\x31\x47\xF8", 17);
-			_PopContractStack();
+			FloatCopySign(true /*fDouble*/);
+			break;
+		case opcode::f64_abs:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.abs\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Abs, true /*fDouble*/);
+			break;
+		case opcode::f64_ceil:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.ceil\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Ceil, true /*fDouble*/);
+			break;
+		case opcode::f64_floor:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.floor\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Floor, true /*fDouble*/);
+			break;
+		case opcode::f64_trunc:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.trunc\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Trunc, true /*fDouble*/);
+			break;
+		case opcode::f64_nearest:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.nearest\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Nearest, true /*fDouble*/);
+			break;
+		case opcode::f64_sqrt:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.sqrt\n");
+#endif
+			FloatUnary(FloatUnaryOperation::Sqrt, true /*fDouble*/);
+			break;
+		case opcode::f64_min:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.min\n");
+#endif
+			FloatMinMax(false /*fMax*/, true /*fDouble*/);
+			break;
+		case opcode::f64_max:
+#ifdef PRINT_DISASSEMBLY
+			printf("f64.max\n");
+#endif
+			FloatMinMax(true /*fMax*/, true /*fDouble*/);
 			break;
 
 		case opcode::i32_wrap_i64:
@@ -2590,28 +5273,42 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("end\n");
 #endif
+			if (fIfConverted)
+			{
+				IfConvertedSelect();
+				fIfConverted = false;
+				break;
+			}
 			if (stackBlockTypeAddr.size() > 1)
 			{
-				LeaveBlock(stackBlockTypeAddr.back().first != value_type::empty_block);	// don't "leave" the function
+				LeaveBlock(0, stackBlockTypeAddr.back().first != value_type::empty_block);	// don't "leave" the function
+				m_veccslotBlock.pop_back();
 			}
 			else
 			{
 				Verify(stackBlockTypeAddr.back().first == value_type::none);
-				LeaveBlock(true);
+				LeaveBlock(0, true);
 			}
 			// Jump targets are after the LeaveBlock because the branch already performs the work (TODO: Maybe not do that?)
 			for (int32_t *poffsetFix : stackVecFixupsRelative.back())
 			{
-				*poffsetFix = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(poffsetFix) + sizeof(*poffsetFix)));
-			}
-			for (void **pp : stackVecFixupsAbsolute.back())
-			{
-				*pp = m_pexecPlaneCur;
+				*PWritable(poffsetFix) = numeric_cast<int32_t>(m_pexecPlaneCur - (reinterpret_cast<uint8_t*>(poffsetFix) + sizeof(*poffsetFix)));
 			}
 
 			stackBlockTypeAddr.pop_back();
 			stackVecFixupsRelative.pop_back();
-			stackVecFixupsAbsolute.pop_back();
+
+			if (popInlineResume != nullptr && stackBlockTypeAddr.size() == cblockInline)
+			{
+				// end of the inlined callee's body, carry on after the call
+				Verify(cb == 0);
+				pop = popInlineResume;
+				cb = cbInlineResume;
+				popInlineResume = nullptr;
+				cblockInline = 0;
+				ilocalBase = 0;
+				clocalsCur = clocals;
+			}
 			break;
 
 		case opcode::current_memory:
@@ -2621,6 +5318,7 @@ void JitWriter::CompileFn(uint32_t ifn)
 			printf("current_memory\n");
 #endif
 			PushC32(0);						// re-use grow_memory, just give a delta of 0
+			_FlushStack();					// GrowMemoryOp calls into C which clobbers the cache registers
 			CallAsmOp(m_pfnGrowMemoryOp);
 			break;
 		}
@@ -2630,6 +5328,7 @@ void JitWriter::CompileFn(uint32_t ifn)
 #ifdef PRINT_DISASSEMBLY
 			printf("grow_memory\n");
 #endif
+			_FlushStack();
 			CallAsmOp(m_pfnGrowMemoryOp);
 			break;
 		}
@@ -2639,93 +5338,435 @@ void JitWriter::CompileFn(uint32_t ifn)
 
 		}
 	}
-	FnEpilogue(m_pctxt->m_vecfn_types[itype]->fHasReturnValue);
+	FnEpilogue(m_pmodule->m_vecfn_types[itype]->fHasReturnValue);
 
-	for (uint32_t ifnCompile : vecifnCompile)
+	// Baseline code for this function arrives here from the head of one of its loops with its pinned locals spilled
+	for (auto &pairLoop : vecpairLoopOsr)
 	{
-		void *&pfn = reinterpret_cast<void**>(m_pexecPlane)[ifnCompile];
-		if (pfn == nullptr)
-		{
-			CompileFn(ifnCompile);
-		}
+		m_vecvecpairOsrEntry.at(ifn).push_back(std::make_pair(pairLoop.first, m_pexecPlaneCur));
+		_ReloadPinnedLocals();
+		Jump(pairLoop.second);
 	}
+
+	StoreShared(reinterpret_cast<void**>(m_pexecPlane) + ifn, static_cast<void*>(pbEntry));
+	if (!m_fWorker)
+		_PatchCallSites(ifn);	// CompileAll patches calls between its threads' code once they are all done
 #ifdef PRINT_DISASSEMBLY
 	printf("\n\n");
 #endif
 }
 
+// Compiles ifn, if that fails whatever it emitted is thrown away and ifn keeps the entry points it had before
+void JitWriter::_CompileFnOrDiscard(uint32_t ifn, bool fOptimize)
+{
+	uint8_t *pbStart = m_pexecPlaneCur;
+	size_t centryCodeMap = m_veccodemap.size();
+	// nullptr before the first compile, the baseline code when tiering up (the vector table is only set on success)
+	uint8_t *pbRegisterEntryPrev = m_vecpbRegisterEntry[ifn];
+	size_t cosrPrev = m_vecvecpairOsrEntry[ifn].size();
+	try
+	{
+		CompileFn(ifn, fOptimize);
+	}
+	catch (...)
+	{
+		m_vecpbRegisterEntry[ifn] = pbRegisterEntryPrev;
+		m_vecvecpairOsrEntry[ifn].resize(cosrPrev);
+		m_pexecPlaneCur = pbStart;
+		m_veccodemap.resize(centryCodeMap);
+		for (auto &vecpbCall : m_vecvecpbCallFixups)
+			vecpbCall.erase(std::remove_if(vecpbCall.begin(), vecpbCall.end(), [&](uint8_t *pbCall) { return pbCall >= pbStart; }), vecpbCall.end());
+		throw;
+	}
+}
+
+// Compiles every function up front on cthread threads.  Each thread takes the next function not yet taken and emits
+//	it into its own slice of the exec plane (together they get half of what is left, the rest is for optimized code and
+//	later lazy compiles).  Once all are done their entry points and code maps are merged into ours and the calls between
+//	their code are patched to direct calls.  A function that fails to compile or doesn't fit in its thread's slice is
+//	left to be compiled on its first call as usual.
+void JitWriter::CompileAll(uint32_t cthread)
+{
+	const uint32_t ifnFirst = numeric_cast<uint32_t>(m_pmodule->m_vecimports.size());
+	if (cthread == 0 || ifnFirst >= m_cfn)
+		return;
+	const size_t cbSlice = (size_t(m_pexecPlaneMax - m_pexecPlaneCur) / (2 * size_t(cthread))) & ~size_t(4095);
+	std::vector<std::unique_ptr<JitWriter>> vecspjitw;
+	for (uint32_t ithread = 0; ithread < cthread; ++ithread)
+	{
+		uint8_t *pbSlice = m_pexecPlaneCur + ithread * cbSlice;
+		vecspjitw.push_back(std::unique_ptr<JitWriter>(new JitWriter(*this, pbSlice, pbSlice + cbSlice)));
+	}
+
+	std::atomic<uint32_t> ifnNext(ifnFirst);
+	auto CompileWorker = [&](JitWriter *pjitw)
+	{
+		for (uint32_t ifn = ifnNext++; ifn < m_cfn; ifn = ifnNext++)
+		{
+			if (reinterpret_cast<void**>(m_pexecPlane)[ifn] != nullptr)
+				continue;	// loaded from the code cache
+			try
+			{
+				pjitw->_CompileFnOrDiscard(ifn);
+			}
+			catch (...)
+			{
+				// left to be compiled on its first call, which fails the same way
+			}
+		}
+	};
+	std::vector<std::thread> vecthread;
+	for (auto &spjitw : vecspjitw)
+		vecthread.emplace_back(CompileWorker, spjitw.get());
+	for (std::thread &thread : vecthread)
+		thread.join();
+
+	// The slices are in address order after anything we compiled so appending their code maps keeps ours sorted
+	for (auto &spjitw : vecspjitw)
+	{
+		for (uint32_t ifn = ifnFirst; ifn < m_cfn; ++ifn)
+		{
+			if (spjitw->m_vecpbRegisterEntry[ifn] != nullptr)
+				m_vecpbRegisterEntry[ifn] = spjitw->m_vecpbRegisterEntry[ifn];
+			const auto &vecpbCall = spjitw->m_vecvecpbCallFixups[ifn];
+			m_vecvecpbCallFixups[ifn].insert(m_vecvecpbCallFixups[ifn].end(), vecpbCall.begin(), vecpbCall.end());
+		}
+		m_veccodemap.insert(m_veccodemap.end(), spjitw->m_veccodemap.begin(), spjitw->m_veccodemap.end());
+		if (spjitw->m_pexecPlaneCur != spjitw->m_pexecPlaneMax - cbSlice)
+			m_pexecPlaneCur = spjitw->m_pexecPlaneCur;
+	}
+	for (uint32_t ifn = ifnFirst; ifn < m_cfn; ++ifn)
+	{
+		if (m_vecpbRegisterEntry[ifn] != nullptr)
+			_PatchCallSites(ifn);
+	}
+}
+
+// The code cache file is a CodeCacheHeader, then for each function after the imports its entry points, tier up state,
+//	call fixups and OSR entries, then the non zero pages of the code and finally the code map.  Everything in the exec
+//	plane is addressed relative to m_pexecPlane and the code only reaches the tables and helpers rip relative (and the
+//	globals through rbp), so it works wherever the plane is mapped.  The helper slots and import entries are filled in
+//	by our constructor.
+struct CodeCacheHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint64_t hashKey;
+	uint64_t cfn;
+	uint64_t ibCodeStart;
+	uint64_t ibCodeEnd;
+};
+static const uint32_t magicCodeCache = 0x6363776A;	// "jwcc"
+
+uint64_t JitWriter::HashBytes(uint64_t hash, const void *pv, size_t cb)
+{
+	// FNV-1a
+	const uint8_t *pb = reinterpret_cast<const uint8_t*>(pv);
+	for (size_t ib = 0; ib < cb; ++ib)
+	{
+		hash ^= pb[ib];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+// The cache key of a module with hash hashModule, code from another version of the JIT or for other CPU features
+//	never matches
+uint64_t JitWriter::HashCodeCacheKey(uint64_t hashModule) const
+{
+	uint32_t rgkey[] = { versionCodeCache, uint32_t(m_fSSE41), 0 };
+#ifdef _DEBUG
+	rgkey[2] = 1;	// debug builds emit extra code for each opcode
+#endif
+	return HashBytes(hashModule, rgkey, sizeof(rgkey));
+}
+
+// Replaces what we have compiled so far with the code saved in pf, returns false (changing nothing) unless it is a
+//	valid cache for hashKey
+bool JitWriter::FLoadCodeCache(FILE *pf, uint64_t hashKey)
+{
+	std::vector<uint8_t> vecb;
+	uint8_t rgbRead[64 * 1024];
+	size_t cbRead;
+	while ((cbRead = fread(rgbRead, 1, sizeof(rgbRead), pf)) > 0)
+		vecb.insert(vecb.end(), rgbRead, rgbRead + cbRead);
+
+	const uint32_t ifnFirst = numeric_cast<uint32_t>(m_pmodule->m_vecimports.size());
+	const uint8_t *pb = vecb.data();
+	size_t cb = vecb.size();
+	std::vector<uint32_t> vecibEntry, vecibRegisterEntry, veccTierUp;
+	std::vector<TierUpState> vecstateTierUp;
+	std::vector<std::vector<uint32_t>> vecvecibCallFixup;
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> vecvecpairOsrEntry;
+	std::vector<std::pair<uint32_t, std::vector<uint8_t>>> vecpairRun;
+	std::vector<CodeMapEntry> veccodemap;
+	try
+	{
+		CodeCacheHeader header = safe_read_buffer<CodeCacheHeader>(&pb, &cb);
+		if (header.magic != magicCodeCache || header.version != versionCodeCache || header.hashKey != hashKey || header.cfn != m_cfn
+			|| header.ibCodeStart != uint64_t(m_pcodeStart - m_pexecPlane) || header.ibCodeEnd < uint64_t(m_pexecPlaneCur - m_pexecPlane)
+			|| header.ibCodeEnd > uint64_t(m_pexecPlaneMax - m_pexecPlane))
+		{
+			return false;
+		}
+		auto FInCode = [&](uint32_t ib) { return ib >= header.ibCodeStart && ib < header.ibCodeEnd; };
+		auto FEntryValid = [&](uint32_t ib) { return ib == 0 || FInCode(ib); };	// 0 when not compiled
+		auto CRead = [&](size_t cbElem) -> uint32_t
+		{
+			// a count of cbElem sized items that follow
+			uint32_t c = safe_read_buffer<uint32_t>(&pb, &cb);
+			if (uint64_t(c) * cbElem > cb)
+				throw 0;
+			return c;
+		};
+
+		for (uint32_t ifn = ifnFirst; ifn < m_cfn; ++ifn)
+		{
+			vecibEntry.push_back(safe_read_buffer<uint32_t>(&pb, &cb));
+			vecibRegisterEntry.push_back(safe_read_buffer<uint32_t>(&pb, &cb));
+			veccTierUp.push_back(safe_read_buffer<uint32_t>(&pb, &cb));
+			vecstateTierUp.push_back(TierUpState(safe_read_buffer<uint8_t>(&pb, &cb)));
+			if (!FEntryValid(vecibEntry.back()) || !FEntryValid(vecibRegisterEntry.back()) || vecstateTierUp.back() > TierUpState::Failed)
+				return false;
+
+			vecvecibCallFixup.emplace_back(CRead(sizeof(uint32_t)));
+			safe_copy_buffer(vecvecibCallFixup.back().data(), vecvecibCallFixup.back().size(), &pb, &cb);
+			for (uint32_t ibCall : vecvecibCallFixup.back())
+			{
+				if (!FInCode(ibCall))
+					return false;
+			}
+
+			vecvecpairOsrEntry.emplace_back(CRead(2 * sizeof(uint32_t)));
+			for (auto &pairOsr : vecvecpairOsrEntry.back())
+			{
+				pairOsr.first = safe_read_buffer<uint32_t>(&pb, &cb);
+				pairOsr.second = safe_read_buffer<uint32_t>(&pb, &cb);
+				if (!FInCode(pairOsr.second))
+					return false;
+			}
+		}
+
+		uint32_t crun = safe_read_buffer<uint32_t>(&pb, &cb);
+		for (uint32_t irun = 0; irun < crun; ++irun)
+		{
+			uint32_t ibRun = safe_read_buffer<uint32_t>(&pb, &cb);
+			uint32_t cbRun = CRead(1);
+			if (ibRun < header.ibCodeStart || uint64_t(ibRun) + cbRun > header.ibCodeEnd)
+				return false;
+			vecpairRun.emplace_back(ibRun, std::vector<uint8_t>(cbRun));
+			safe_copy_buffer(vecpairRun.back().second.data(), cbRun, &pb, &cb);
+		}
+
+		veccodemap.resize(CRead(sizeof(CodeMapEntry)));
+		safe_copy_buffer(veccodemap.data(), veccodemap.size(), &pb, &cb);
+		for (const CodeMapEntry &entry : veccodemap)
+		{
+			if (!FInCode(entry.ibCode) || entry.ifn >= m_cfn)
+				return false;
+		}
+		if (cb != 0)
+			return false;
+		m_pexecPlaneCur = m_pexecPlane + header.ibCodeEnd;
+	}
+	catch (int)
+	{
+		return false;	// truncated
+	}
+
+	for (const auto &pairRun : vecpairRun)
+		memcpy(PWritable(m_pexecPlane + pairRun.first), pairRun.second.data(), pairRun.second.size());
+	auto PbFromIb = [&](uint32_t ib) { return (ib != 0) ? (m_pexecPlane + ib) : nullptr; };
+	for (uint32_t ifn = ifnFirst; ifn < m_cfn; ++ifn)
+	{
+		uint32_t ifnCache = ifn - ifnFirst;
+		reinterpret_cast<void**>(m_pexecPlane)[ifn] = PbFromIb(vecibEntry[ifnCache]);
+		m_vecpbRegisterEntry[ifn] = PbFromIb(vecibRegisterEntry[ifnCache]);
+		m_rgcTierUp[ifn] = int32_t(veccTierUp[ifnCache]);
+		m_vecstateTierUp[ifn] = vecstateTierUp[ifnCache];
+		m_vecvecpbCallFixups[ifn].clear();
+		for (uint32_t ibCall : vecvecibCallFixup[ifnCache])
+			m_vecvecpbCallFixups[ifn].push_back(m_pexecPlane + ibCall);
+		m_vecvecpairOsrEntry[ifn].clear();
+		for (const auto &pairOsr : vecvecpairOsrEntry[ifnCache])
+			m_vecvecpairOsrEntry[ifn].push_back(std::make_pair(pairOsr.first, m_pexecPlane + pairOsr.second));
+	}
+	m_veccodemap = std::move(veccodemap);
+	m_pbCodeCacheEnd = m_pexecPlaneCur;
+	return true;
+}
+
+// Writes everything compiled so far to pf in the format FLoadCodeCache reads, the zero pages between CompileAll's
+//	slices are left out
+void JitWriter::SaveCodeCache(FILE *pf, uint64_t hashKey)
+{
+	std::lock_guard<std::mutex> lock(m_mutexCompile);
+	std::vector<uint8_t> vecb;
+	auto Append = [&](const void *pv, size_t cb)
+	{
+		const uint8_t *pb = reinterpret_cast<const uint8_t*>(pv);
+		vecb.insert(vecb.end(), pb, pb + cb);
+	};
+	auto AppendIb = [&](const uint8_t *pb)
+	{
+		uint32_t ib = (pb != nullptr) ? numeric_cast<uint32_t>(pb - m_pexecPlane) : 0;
+		Append(&ib, sizeof(ib));
+	};
+
+	CodeCacheHeader header = { magicCodeCache, versionCodeCache, hashKey, m_cfn, uint64_t(m_pcodeStart - m_pexecPlane), uint64_t(m_pexecPlaneCur - m_pexecPlane) };
+	Append(&header, sizeof(header));
+	for (uint32_t ifn = numeric_cast<uint32_t>(m_pmodule->m_vecimports.size()); ifn < m_cfn; ++ifn)
+	{
+		AppendIb(reinterpret_cast<uint8_t**>(m_pexecPlane)[ifn]);
+		AppendIb(m_vecpbRegisterEntry[ifn]);
+		int32_t cTierUp = m_rgcTierUp[ifn];
+		Append(&cTierUp, sizeof(cTierUp));
+		uint8_t stateTierUp = uint8_t(m_vecstateTierUp[ifn]);
+		Append(&stateTierUp, sizeof(stateTierUp));
+
+		uint32_t ccall = numeric_cast<uint32_t>(m_vecvecpbCallFixups[ifn].size());
+		Append(&ccall, sizeof(ccall));
+		for (uint8_t *pbCall : m_vecvecpbCallFixups[ifn])
+			AppendIb(pbCall);
+
+		uint32_t cosr = numeric_cast<uint32_t>(m_vecvecpairOsrEntry[ifn].size());
+		Append(&cosr, sizeof(cosr));
+		for (const auto &pairOsr : m_vecvecpairOsrEntry[ifn])
+		{
+			Append(&pairOsr.first, sizeof(pairOsr.first));
+			AppendIb(pairOsr.second);
+		}
+	}
+
+	// Runs of pages with anything on them
+	const size_t cbPage = 4096;
+	std::vector<std::pair<uint8_t*, uint8_t*>> vecpairRun;
+	for (uint8_t *pbPage = m_pcodeStart; pbPage < m_pexecPlaneCur; pbPage += cbPage)
+	{
+		uint8_t *pbPageEnd = std::min(pbPage + cbPage, m_pexecPlaneCur);
+		if (std::all_of(pbPage, pbPageEnd, [](uint8_t b) { return b == 0; }))
+			continue;
+		if (!vecpairRun.empty() && vecpairRun.back().second == pbPage)
+			vecpairRun.back().second = pbPageEnd;
+		else
+			vecpairRun.push_back(std::make_pair(pbPage, pbPageEnd));
+	}
+	uint32_t crun = numeric_cast<uint32_t>(vecpairRun.size());
+	Append(&crun, sizeof(crun));
+	for (const auto &pairRun : vecpairRun)
+	{
+		AppendIb(pairRun.first);
+		uint32_t cbRun = numeric_cast<uint32_t>(pairRun.second - pairRun.first);
+		Append(&cbRun, sizeof(cbRun));
+		Append(pairRun.first, cbRun);
+	}
+
+	uint32_t centry = numeric_cast<uint32_t>(m_veccodemap.size());
+	Append(&centry, sizeof(centry));
+	Append(m_veccodemap.data(), m_veccodemap.size() * sizeof(CodeMapEntry));
+
+	Verify(fwrite(vecb.data(), 1, vecb.size(), pf) == vecb.size(), "Failed to write the code cache");
+	m_pbCodeCacheEnd = m_pexecPlaneCur;
+}
+
 extern "C" uint64_t ExternCallFnASM(ExecutionControlBlock *pctl);
 
 
+// Unless the exec plane is dual mapped, code is only writable while we compile and only executable while it runs
 void JitWriter::ProtectForRuntime()
 {
+	if (m_dbWrite != 0)
+		return;
 	layer::ProtectRange(*m_spapbExecPlane, m_pcodeStart, m_pexecPlaneCur - m_pcodeStart, layer::PAGE_PROTECTION::ReadExecute);
 }
 
 void JitWriter::UnprotectRuntime()
 {
+	if (m_dbWrite != 0)
+		return;
 	layer::ProtectRange(*m_spapbExecPlane, m_pcodeStart, m_pexecPlaneCur - m_pcodeStart, layer::PAGE_PROTECTION::ReadWrite);
 }
 
-ExpressionService::Variant JitWriter::ExternCallFn(uint32_t ifn, void *pvAddr, ExpressionService::Variant *rgargs, uint32_t cargs)
+ExpressionService::Variant JitWriter::ExternCallFn(WasmContext *pctxtInstance, uint32_t ifn, ExpressionService::Variant *rgargs, uint32_t cargs)
 {
 	uint64_t retV;
-	size_t itype = m_pctxt->m_vecfn_entries.at(ifn);
-	auto ptype = m_pctxt->m_vecfn_types[itype].get();
-	void *&pfn = reinterpret_cast<void**>(m_pexecPlane)[ifn];
+	size_t itype = m_pmodule->m_vecfn_entries.at(ifn);
+	auto ptype = m_pmodule->m_vecfn_types[itype].get();
+	std::unique_lock<std::mutex> lockRun(m_mutexRun, std::defer_lock);
+	if (m_dbWrite == 0)
+		lockRun.lock();
+	void *pfn = LoadShared(reinterpret_cast<void**>(m_pexecPlane) + ifn);
 	if (pfn == nullptr)
 	{
-		CompileFn(ifn);
+		std::lock_guard<std::mutex> lock(m_mutexCompile);
+		if (LoadShared(reinterpret_cast<void**>(m_pexecPlane) + ifn) == nullptr)
+			_CompileFnOrDiscard(ifn);
+		pfn = LoadShared(reinterpret_cast<void**>(m_pexecPlane) + ifn);
 	}
 	
-	m_vecoperand.resize(4096 * 100);
-	m_veclocals.resize(4096 * 100);
+	pctxtInstance->m_vecoperand.resize(4096 * 100);
+	pctxtInstance->m_veclocals.resize(4096 * 100);
 	Verify(pfn != nullptr);
-	if (m_pheap == nullptr)
+	if (pctxtInstance->m_pheap == nullptr)
 	{
-		// Reserve 8GB of memory for our heap plane, this is 2^33 because effective addresses can compute to 33 bits (even though we actually truncate to 32 we reserve the max to prevent security flaws if we truncate incorrectly)
+		// Reserve 8GB of memory for our heap plane, this is 2^33 because effective addresses can compute to 33 bits (address + offset are formed directly in the x86 address mode)
+		//	Only the current memory size is accessible, the rest of the reservation is a guard region so out of bounds accesses fault and become traps
 		const size_t cbAlloc = 0x200000000;
-		m_spapbHeap = layer::ReservePages(nullptr, cbAlloc);
-		layer::ProtectRange(*m_spapbHeap, m_spapbHeap->PvBaseAddr(), cbAlloc, layer::PAGE_PROTECTION::ReadWrite);
-		m_pheap = m_spapbHeap->PvBaseAddr();
-		memcpy(m_pheap, m_pctxt->m_vecmem.data(), m_pctxt->m_vecmem.size());
+		size_t cbHeapInitial = (m_pmodule->m_vecmem_types.size() > 0) ? size_t(m_pmodule->m_vecmem_types[0].initial_size) * WASM_PAGE_SIZE : 0;
+		Verify(m_pmodule->m_vecmem.size() <= cbHeapInitial, "Data segment does not fit in memory");
+		pctxtInstance->m_spapbHeap = layer::ReservePages(nullptr, cbAlloc);
+		pctxtInstance->m_pheap = pctxtInstance->m_spapbHeap->PvBaseAddr();
+		if (cbHeapInitial > 0)
+			layer::ProtectRange(*pctxtInstance->m_spapbHeap, pctxtInstance->m_pheap, cbHeapInitial, layer::PAGE_PROTECTION::ReadWrite);
+		memcpy(pctxtInstance->m_pheap, m_pmodule->m_vecmem.data(), m_pmodule->m_vecmem.size());
+		layer::RegisterTrapRange(pctxtInstance->m_pheap, cbAlloc, m_pexecPlane, m_spapbExecPlane->Cb(), TrapFault);
+		pctxtInstance->m_cbHeap = cbHeapInitial;
 	}
 
 	// Process Arguments
 	for (uint32_t iarg = 0; iarg < cargs; ++iarg)
 	{
-		m_veclocals[iarg] = rgargs[iarg].val;
+		pctxtInstance->m_veclocals[iarg] = rgargs[iarg].val;
 	}
 
-	ExecutionControlBlock ectl;
+	ExecutionControlBlock &ectl = *reinterpret_cast<ExecutionControlBlock*>(pctxtInstance->m_vecectlGlobals.data());
 	ectl.pjitWriter = this;
 	ectl.pfnEntry = pfn;
-	ectl.operandStack = m_vecoperand.data();
-	ectl.localsStack = m_veclocals.data();
-	if (m_pctxt->m_vecmem_types.size() > 0)
-	{
-		ectl.cbHeap = m_pctxt->m_vecmem_types[0].initial_size * (64 * 1024);
-	}
-	else
-	{
-		ectl.cbHeap = 0;
-	}
-	ectl.memoryBase = m_pheap;
-	ectl.cFnIndirect = m_pctxt->m_vecIndirectFnTable.size();
-	ectl.rgfnIndirect = m_pctxt->m_vecIndirectFnTable.data();
-	ectl.rgFnTypeIndicies = m_pctxt->m_vecfn_entries.data();
-	ectl.cFnTypeIndicies = m_pctxt->m_vecfn_entries.size();
+	ectl.operandStack = pctxtInstance->m_vecoperand.data();
+	ectl.localsStack = pctxtInstance->m_veclocals.data();
+	ectl.cbHeap = pctxtInstance->m_cbHeap;
+	ectl.memoryBase = pctxtInstance->m_pheap;
+	ectl.cFnIndirect = m_pmodule->m_vecIndirectFnTable.size();
+	ectl.rgfnIndirect = m_pmodule->m_vecIndirectFnTable.data();
+	ectl.rgFnTypeIndicies = m_pmodule->m_vecfn_entries.data();
+	ectl.cFnTypeIndicies = m_pmodule->m_vecfn_entries.size();
 	ectl.rgFnPtrs = (void*)m_pexecPlane;
 	ectl.cFnPtrs = m_cfn;
+	ectl.pctxtInstance = pctxtInstance;
 	
 	ProtectForRuntime();
 	retV = ExternCallFnASM(&ectl);
 	UnprotectRuntime();
-	Verify(retV);
-	Verify(ectl.operandStack >= m_vecoperand.data());
-	Verify(ectl.localsStack >= m_veclocals.data());
-	if (ectl.cbHeap > 0)
-		m_pctxt->m_vecmem_types[0].initial_size = numeric_cast<uint32_t>(ectl.cbHeap / (64 * 1024));
+	pctxtInstance->m_cbHeap = ectl.cbHeap;	// memory growth sticks even if we trapped
+	if (pctxtInstance->m_exptrCompile != nullptr)
+	{
+		// A function called for the first time failed to compile, that stopped execution like a trap
+		std::exception_ptr exptr = pctxtInstance->m_exptrCompile;
+		pctxtInstance->m_exptrCompile = nullptr;
+		std::rethrow_exception(exptr);
+	}
+	if (!retV)
+	{
+		char szTrap[128];
+		uint32_t ifnTrap, ibTrap;
+		if (FLookupCode(reinterpret_cast<void*>(ectl.trapaddr), &ifnTrap, &ibTrap))
+			snprintf(szTrap, sizeof(szTrap), "Trap in function %u at bytecode offset 0x%X", ifnTrap, ibTrap);
+		else
+			snprintf(szTrap, sizeof(szTrap), "Trap");
+		throw RuntimeException(szTrap);
+	}
+	Verify(ectl.operandStack >= pctxtInstance->m_vecoperand.data());
+	Verify(ectl.localsStack >= pctxtInstance->m_veclocals.data());
 
 	ExpressionService::Variant varRet;
 	
@@ -2735,25 +5776,125 @@ ExpressionService::Variant JitWriter::ExternCallFn(uint32_t ifn, void *pvAddr, E
 	return varRet;
 }
 
-extern "C" void CompileFn(ExecutionControlBlock *pectl, uint32_t ifn)
+bool JitWriter::FLookupCode(const void *pv, uint32_t *pifn, uint32_t *pibBytecode) const
+{
+	std::lock_guard<std::mutex> lock(m_mutexCompile);
+	const uint8_t *pb = reinterpret_cast<const uint8_t*>(pv);
+	if (pb < m_pcodeStart || pb >= m_pexecPlaneCur)
+		return false;
+
+	// Find the last opcode that starts at or before pv
+	uint32_t ibCode = static_cast<uint32_t>(pb - m_pexecPlane);
+	auto itrEntry = std::upper_bound(m_veccodemap.begin(), m_veccodemap.end(), ibCode, [](uint32_t ib, const CodeMapEntry &entry) { return ib < entry.ibCode; });
+	if (itrEntry == m_veccodemap.begin())
+		return false;
+	--itrEntry;
+	*pifn = itrEntry->ifn;
+	*pibBytecode = itrEntry->ibBytecode;
+	return true;
+}
+
+// Called the first time ifn is called, returns false if it failed to compile (the caller then traps)
+extern "C" bool CompileFn(ExecutionControlBlock *pectl, uint32_t ifn)
+{
+	JitWriter *pjitw = pectl->pjitWriter;
+	std::lock_guard<std::mutex> lock(pjitw->m_mutexCompile);
+	if (LoadShared(reinterpret_cast<void**>(pjitw->m_pexecPlane) + ifn) != nullptr)
+		return true;	// another thread compiled it while we waited, which patched our call too
+	bool fCompiled = true;
+	pjitw->UnprotectRuntime();
+	try
+	{
+		pjitw->_CompileFnOrDiscard(ifn);
+	}
+	catch (...)
+	{
+		pectl->pctxtInstance->m_exptrCompile = std::current_exception();	// can't unwind through jitted code, ExternCallFn rethrows it
+		fCompiled = false;
+	}
+	pjitw->ProtectForRuntime();
+	return fCompiled;
+}
+
+// Called by baseline code once ifn's tier up counter runs out, the check's call returns to pbReturn.  Returns where to
+//	continue: the optimized function's entry, the optimized code for the loop at ibLoop, or nullptr to stay in the
+//	baseline code.
+uint8_t *JitWriter::TierUp(uint32_t ifn, uint32_t ibLoop, uint8_t *pbReturn)
 {
-	pectl->pjitWriter->UnprotectRuntime();
-	pectl->pjitWriter->CompileFn(ifn);
-	pectl->pjitWriter->ProtectForRuntime();
+	if (m_vecstateTierUp.at(ifn) == TierUpState::Baseline)
+	{
+		// Failed until the optimized code is in place, so a compile that throws is never tried again
+		m_vecstateTierUp.at(ifn) = TierUpState::Failed;
+		uint8_t *pbBaseline = m_vecpbRegisterEntry.at(ifn);
+		_CompileFnOrDiscard(ifn, true /*fOptimize*/);
+
+		// Direct calls to the baseline code land on its register entry, forward them to the optimized one
+		//	jmp rel32		; replaces the nop FnPrologue put there, the rest of the 8 bytes stay as they are
+		int32_t rel = numeric_cast<int32_t>(m_vecpbRegisterEntry.at(ifn) - (pbBaseline + 5));
+		uint8_t rgcode[sizeof(uint64_t)];
+		memcpy(rgcode, pbBaseline, sizeof(rgcode));
+		Verify(rgcode[0] == 0x0F && rgcode[1] == 0x1F);
+		rgcode[0] = 0xE9;
+		memcpy(rgcode + 1, &rel, sizeof(rel));
+		uint64_t code;
+		memcpy(&code, rgcode, sizeof(code));
+		StoreShared(reinterpret_cast<uint64_t*>(PWritable(pbBaseline)), code);
+		m_vecstateTierUp.at(ifn) = TierUpState::Optimized;
+		m_rgcTierUp[ifn] = 0;	// other baseline activations move over at their next loop head
+	}
+
+	if (m_vecstateTierUp.at(ifn) == TierUpState::Optimized)
+	{
+		if (ibLoop == ibTierUpEntry)
+			return reinterpret_cast<uint8_t**>(m_pexecPlane)[ifn];
+		for (auto &pairLoop : m_vecvecpairOsrEntry.at(ifn))
+		{
+			if (pairLoop.first == ibLoop)
+				return pairLoop.second;
+		}
+	}
+	// Nothing to move over to from this check (a loop the optimized code has no entry for, or the function failed to
+	//	compile), leaving it would call us again on every pass once the shared counter has run out
+	_DisableTierUpCheck(pbReturn);
+	return nullptr;
+}
+
+extern "C" uint8_t *TierUp(ExecutionControlBlock *pectl, uint32_t ifn, uint32_t ibLoop, uint8_t *pbReturn)
+{
+	JitWriter *pjitw = pectl->pjitWriter;
+	std::lock_guard<std::mutex> lock(pjitw->m_mutexCompile);
+	uint8_t *pbContinue = nullptr;
+	pjitw->UnprotectRuntime();
+	try
+	{
+		pbContinue = pjitw->TierUp(ifn, ibLoop, pbReturn);
+	}
+	catch (...)
+	{
+		// can't unwind through jitted code.  TierUp left the function marked failed so it carries on in its baseline code,
+		//	the next check to run out drops itself.
+	}
+	pjitw->ProtectForRuntime();
+	return pbContinue;
 }
 
 uint32_t JitWriter::GrowMemory(ExecutionControlBlock *pectl, uint32_t cpages)
 {
 	size_t cb = size_t(cpages) * 64 * 1024;	// convert to bytes
 	size_t cbMax = 0x100000000;
-	if (m_pctxt->m_vecmem_types.size() > 0 && m_pctxt->m_vecmem_types[0].fMaxSet)
+	if (m_pmodule->m_vecmem_types.size() > 0 && m_pmodule->m_vecmem_types[0].fMaxSet)
 	{
-		cbMax = m_pctxt->m_vecmem_types[0].maximum_size * (64 * 1024ULL);
+		cbMax = m_pmodule->m_vecmem_types[0].maximum_size * (64 * 1024ULL);
 	}
 	if ((pectl->cbHeap + cb) > cbMax)
 		return -1;
 	Verify(pectl->cbHeap + cb < 0x100000000);
 	uint32_t cbRet = (uint32_t)(pectl->cbHeap / (64 * 1024));
+	if (cb > 0)
+	{
+		WasmContext *pctxtInstance = pectl->pctxtInstance;
+		layer::ProtectRange(*pctxtInstance->m_spapbHeap, reinterpret_cast<uint8_t*>(pctxtInstance->m_pheap) + pectl->cbHeap, cb, layer::PAGE_PROTECTION::ReadWrite);
+	}
 	pectl->cbHeap += cb;
 	return cbRet;
 }
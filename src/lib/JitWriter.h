@@ -4,24 +4,57 @@
 #include "Exceptions.h"
 #include "numeric_cast.h"
 #include "ExpressionService.h"
+#include <atomic>
+#include <mutex>
 
-extern "C" void CompileFn(struct ExecutionControlBlock *pectl, uint32_t ifn);
+extern "C" bool CompileFn(struct ExecutionControlBlock *pectl, uint32_t ifn);
+extern "C" uint8_t *TierUp(struct ExecutionControlBlock *pectl, uint32_t ifn, uint32_t ibLoop, uint8_t *pbReturn);
+class SsaFunction;
 class JitWriter
 {
-	friend void CompileFn(ExecutionControlBlock *pectl, uint32_t ifn);
+	friend bool CompileFn(ExecutionControlBlock *pectl, uint32_t ifn);
+	friend uint8_t *TierUp(ExecutionControlBlock *pectl, uint32_t ifn, uint32_t ibLoop, uint8_t *pbReturn);
 public:
-	JitWriter(class WasmContext *pctxt, size_t cfn, size_t cglbls);
+	// Baseline code counts function entries and loop iterations down from cTierUpThreshold, when it runs out the function
+	//	is recompiled by the optimizing tier (see TierUp).  With 0 each function is optimized the first time it is called.
+	static const int32_t cTierUpThresholdDefault = 10000;
+
+	JitWriter(class WasmModule *pmodule, size_t cfn, bool fAllowSSE41 = true, int32_t cTierUpThreshold = cTierUpThresholdDefault);
 	~JitWriter();
 
-	void CompileFn(uint32_t ifn);
+	void CompileFn(uint32_t ifn, bool fOptimize = false);
+	void CompileAll(uint32_t cthread);
+
+	// Compiled code can be saved to a file and loaded by a later run that loads the same module (see FLoadCodeCache)
+	static const uint32_t versionCodeCache = 4;	// bump whenever the code emitted or the exec plane layout changes
+	static uint64_t HashBytes(uint64_t hash, const void *pv, size_t cb);
+	uint64_t HashCodeCacheKey(uint64_t hashModule) const;
+	bool FLoadCodeCache(FILE *pf, uint64_t hashKey);
+	void SaveCodeCache(FILE *pf, uint64_t hashKey);
+	bool FCodeCacheStale() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutexCompile);
+		return m_pexecPlaneCur != m_pbCodeCacheEnd;
+	}
 
-	ExpressionService::Variant ExternCallFn(uint32_t ifn, void *pvAddrMem, ExpressionService::Variant *rgargs, uint32_t cargs);
+	// Runs ifn on the instance pctxtInstance, every instance of our module shares our code.  Different instances can run
+	//	on different threads at once, compiling and tiering up take m_mutexCompile.
+	ExpressionService::Variant ExternCallFn(class WasmContext *pctxtInstance, uint32_t ifn, ExpressionService::Variant *rgargs, uint32_t cargs);
 
 	// Psuedo private callbacks from ASM
 	uint64_t CReentryFn(int ifn, uint64_t *pvArgs, uint8_t *pvMemBase, ExecutionControlBlock *pecb);
 	uint32_t GrowMemory(ExecutionControlBlock *pectl, uint32_t cpages);
+	uint8_t *TierUp(uint32_t ifn, uint32_t ibLoop, uint8_t *pbReturn);
+
+	// Maps an address in jitted code back to its function and the offset of the wasm opcode within the function body
+	bool FLookupCode(const void *pv, uint32_t *pifn, uint32_t *pibBytecode) const;
 private:
+	JitWriter(const JitWriter &jitwShared, uint8_t *pbCode, uint8_t *pbCodeMax);
+
 	void SafePushCode(const void *pv, size_t cb);
+	// Where code at pv in the exec plane is written, anything patched after being emitted goes through this too
+	template<typename T>
+	T *PWritable(T *pv) const { return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(pv) + m_dbWrite); }
 	template<typename T, size_t size>
 	size_t GetArrLength(T(&)[size]) { return size; }
 
@@ -70,17 +103,87 @@ private:
 		Multiply,
 		Divide,
 	};
+	enum class FloatUnaryOperation
+	{
+		Abs,
+		Ceil,
+		Floor,
+		Trunc,
+		Nearest,
+		Sqrt,
+	};
+	enum class ConditionCode : uint8_t	// x86 condition code nibble as used by jcc/setcc/cmovcc
+	{
+		Overflow, NoOverflow, Below, AboveEqual, Equal, NotEqual, BelowEqual, Above,
+		Sign, NoSign, Parity, NoParity, Less, GreaterEqual, LessEqual, Greater,
+	};
+	enum class Register : uint8_t
+	{
+		rax, rcx, rdx, rbx, rsp, rbp, rsi, rdi,
+		r8, r9, r10, r11, r12, r13, r14, r15,
+		xmm0, xmm1, xmm2, xmm3, xmm4, xmm5, xmm6, xmm7,	// only ever seen in the operand stack cache
+	};
+	static bool FXmmRegister(Register reg) { return reg >= Register::xmm0; }
+
+	// Direct calls between jitted functions pass their first arguments in r13-r15, the first locals that can be pinned
+	static const uint32_t cargRegister = 3;
+	static Register RegArgument(uint32_t iarg) { return Register(uint8_t(Register::r13) + iarg); }
+
+	// Callees with bodies up to this size (getters, setters, thin wrappers) are compiled into each caller instead of called
+	static const size_t cbInlineMax = 32;
+	static const size_t cbInlineMaxOptimized = 128;
+
+	// Value IFs with arms of up to this many ops are compiled to a cmov instead of branches
+	static const uint32_t copIfConvertMax = 6;
+
+	// Stands in for the loop offset in the tier up check at function entry (see TierUp)
+	static const uint32_t ibTierUpEntry = 0xFFFFFFFF;
 
 	int32_t RelAddrPfnVector(uint32_t ifn, uint32_t opSize) const
 	{
 		return numeric_cast<int32_t>((m_pexecPlane + (sizeof(void*)*ifn)) - (m_pexecPlaneCur + opSize));
 	}
 
+	// Direct calls to a function that isn't compiled yet go to its compile stub (mov ecx, ifn; jmp [LazyCompileShim])
+	static const size_t cbCompileStub = 11;
+	uint8_t *PbCompileStub(uint32_t ifn) const;
+
 	// Common code sequences (does not leave machine in valid state)
 	void _PushExpandStack();
 	void _PopContractStack();
 	void _PopSecondParam(bool fSwapParams = false);
+	void _FlushStack();
+	void _SpillStack();
+	void _DiscardStackCache();
+	void _RdiModRM(uint8_t op, uint8_t reg, int32_t cslot);
+	void _SetStackHeight(int32_t cslot);
+	void _SetCondPending(ConditionCode cond);
+	void _MaterializeCond();
+	ConditionCode _PopCondition();
+	static bool FXmmOperandOp(opcode op);
+	void _MaterializeFloat();
+	void _LoadFloatTop(bool fDouble);
+	Register _PopFloatSecond(bool fDouble);
+	static bool FConstFoldable(opcode opNext, int64_t c, bool f64);
+	void _ArithImmPending(uint8_t opext, bool f64);
+	void _ShiftImmPending(uint8_t opext, bool f64);
+	void _MulImmPending(bool f64);
+	void _DivImmPending(bool fSigned, bool fModulo, bool f64);
+	void _DivRcx(bool fSigned, bool fModulo, bool f64);
+	void _LogicOpImmPending(LogicOperation op, bool f64);
+	uint32_t _PrepareHeapIndex(uint32_t offset);
+	void _HeapOperand(uint32_t disp);
+	void _LoadLocal32(Register regDst, uint32_t idx);
+	bool FFoldLocalAddress(uint32_t idx, uint32_t ilocalBase, uint32_t clocals, const uint8_t **ppop, size_t *pcb);
+	bool _FPinnedLocal(uint32_t idx, Register *preg) const;
+	void _StoreLocalMem(uint32_t idx);
+	void _SpillPinnedLocals();
+	void _ReloadPinnedLocals();
 	void _SetDbgReg(uint32_t opcode);
+	void _PatchCallSites(uint32_t ifn);
+	void _CompileFnOrDiscard(uint32_t ifn, bool fOptimize = false);
+	void _TierUpCheck(uint32_t ifn, uint32_t ibLoop);
+	void _DisableTierUpCheck(uint8_t *pbReturn);
 
 	// common operations (does leave machine in valid state)
 	void LoadMem(uint32_t offset, bool f64Dst /* else 32 */, uint32_t cbSrc, bool fSignExtend);
@@ -107,6 +210,7 @@ private:
 	void CountTrailingZeros(bool f64);
 	void CountLeadingZeros(bool f64);
 	void Select();
+	void IfConvertedSelect();
 	void Compare(CompareType type, bool fSigned, bool f64);
 	void FloatCompare(CompareType type);
 	void DoubleCompare(CompareType type);
@@ -120,38 +224,127 @@ private:
 	int32_t *Jump(void *addr);
 	void CallIfn(uint32_t ifn, uint32_t clocalsCaller, uint32_t cargsCallee, bool fReturnValue, bool fIndirect);
 	void FnEpilogue(bool fRetVal);
-	void FnPrologue(uint32_t clocals, uint32_t cargs);
-	void BranchTableParse(const uint8_t **ppoperand, size_t *pcbOperand, const std::vector<std::pair<value_type, void*>> &stackBlockTypeAddr, std::vector<std::vector<int32_t*>> &stackVecFixups, std::vector<std::vector<void**>> &stackVecFixupsAbsolute);
+	uint8_t *FnPrologue(uint32_t ifn, uint32_t clocals, uint32_t cargs);
+	void AllocateLocalRegisters(const uint8_t *pop, size_t cb, uint32_t clocals, uint32_t cargs);
+	bool FInlineCandidate(uint32_t ifn, bool *pfCalls) const;
+	static bool FIfConvertible(const uint8_t *pop, size_t cb);
+	void BranchTableParse(const uint8_t **ppoperand, size_t *pcbOperand, const std::vector<std::pair<value_type, void*>> &stackBlockTypeAddr, size_t cblockInline, std::vector<std::vector<int32_t*>> &stackVecFixups);
 	void ExtendSigned32_64();
 	void FloatNeg(bool fDouble);
+	void FloatUnary(FloatUnaryOperation op, bool fDouble);
+	void FloatMinMax(bool fMax, bool fDouble);
+	void FloatCopySign(bool fDouble);
 
 	void Ud2();
 
 	void EnterBlock();
 	int32_t *EnterIF();
-	void LeaveBlock(bool fHasReturn);
+	void LeaveBlock(uint32_t depth, bool fHasReturn);	// restores the stack of the block depth levels out
+	static bool FBranchValue(const std::pair<value_type, void*> &pairBlock);
 
 	void ProtectForRuntime();
 	void UnprotectRuntime();
 
-	class WasmContext *m_pctxt = nullptr;	// Parent
+	// Optimizing tier code generation from SSA form (see SsaFunction.h).  Values live in r8-r15 or in spill slots after
+	//	the locals, rax, rcx and rdx are scratch.  Only used for functions SsaFunction can build, the rest go through the
+	//	stack machine emitter above.
+	struct SsaLoc
+	{
+		enum class Kind : uint8_t { Reg, Mem, Imm } kind;
+		Register reg;
+		int32_t disp;		// [rbx + disp]
+		int64_t imm;
+	};
+	static SsaLoc LocReg(Register reg) { return SsaLoc{ SsaLoc::Kind::Reg, reg, 0, 0 }; }
+	static SsaLoc LocMem(int32_t disp) { return SsaLoc{ SsaLoc::Kind::Mem, Register::rax, disp, 0 }; }
+	static SsaLoc LocImm(int64_t imm) { return SsaLoc{ SsaLoc::Kind::Imm, Register::rax, 0, imm }; }
+	static bool FSameLoc(const SsaLoc &locA, const SsaLoc &locB);
+	bool FCompileFnSsa(uint32_t ifn);
+	SsaLoc _SsaLocation(const SsaFunction &ssa, uint32_t ival) const;
+	SsaLoc _SsaOperand(const SsaFunction &ssa, uint32_t ival, bool f64, Register regScratch);
+	void _SsaModRM(uint8_t prefix, std::initializer_list<uint8_t> ilopcode, uint8_t regField, const SsaLoc &locRM, bool f64);
+	void _SsaHeapModRM(uint8_t prefix, std::initializer_list<uint8_t> ilopcode, uint8_t regField, bool f64, const SsaLoc &locAddr, uint32_t offset);
+	void _SsaGlobalModRM(std::initializer_list<uint8_t> ilopcode, Register reg, bool f64, uint32_t idxGlobal);
+	void _SsaMovImm(Register reg, int64_t imm);
+	void _SsaMov(const SsaLoc &locDst, const SsaLoc &locSrc);
+	void _SsaAluRM(uint8_t opext, Register regDst, const SsaLoc &locSrc, bool f64);
+	void _SsaParallelMove(std::vector<std::pair<SsaLoc, SsaLoc>> vecpairMove);
+	void _SsaEdgeMoves(const SsaFunction &ssa, uint32_t iblockFrom, uint32_t iblockTo, std::vector<std::pair<SsaLoc, SsaLoc>> *pvecpairMove);
+	ConditionCode _SsaCompare(const SsaFunction &ssa, uint32_t ival);
+	void _SsaLowerValue(const SsaFunction &ssa, uint32_t ival);
+
+	class WasmModule *m_pmodule = nullptr;	// Parent, owns us
 	uint8_t *m_pexecPlane = nullptr;
 	uint8_t *m_pcodeStart = nullptr;
 	uint8_t *m_pexecPlaneCur = nullptr;
 	uint8_t *m_pexecPlaneMax = nullptr;
+	ptrdiff_t m_dbWrite = 0;	// from the exec plane to its ReadWrite alias when it is dual mapped
 	void **m_pfnCallIndirectShim = nullptr;
-	void **m_pfnBranchTable = nullptr;
 	void **m_pfnU64ToF32 = nullptr;
 	void **m_pfnU64ToF64 = nullptr;
 	void **m_pfnGrowMemoryOp = nullptr;
 	void **m_pfnF32ToU64Trunc = nullptr;
 	void **m_pfnF64ToU64Trunc = nullptr;
-	uint64_t *m_pGlobalsStart = nullptr;
-	void *m_pheap = nullptr;
+	void **m_pfnF32Round = nullptr;
+	void **m_pfnF64Round = nullptr;
+	void **m_pfnTierUpStub = nullptr;
+	void **m_pfnLazyCompileShim = nullptr;
+	uint8_t *m_pbCompileStubs = nullptr;	// one per function after the imports (see PbCompileStub)
+	std::atomic<int32_t> *m_rgcTierUp = nullptr;		// per function tier up counters (see cTierUpThresholdDefault)
+	int32_t m_cTierUpThreshold = cTierUpThresholdDefault;	// what baseline code starts them at
 	size_t m_cfn;
+	bool m_fSSE41 = false;	// roundss/roundsd are available, otherwise rounding goes through the x87 helpers
+
+	// Operand stack entries below rax that are held in registers rather than at [rdi] (bottom first), floats may be held in xmm4-xmm7
+	std::vector<Register> m_vecregStackCache;
+	// rdi is always this many slots above the operand stack it had on entry to the function, validation makes the height
+	//	at each point static.  Blocks remember the height once they have spilled rax and branches out restore it with a lea.
+	int32_t m_cslotStack = 0;
+	std::vector<int32_t> m_veccslotBlock;
+	// When set the top of the operand stack is a boolean that still lives in the flags (rax is garbage)
+	bool m_fCondPending = false;
+	ConditionCode m_condPending = ConditionCode::NotEqual;
+	// When set the top of the operand stack is a float that still lives in xmm0 (rax is garbage).  An f32 held in an
+	//	xmm register always has bits 32-63 clear so it can be moved with movq like every other stack value.
+	bool m_fTopInXmm = false;
+	// When set a constant is the second operand of the next op and is encoded as an immediate instead of being pushed
+	bool m_fConstPending = false;
+	int64_t m_constPending = 0;
+	// When set the next load takes its (zero extended) address from rcx rather than the top of the stack
+	bool m_fAddrPending = false;
+	// Per function, the calls to its compile stub emitted before it was compiled (retargeted by _PatchCallSites)
+	std::vector<std::vector<uint8_t*>> m_vecvecpbCallFixups;
+	// Per function, the entry point for direct calls with register arguments (the function vector has the memory argument entry)
+	std::vector<uint8_t*> m_vecpbRegisterEntry;
+	// Set while compiling with the optimizing tier, which spends more time on the code and doesn't count for tier up
+	bool m_fOptimizing = false;
+	// Set for the JitWriters of CompileAll's threads, which leave patching calls to it
+	bool m_fWorker = false;
+	// Per function, whether TierUp has replaced its baseline code.  Failed functions stay on their baseline code for good.
+	enum class TierUpState : uint8_t { Baseline, Optimized, Failed };
+	std::vector<TierUpState> m_vecstateTierUp;
+	// Per optimized function, the loops baseline code can jump into mid execution (bytecode offset of the loop, entry code)
+	std::vector<std::vector<std::pair<uint32_t, uint8_t*>>> m_vecvecpairOsrEntry;
+	// Locals of the current function that live in callee saved registers instead of [rbx + idx*8]
+	std::vector<std::pair<uint32_t, Register>> m_vecpairLocalReg;
+
+	// Maps native code back to wasm opcodes for trap reporting, debuggers and profilers (release builds emit nothing
+	//	else to identify the current opcode).  One entry per compiled opcode that emitted code, in ascending code order
+	//	since code is only ever appended to the exec plane.
+	struct CodeMapEntry
+	{
+		uint32_t ibCode;		// offset of the opcode's first instruction from m_pexecPlane
+		uint32_t ifn;
+		uint32_t ibBytecode;	// offset of the opcode within the function body
+	};
+	std::vector<CodeMapEntry> m_veccodemap;
+	uint8_t *m_pbCodeCacheEnd = nullptr;	// the end of the code last loaded from or saved to the code cache
+
+	// Held while compiling, tiering up or reading what they change.  Code is only published once it is complete and is
+	//	patched with single aligned stores (see StoreShared), so other threads keep running it meanwhile.
+	mutable std::mutex m_mutexCompile;
+	// Without the dual mapping the code isn't executable while it is being written, so only one thread runs it at a time
+	std::mutex m_mutexRun;
 
-	std::vector<uint64_t> m_vecoperand;
-	std::vector<uint64_t> m_veclocals;
 	std::unique_ptr<layer::AllocatedPageBlock> m_spapbExecPlane;
-	std::unique_ptr<layer::AllocatedPageBlock> m_spapbHeap;
 };
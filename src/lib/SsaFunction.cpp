@@ -0,0 +1,2122 @@
+#include "stdafx.h"
+#include "wasm_types.h"
+#include "Exceptions.h"
+#include "safe_access.h"
+#include "SsaFunction.h"
+#include "WasmModule.h"
+#include "numeric_cast.h"
+#include <map>
+
+// Bigger functions stay with the stack machine emitter, liveness is a bit vector per block over all values
+static const size_t cvalMax = 32768;
+static const size_t cblockMax = 4096;
+static const size_t clocalMax = 1024;
+
+const uint32_t SsaFunction::ivalNil;
+const uint32_t SsaFunction::cregAllocatable;
+
+static bool FIntegerType(value_type type)
+{
+	return type == value_type::i32 || type == value_type::i64;
+}
+
+static bool FCompareOp(opcode op)
+{
+	return (op >= opcode::i32_eqz && op <= opcode::i32_ge_u) || (op >= opcode::i64_eqz && op <= opcode::i64_ge_u);
+}
+
+static bool FDivOp(opcode op)
+{
+	return (op >= opcode::i32_div_s && op <= opcode::i32_rem_u) || (op >= opcode::i64_div_s && op <= opcode::i64_rem_u);
+}
+
+uint32_t SsaFunction::NewValue(ValueKind kind, opcode op, value_type type, uint32_t ibBytecode)
+{
+	Value val;
+	val.kind = kind;
+	val.op = op;
+	val.type = type;
+	val.rgival[0] = val.rgival[1] = val.rgival[2] = ivalNil;
+	val.imm = 0;
+	val.ibBytecode = ibBytecode;
+	val.iblock = ivalNil;
+	val.ivalReplace = ivalNil;
+	val.idxLocal = ivalNil;
+	val.cuse = 0;
+	val.ireg = -1;
+	val.islot = ivalNil;
+	val.fFused = false;
+	m_vecval.push_back(val);
+	return numeric_cast<uint32_t>(m_vecval.size() - 1);
+}
+
+// Constants belong to no block, the lowering encodes them as immediates wherever they are used
+uint32_t SsaFunction::NewConst(value_type type, uint64_t val)
+{
+	uint32_t ival = NewValue(ValueKind::Const, type == value_type::i64 ? opcode::i64_const : opcode::i32_const, type, m_ibBytecodeCur);
+	m_vecval[ival].imm = int64_t((type == value_type::i64) ? val : uint64_t(uint32_t(val)));
+	return ival;
+}
+
+uint32_t SsaFunction::NewOp(opcode op, value_type type, uint32_t ival0, uint32_t ival1, uint32_t ival2, int64_t imm)
+{
+	uint32_t ival = NewValue(ValueKind::Op, op, type, m_ibBytecodeCur);
+	Value &val = m_vecval[ival];
+	val.rgival[0] = ival0;
+	val.rgival[1] = ival1;
+	val.rgival[2] = ival2;
+	val.imm = imm;
+	val.iblock = m_iblockCur;
+	m_vecblock[m_iblockCur].vecival.push_back(ival);
+	return ival;
+}
+
+uint32_t SsaFunction::NewPhi(uint32_t iblock, value_type type, uint32_t idxLocal)
+{
+	uint32_t ival = NewValue(ValueKind::Phi, opcode::nop, type, m_ibBytecodeCur);
+	m_vecval[ival].rgival[0] = numeric_cast<uint32_t>(m_vecvecivalPhi.size());
+	m_vecval[ival].iblock = iblock;
+	m_vecval[ival].idxLocal = idxLocal;
+	m_vecvecivalPhi.emplace_back();
+	auto &vecival = m_vecblock[iblock].vecival;
+	auto itval = vecival.begin();
+	while (itval != vecival.end() && m_vecval[*itval].kind == ValueKind::Phi)
+		++itval;
+	vecival.insert(itval, ival);
+	return ival;
+}
+
+uint32_t SsaFunction::NewBlock(bool fSealed)
+{
+	m_vecblock.emplace_back();
+	m_vecblock.back().fSealed = fSealed;
+	m_vecblock.back().vecivalLocal.resize(m_vectypeLocal.size(), ivalNil);
+	return numeric_cast<uint32_t>(m_vecblock.size() - 1);
+}
+
+void SsaFunction::StartBlock(uint32_t iblock)
+{
+	m_iblockCur = iblock;
+	if (m_vecblock[iblock].iorder == ivalNil)
+		m_vecblock[iblock].iorder = m_iorderNext++;
+}
+
+void SsaFunction::AddEdge(uint32_t iblockFrom, uint32_t iblockTo)
+{
+	Verify(!m_vecblock[iblockTo].fSealed);
+	m_vecblock[iblockTo].veciblockPred.push_back(iblockFrom);
+}
+
+// Drops the edge and the matching operand of every phi in iblockTo
+void SsaFunction::RemoveEdge(uint32_t iblockFrom, uint32_t iblockTo)
+{
+	Block &blockTo = m_vecblock[iblockTo];
+	auto itiblock = std::find(blockTo.veciblockPred.begin(), blockTo.veciblockPred.end(), iblockFrom);
+	Verify(itiblock != blockTo.veciblockPred.end());
+	size_t ipred = itiblock - blockTo.veciblockPred.begin();
+	blockTo.veciblockPred.erase(itiblock);
+	for (uint32_t ival : blockTo.vecival)
+	{
+		if (m_vecval[ival].kind != ValueKind::Phi)
+			break;
+		auto &vecivalArg = m_vecvecivalPhi[m_vecval[ival].rgival[0]];
+		vecivalArg.erase(vecivalArg.begin() + ipred);
+	}
+}
+
+// Adds the edge for a branch to label, carrying the top of the operand stack if the label has a result
+void SsaFunction::BranchTo(Label &label, uint32_t iblockFrom)
+{
+	AddEdge(iblockFrom, label.iblockBranch);
+	if (label.op != opcode::loop && label.type != value_type::empty_block)
+		label.vecivalResult.push_back(Top());
+}
+
+// Code after br, return or unreachable goes in a block without predecessors that is thrown away later
+bool SsaFunction::FReachable() const
+{
+	return m_iblockCur == 0 || !m_vecblock[m_iblockCur].veciblockPred.empty();
+}
+
+uint32_t SsaFunction::Resolve(uint32_t ival) const
+{
+	while (m_vecval[ival].ivalReplace != ivalNil)
+		ival = m_vecval[ival].ivalReplace;
+	return ival;
+}
+
+void SsaFunction::Replace(uint32_t ival, uint32_t ivalNew)
+{
+	Verify(ival != ivalNew);
+	m_vecval[ival].ivalReplace = ivalNew;
+}
+
+void SsaFunction::WriteLocal(uint32_t iblock, uint32_t idx, uint32_t ival)
+{
+	m_vecblock[iblock].vecivalLocal[idx] = ival;
+}
+
+uint32_t SsaFunction::ReadLocal(uint32_t iblock, uint32_t idx)
+{
+	if (m_vecblock[iblock].vecivalLocal[idx] != ivalNil)
+		return Resolve(m_vecblock[iblock].vecivalLocal[idx]);
+
+	uint32_t ival;
+	value_type type = m_vectypeLocal[idx];
+	if (!m_vecblock[iblock].fSealed)
+	{
+		ival = NewPhi(iblock, type, idx);
+		m_vecblock[iblock].vecpairIncompletePhi.push_back(std::make_pair(idx, ival));
+	}
+	else if (m_vecblock[iblock].veciblockPred.empty())
+	{
+		ival = NewConst(type, 0);	// unreachable code
+	}
+	else if (m_vecblock[iblock].veciblockPred.size() == 1)
+	{
+		ival = ReadLocal(m_vecblock[iblock].veciblockPred.front(), idx);
+	}
+	else
+	{
+		ival = NewPhi(iblock, type, idx);
+		WriteLocal(iblock, idx, ival);	// breaks cycles through loops
+		AddPhiOperands(ival, idx);
+		ival = TryRemoveTrivialPhi(ival);
+	}
+	WriteLocal(iblock, idx, ival);
+	return ival;
+}
+
+void SsaFunction::AddPhiOperands(uint32_t ivalPhi, uint32_t idx)
+{
+	uint32_t iblock = m_vecval[ivalPhi].iblock;
+	for (size_t ipred = 0; ipred < m_vecblock[iblock].veciblockPred.size(); ++ipred)
+	{
+		uint32_t ivalArg = ReadLocal(m_vecblock[iblock].veciblockPred[ipred], idx);
+		m_vecvecivalPhi[m_vecval[ivalPhi].rgival[0]].push_back(ivalArg);
+	}
+}
+
+// A phi whose operands are all the same value (or itself) is that value
+uint32_t SsaFunction::TryRemoveTrivialPhi(uint32_t ivalPhi)
+{
+	uint32_t ivalSame = ivalNil;
+	for (uint32_t ivalArg : m_vecvecivalPhi[m_vecval[ivalPhi].rgival[0]])
+	{
+		ivalArg = Resolve(ivalArg);
+		if (ivalArg == ivalSame || ivalArg == ivalPhi)
+			continue;
+		if (ivalSame != ivalNil)
+			return ivalPhi;
+		ivalSame = ivalArg;
+	}
+	if (ivalSame == ivalNil)
+		ivalSame = NewConst(m_vecval[ivalPhi].type, 0);	// only reachable through itself
+	Replace(ivalPhi, ivalSame);
+	return ivalSame;
+}
+
+void SsaFunction::SealBlock(uint32_t iblock)
+{
+	std::vector<std::pair<uint32_t, uint32_t>> vecpairIncomplete;
+	vecpairIncomplete.swap(m_vecblock[iblock].vecpairIncompletePhi);
+	m_vecblock[iblock].fSealed = true;
+	for (auto &pair : vecpairIncomplete)
+	{
+		AddPhiOperands(pair.second, pair.first);
+		TryRemoveTrivialPhi(pair.second);
+	}
+}
+
+uint32_t SsaFunction::Pop()
+{
+	if (m_vecivalStack.size() <= m_veclabel.back().cvalStack)
+	{
+		Verify(!FReachable());	// only unreachable code may pop values it never pushed
+		return NewConst(value_type::i32, 0);
+	}
+	uint32_t ival = m_vecivalStack.back();
+	m_vecivalStack.pop_back();
+	return ival;
+}
+
+uint32_t SsaFunction::Top() const
+{
+	Verify(m_vecivalStack.size() > m_veclabel.back().cvalStack);
+	return m_vecivalStack.back();
+}
+
+void SsaFunction::Push(uint32_t ival)
+{
+	m_vecivalStack.push_back(ival);
+}
+
+uint32_t SsaFunction::CArgs(const Value &val)
+{
+	if (val.kind != ValueKind::Op)
+		return 0;
+	switch (val.op)
+	{
+	case opcode::get_global:
+		return 0;
+	case opcode::set_global:
+	case opcode::i32_eqz:
+	case opcode::i64_eqz:
+	case opcode::i32_clz:
+	case opcode::i32_ctz:
+	case opcode::i32_popcnt:
+	case opcode::i64_clz:
+	case opcode::i64_ctz:
+	case opcode::i64_popcnt:
+	case opcode::i32_wrap_i64:
+	case opcode::i64_extend_s_i32:
+	case opcode::i64_extend_u_i32:
+		return 1;
+	case opcode::select:
+		return 3;
+	default:
+		if (val.op >= opcode::i32_load && val.op <= opcode::i64_load32_u)
+			return 1;
+		return 2;	// stores, compares and binary operators
+	}
+}
+
+// Computes its result from its operands alone without trapping
+bool SsaFunction::FPure(const Value &val)
+{
+	if (val.kind != ValueKind::Op)
+		return false;
+	if (val.op == opcode::get_global || val.op == opcode::set_global)
+		return false;
+	if (val.op >= opcode::i32_load && val.op <= opcode::i64_store32)
+		return false;
+	return !FDivOp(val.op);
+}
+
+bool SsaFunction::FSideEffects(const Value &val)
+{
+	if (val.kind != ValueKind::Op)
+		return false;
+	if (val.op == opcode::set_global)
+		return true;
+	if (val.op >= opcode::i32_load && val.op <= opcode::i64_store32)
+		return true;	// loads can trap
+	return FDivOp(val.op);
+}
+
+bool SsaFunction::FCommutative(opcode op)
+{
+	switch (op)
+	{
+	case opcode::i32_add:
+	case opcode::i32_mul:
+	case opcode::i32_and:
+	case opcode::i32_or:
+	case opcode::i32_xor:
+	case opcode::i32_eq:
+	case opcode::i32_ne:
+	case opcode::i64_add:
+	case opcode::i64_mul:
+	case opcode::i64_and:
+	case opcode::i64_or:
+	case opcode::i64_xor:
+	case opcode::i64_eq:
+	case opcode::i64_ne:
+		return true;
+	default:
+		return false;
+	}
+}
+
+template<typename T>
+static T CountLeadingZeros(T x)
+{
+	T c = 0;
+	for (T bit = T(1) << (sizeof(T) * 8 - 1); bit != 0 && !(x & bit); bit >>= 1)
+		++c;
+	return c;
+}
+
+template<typename T>
+static T CountTrailingZeros(T x)
+{
+	T c = 0;
+	for (T bit = 1; bit != 0 && !(x & bit); bit <<= 1)
+		++c;
+	return c;
+}
+
+template<typename T>
+static T CountBits(T x)
+{
+	T c = 0;
+	for (; x != 0; x &= x - 1)
+		++c;
+	return c;
+}
+
+// Evaluates op at compile time, false for the operands that have to trap at run time
+template<typename U, typename S>
+static bool FFoldT(opcode op, U a, U b, uint64_t *pres)
+{
+	const unsigned cbit = sizeof(U) * 8;
+	const unsigned shift = unsigned(b) & (cbit - 1);
+	const S sa = S(a), sb = S(b);
+	const S sMin = S(U(1) << (cbit - 1));
+	U res;
+	switch (op)
+	{
+	case opcode::i32_eqz: case opcode::i64_eqz:			res = (a == 0); break;
+	case opcode::i32_eq: case opcode::i64_eq:			res = (a == b); break;
+	case opcode::i32_ne: case opcode::i64_ne:			res = (a != b); break;
+	case opcode::i32_lt_s: case opcode::i64_lt_s:		res = (sa < sb); break;
+	case opcode::i32_lt_u: case opcode::i64_lt_u:		res = (a < b); break;
+	case opcode::i32_gt_s: case opcode::i64_gt_s:		res = (sa > sb); break;
+	case opcode::i32_gt_u: case opcode::i64_gt_u:		res = (a > b); break;
+	case opcode::i32_le_s: case opcode::i64_le_s:		res = (sa <= sb); break;
+	case opcode::i32_le_u: case opcode::i64_le_u:		res = (a <= b); break;
+	case opcode::i32_ge_s: case opcode::i64_ge_s:		res = (sa >= sb); break;
+	case opcode::i32_ge_u: case opcode::i64_ge_u:		res = (a >= b); break;
+	case opcode::i32_clz: case opcode::i64_clz:			res = CountLeadingZeros<U>(a); break;
+	case opcode::i32_ctz: case opcode::i64_ctz:			res = CountTrailingZeros<U>(a); break;
+	case opcode::i32_popcnt: case opcode::i64_popcnt:	res = CountBits<U>(a); break;
+	case opcode::i32_add: case opcode::i64_add:			res = a + b; break;
+	case opcode::i32_sub: case opcode::i64_sub:			res = a - b; break;
+	case opcode::i32_mul: case opcode::i64_mul:			res = a * b; break;
+	case opcode::i32_and: case opcode::i64_and:			res = a & b; break;
+	case opcode::i32_or: case opcode::i64_or:			res = a | b; break;
+	case opcode::i32_xor: case opcode::i64_xor:			res = a ^ b; break;
+	case opcode::i32_shl: case opcode::i64_shl:			res = a << shift; break;
+	case opcode::i32_shr_s: case opcode::i64_shr_s:		res = U(sa >> shift); break;
+	case opcode::i32_shr_u: case opcode::i64_shr_u:		res = a >> shift; break;
+	case opcode::i32_rotl: case opcode::i64_rotl:		res = shift ? U((a << shift) | (a >> (cbit - shift))) : a; break;
+	case opcode::i32_rotr: case opcode::i64_rotr:		res = shift ? U((a >> shift) | (a << (cbit - shift))) : a; break;
+	case opcode::i32_div_s: case opcode::i64_div_s:
+		if (b == 0 || (sa == sMin && sb == -1))
+			return false;
+		res = U(sa / sb);
+		break;
+	case opcode::i32_div_u: case opcode::i64_div_u:
+		if (b == 0)
+			return false;
+		res = a / b;
+		break;
+	case opcode::i32_rem_s: case opcode::i64_rem_s:
+		if (b == 0)
+			return false;
+		res = (sb == -1) ? 0 : U(sa % sb);
+		break;
+	case opcode::i32_rem_u: case opcode::i64_rem_u:
+		if (b == 0)
+			return false;
+		res = a % b;
+		break;
+	default:
+		return false;
+	}
+	*pres = uint64_t(res);
+	return true;
+}
+
+bool SsaFunction::FFoldOp(opcode op, uint64_t a, uint64_t b, uint64_t *pres)
+{
+	switch (op)
+	{
+	case opcode::i32_wrap_i64:
+	case opcode::i64_extend_u_i32:
+		*pres = uint32_t(a);
+		return true;
+	case opcode::i64_extend_s_i32:
+		*pres = uint64_t(int64_t(int32_t(a)));
+		return true;
+	default:
+		break;
+	}
+	if ((op >= opcode::i32_eqz && op <= opcode::i32_ge_u) || (op >= opcode::i32_clz && op <= opcode::i32_rotr))
+		return FFoldT<uint32_t, int32_t>(op, uint32_t(a), uint32_t(b), pres);
+	if ((op >= opcode::i64_eqz && op <= opcode::i64_ge_u) || (op >= opcode::i64_clz && op <= opcode::i64_rotr))
+		return FFoldT<uint64_t, int64_t>(op, a, b, pres);
+	return false;
+}
+
+bool SsaFunction::FBuild(WasmModule *pmodule, uint32_t ifn)
+{
+	m_pmodule = pmodule;
+	size_t cimports = pmodule->m_vecimports.size();
+	Verify(ifn >= cimports);
+	const FunctionCodeEntry *pfnc = pmodule->m_vecfn_code.at(ifn - cimports).get();
+	const FunctionTypeEntry *ptype = pmodule->m_vecfn_types.at(pmodule->m_vecfn_entries.at(ifn)).get();
+
+	if (ptype->fHasReturnValue)
+	{
+		if (!FIntegerType(ptype->return_type))
+			return false;
+		m_typeReturn = ptype->return_type;
+	}
+	m_cparams = ptype->cparams;
+	size_t clocals = m_cparams;
+	for (uint32_t ilocalInfo = 0; ilocalInfo < pfnc->clocalVars; ++ilocalInfo)
+		clocals += pfnc->rglocals[ilocalInfo].count;
+	if (clocals > clocalMax)
+		return false;
+	for (uint32_t iparam = 0; iparam < m_cparams; ++iparam)
+		m_vectypeLocal.push_back(ptype->rgparam_type[iparam]);
+	for (uint32_t ilocalInfo = 0; ilocalInfo < pfnc->clocalVars; ++ilocalInfo)
+		m_vectypeLocal.insert(m_vectypeLocal.end(), pfnc->rglocals[ilocalInfo].count, pfnc->rglocals[ilocalInfo].type);
+	for (value_type type : m_vectypeLocal)
+	{
+		if (!FIntegerType(type))
+			return false;
+	}
+
+	uint32_t iblockEntry = NewBlock(true);
+	StartBlock(iblockEntry);
+	for (uint32_t idx = 0; idx < m_vectypeLocal.size(); ++idx)
+	{
+		uint32_t ival;
+		if (idx < m_cparams)
+		{
+			ival = NewValue(ValueKind::Param, opcode::get_local, m_vectypeLocal[idx], 0);
+			m_vecval[ival].imm = idx;
+			m_vecval[ival].iblock = iblockEntry;
+			m_vecblock[iblockEntry].vecival.push_back(ival);
+		}
+		else
+		{
+			ival = NewConst(m_vectypeLocal[idx], 0);
+		}
+		WriteLocal(iblockEntry, idx, ival);
+	}
+
+	m_veclabel.push_back(Label{ opcode::block, ptype->fHasReturnValue ? ptype->return_type : value_type::empty_block, NewBlock(false), ivalNil, 0, {} });
+
+	const uint8_t *pop = pfnc->vecbytecode.data();
+	size_t cb = pfnc->vecbytecode.size();
+	while (cb > 0)
+	{
+		if (m_vecval.size() > cvalMax || m_vecblock.size() > cblockMax)
+			return false;
+		Verify(!m_veclabel.empty());
+		m_ibBytecodeCur = numeric_cast<uint32_t>(pop - pfnc->vecbytecode.data());
+		opcode op = opcode(*pop);
+		++pop;
+		--cb;
+		switch (op)
+		{
+		case opcode::unreachable:
+			m_vecblock[m_iblockCur].exit = ExitKind::Trap;
+			m_vecblock[m_iblockCur].ibBytecodeExit = m_ibBytecodeCur;
+			StartBlock(NewBlock(true));
+			break;
+
+		case opcode::nop:
+			break;
+
+		case opcode::block:
+		{
+			value_type type = safe_read_buffer<value_type>(&pop, &cb);
+			m_veclabel.push_back(Label{ opcode::block, type, NewBlock(false), ivalNil, m_vecivalStack.size(), {} });
+			break;
+		}
+
+		case opcode::loop:
+		{
+			value_type type = safe_read_buffer<value_type>(&pop, &cb);
+			uint32_t iblockHeader = NewBlock(false);
+			bool fReachable = FReachable();
+			if (fReachable)
+			{
+				AddEdge(m_iblockCur, iblockHeader);
+				m_vecblock[m_iblockCur].exit = ExitKind::Jump;
+				m_vecblock[m_iblockCur].rgiblockSucc[0] = iblockHeader;
+			}
+			StartBlock(iblockHeader);
+			if (fReachable && m_vecivalStack.empty())
+			{
+				// Baseline code can tier up here, remember what each local holds on entry to the loop
+				Loop loop;
+				loop.ibLoop = m_ibBytecodeCur;
+				loop.iblockHeader = iblockHeader;
+				for (uint32_t idx = 0; idx < m_vectypeLocal.size(); ++idx)
+					loop.vecivalLocal.push_back(ReadLocal(iblockHeader, idx));
+				m_vecloop.push_back(std::move(loop));
+			}
+			m_veclabel.push_back(Label{ opcode::loop, type, iblockHeader, ivalNil, m_vecivalStack.size(), {} });
+			break;
+		}
+
+		case opcode::IF:
+		{
+			value_type type = safe_read_buffer<value_type>(&pop, &cb);
+			uint32_t ivalCond = Pop();
+			uint32_t iblockThen = NewBlock(false);
+			uint32_t iblockElse = NewBlock(false);
+			uint32_t iblockMerge = NewBlock(false);
+			if (FReachable())
+			{
+				Block &block = m_vecblock[m_iblockCur];
+				block.exit = ExitKind::Branch;
+				block.ivalExit = ivalCond;
+				block.rgiblockSucc[0] = iblockThen;
+				block.rgiblockSucc[1] = iblockElse;
+				block.ibBytecodeExit = m_ibBytecodeCur;
+				AddEdge(m_iblockCur, iblockThen);
+				AddEdge(m_iblockCur, iblockElse);
+			}
+			SealBlock(iblockThen);
+			SealBlock(iblockElse);
+			StartBlock(iblockThen);
+			m_veclabel.push_back(Label{ opcode::IF, type, iblockMerge, iblockElse, m_vecivalStack.size(), {} });
+			break;
+		}
+
+		case opcode::ELSE:
+		{
+			Label &label = m_veclabel.back();
+			Verify(label.op == opcode::IF && label.iblockElse != ivalNil);
+			if (FReachable())
+			{
+				BranchTo(label, m_iblockCur);
+				m_vecblock[m_iblockCur].exit = ExitKind::Jump;
+				m_vecblock[m_iblockCur].rgiblockSucc[0] = label.iblockBranch;
+			}
+			m_vecivalStack.resize(label.cvalStack);
+			StartBlock(label.iblockElse);
+			label.iblockElse = ivalNil;
+			break;
+		}
+
+		case opcode::end:
+		{
+			Label &label = m_veclabel.back();
+			if (label.op == opcode::loop)
+			{
+				SealBlock(label.iblockBranch);
+				uint32_t ivalResult = ivalNil;
+				if (label.type != value_type::empty_block)
+					ivalResult = FReachable() ? Pop() : NewConst(label.type, 0);
+				m_vecivalStack.resize(label.cvalStack);
+				if (ivalResult != ivalNil)
+					Push(ivalResult);
+			}
+			else
+			{
+				if (FReachable())
+				{
+					BranchTo(label, m_iblockCur);
+					m_vecblock[m_iblockCur].exit = ExitKind::Jump;
+					m_vecblock[m_iblockCur].rgiblockSucc[0] = label.iblockBranch;
+				}
+				if (label.iblockElse != ivalNil && !m_vecblock[label.iblockElse].veciblockPred.empty())
+				{
+					// if without else, the condition being false goes straight to the end
+					Verify(label.type == value_type::empty_block);
+					AddEdge(label.iblockElse, label.iblockBranch);
+					m_vecblock[label.iblockElse].exit = ExitKind::Jump;
+					m_vecblock[label.iblockElse].rgiblockSucc[0] = label.iblockBranch;
+					m_vecblock[label.iblockElse].iorder = m_iorderNext++;
+				}
+				m_vecivalStack.resize(label.cvalStack);
+				SealBlock(label.iblockBranch);
+				StartBlock(label.iblockBranch);
+				if (label.type != value_type::empty_block)
+				{
+					uint32_t ivalResult;
+					if (label.vecivalResult.empty())
+					{
+						ivalResult = NewConst(label.type, 0);
+					}
+					else if (label.vecivalResult.size() == 1)
+					{
+						ivalResult = label.vecivalResult.front();
+					}
+					else
+					{
+						ivalResult = NewPhi(label.iblockBranch, label.type, ivalNil);
+						m_vecvecivalPhi[m_vecval[ivalResult].rgival[0]] = label.vecivalResult;
+					}
+					Push(ivalResult);
+				}
+			}
+			m_veclabel.pop_back();
+
+			if (m_veclabel.empty())
+			{
+				Block &block = m_vecblock[m_iblockCur];
+				block.ibBytecodeExit = m_ibBytecodeCur;
+				if (FReachable())
+				{
+					block.exit = ExitKind::Return;
+					if (m_typeReturn != value_type::none)
+						block.ivalExit = m_vecivalStack.back();
+				}
+				Verify(cb == 0);
+			}
+			break;
+		}
+
+		case opcode::br:
+		case opcode::ret:
+		{
+			uint32_t depth = (op == opcode::br) ? uint32_t(safe_read_buffer<varuint32>(&pop, &cb)) : numeric_cast<uint32_t>(m_veclabel.size() - 1);
+			Verify(depth < m_veclabel.size());
+			Label &label = *(m_veclabel.rbegin() + depth);
+			if (FReachable())
+			{
+				BranchTo(label, m_iblockCur);
+				m_vecblock[m_iblockCur].exit = ExitKind::Jump;
+				m_vecblock[m_iblockCur].rgiblockSucc[0] = label.iblockBranch;
+			}
+			StartBlock(NewBlock(true));
+			break;
+		}
+
+		case opcode::br_if:
+		{
+			uint32_t depth = safe_read_buffer<varuint32>(&pop, &cb);
+			Verify(depth < m_veclabel.size());
+			uint32_t ivalCond = Pop();
+			if (FReachable())
+			{
+				Label &label = *(m_veclabel.rbegin() + depth);
+				uint32_t iblockNext = NewBlock(false);
+				Block &block = m_vecblock[m_iblockCur];
+				block.exit = ExitKind::Branch;
+				block.ivalExit = ivalCond;
+				block.rgiblockSucc[0] = label.iblockBranch;
+				block.rgiblockSucc[1] = iblockNext;
+				block.ibBytecodeExit = m_ibBytecodeCur;
+				BranchTo(label, m_iblockCur);
+				AddEdge(m_iblockCur, iblockNext);
+				SealBlock(iblockNext);
+				StartBlock(iblockNext);
+			}
+			break;
+		}
+
+		case opcode::drop:
+			Pop();
+			break;
+
+		case opcode::select:
+		{
+			uint32_t ivalCond = Pop();
+			uint32_t ivalFalse = Pop();
+			uint32_t ivalTrue = Pop();
+			Push(NewOp(opcode::select, m_vecval[ivalTrue].type, ivalTrue, ivalFalse, ivalCond));
+			break;
+		}
+
+		case opcode::get_local:
+		{
+			uint32_t idx = safe_read_buffer<varuint32>(&pop, &cb);
+			Verify(idx < m_vectypeLocal.size());
+			Push(ReadLocal(m_iblockCur, idx));
+			break;
+		}
+		case opcode::set_local:
+		case opcode::tee_local:
+		{
+			uint32_t idx = safe_read_buffer<varuint32>(&pop, &cb);
+			Verify(idx < m_vectypeLocal.size());
+			WriteLocal(m_iblockCur, idx, (op == opcode::set_local) ? Pop() : Top());
+			break;
+		}
+
+		case opcode::get_global:
+		case opcode::set_global:
+		{
+			uint32_t iglbl = safe_read_buffer<varuint32>(&pop, &cb);
+			auto &glbl = pmodule->m_vecglbls.at(iglbl);
+			if (!FIntegerType(glbl.type))
+				return false;
+			if (op == opcode::set_global)
+				NewOp(opcode::set_global, value_type::none, Pop(), ivalNil, ivalNil, iglbl);
+			else if (glbl.fMutable)
+				Push(NewOp(opcode::get_global, glbl.type, ivalNil, ivalNil, ivalNil, iglbl));
+			else
+				Push(NewConst(glbl.type, glbl.val));
+			break;
+		}
+
+		case opcode::i32_load:
+		case opcode::i32_load8_s:
+		case opcode::i32_load8_u:
+		case opcode::i32_load16_s:
+		case opcode::i32_load16_u:
+		case opcode::i64_load:
+		case opcode::i64_load8_s:
+		case opcode::i64_load8_u:
+		case opcode::i64_load16_s:
+		case opcode::i64_load16_u:
+		case opcode::i64_load32_s:
+		case opcode::i64_load32_u:
+		{
+			safe_read_buffer<varuint32>(&pop, &cb);	// alignment hint
+			uint32_t offset = safe_read_buffer<varuint32>(&pop, &cb);
+			value_type type = (op == opcode::i64_load || op >= opcode::i64_load8_s) ? value_type::i64 : value_type::i32;
+			Push(NewOp(op, type, Pop(), ivalNil, ivalNil, offset));
+			break;
+		}
+
+		case opcode::i32_store:
+		case opcode::i64_store:
+		case opcode::i32_store8:
+		case opcode::i32_store16:
+		case opcode::i64_store8:
+		case opcode::i64_store16:
+		case opcode::i64_store32:
+		{
+			safe_read_buffer<varuint32>(&pop, &cb);	// alignment hint
+			uint32_t offset = safe_read_buffer<varuint32>(&pop, &cb);
+			uint32_t ivalStore = Pop();
+			uint32_t ivalAddr = Pop();
+			NewOp(op, value_type::none, ivalAddr, ivalStore, ivalNil, offset);
+			break;
+		}
+
+		case opcode::i32_const:
+			Push(NewConst(value_type::i32, uint32_t(safe_read_buffer<varint32>(&pop, &cb))));
+			break;
+		case opcode::i64_const:
+			Push(NewConst(value_type::i64, uint64_t(int64_t(safe_read_buffer<varint64>(&pop, &cb)))));
+			break;
+
+		case opcode::i32_eqz:
+		case opcode::i64_eqz:
+		case opcode::i32_clz:
+		case opcode::i32_ctz:
+		case opcode::i32_popcnt:
+		case opcode::i64_clz:
+		case opcode::i64_ctz:
+		case opcode::i64_popcnt:
+		case opcode::i32_wrap_i64:
+		case opcode::i64_extend_s_i32:
+		case opcode::i64_extend_u_i32:
+		{
+			value_type type = value_type::i32;
+			if ((op >= opcode::i64_clz && op <= opcode::i64_popcnt) || op == opcode::i64_extend_s_i32 || op == opcode::i64_extend_u_i32)
+				type = value_type::i64;
+			Push(NewOp(op, type, Pop()));
+			break;
+		}
+
+		default:
+			if (FCompareOp(op) || (op >= opcode::i32_add && op <= opcode::i32_rotr) || (op >= opcode::i64_add && op <= opcode::i64_rotr))
+			{
+				value_type type = (op >= opcode::i64_add && op <= opcode::i64_rotr) ? value_type::i64 : value_type::i32;
+				uint32_t ival1 = Pop();
+				uint32_t ival0 = Pop();
+				Push(NewOp(op, type, ival0, ival1));
+				break;
+			}
+			return false;	// floats, calls, br_table and memory size ops stay with the baseline emitter
+		}
+	}
+	Verify(m_veclabel.empty());
+	m_vecivalStack.clear();
+	return true;
+}
+
+// Removes replaced values from the blocks and points every operand at the value that replaced it
+void SsaFunction::ResolveOperands()
+{
+	bool fChanged = true;
+	while (fChanged)
+	{
+		fChanged = false;
+		for (Block &block : m_vecblock)
+		{
+			for (uint32_t ival : block.vecival)
+			{
+				if (m_vecval[ival].kind == ValueKind::Phi && m_vecval[ival].ivalReplace == ivalNil)
+					fChanged |= (TryRemoveTrivialPhi(ival) != ival);
+			}
+		}
+	}
+
+	for (Block &block : m_vecblock)
+	{
+		block.vecival.erase(std::remove_if(block.vecival.begin(), block.vecival.end(), [&](uint32_t ival) { return m_vecval[ival].ivalReplace != ivalNil; }), block.vecival.end());
+		for (uint32_t ival : block.vecival)
+		{
+			Value &val = m_vecval[ival];
+			if (val.kind == ValueKind::Phi)
+			{
+				for (uint32_t &ivalArg : m_vecvecivalPhi[val.rgival[0]])
+					ivalArg = Resolve(ivalArg);
+				continue;
+			}
+			for (uint32_t iarg = 0; iarg < CArgs(val); ++iarg)
+				val.rgival[iarg] = Resolve(val.rgival[iarg]);
+		}
+		if (block.ivalExit != ivalNil)
+			block.ivalExit = Resolve(block.ivalExit);
+	}
+	for (Loop &loop : m_vecloop)
+	{
+		for (uint32_t &ival : loop.vecivalLocal)
+			ival = Resolve(ival);
+		for (auto &pairRecompute : loop.vecpairRecompute)
+		{
+			// a value replaced by another one still computes what that one holds
+			pairRecompute.first = Resolve(pairRecompute.first);
+			Value &valCalc = m_vecval[pairRecompute.second];
+			for (uint32_t iarg = 0; iarg < CArgs(valCalc); ++iarg)
+				valCalc.rgival[iarg] = Resolve(valCalc.rgival[iarg]);
+		}
+		loop.vecpairRecompute.erase(std::remove_if(loop.vecpairRecompute.begin(), loop.vecpairRecompute.end(),
+			[&](const std::pair<uint32_t, uint32_t> &pair) { return m_vecval[pair.first].kind == ValueKind::Const || m_vecval[pair.second].kind != ValueKind::Op; }), loop.vecpairRecompute.end());
+	}
+}
+
+// Folds constant operands and algebraic identities, and branches on constants into jumps
+bool SsaFunction::FFoldConstants()
+{
+	bool fChanged = false;
+	for (uint32_t iblock = 0; iblock < m_vecblock.size(); ++iblock)
+	{
+		for (size_t iival = 0; iival < m_vecblock[iblock].vecival.size(); ++iival)
+		{
+			uint32_t ival = m_vecblock[iblock].vecival[iival];
+			if (m_vecval[ival].ivalReplace != ivalNil)
+				continue;
+			if (m_vecval[ival].kind == ValueKind::Phi)
+			{
+				fChanged |= (TryRemoveTrivialPhi(ival) != ival);
+				continue;
+			}
+			if (m_vecval[ival].kind != ValueKind::Op)
+				continue;
+
+			Value &val = m_vecval[ival];
+			uint32_t cargs = CArgs(val);
+			for (uint32_t iarg = 0; iarg < cargs; ++iarg)
+				val.rgival[iarg] = Resolve(val.rgival[iarg]);
+			const uint32_t ivalA = val.rgival[0];
+			const uint32_t ivalB = val.rgival[1];
+			const bool fConstA = cargs >= 1 && m_vecval[ivalA].kind == ValueKind::Const;
+			const bool fConstB = cargs >= 2 && m_vecval[ivalB].kind == ValueKind::Const;
+			const uint64_t a = fConstA ? uint64_t(m_vecval[ivalA].imm) : 0;
+			const uint64_t b = fConstB ? uint64_t(m_vecval[ivalB].imm) : 0;
+
+			uint64_t res;
+			if ((cargs == 1 && fConstA && val.op != opcode::set_global && !(val.op >= opcode::i32_load && val.op <= opcode::i64_load32_u))
+				|| (cargs == 2 && fConstA && fConstB && !(val.op >= opcode::i32_store && val.op <= opcode::i64_store32)))
+			{
+				if (FFoldOp(val.op, a, b, &res))
+				{
+					Replace(ival, NewConst(val.type, res));
+					fChanged = true;
+				}
+				continue;
+			}
+
+			const bool f64 = (val.type == value_type::i64);
+			const uint64_t mask = f64 ? ~uint64_t(0) : 0xFFFFFFFF;
+			const uint64_t maskShift = f64 ? 63 : 31;
+			uint32_t ivalNew = ivalNil;
+			switch (val.op)
+			{
+			case opcode::i32_add: case opcode::i64_add:
+			case opcode::i32_or: case opcode::i64_or:
+			case opcode::i32_xor: case opcode::i64_xor:
+				if (fConstB && (b & mask) == 0)
+					ivalNew = ivalA;
+				else if (fConstA && (a & mask) == 0)
+					ivalNew = ivalB;
+				else if (ivalA == ivalB && (val.op == opcode::i32_or || val.op == opcode::i64_or))
+					ivalNew = ivalA;
+				else if (ivalA == ivalB && (val.op == opcode::i32_xor || val.op == opcode::i64_xor))
+					ivalNew = NewConst(val.type, 0);
+				break;
+			case opcode::i32_sub: case opcode::i64_sub:
+				if (fConstB && (b & mask) == 0)
+					ivalNew = ivalA;
+				else if (ivalA == ivalB)
+					ivalNew = NewConst(val.type, 0);
+				break;
+			case opcode::i32_shl: case opcode::i64_shl:
+			case opcode::i32_shr_s: case opcode::i64_shr_s:
+			case opcode::i32_shr_u: case opcode::i64_shr_u:
+			case opcode::i32_rotl: case opcode::i64_rotl:
+			case opcode::i32_rotr: case opcode::i64_rotr:
+				if (fConstB && (b & maskShift) == 0)
+					ivalNew = ivalA;
+				break;
+			case opcode::i32_mul: case opcode::i64_mul:
+				if (fConstB && (b & mask) == 1)
+					ivalNew = ivalA;
+				else if (fConstA && (a & mask) == 1)
+					ivalNew = ivalB;
+				else if ((fConstA && (a & mask) == 0) || (fConstB && (b & mask) == 0))
+					ivalNew = NewConst(val.type, 0);
+				break;
+			case opcode::i32_and: case opcode::i64_and:
+				if ((fConstB && (b & mask) == mask) || ivalA == ivalB)
+					ivalNew = ivalA;
+				else if (fConstA && (a & mask) == mask)
+					ivalNew = ivalB;
+				else if ((fConstA && (a & mask) == 0) || (fConstB && (b & mask) == 0))
+					ivalNew = NewConst(val.type, 0);
+				break;
+			case opcode::i32_eq: case opcode::i64_eq:
+			case opcode::i32_le_s: case opcode::i64_le_s:
+			case opcode::i32_le_u: case opcode::i64_le_u:
+			case opcode::i32_ge_s: case opcode::i64_ge_s:
+			case opcode::i32_ge_u: case opcode::i64_ge_u:
+				if (ivalA == ivalB)
+					ivalNew = NewConst(value_type::i32, 1);
+				break;
+			case opcode::i32_ne: case opcode::i64_ne:
+			case opcode::i32_lt_s: case opcode::i64_lt_s:
+			case opcode::i32_lt_u: case opcode::i64_lt_u:
+			case opcode::i32_gt_s: case opcode::i64_gt_s:
+			case opcode::i32_gt_u: case opcode::i64_gt_u:
+				if (ivalA == ivalB)
+					ivalNew = NewConst(value_type::i32, 0);
+				break;
+			case opcode::i64_extend_u_i32:
+				ivalNew = ivalA;	// i32 values are already zero extended
+				break;
+			case opcode::i32_wrap_i64:
+				if (m_vecval[ivalA].kind == ValueKind::Op && (m_vecval[ivalA].op == opcode::i64_extend_s_i32 || m_vecval[ivalA].op == opcode::i64_extend_u_i32))
+					ivalNew = m_vecval[ivalA].rgival[0];
+				else if (m_vecval[ivalA].type == value_type::i32)
+					ivalNew = ivalA;	// an extend_u that was already folded away
+				break;
+			case opcode::select:
+			{
+				uint32_t ivalCond = val.rgival[2];
+				if (m_vecval[ivalCond].kind == ValueKind::Const)
+				{
+					ivalNew = (m_vecval[ivalCond].imm != 0) ? ivalA : ivalB;
+				}
+				else if (ivalA == ivalB)
+				{
+					ivalNew = ivalA;
+				}
+				else if (m_vecval[ivalCond].kind == ValueKind::Op && m_vecval[ivalCond].op == opcode::i32_eqz)
+				{
+					val.rgival[0] = ivalB;
+					val.rgival[1] = ivalA;
+					val.rgival[2] = m_vecval[ivalCond].rgival[0];
+					fChanged = true;
+				}
+				break;
+			}
+			default:
+				break;
+			}
+			if (ivalNew != ivalNil)
+			{
+				Replace(ival, ivalNew);
+				fChanged = true;
+			}
+		}
+
+		Block &block = m_vecblock[iblock];
+		if (block.exit != ExitKind::Branch)
+			continue;
+		block.ivalExit = Resolve(block.ivalExit);
+		const Value &valCond = m_vecval[block.ivalExit];
+		if (valCond.kind == ValueKind::Const)
+		{
+			uint32_t iblockTaken = block.rgiblockSucc[valCond.imm != 0 ? 0 : 1];
+			uint32_t iblockNot = block.rgiblockSucc[valCond.imm != 0 ? 1 : 0];
+			RemoveEdge(iblock, iblockNot);
+			block.exit = ExitKind::Jump;
+			block.ivalExit = ivalNil;
+			block.rgiblockSucc[0] = iblockTaken;
+			block.rgiblockSucc[1] = ivalNil;
+			fChanged = true;
+		}
+		else if (valCond.kind == ValueKind::Op && (valCond.op == opcode::i32_eqz || valCond.op == opcode::i64_eqz))
+		{
+			// Branches test all 64 bits so the operand of either eqz can be tested directly
+			block.ivalExit = Resolve(valCond.rgival[0]);
+			std::swap(block.rgiblockSucc[0], block.rgiblockSucc[1]);
+			fChanged = true;
+		}
+	}
+	return fChanged;
+}
+
+// Cooper, Harvey and Kennedy's "A Simple, Fast Dominance Algorithm"
+void SsaFunction::ComputeDominators(std::vector<uint32_t> *pveciblockIdom, std::vector<uint32_t> *pveciblockRpo) const
+{
+	const uint32_t cblock = numeric_cast<uint32_t>(m_vecblock.size());
+	std::vector<uint32_t> &veciblockRpo = *pveciblockRpo;
+	veciblockRpo.clear();
+	std::vector<bool> vecfVisited(cblock);
+	std::vector<std::pair<uint32_t, uint32_t>> stackpair;	// (block, next successor to visit)
+	stackpair.push_back(std::make_pair(0u, 0u));
+	vecfVisited[0] = true;
+	while (!stackpair.empty())
+	{
+		auto &pair = stackpair.back();
+		const Block &block = m_vecblock[pair.first];
+		if (pair.second < 2 && block.rgiblockSucc[pair.second] != ivalNil && (block.exit == ExitKind::Jump || block.exit == ExitKind::Branch))
+		{
+			uint32_t iblockSucc = block.rgiblockSucc[pair.second++];
+			if (!vecfVisited[iblockSucc])
+			{
+				vecfVisited[iblockSucc] = true;
+				stackpair.push_back(std::make_pair(iblockSucc, 0u));
+			}
+			continue;
+		}
+		veciblockRpo.push_back(pair.first);
+		stackpair.pop_back();
+	}
+	std::reverse(veciblockRpo.begin(), veciblockRpo.end());
+
+	std::vector<uint32_t> vecirpo(cblock, ivalNil);
+	for (uint32_t irpo = 0; irpo < veciblockRpo.size(); ++irpo)
+		vecirpo[veciblockRpo[irpo]] = irpo;
+
+	std::vector<uint32_t> &veciblockIdom = *pveciblockIdom;
+	veciblockIdom.assign(cblock, ivalNil);
+	veciblockIdom[0] = 0;
+	bool fChanged = true;
+	while (fChanged)
+	{
+		fChanged = false;
+		for (uint32_t irpo = 1; irpo < veciblockRpo.size(); ++irpo)
+		{
+			uint32_t iblock = veciblockRpo[irpo];
+			uint32_t iblockIdom = ivalNil;
+			for (uint32_t iblockPred : m_vecblock[iblock].veciblockPred)
+			{
+				if (veciblockIdom[iblockPred] == ivalNil)
+					continue;
+				if (iblockIdom == ivalNil)
+				{
+					iblockIdom = iblockPred;
+					continue;
+				}
+				uint32_t iblockA = iblockPred;
+				while (iblockA != iblockIdom)
+				{
+					while (vecirpo[iblockA] > vecirpo[iblockIdom])
+						iblockA = veciblockIdom[iblockA];
+					while (vecirpo[iblockIdom] > vecirpo[iblockA])
+						iblockIdom = veciblockIdom[iblockIdom];
+				}
+			}
+			if (veciblockIdom[iblock] != iblockIdom)
+			{
+				veciblockIdom[iblock] = iblockIdom;
+				fChanged = true;
+			}
+		}
+	}
+}
+
+// Value numbering over the dominator tree: a pure op with the same operands as one that dominates it is that op
+void SsaFunction::EliminateCommonSubexpressions()
+{
+	std::vector<uint32_t> veciblockIdom, veciblockRpo;
+	ComputeDominators(&veciblockIdom, &veciblockRpo);
+	std::vector<std::vector<uint32_t>> vecveciblockChild(m_vecblock.size());
+	for (uint32_t iblock : veciblockRpo)
+	{
+		if (iblock != 0)
+			vecveciblockChild[veciblockIdom[iblock]].push_back(iblock);
+	}
+
+	// Operands are keyed by value index, or by their value for constants (equal constants are separate values)
+	using Key = std::tuple<opcode, value_type, int64_t, uint8_t, uint64_t, uint64_t, uint64_t>;
+	std::map<Key, uint32_t> mapkeyival;
+	std::vector<std::vector<Key>> vecveckeyScope(m_vecblock.size());
+	std::vector<std::pair<uint32_t, bool>> stackpair;	// (block, leaving)
+	stackpair.push_back(std::make_pair(0u, false));
+	while (!stackpair.empty())
+	{
+		auto pair = stackpair.back();
+		stackpair.pop_back();
+		if (pair.second)
+		{
+			for (const Key &key : vecveckeyScope[pair.first])
+				mapkeyival.erase(key);
+			continue;
+		}
+
+		for (uint32_t ival : m_vecblock[pair.first].vecival)
+		{
+			Value &val = m_vecval[ival];
+			if (val.kind != ValueKind::Op || (!FPure(val) && !FDivOp(val.op)))
+				continue;	// division is fine, if the first one didn't trap neither will the second
+			for (uint32_t iarg = 0; iarg < CArgs(val); ++iarg)
+				val.rgival[iarg] = Resolve(val.rgival[iarg]);
+			std::pair<bool, uint64_t> rgpairKey[3];
+			for (uint32_t iarg = 0; iarg < 3; ++iarg)
+			{
+				uint32_t ivalArg = val.rgival[iarg];
+				if (ivalArg != ivalNil && m_vecval[ivalArg].kind == ValueKind::Const)
+					rgpairKey[iarg] = std::make_pair(true, uint64_t(m_vecval[ivalArg].imm));
+				else
+					rgpairKey[iarg] = std::make_pair(false, uint64_t(ivalArg));
+			}
+			if (FCommutative(val.op) && rgpairKey[1] < rgpairKey[0])
+				std::swap(rgpairKey[0], rgpairKey[1]);
+			uint8_t maskConst = uint8_t(rgpairKey[0].first | (rgpairKey[1].first << 1) | (rgpairKey[2].first << 2));
+			Key key(val.op, val.type, val.imm, maskConst, rgpairKey[0].second, rgpairKey[1].second, rgpairKey[2].second);
+			auto itkey = mapkeyival.find(key);
+			if (itkey != mapkeyival.end())
+			{
+				Replace(ival, itkey->second);
+				continue;
+			}
+			mapkeyival.emplace(key, ival);
+			vecveckeyScope[pair.first].push_back(key);
+		}
+
+		stackpair.push_back(std::make_pair(pair.first, true));
+		for (uint32_t iblockChild : vecveciblockChild[pair.first])
+			stackpair.push_back(std::make_pair(iblockChild, false));
+	}
+}
+
+void SsaFunction::EliminateDeadCode()
+{
+	std::vector<bool> vecfLive(m_vecval.size());
+	std::vector<uint32_t> vecivalWork;
+	auto MarkLive = [&](uint32_t ival)
+	{
+		if (ival != ivalNil && !vecfLive[ival])
+		{
+			vecfLive[ival] = true;
+			vecivalWork.push_back(ival);
+		}
+	};
+
+	for (const Block &block : m_vecblock)
+	{
+		for (uint32_t ival : block.vecival)
+		{
+			const Value &val = m_vecval[ival];
+			if (!FSideEffects(val))
+				continue;
+			if (FDivOp(val.op))
+			{
+				// a constant divisor that can't trap leaves nothing to observe
+				const Value &valDivisor = m_vecval[val.rgival[1]];
+				bool fSigned = val.op == opcode::i32_div_s || val.op == opcode::i64_div_s;
+				uint64_t divisor = uint64_t(valDivisor.imm) & ((val.type == value_type::i64) ? ~uint64_t(0) : 0xFFFFFFFF);
+				uint64_t maskMinusOne = (val.type == value_type::i64) ? ~uint64_t(0) : 0xFFFFFFFF;
+				if (valDivisor.kind == ValueKind::Const && divisor != 0 && !(fSigned && divisor == maskMinusOne))
+					continue;
+			}
+			MarkLive(ival);
+		}
+		if (block.exit == ExitKind::Branch || block.exit == ExitKind::Return)
+			MarkLive(block.ivalExit);
+	}
+	while (!vecivalWork.empty())
+	{
+		const Value &val = m_vecval[vecivalWork.back()];
+		vecivalWork.pop_back();
+		if (val.kind == ValueKind::Phi)
+		{
+			for (uint32_t ivalArg : m_vecvecivalPhi[val.rgival[0]])
+				MarkLive(ivalArg);
+			continue;
+		}
+		for (uint32_t iarg = 0; iarg < CArgs(val); ++iarg)
+			MarkLive(val.rgival[iarg]);
+	}
+
+	for (Block &block : m_vecblock)
+		block.vecival.erase(std::remove_if(block.vecival.begin(), block.vecival.end(), [&](uint32_t ival) { return !vecfLive[ival]; }), block.vecival.end());
+	for (Loop &loop : m_vecloop)
+	{
+		loop.vecpairRecompute.erase(std::remove_if(loop.vecpairRecompute.begin(), loop.vecpairRecompute.end(),
+			[&](const std::pair<uint32_t, uint32_t> &pair) { return !vecfLive[pair.first]; }), loop.vecpairRecompute.end());
+	}
+}
+
+// Drops blocks no longer reachable from the entry and numbers the rest in code layout order
+void SsaFunction::RemoveUnreachableBlocks()
+{
+	const uint32_t cblock = numeric_cast<uint32_t>(m_vecblock.size());
+	std::vector<bool> vecfReachable(cblock);
+	std::vector<uint32_t> veciblockWork;
+	vecfReachable[0] = true;
+	veciblockWork.push_back(0);
+	while (!veciblockWork.empty())
+	{
+		const Block &block = m_vecblock[veciblockWork.back()];
+		veciblockWork.pop_back();
+		if (block.exit != ExitKind::Jump && block.exit != ExitKind::Branch)
+			continue;
+		for (uint32_t isucc = 0; isucc < ((block.exit == ExitKind::Branch) ? 2u : 1u); ++isucc)
+		{
+			if (!vecfReachable[block.rgiblockSucc[isucc]])
+			{
+				vecfReachable[block.rgiblockSucc[isucc]] = true;
+				veciblockWork.push_back(block.rgiblockSucc[isucc]);
+			}
+		}
+	}
+
+	std::vector<uint32_t> veciblockOld;
+	for (uint32_t iblock = 0; iblock < cblock; ++iblock)
+	{
+		if (!vecfReachable[iblock])
+			continue;
+		veciblockOld.push_back(iblock);
+		Block &block = m_vecblock[iblock];
+		for (size_t ipred = block.veciblockPred.size(); ipred-- > 0;)
+		{
+			if (!vecfReachable[block.veciblockPred[ipred]])
+				RemoveEdge(block.veciblockPred[ipred], iblock);
+		}
+	}
+	std::stable_sort(veciblockOld.begin() + 1, veciblockOld.end(), [&](uint32_t iblockA, uint32_t iblockB) { return m_vecblock[iblockA].iorder < m_vecblock[iblockB].iorder; });
+
+	std::vector<uint32_t> veciblockNew(cblock, ivalNil);
+	for (uint32_t iblockNew = 0; iblockNew < veciblockOld.size(); ++iblockNew)
+		veciblockNew[veciblockOld[iblockNew]] = iblockNew;
+
+	std::vector<Block> vecblock;
+	vecblock.reserve(veciblockOld.size());
+	for (uint32_t iblockOld : veciblockOld)
+	{
+		vecblock.push_back(std::move(m_vecblock[iblockOld]));
+		Block &block = vecblock.back();
+		for (uint32_t &iblockPred : block.veciblockPred)
+			iblockPred = veciblockNew[iblockPred];
+		for (uint32_t &iblockSucc : block.rgiblockSucc)
+		{
+			if (iblockSucc != ivalNil)
+				iblockSucc = veciblockNew[iblockSucc];
+		}
+		for (uint32_t ival : block.vecival)
+			m_vecval[ival].iblock = numeric_cast<uint32_t>(vecblock.size() - 1);
+	}
+	m_vecblock = std::move(vecblock);
+
+	m_vecloop.erase(std::remove_if(m_vecloop.begin(), m_vecloop.end(), [&](const Loop &loop) { return veciblockNew[loop.iblockHeader] == ivalNil; }), m_vecloop.end());
+	for (Loop &loop : m_vecloop)
+		loop.iblockHeader = veciblockNew[loop.iblockHeader];
+}
+
+// A branch whose sides are a few side effect free values each (or nothing) meeting again right away becomes straight
+//	line code: both sides are computed and the join's phis pick the results with selects, which lower to cmov.  The
+//	join is then merged into the branch block so the result can be a side of an enclosing diamond further up.
+bool SsaFunction::FIfConvert()
+{
+	bool fChanged = false;
+	for (uint32_t iblock = numeric_cast<uint32_t>(m_vecblock.size()); iblock-- > 0;)
+	{
+		if (m_vecblock[iblock].exit != ExitKind::Branch || m_vecblock[iblock].rgiblockSucc[0] == m_vecblock[iblock].rgiblockSucc[1])
+			continue;
+		// Each side is either an arm block only we jump to, or the edge straight to the join
+		uint32_t rgiblockArm[2] = { ivalNil, ivalNil };
+		uint32_t rgiblockJoin[2];
+		for (uint32_t iside = 0; iside < 2; ++iside)
+		{
+			const uint32_t iblockSucc = m_vecblock[iblock].rgiblockSucc[iside];
+			const Block &blockSucc = m_vecblock[iblockSucc];
+			rgiblockJoin[iside] = iblockSucc;
+			if (blockSucc.exit != ExitKind::Jump || blockSucc.veciblockPred.size() != 1 || blockSucc.vecival.size() > cvalIfConvertMax)
+				continue;
+			bool fArm = true;
+			for (uint32_t ival : blockSucc.vecival)
+				fArm = fArm && m_vecval[ival].kind == ValueKind::Op && !FSideEffects(m_vecval[ival]);
+			if (fArm)
+			{
+				rgiblockArm[iside] = iblockSucc;
+				rgiblockJoin[iside] = blockSucc.rgiblockSucc[0];
+			}
+		}
+		const uint32_t iblockJoin = rgiblockJoin[0];
+		if (iblockJoin != rgiblockJoin[1] || iblockJoin == iblock || m_vecblock[iblockJoin].veciblockPred.size() != 2)
+			continue;
+		uint32_t cphi = 0;
+		for (uint32_t ival : m_vecblock[iblockJoin].vecival)
+		{
+			if (m_vecval[ival].kind == ValueKind::Phi)
+				++cphi;
+		}
+		if (cphi > cvalIfConvertMax)
+			continue;
+
+		// The arms go before the condition if it ends the block, so a lone select can fuse with a compare
+		const uint32_t ivalCond = m_vecblock[iblock].ivalExit;
+		std::vector<uint32_t> vecivalArms;
+		for (uint32_t iblockArm : rgiblockArm)
+		{
+			if (iblockArm == ivalNil)
+				continue;
+			for (uint32_t ival : m_vecblock[iblockArm].vecival)
+			{
+				m_vecval[ival].iblock = iblock;
+				vecivalArms.push_back(ival);
+			}
+			m_vecblock[iblockArm].vecival.clear();
+			m_vecblock[iblockArm].veciblockPred.clear();
+			m_vecblock[iblockArm].exit = ExitKind::Trap;
+		}
+		auto &vecival = m_vecblock[iblock].vecival;
+		auto itivalInsert = vecival.end();
+		if (!vecival.empty() && vecival.back() == ivalCond)
+		{
+			itivalInsert = vecival.end() - 1;
+			for (uint32_t ival : vecivalArms)
+			{
+				const Value &val = m_vecval[ival];
+				if (std::find(val.rgival, val.rgival + CArgs(val), ivalCond) != val.rgival + CArgs(val))
+					itivalInsert = vecival.end();
+			}
+		}
+		vecival.insert(itivalInsert, vecivalArms.begin(), vecivalArms.end());
+
+		const auto &veciblockPredJoin = m_vecblock[iblockJoin].veciblockPred;
+		const uint32_t iblockFromTrue = (rgiblockArm[0] != ivalNil) ? rgiblockArm[0] : iblock;
+		const size_t ipredTrue = std::find(veciblockPredJoin.begin(), veciblockPredJoin.end(), iblockFromTrue) - veciblockPredJoin.begin();
+		Verify(ipredTrue < 2);
+		for (uint32_t ival : m_vecblock[iblockJoin].vecival)
+		{
+			if (m_vecval[ival].kind != ValueKind::Phi)
+				break;
+			const auto &vecivalArg = m_vecvecivalPhi[m_vecval[ival].rgival[0]];
+			const uint32_t ivalTrue = Resolve(vecivalArg[ipredTrue]);
+			const uint32_t ivalFalse = Resolve(vecivalArg[1 - ipredTrue]);
+			if (ivalTrue == ivalFalse)
+			{
+				Replace(ival, ivalTrue);
+				continue;
+			}
+			uint32_t ivalSelect = NewValue(ValueKind::Op, opcode::select, m_vecval[ival].type, m_vecblock[iblock].ibBytecodeExit);
+			m_vecval[ivalSelect].rgival[0] = ivalTrue;
+			m_vecval[ivalSelect].rgival[1] = ivalFalse;
+			m_vecval[ivalSelect].rgival[2] = ivalCond;
+			m_vecval[ivalSelect].iblock = iblock;
+			m_vecblock[iblock].vecival.push_back(ivalSelect);
+			Replace(ival, ivalSelect);
+		}
+
+		// Nothing else reaches the join now, unless it is a loop header OSR can enter it becomes part of this block
+		Block &block = m_vecblock[iblock];
+		Block &blockJoin = m_vecblock[iblockJoin];
+		bool fLoopHeader = std::any_of(m_vecloop.begin(), m_vecloop.end(), [&](const Loop &loop) { return loop.iblockHeader == iblockJoin; });
+		if (fLoopHeader)
+		{
+			block.exit = ExitKind::Jump;
+			block.ivalExit = ivalNil;
+			block.rgiblockSucc[0] = iblockJoin;
+			block.rgiblockSucc[1] = ivalNil;
+			blockJoin.veciblockPred.assign(1, iblock);
+			fChanged = true;
+			continue;
+		}
+		for (uint32_t ival : blockJoin.vecival)
+		{
+			if (m_vecval[ival].kind == ValueKind::Phi)
+				continue;	// all replaced above
+			m_vecval[ival].iblock = iblock;
+			block.vecival.push_back(ival);
+		}
+		block.exit = blockJoin.exit;
+		block.ivalExit = blockJoin.ivalExit;
+		block.ibBytecodeExit = blockJoin.ibBytecodeExit;
+		block.rgiblockSucc[0] = blockJoin.rgiblockSucc[0];
+		block.rgiblockSucc[1] = blockJoin.rgiblockSucc[1];
+		for (uint32_t iblockSucc : block.rgiblockSucc)
+		{
+			if (iblockSucc != ivalNil)
+				std::replace(m_vecblock[iblockSucc].veciblockPred.begin(), m_vecblock[iblockSucc].veciblockPred.end(), iblockJoin, iblock);
+		}
+		blockJoin.vecival.clear();
+		blockJoin.veciblockPred.clear();
+		blockJoin.exit = ExitKind::Trap;
+		blockJoin.ivalExit = ivalNil;
+		blockJoin.rgiblockSucc[0] = blockJoin.rgiblockSucc[1] = ivalNil;
+		fChanged = true;
+	}
+	return fChanged;
+}
+
+bool SsaFunction::FDominates(const std::vector<uint32_t> &veciblockIdom, uint32_t iblockA, uint32_t iblockB)
+{
+	while (iblockB != iblockA && iblockB != 0)
+		iblockB = veciblockIdom[iblockB];
+	return iblockB == iblockA;
+}
+
+// Natural loops from the back edges, outer loops first.  Loops built from wasm bytecode always have a single entry
+//	edge, the block holding the loop opcode jumps to the header.
+void SsaFunction::FindLoops(const std::vector<uint32_t> &veciblockIdom, const std::vector<uint32_t> &veciblockRpo, std::vector<NaturalLoop> *pvecnloop) const
+{
+	for (uint32_t iblockHeader : veciblockRpo)
+	{
+		const Block &blockHeader = m_vecblock[iblockHeader];
+		NaturalLoop nloop;
+		nloop.iblockHeader = iblockHeader;
+		nloop.iblockPreheader = ivalNil;
+		nloop.vecfBlock.assign(m_vecblock.size(), false);
+		nloop.vecfBlock[iblockHeader] = true;
+		std::vector<uint32_t> veciblockWork;
+		for (uint32_t iblockPred : blockHeader.veciblockPred)
+		{
+			if (FDominates(veciblockIdom, iblockHeader, iblockPred))
+			{
+				nloop.veciblockLatch.push_back(iblockPred);
+				veciblockWork.push_back(iblockPred);
+			}
+		}
+		if (nloop.veciblockLatch.empty())
+			continue;
+		while (!veciblockWork.empty())
+		{
+			uint32_t iblock = veciblockWork.back();
+			veciblockWork.pop_back();
+			if (nloop.vecfBlock[iblock])
+				continue;
+			nloop.vecfBlock[iblock] = true;
+			veciblockWork.insert(veciblockWork.end(), m_vecblock[iblock].veciblockPred.begin(), m_vecblock[iblock].veciblockPred.end());
+		}
+
+		bool fSingleEntry = true;
+		for (uint32_t iblockPred : blockHeader.veciblockPred)
+		{
+			if (nloop.vecfBlock[iblockPred])
+				continue;
+			fSingleEntry = fSingleEntry && (nloop.iblockPreheader == ivalNil);
+			nloop.iblockPreheader = iblockPred;
+		}
+		if (!fSingleEntry || nloop.iblockPreheader == ivalNil || m_vecblock[nloop.iblockPreheader].exit != ExitKind::Jump)
+			continue;
+
+		for (uint32_t iblock : veciblockRpo)
+		{
+			if (!nloop.vecfBlock[iblock])
+				continue;
+			nloop.veciblock.push_back(iblock);
+			const Block &block = m_vecblock[iblock];
+			bool fExit = (block.exit == ExitKind::Return || block.exit == ExitKind::Trap);
+			for (uint32_t isucc = 0; isucc < ((block.exit == ExitKind::Branch) ? 2u : ((block.exit == ExitKind::Jump) ? 1u : 0u)); ++isucc)
+				fExit = fExit || !nloop.vecfBlock[block.rgiblockSucc[isucc]];
+			if (fExit)
+				nloop.veciblockExit.push_back(iblock);
+			for (uint32_t ival : block.vecival)
+			{
+				const Value &val = m_vecval[ival];
+				if (val.kind == ValueKind::Op && val.op >= opcode::i32_store && val.op <= opcode::i64_store32)
+					nloop.fStores = true;
+				else if (val.kind == ValueKind::Op && val.op == opcode::set_global)
+					nloop.vecidxGlobalSet.push_back(val.imm);
+			}
+		}
+		RecognizeCountedLoop(&nloop);
+		pvecnloop->push_back(std::move(nloop));
+	}
+}
+
+// A header phi stepped by the same constant on every trip around the loop: init on entry, phi + step on the back edges
+bool SsaFunction::FBasicInduction(const NaturalLoop &nloop, uint32_t ivalPhi, uint32_t *pivalInit, uint32_t *pivalNext, uint64_t *pstep) const
+{
+	const Value &valPhi = m_vecval[ivalPhi];
+	if (valPhi.kind != ValueKind::Phi)
+		return false;
+	const Block &blockHeader = m_vecblock[nloop.iblockHeader];
+	const auto &vecivalArg = m_vecvecivalPhi[valPhi.rgival[0]];
+	uint32_t ivalInit = ivalNil;
+	uint32_t ivalNext = ivalNil;
+	for (size_t ipred = 0; ipred < vecivalArg.size(); ++ipred)
+	{
+		uint32_t ivalArg = Resolve(vecivalArg[ipred]);
+		if (blockHeader.veciblockPred[ipred] == nloop.iblockPreheader)
+			ivalInit = ivalArg;
+		else if (ivalNext == ivalNil || ivalNext == ivalArg)
+			ivalNext = ivalArg;
+		else
+			return false;
+	}
+	if (ivalInit == ivalNil || ivalNext == ivalNil)
+		return false;
+
+	const Value &valNext = m_vecval[ivalNext];
+	if (valNext.kind != ValueKind::Op || valNext.type != valPhi.type)
+		return false;
+	const bool fAdd = (valNext.op == opcode::i32_add || valNext.op == opcode::i64_add);
+	const bool fSub = (valNext.op == opcode::i32_sub || valNext.op == opcode::i64_sub);
+	uint32_t ivalStep;
+	if ((fAdd || fSub) && Resolve(valNext.rgival[0]) == ivalPhi)
+		ivalStep = Resolve(valNext.rgival[1]);
+	else if (fAdd && Resolve(valNext.rgival[1]) == ivalPhi)
+		ivalStep = Resolve(valNext.rgival[0]);
+	else
+		return false;
+	if (m_vecval[ivalStep].kind != ValueKind::Const)
+		return false;
+
+	*pivalInit = ivalInit;
+	*pivalNext = ivalNext;
+	*pstep = fSub ? (0 - uint64_t(m_vecval[ivalStep].imm)) : uint64_t(m_vecval[ivalStep].imm);
+	return true;
+}
+
+// A counted loop leaves only from its header, comparing an induction variable with a bound.  When both the start and
+//	the bound are constants the first test is known and a loop that gets past it runs everything dominating its latches.
+void SsaFunction::RecognizeCountedLoop(NaturalLoop *pnloop) const
+{
+	const Block &blockHeader = m_vecblock[pnloop->iblockHeader];
+	if (pnloop->veciblockExit.size() != 1 || pnloop->veciblockExit.front() != pnloop->iblockHeader || blockHeader.exit != ExitKind::Branch)
+		return;
+	const Value &valCond = m_vecval[Resolve(blockHeader.ivalExit)];
+	if (valCond.kind != ValueKind::Op || !FCompareOp(valCond.op) || CArgs(valCond) != 2 || valCond.iblock != pnloop->iblockHeader)
+		return;
+
+	uint64_t rgval[2];
+	bool fInduction = false;
+	for (uint32_t iarg = 0; iarg < 2; ++iarg)
+	{
+		uint32_t ivalArg = Resolve(valCond.rgival[iarg]);
+		uint32_t ivalInit, ivalNext;
+		uint64_t step;
+		if (m_vecval[ivalArg].kind == ValueKind::Const)
+		{
+			rgval[iarg] = uint64_t(m_vecval[ivalArg].imm);
+		}
+		else if (!fInduction && m_vecval[ivalArg].iblock == pnloop->iblockHeader && FBasicInduction(*pnloop, ivalArg, &ivalInit, &ivalNext, &step)
+			&& m_vecval[ivalInit].kind == ValueKind::Const)
+		{
+			rgval[iarg] = uint64_t(m_vecval[ivalInit].imm);
+			fInduction = true;
+		}
+		else
+		{
+			return;
+		}
+	}
+	uint64_t res;
+	if (fInduction && FFoldOp(valCond.op, rgval[0], rgval[1], &res))
+		pnloop->fCountedEntered = pnloop->vecfBlock[blockHeader.rgiblockSucc[res != 0 ? 0 : 1]];
+}
+
+// Whether a value in iblock is computed on the first trip through the loop whenever the loop is entered, so it can
+//	run in the preheader even if it might trap
+bool SsaFunction::FRunsOnEntry(const NaturalLoop &nloop, const std::vector<uint32_t> &veciblockIdom, uint32_t iblock) const
+{
+	for (uint32_t iblockLatch : nloop.veciblockLatch)
+	{
+		if (!FDominates(veciblockIdom, iblock, iblockLatch))
+			return false;
+	}
+	if (nloop.fCountedEntered)
+		return true;
+	for (uint32_t iblockExit : nloop.veciblockExit)
+	{
+		if (!FDominates(veciblockIdom, iblock, iblockExit))
+			return false;
+	}
+	return true;
+}
+
+// Inserts an op in front of position iival of iblock
+uint32_t SsaFunction::InsertOp(uint32_t iblock, size_t iival, opcode op, value_type type, uint32_t ival0, uint32_t ival1, uint32_t ibBytecode)
+{
+	uint32_t ival = NewValue(ValueKind::Op, op, type, ibBytecode);
+	m_vecval[ival].rgival[0] = ival0;
+	m_vecval[ival].rgival[1] = ival1;
+	m_vecval[ival].iblock = iblock;
+	m_vecblock[iblock].vecival.insert(m_vecblock[iblock].vecival.begin() + iival, ival);
+	return ival;
+}
+
+// Moves values computed from operands defined outside the loop to the end of its preheader.  Pure ops can always go,
+//	global reads unless the loop writes that global, and loads and divisions only when they would have run on the first
+//	trip anyway and the loop has no stores or global writes that a trap in the preheader would skip.  An OSR entry
+//	recomputes them as the preheader never ran.
+void SsaFunction::HoistLoopInvariants(const NaturalLoop &nloop, const std::vector<uint32_t> &veciblockIdom, Loop *ploop)
+{
+	auto FInvariant = [&](uint32_t ival) { return m_vecval[ival].kind == ValueKind::Const || !nloop.vecfBlock[m_vecval[ival].iblock]; };
+	const bool fSideEffects = nloop.fStores || !nloop.vecidxGlobalSet.empty();
+	for (uint32_t iblock : nloop.veciblock)
+	{
+		auto &vecival = m_vecblock[iblock].vecival;
+		for (size_t iival = 0; iival < vecival.size();)
+		{
+			const uint32_t ival = vecival[iival];
+			Value &val = m_vecval[ival];
+			bool fHoist = (val.kind == ValueKind::Op && val.ivalReplace == ivalNil);
+			for (uint32_t iarg = 0; fHoist && iarg < CArgs(val); ++iarg)
+			{
+				val.rgival[iarg] = Resolve(val.rgival[iarg]);
+				fHoist = FInvariant(val.rgival[iarg]);
+			}
+			if (fHoist && !FPure(val))
+			{
+				if (val.op == opcode::get_global)
+					fHoist = std::find(nloop.vecidxGlobalSet.begin(), nloop.vecidxGlobalSet.end(), val.imm) == nloop.vecidxGlobalSet.end();
+				else if ((val.op >= opcode::i32_load && val.op <= opcode::i64_load32_u) || FDivOp(val.op))
+					fHoist = !fSideEffects && FRunsOnEntry(nloop, veciblockIdom, iblock);
+				else
+					fHoist = false;
+			}
+			if (!fHoist)
+			{
+				++iival;
+				continue;
+			}
+			vecival.erase(vecival.begin() + iival);
+			val.iblock = nloop.iblockPreheader;
+			m_vecblock[nloop.iblockPreheader].vecival.push_back(ival);
+			if (ploop != nullptr)
+				ploop->vecpairRecompute.push_back(std::make_pair(ival, ival));
+		}
+	}
+}
+
+// Strength reduction: phi * k for a basic induction variable phi and an invariant k becomes a phi of its own, started at
+//	init * k and stepped by step * k next to the original induction variable's step
+void SsaFunction::ReduceInductionVariables(const NaturalLoop &nloop, Loop *ploop)
+{
+	const uint32_t iblockHeader = nloop.iblockHeader;
+	std::vector<uint32_t> vecivalPhi;
+	for (uint32_t ival : m_vecblock[iblockHeader].vecival)
+	{
+		if (m_vecval[ival].kind == ValueKind::Phi)
+			vecivalPhi.push_back(ival);
+	}
+
+	for (uint32_t ivalPhi : vecivalPhi)
+	{
+		uint32_t ivalInit, ivalNext;
+		uint64_t step;
+		if (m_vecval[ivalPhi].ivalReplace != ivalNil || !FBasicInduction(nloop, ivalPhi, &ivalInit, &ivalNext, &step))
+			continue;
+		const value_type type = m_vecval[ivalPhi].type;
+		const opcode opMul = (type == value_type::i64) ? opcode::i64_mul : opcode::i32_mul;
+		const opcode opAdd = (type == value_type::i64) ? opcode::i64_add : opcode::i32_add;
+
+		for (uint32_t iblock : nloop.veciblock)
+		{
+			for (size_t iival = 0; iival < m_vecblock[iblock].vecival.size(); ++iival)
+			{
+				const uint32_t ival = m_vecblock[iblock].vecival[iival];
+				const Value &val = m_vecval[ival];
+				if (val.kind != ValueKind::Op || val.op != opMul || val.ivalReplace != ivalNil)
+					continue;
+				uint32_t ivalFactor;
+				if (Resolve(val.rgival[0]) == ivalPhi)
+					ivalFactor = Resolve(val.rgival[1]);
+				else if (Resolve(val.rgival[1]) == ivalPhi)
+					ivalFactor = Resolve(val.rgival[0]);
+				else
+					continue;
+				const Value &valFactor = m_vecval[ivalFactor];
+				if (valFactor.kind != ValueKind::Const && nloop.vecfBlock[valFactor.iblock])
+					continue;
+				const uint32_t ibBytecode = val.ibBytecode;
+
+				// The start and step go in the preheader, folded when they are constants
+				auto MulInPreheader = [&](uint32_t ivalA, uint32_t ivalB)
+				{
+					uint64_t res;
+					if (m_vecval[ivalA].kind == ValueKind::Const && m_vecval[ivalB].kind == ValueKind::Const
+						&& FFoldOp(opMul, uint64_t(m_vecval[ivalA].imm), uint64_t(m_vecval[ivalB].imm), &res))
+						return NewConst(type, res);
+					Block &blockPreheader = m_vecblock[nloop.iblockPreheader];
+					uint32_t ivalMul = InsertOp(nloop.iblockPreheader, blockPreheader.vecival.size(), opMul, type, ivalA, ivalB, ibBytecode);
+					if (ploop != nullptr)
+						ploop->vecpairRecompute.push_back(std::make_pair(ivalMul, ivalMul));
+					return ivalMul;
+				};
+				const uint32_t ivalInitReduced = MulInPreheader(ivalInit, ivalFactor);
+				const uint32_t ivalStepReduced = MulInPreheader(ivalFactor, NewConst(type, step));
+
+				m_ibBytecodeCur = m_vecval[ivalPhi].ibBytecode;
+				const uint32_t ivalPhiReduced = NewPhi(iblockHeader, type, ivalNil);
+				const uint32_t iblockNext = m_vecval[ivalNext].iblock;
+				auto &vecivalNextBlock = m_vecblock[iblockNext].vecival;
+				const size_t iivalNext = std::find(vecivalNextBlock.begin(), vecivalNextBlock.end(), ivalNext) - vecivalNextBlock.begin();
+				const uint32_t ivalNextReduced = InsertOp(iblockNext, iivalNext + 1, opAdd, type, ivalPhiReduced, ivalStepReduced, m_vecval[ivalNext].ibBytecode);
+				auto &vecivalArg = m_vecvecivalPhi[m_vecval[ivalPhiReduced].rgival[0]];
+				for (uint32_t iblockPred : m_vecblock[iblockHeader].veciblockPred)
+					vecivalArg.push_back((iblockPred == nloop.iblockPreheader) ? ivalInitReduced : ivalNextReduced);
+
+				if (ploop != nullptr)
+				{
+					// OSR entries start the new phi from the induction variable's current value
+					uint32_t ivalCalc = NewValue(ValueKind::Op, opMul, type, ibBytecode);
+					m_vecval[ivalCalc].rgival[0] = ivalPhi;
+					m_vecval[ivalCalc].rgival[1] = ivalFactor;
+					ploop->vecpairRecompute.push_back(std::make_pair(ivalPhiReduced, ivalCalc));
+				}
+				Replace(ival, ivalPhiReduced);
+				if (iblock == iblockHeader)
+					++iival;	// the new phi went in front of it
+			}
+		}
+	}
+}
+
+// Innermost loops first so their invariants can keep moving out through the loops around them
+void SsaFunction::OptimizeLoops()
+{
+	std::vector<uint32_t> veciblockIdom, veciblockRpo;
+	ComputeDominators(&veciblockIdom, &veciblockRpo);
+	std::vector<NaturalLoop> vecnloop;
+	FindLoops(veciblockIdom, veciblockRpo, &vecnloop);
+	for (size_t inloop = vecnloop.size(); inloop-- > 0;)
+	{
+		const NaturalLoop &nloop = vecnloop[inloop];
+		Loop *ploop = nullptr;
+		for (Loop &loop : m_vecloop)
+		{
+			if (loop.iblockHeader == nloop.iblockHeader)
+				ploop = &loop;
+		}
+		HoistLoopInvariants(nloop, veciblockIdom, ploop);
+		ReduceInductionVariables(nloop, ploop);
+	}
+}
+
+void SsaFunction::Optimize()
+{
+	ResolveOperands();
+	RemoveUnreachableBlocks();
+	for (int ipass = 0; ipass < 4 && FFoldConstants(); ++ipass)
+	{
+		ResolveOperands();
+		RemoveUnreachableBlocks();
+	}
+	ResolveOperands();
+	EliminateCommonSubexpressions();
+	ResolveOperands();
+	if (FFoldConstants())
+	{
+		ResolveOperands();
+		RemoveUnreachableBlocks();
+		ResolveOperands();
+	}
+	if (FIfConvert())
+	{
+		ResolveOperands();
+		RemoveUnreachableBlocks();
+		ResolveOperands();
+	}
+	OptimizeLoops();
+	ResolveOperands();
+	if (FFoldConstants())
+	{
+		ResolveOperands();
+		RemoveUnreachableBlocks();
+		ResolveOperands();
+	}
+	EliminateDeadCode();
+}
+
+void SsaFunction::CountUses()
+{
+	for (Value &val : m_vecval)
+		val.cuse = 0;
+	for (const Block &block : m_vecblock)
+	{
+		for (uint32_t ival : block.vecival)
+		{
+			const Value &val = m_vecval[ival];
+			if (val.kind == ValueKind::Phi)
+			{
+				for (uint32_t ivalArg : m_vecvecivalPhi[val.rgival[0]])
+					++m_vecval[ivalArg].cuse;
+				continue;
+			}
+			for (uint32_t iarg = 0; iarg < CArgs(val); ++iarg)
+				++m_vecval[val.rgival[iarg]].cuse;
+		}
+		if (block.ivalExit != ivalNil)
+			++m_vecval[block.ivalExit].cuse;
+	}
+}
+
+// Linear scan over the blocks in layout order with one interval per value covering every position it is live at.
+//	Values that lose out are spilled to a slot of their own for their whole life.
+bool SsaFunction::FAllocateRegisters()
+{
+	CountUses();
+	const uint32_t cval = numeric_cast<uint32_t>(m_vecval.size());
+	const size_t cword = (cval + 63) / 64;
+	if (cword * m_vecblock.size() > (size_t(1) << 20))
+		return false;
+
+	// A compare feeding only the branch or select right after it never needs to be materialized.  One an OSR entry
+	//	recomputes has to be, the copy of its select can't count on the compare's operands being live there.
+	auto FFusable = [&](uint32_t ival)
+	{
+		const Value &val = m_vecval[ival];
+		if (val.kind != ValueKind::Op || !FCompareOp(val.op) || val.cuse != 1)
+			return false;
+		for (const Loop &loop : m_vecloop)
+		{
+			for (const auto &pairRecompute : loop.vecpairRecompute)
+			{
+				if (pairRecompute.first == ival)
+					return false;
+			}
+		}
+		return true;
+	};
+	for (Block &block : m_vecblock)
+	{
+		for (size_t iival = 1; iival < block.vecival.size(); ++iival)
+		{
+			const Value &val = m_vecval[block.vecival[iival]];
+			if (val.kind == ValueKind::Op && val.op == opcode::select && val.rgival[2] == block.vecival[iival - 1] && FFusable(val.rgival[2]))
+				m_vecval[val.rgival[2]].fFused = true;
+		}
+		if (block.exit != ExitKind::Branch || block.vecival.empty() || block.vecival.back() != block.ivalExit)
+			continue;
+		if (FFusable(block.ivalExit))
+			m_vecval[block.ivalExit].fFused = true;
+	}
+
+	std::vector<uint32_t> vecpos(cval, 0);
+	uint32_t pos = 0;
+	for (Block &block : m_vecblock)
+	{
+		block.posStart = pos++;
+		for (uint32_t ival : block.vecival)
+			vecpos[ival] = (m_vecval[ival].kind == ValueKind::Phi) ? block.posStart : pos++;
+		block.posEnd = pos++;
+	}
+
+	auto FTracked = [&](uint32_t ival) { return ival != ivalNil && m_vecval[ival].kind != ValueKind::Const; };
+	auto LiveOut = [&](uint32_t iblock, std::vector<uint64_t> *pvecbit)
+	{
+		pvecbit->assign(cword, 0);
+		const Block &block = m_vecblock[iblock];
+		if (block.exit != ExitKind::Jump && block.exit != ExitKind::Branch)
+			return;
+		for (uint32_t isucc = 0; isucc < ((block.exit == ExitKind::Branch) ? 2u : 1u); ++isucc)
+		{
+			const Block &blockSucc = m_vecblock[block.rgiblockSucc[isucc]];
+			if (!blockSucc.vecbitLiveIn.empty())
+			{
+				for (size_t iword = 0; iword < cword; ++iword)
+					(*pvecbit)[iword] |= blockSucc.vecbitLiveIn[iword];
+			}
+			size_t ipred = std::find(blockSucc.veciblockPred.begin(), blockSucc.veciblockPred.end(), iblock) - blockSucc.veciblockPred.begin();
+			for (uint32_t ival : blockSucc.vecival)
+			{
+				if (m_vecval[ival].kind != ValueKind::Phi)
+					break;
+				uint32_t ivalArg = m_vecvecivalPhi[m_vecval[ival].rgival[0]][ipred];
+				if (FTracked(ivalArg))
+					(*pvecbit)[ivalArg / 64] |= uint64_t(1) << (ivalArg % 64);
+			}
+		}
+	};
+
+	std::vector<uint64_t> vecbit;
+	bool fChanged = true;
+	while (fChanged)
+	{
+		fChanged = false;
+		for (uint32_t iblock = numeric_cast<uint32_t>(m_vecblock.size()); iblock-- > 0;)
+		{
+			LiveOut(iblock, &vecbit);
+			const Block &block = m_vecblock[iblock];
+			if (block.exit == ExitKind::Branch || block.exit == ExitKind::Return)
+			{
+				if (FTracked(block.ivalExit))
+					vecbit[block.ivalExit / 64] |= uint64_t(1) << (block.ivalExit % 64);
+			}
+			for (size_t iival = block.vecival.size(); iival-- > 0;)
+			{
+				uint32_t ival = block.vecival[iival];
+				const Value &val = m_vecval[ival];
+				vecbit[ival / 64] &= ~(uint64_t(1) << (ival % 64));
+				if (val.kind == ValueKind::Phi)
+					continue;
+				for (uint32_t iarg = 0; iarg < CArgs(val); ++iarg)
+				{
+					if (FTracked(val.rgival[iarg]))
+						vecbit[val.rgival[iarg] / 64] |= uint64_t(1) << (val.rgival[iarg] % 64);
+				}
+			}
+			if (vecbit != block.vecbitLiveIn)
+			{
+				m_vecblock[iblock].vecbitLiveIn = vecbit;
+				fChanged = true;
+			}
+		}
+	}
+
+	std::vector<uint32_t> vecposStart(cval, UINT32_MAX);
+	std::vector<uint32_t> vecposEnd(cval, 0);
+	auto Extend = [&](uint32_t ival, uint32_t posT)
+	{
+		if (!FTracked(ival))
+			return;
+		vecposStart[ival] = std::min(vecposStart[ival], posT);
+		vecposEnd[ival] = std::max(vecposEnd[ival], posT);
+	};
+	auto ForEachBit = [&](const std::vector<uint64_t> &vecbitT, uint32_t posT)
+	{
+		for (size_t iword = 0; iword < vecbitT.size(); ++iword)
+		{
+			for (uint64_t word = vecbitT[iword]; word != 0; word &= word - 1)
+			{
+				uint32_t ibit = 0;
+				while (!((word >> ibit) & 1))
+					++ibit;
+				Extend(numeric_cast<uint32_t>(iword * 64 + ibit), posT);
+			}
+		}
+	};
+	for (uint32_t iblock = 0; iblock < m_vecblock.size(); ++iblock)
+	{
+		const Block &block = m_vecblock[iblock];
+		if (!block.vecbitLiveIn.empty())
+			ForEachBit(block.vecbitLiveIn, block.posStart);
+		LiveOut(iblock, &vecbit);
+		ForEachBit(vecbit, block.posEnd);
+		for (uint32_t ival : block.vecival)
+		{
+			const Value &val = m_vecval[ival];
+			if (val.type != value_type::none)
+				Extend(ival, vecpos[ival]);
+			if (val.kind == ValueKind::Phi)
+			{
+				const auto &vecivalArg = m_vecvecivalPhi[val.rgival[0]];
+				for (size_t ipred = 0; ipred < vecivalArg.size(); ++ipred)
+				{
+					// the phi is written by the moves at the end of each predecessor
+					Extend(vecivalArg[ipred], m_vecblock[block.veciblockPred[ipred]].posEnd);
+					Extend(ival, m_vecblock[block.veciblockPred[ipred]].posEnd);
+				}
+				continue;
+			}
+			// a fused compare reads its operands at the branch ending the block or at the select right after it
+			uint32_t posUse = vecpos[ival];
+			if (val.fFused)
+				posUse = (block.exit == ExitKind::Branch && block.ivalExit == ival) ? block.posEnd : vecpos[ival] + 1;
+			for (uint32_t iarg = 0; iarg < CArgs(val); ++iarg)
+				Extend(val.rgival[iarg], posUse);
+		}
+		if (block.exit == ExitKind::Branch || block.exit == ExitKind::Return)
+			Extend(block.ivalExit, block.posEnd);
+	}
+
+	std::vector<uint32_t> vecivalOrder;
+	for (const Block &block : m_vecblock)
+	{
+		for (uint32_t ival : block.vecival)
+		{
+			if (m_vecval[ival].type != value_type::none && !m_vecval[ival].fFused)
+				vecivalOrder.push_back(ival);
+		}
+	}
+	std::sort(vecivalOrder.begin(), vecivalOrder.end(), [&](uint32_t ivalA, uint32_t ivalB) { return std::make_pair(vecposStart[ivalA], ivalA) < std::make_pair(vecposStart[ivalB], ivalB); });
+
+	std::vector<uint32_t> vecivalActive;
+	uint32_t maskFree = (1u << cregAllocatable) - 1;
+	for (uint32_t ival : vecivalOrder)
+	{
+		for (size_t iactive = vecivalActive.size(); iactive-- > 0;)
+		{
+			if (vecposEnd[vecivalActive[iactive]] < vecposStart[ival])
+			{
+				maskFree |= 1u << m_vecval[vecivalActive[iactive]].ireg;
+				vecivalActive.erase(vecivalActive.begin() + iactive);
+			}
+		}
+		if (maskFree != 0)
+		{
+			int8_t ireg = 0;
+			while (!((maskFree >> ireg) & 1))
+				++ireg;
+			maskFree &= ~(1u << ireg);
+			m_vecval[ival].ireg = ireg;
+			vecivalActive.push_back(ival);
+			continue;
+		}
+		size_t iactiveSpill = 0;
+		for (size_t iactive = 1; iactive < vecivalActive.size(); ++iactive)
+		{
+			if (vecposEnd[vecivalActive[iactive]] > vecposEnd[vecivalActive[iactiveSpill]])
+				iactiveSpill = iactive;
+		}
+		uint32_t ivalSpill = vecivalActive[iactiveSpill];
+		if (vecposEnd[ivalSpill] > vecposEnd[ival])
+		{
+			m_vecval[ival].ireg = m_vecval[ivalSpill].ireg;
+			m_vecval[ivalSpill].ireg = -1;
+			m_vecval[ivalSpill].islot = m_cslot++;
+			vecivalActive[iactiveSpill] = ival;
+		}
+		else
+		{
+			m_vecval[ival].islot = m_cslot++;
+		}
+	}
+
+	// Loops can be entered from baseline code when everything live at their head is in a local or can be recomputed
+	//	from locals.  The recomputations run first, reading locals straight from the locals array.
+	for (Loop &loop : m_vecloop)
+	{
+		const Block &blockHeader = m_vecblock[loop.iblockHeader];
+		std::vector<uint32_t> vecivalLive;
+		for (uint32_t ival : blockHeader.vecival)
+		{
+			if (m_vecval[ival].kind == ValueKind::Phi)
+				vecivalLive.push_back(ival);
+		}
+		for (size_t iword = 0; iword < blockHeader.vecbitLiveIn.size(); ++iword)
+		{
+			for (uint32_t ibit = 0; ibit < 64; ++ibit)
+			{
+				if ((blockHeader.vecbitLiveIn[iword] >> ibit) & 1)
+					vecivalLive.push_back(numeric_cast<uint32_t>(iword * 64 + ibit));
+			}
+		}
+		loop.fOsr = true;
+		std::vector<uint32_t> vecivalRecomputed;
+		for (auto &pairRecompute : loop.vecpairRecompute)
+		{
+			const uint32_t ivalCalc = pairRecompute.second;
+			uint32_t ivalCopy = NewValue(ValueKind::Op, m_vecval[ivalCalc].op, m_vecval[ivalCalc].type, m_vecval[ivalCalc].ibBytecode);
+			m_vecval[ivalCopy].imm = m_vecval[ivalCalc].imm;
+			m_vecval[ivalCopy].ireg = m_vecval[pairRecompute.first].ireg;
+			m_vecval[ivalCopy].islot = m_vecval[pairRecompute.first].islot;
+			for (uint32_t iarg = 0; iarg < CArgs(m_vecval[ivalCalc]); ++iarg)
+			{
+				uint32_t ivalArg = m_vecval[ivalCalc].rgival[iarg];
+				auto itival = std::find(loop.vecivalLocal.begin(), loop.vecivalLocal.end(), ivalArg);
+				if (m_vecval[ivalArg].kind != ValueKind::Const && std::find(vecivalRecomputed.begin(), vecivalRecomputed.end(), ivalArg) == vecivalRecomputed.end())
+				{
+					if (itival == loop.vecivalLocal.end())
+					{
+						loop.fOsr = false;
+						break;
+					}
+					// a parameter outside of any block is the local in the locals array
+					uint32_t idx = numeric_cast<uint32_t>(itival - loop.vecivalLocal.begin());
+					ivalArg = NewValue(ValueKind::Param, opcode::get_local, m_vectypeLocal[idx], m_vecval[ivalCalc].ibBytecode);
+					m_vecval[ivalArg].imm = idx;
+				}
+				m_vecval[ivalCopy].rgival[iarg] = ivalArg;
+			}
+			if (!loop.fOsr)
+				break;
+			loop.vecivalRecompute.push_back(ivalCopy);
+			vecivalRecomputed.push_back(pairRecompute.first);
+		}
+		for (uint32_t ival : vecivalLive)
+		{
+			if (!loop.fOsr)
+				break;
+			auto itival = std::find(loop.vecivalLocal.begin(), loop.vecivalLocal.end(), ival);
+			if (itival != loop.vecivalLocal.end())
+				loop.vecpairValueLocal.push_back(std::make_pair(ival, numeric_cast<uint32_t>(itival - loop.vecivalLocal.begin())));
+			else if (std::find(vecivalRecomputed.begin(), vecivalRecomputed.end(), ival) == vecivalRecomputed.end())
+				loop.fOsr = false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "wasm_types.h"
+
+// A function body in static single assignment form, built for the optimizing tier.  Locals and operand stack slots
+//	become values, structured control flow becomes basic blocks and phis, and after a few cleanup and loop passes every
+//	value is given a register or a spill slot.  JitWriter lowers the result to x86 (see JitWriter::FCompileFnSsa).
+//
+//	Only integer code is handled: functions with floats, calls, br_table or memory size ops make FBuild return false
+//	and stay with the stack machine emitter.
+class SsaFunction
+{
+	friend class JitWriter;
+public:
+	SsaFunction() = default;
+
+	bool FBuild(class WasmModule *pmodule, uint32_t ifn);
+	void Optimize();
+	bool FAllocateRegisters();
+
+	static const uint32_t ivalNil = 0xFFFFFFFF;
+	static const uint32_t cregAllocatable = 8;	// JitWriter maps register n to r8 + n
+	static const uint32_t cvalIfConvertMax = 4;	// values per arm and selects per join for FIfConvert
+
+private:
+	enum class ValueKind : uint8_t
+	{
+		Op,			// computed by the wasm opcode op from rgival
+		Const,		// imm (i32 constants are kept zero extended like i32 values in registers)
+		Param,		// parameter imm as found in the locals array on entry
+		Phi,		// one operand per predecessor of the block, see m_vecvecivalPhi
+	};
+
+	struct Value
+	{
+		ValueKind kind;
+		opcode op;
+		value_type type;			// i32 or i64, none for stores and set_global
+		uint32_t rgival[3];			// operands, a phi keeps the index of its operand list in rgival[0]
+		int64_t imm;				// constant, parameter or global index, memory offset
+		uint32_t ibBytecode;
+		uint32_t iblock;
+		uint32_t ivalReplace;		// set once the value has been replaced by another one (trivial phis, folding, CSE)
+		uint32_t idxLocal;			// phis built for a local, ivalNil for block results
+		uint32_t cuse;
+		// Assigned by FAllocateRegisters
+		int8_t ireg;				// -1 when the value lives in a spill slot or needs no location
+		uint32_t islot;
+		bool fFused;				// a compare only used by the branch ending its block or the select after it, emitted as cmp/jcc or cmp/cmovcc
+	};
+
+	enum class ExitKind : uint8_t
+	{
+		Jump,		// to rgiblockSucc[0]
+		Branch,		// to rgiblockSucc[0] if ivalExit is non zero, else to rgiblockSucc[1]
+		Return,		// ivalExit (ivalNil for void functions)
+		Trap,
+	};
+
+	struct Block
+	{
+		std::vector<uint32_t> vecival;			// phis first, then in execution order
+		std::vector<uint32_t> veciblockPred;	// phi operands are in the same order
+		ExitKind exit = ExitKind::Trap;
+		uint32_t ivalExit = ivalNil;
+		uint32_t rgiblockSucc[2] = { ivalNil, ivalNil };
+		uint32_t ibBytecodeExit = 0;
+		uint32_t iorder = ivalNil;				// when the block started being filled, this is the code layout order
+
+		// Construction state (Braun et al, "Simple and Efficient Construction of Static Single Assignment Form")
+		bool fSealed = false;					// all predecessors are known
+		std::vector<uint32_t> vecivalLocal;		// the current value of each local
+		std::vector<std::pair<uint32_t, uint32_t>> vecpairIncompletePhi;	// (local, phi) read before sealing
+
+		// Assigned by FAllocateRegisters
+		uint32_t posStart = 0;
+		uint32_t posEnd = 0;
+		std::vector<uint64_t> vecbitLiveIn;
+	};
+
+	// A loop that baseline code for the function can be running when it tiers up.  The optimized code can be entered
+	//	at its head when every value live there is the current value of some local.
+	struct Loop
+	{
+		uint32_t ibLoop;
+		uint32_t iblockHeader;
+		std::vector<uint32_t> vecivalLocal;
+		// (value, how to compute it) for values the loop passes made live at the head, in program order
+		std::vector<std::pair<uint32_t, uint32_t>> vecpairRecompute;
+		// Filled in by FAllocateRegisters
+		std::vector<std::pair<uint32_t, uint32_t>> vecpairValueLocal;
+		std::vector<uint32_t> vecivalRecompute;		// copies of the computations targeting their values' locations
+		bool fOsr = false;
+	};
+
+	// A loop found from the control flow graph for the loop passes
+	struct NaturalLoop
+	{
+		uint32_t iblockHeader;
+		uint32_t iblockPreheader;				// the only block outside the loop jumping to the header
+		std::vector<bool> vecfBlock;			// indexed by block
+		std::vector<uint32_t> veciblock;		// in reverse postorder
+		std::vector<uint32_t> veciblockLatch;	// blocks jumping back to the header
+		std::vector<uint32_t> veciblockExit;	// blocks leaving the loop, including by return or trap
+		std::vector<int64_t> vecidxGlobalSet;
+		bool fStores = false;
+		bool fCountedEntered = false;			// a counted loop whose first test is known to enter the body
+	};
+
+	// Control flow constructs still open while building, the function body is the outermost block
+	struct Label
+	{
+		opcode op;					// block, loop or IF
+		value_type type;
+		uint32_t iblockBranch;		// the block a branch to this label goes to (the header for loops)
+		uint32_t iblockElse;		// IF blocks until their ELSE is seen
+		size_t cvalStack;			// operand stack height on entry
+		std::vector<uint32_t> vecivalResult;	// result value carried by each edge into iblockBranch
+	};
+
+	uint32_t NewValue(ValueKind kind, opcode op, value_type type, uint32_t ibBytecode);
+	uint32_t NewConst(value_type type, uint64_t val);
+	uint32_t NewOp(opcode op, value_type type, uint32_t ival0 = ivalNil, uint32_t ival1 = ivalNil, uint32_t ival2 = ivalNil, int64_t imm = 0);
+	uint32_t NewPhi(uint32_t iblock, value_type type, uint32_t idxLocal);
+	uint32_t NewBlock(bool fSealed);
+	void StartBlock(uint32_t iblock);
+	void AddEdge(uint32_t iblockFrom, uint32_t iblockTo);
+	void RemoveEdge(uint32_t iblockFrom, uint32_t iblockTo);
+	void BranchTo(Label &label, uint32_t iblockFrom);
+	bool FReachable() const;
+
+	uint32_t ReadLocal(uint32_t iblock, uint32_t idx);
+	void WriteLocal(uint32_t iblock, uint32_t idx, uint32_t ival);
+	void AddPhiOperands(uint32_t ivalPhi, uint32_t idx);
+	uint32_t TryRemoveTrivialPhi(uint32_t ivalPhi);
+	void SealBlock(uint32_t iblock);
+	uint32_t Resolve(uint32_t ival) const;
+	void Replace(uint32_t ival, uint32_t ivalNew);
+
+	uint32_t Pop();
+	uint32_t Top() const;
+	void Push(uint32_t ival);
+
+	static uint32_t CArgs(const Value &val);
+	static bool FPure(const Value &val);
+	static bool FSideEffects(const Value &val);
+	static bool FCommutative(opcode op);
+	static bool FFoldOp(opcode op, uint64_t a, uint64_t b, uint64_t *pres);
+
+	void ResolveOperands();
+	bool FFoldConstants();
+	void EliminateCommonSubexpressions();
+	void EliminateDeadCode();
+	void RemoveUnreachableBlocks();
+	bool FIfConvert();
+	void OptimizeLoops();
+	void FindLoops(const std::vector<uint32_t> &veciblockIdom, const std::vector<uint32_t> &veciblockRpo, std::vector<NaturalLoop> *pvecnloop) const;
+	bool FBasicInduction(const NaturalLoop &nloop, uint32_t ivalPhi, uint32_t *pivalInit, uint32_t *pivalNext, uint64_t *pstep) const;
+	void RecognizeCountedLoop(NaturalLoop *pnloop) const;
+	bool FRunsOnEntry(const NaturalLoop &nloop, const std::vector<uint32_t> &veciblockIdom, uint32_t iblock) const;
+	void HoistLoopInvariants(const NaturalLoop &nloop, const std::vector<uint32_t> &veciblockIdom, Loop *ploop);
+	void ReduceInductionVariables(const NaturalLoop &nloop, Loop *ploop);
+	uint32_t InsertOp(uint32_t iblock, size_t iival, opcode op, value_type type, uint32_t ival0, uint32_t ival1, uint32_t ibBytecode);
+	void ComputeDominators(std::vector<uint32_t> *pveciblockIdom, std::vector<uint32_t> *pveciblockRpo) const;
+	void CountUses();
+	static bool FDominates(const std::vector<uint32_t> &veciblockIdom, uint32_t iblockA, uint32_t iblockB);
+	bool FLive(const std::vector<uint64_t> &vecbit, uint32_t ival) const { return (vecbit[ival / 64] >> (ival % 64)) & 1; }
+
+	std::vector<Value> m_vecval;
+	std::vector<Block> m_vecblock;
+	std::vector<std::vector<uint32_t>> m_vecvecivalPhi;
+	std::vector<Loop> m_vecloop;
+	std::vector<value_type> m_vectypeLocal;
+	uint32_t m_cparams = 0;
+	value_type m_typeReturn = value_type::none;
+	uint32_t m_cslot = 0;
+
+	// Build state
+	class WasmModule *m_pmodule = nullptr;
+	uint32_t m_iblockCur = 0;
+	uint32_t m_ibBytecodeCur = 0;
+	uint32_t m_iorderNext = 0;
+	std::vector<uint32_t> m_vecivalStack;
+	std::vector<Label> m_veclabel;
+};
@@ -2,58 +2,57 @@
 #include "wasm_types.h"
 #include "ExpressionService.h"
 
+namespace layer
+{
+	class AllocatedPageBlock;
+}
+
+extern "C" bool CompileFn(struct ExecutionControlBlock *pectl, uint32_t ifn);
 class WasmContext
 {
 	friend class JitWriter;
+	friend bool CompileFn(ExecutionControlBlock *pectl, uint32_t ifn);
 
 public:
 	EXPORT WasmContext();
 	EXPORT ~WasmContext();
 
 	EXPORT ExpressionService::Variant CallFunction(const char *szName, ExpressionService::Variant *rgargs = nullptr, uint32_t cargs = 0);
-	EXPORT void LoadModule(FILE *pfModule);
+	// With cthreadCompile > 0 every function is compiled up front on that many threads, otherwise on first call
+	EXPORT void LoadModule(FILE *pfModule, uint32_t cthreadCompile = 0);
+	// Another instance of the module ctxtLoaded has loaded, with memory and globals of its own but sharing the module and
+	//	its compiled code, which live as long as any instance does.  Each instance can run on a thread of its own, but
+	//	one instance only runs on one thread at a time.
+	EXPORT void LoadModule(const WasmContext &ctxtLoaded);
+
+	// Compiled code is saved in szDir and reused by later runs that load the same module, set it before LoadModule.
+	//	SaveCodeCache writes out what this run compiled (nothing if it all came from the cache).
+	EXPORT void SetCodeCacheDirectory(const char *szDir);
+	EXPORT void SaveCodeCache();
+
+	// Round through the x87 helpers even on CPUs with SSE4.1 so that path can be tested, set it before LoadModule
+	EXPORT void DisableSSE41();
+
+	// Functions are recompiled by the optimizing tier once their calls and loop iterations reach ccountTierUp (0 optimizes
+	//	them on their first call), set it before LoadModule
+	EXPORT void SetTierUpThreshold(uint32_t ccountTierUp);
 
 protected:
-	// File Load Helpers
-	void load_fn_type(const uint8_t **prgbPayload, size_t *pcbData);
-	void load_fn_types(const uint8_t *rgbPayload, size_t cbData);
-	void load_fn_decls(const uint8_t *rgbPayload, size_t cbData);
-	void load_tables(const uint8_t *rgbPayload, size_t cbData);
-	void load_memory(const uint8_t *rgbPayload, size_t cbData);
-	void load_globals(const uint8_t *rgbPayload, size_t cbData);
-	void load_exports(const uint8_t *rgbPayload, size_t cbData);
-	void load_code(const uint8_t *rgbPayload, size_t cbData);
-	void load_imports(const uint8_t *rgbPayload, size_t cbData);
-	void load_elements(const uint8_t *rgbPayload, size_t cbData);
-	void load_data(const uint8_t *rgbPayload, size_t cbData);
-	void load_start(const uint8_t *rgbPayload, size_t cbData);
-	bool load_section(FILE *pf);
-
-	void InitializeMemory();
-	void LinkImports();
-
-	uint32_t ITypeCanonicalFromIType(uint32_t idx);
-
-	struct GlobalVar
-	{
-		uint64_t val;
-		value_type type;
-		bool fMutable;
-	};
-	std::vector<GlobalVar> m_vecglbls;
-	std::vector<FunctionTypeEntry::unique_pfne_ptr> m_vecfn_types;
-	std::vector<uint32_t> m_vecfn_entries;
-	std::vector<table_type> m_vectbl;
-	std::vector<resizable_limits> m_vecmem_types;
-	std::vector<int> m_vecimports;
-	std::vector<uint32_t> m_vecIndirectFnTable;
-	std::vector<std::string> m_vecimportFnNames;
-	std::vector<export_entry> m_vecexports;
-	std::vector<FunctionCodeEntry::unique_pfne_ptr> m_vecfn_code;
-	std::vector<uint8_t> m_vecmem;
-
-	bool m_fStartFn = false;
-	uint32_t m_ifnStart = 0;
-
-	std::unique_ptr<class JitWriter> m_spjitwriter;
+	void InitializeInstance();
+
+	bool m_fAllowSSE41 = true;
+	int32_t m_cTierUpThreshold;
+	std::string m_strCodeCacheDir;
+
+	std::shared_ptr<class WasmModule> m_spmodule;
+
+	// What this instance of the module has to itself, the jitted code finds it through the ExecutionControlBlock
+	std::vector<uint64_t> m_vecectlGlobals;		// the ExecutionControlBlock followed by the values of the globals
+	std::vector<uint64_t> m_vecoperand;
+	std::vector<uint64_t> m_veclocals;
+	void *m_pheap = nullptr;
+	uint64_t m_cbHeap = 0;
+	std::unique_ptr<layer::AllocatedPageBlock> m_spapbHeap;
+	// Why the last lazy compile from jitted code failed, until ExternCallFn rethrows it
+	std::exception_ptr m_exptrCompile;
 };
@@ -0,0 +1,70 @@
+#pragma once
+#include "wasm_types.h"
+#include "ExpressionService.h"
+
+// A loaded module and the code compiled for it, shared by every instance (WasmContext) of the module.  Nothing here
+//	changes once loaded apart from the JitWriter compiling more of the module, instances keep a reference to it so it
+//	lives as long as the last of them.
+class WasmModule
+{
+	friend class WasmContext;
+	friend class JitWriter;
+	friend class SsaFunction;
+
+public:
+	WasmModule();
+	~WasmModule();
+
+	// With cthreadCompile > 0 every function is compiled up front on that many threads, otherwise on first call.  Code
+	//	saved in strCodeCacheDir for the same module is used instead of compiling it again (unless it is empty).
+	void Load(FILE *pfModule, uint32_t cthreadCompile, bool fAllowSSE41, int32_t cTierUpThreshold, const std::string &strCodeCacheDir);
+	void SaveCodeCache();
+
+protected:
+	// File Load Helpers
+	void load_fn_type(const uint8_t **prgbPayload, size_t *pcbData);
+	void load_fn_types(const uint8_t *rgbPayload, size_t cbData);
+	void load_fn_decls(const uint8_t *rgbPayload, size_t cbData);
+	void load_tables(const uint8_t *rgbPayload, size_t cbData);
+	void load_memory(const uint8_t *rgbPayload, size_t cbData);
+	void load_globals(const uint8_t *rgbPayload, size_t cbData);
+	void load_exports(const uint8_t *rgbPayload, size_t cbData);
+	void load_code(const uint8_t *rgbPayload, size_t cbData);
+	void load_imports(const uint8_t *rgbPayload, size_t cbData);
+	void load_elements(const uint8_t *rgbPayload, size_t cbData);
+	void load_data(const uint8_t *rgbPayload, size_t cbData);
+	void load_start(const uint8_t *rgbPayload, size_t cbData);
+	bool load_section(FILE *pf);
+
+	void InitializeMemory();
+	void LinkImports();
+	std::string StrCodeCachePath() const;
+
+	uint32_t ITypeCanonicalFromIType(uint32_t idx);
+
+	struct GlobalVar
+	{
+		uint64_t val;	// the initial value, each instance has its own copy
+		value_type type;
+		bool fMutable;
+	};
+	std::vector<GlobalVar> m_vecglbls;
+	std::vector<FunctionTypeEntry::unique_pfne_ptr> m_vecfn_types;
+	std::vector<uint32_t> m_vecfn_entries;
+	std::vector<table_type> m_vectbl;
+	std::vector<resizable_limits> m_vecmem_types;
+	std::vector<int> m_vecimports;
+	std::vector<uint32_t> m_vecIndirectFnTable;
+	std::vector<std::string> m_vecimportFnNames;
+	std::vector<export_entry> m_vecexports;
+	std::vector<FunctionCodeEntry::unique_pfne_ptr> m_vecfn_code;
+	std::vector<uint8_t> m_vecmem;	// the memory an instance starts out with
+
+	bool m_fStartFn = false;
+	uint32_t m_ifnStart = 0;
+
+	std::string m_strCodeCacheDir;
+	uint64_t m_hashModule = 0;	// of the sections that matter for the code, custom sections are left out
+
+	std::unique_ptr<class JitWriter> m_spjitwriter;
+};
@@ -13,10 +13,13 @@ public:
 
 	void *PvBaseAddr() const { return m_pv; }
 	size_t Cb() const { return m_cb; }
+	// Where the block can be written when it is dual mapped (see ReserveDualMappedPages), else the block itself
+	void *PvWriteAddr() const { return (m_pvWrite != nullptr) ? m_pvWrite : m_pv; }
 protected:
 	AllocatedPageBlock() = default;
 
 	void *m_pv = nullptr;
+	void *m_pvWrite = nullptr;
 	size_t m_cb = 0;
 };
 
@@ -31,5 +34,19 @@ enum class PAGE_PROTECTION
 // ReservePages reserves a range but does not commit it
 std::unique_ptr<AllocatedPageBlock> ReservePages(const void *pvBaseRequested, size_t cb);
 
+// ReserveDualMappedPages maps the same memory twice: PvBaseAddr() is ReadExecute and PvWriteAddr() is a ReadWrite alias, so
+//	code can be written without ever changing the protection of the view it runs from.  Returns nullptr when the platform
+//	can't, callers fall back to ReservePages and flipping the protection with ProtectRange.
+std::unique_ptr<AllocatedPageBlock> ReserveDualMappedPages(const void *pvBaseRequested, size_t cb);
+
 void ProtectRange(AllocatedPageBlock &block, void *pvAddrStart, size_t cbRange, PAGE_PROTECTION prot);
+
+// Faults raised by code in [pvCodeStart, pvCodeStart + cbCode) resume at pfnTrap instead of crashing the process, with the
+//	address of the faulting instruction in rcx.  This covers access violations on [pvStart, pvStart + cb), integer divide
+//	errors and ud2.  It lets guard pages and the divide hardware act as the runtime checks for jitted code.
+void RegisterTrapRange(const void *pvStart, size_t cb, const void *pvCodeStart, size_t cbCode, void (*pfnTrap)());
+void UnregisterTrapRange(const void *pvStart);
+
+// CPU feature detection for instruction selection in the JIT
+bool FCpuSupportsSSE41();
 };
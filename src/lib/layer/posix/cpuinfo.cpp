@@ -0,0 +1,17 @@
+#include <cstdlib>
+#include <inttypes.h>
+#include <memory>
+#include "../layer.h"
+#include <cpuid.h>
+
+namespace layer
+{
+
+bool FCpuSupportsSSE41()
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return !!(ecx & bit_SSE4_1);
+}
+};
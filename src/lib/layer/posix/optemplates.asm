@@ -31,6 +31,9 @@ STRUC ExecutionControlBlock
 	; Outputs and Temps
 	.stackrestore resq 1
 	.retvalue resq 1
+	.trapaddr resq 1
+
+	.pctxtInstance resq 1
 ENDSTRUC
 
 %macro CallCFn 1
@@ -103,55 +106,16 @@ LTrapRet:
 	xor eax, eax	; return 0 for failed execution
 	jmp ExternCallFnASM.LDone
 
-global BranchTable
-BranchTable:
-	; jump to an argument in the table or default
-	;	note: this is a candidate for more optimization but for now we will always perform a jump table
-	;
-	;	rax - table index
-	;	rcx - table pointer
-	;	edx - temp
-	;
-	;	Table Format:
-	;		dword count
-	;		dword fReturnVal
-	;		--default_target--
-	;		qword distance (how many blocks we're jumping)
-	;		qword target_addr
-	;		--table_targets---
-	;		.... * count
-	
-	mov edx, eax		; backup the table index
-	mov rax, [rdi]		; store the block return value (or garbage)
-
-	cmp edx, [rcx]
-	jb .LNotDefault
-	xor edx, edx
-	jmp .LDefault
-
-.LNotDefault:
-	;else use table
-	add edx, 1						; skip the default
-	shl edx, 4						; convert table offset to a byte offset
-.LDefault:
-	; at this point rdx is a byte offset into the vector table
-	; Lets adjust the stack to deal with the blocks we're leaving
-	mov r11d, [rcx+8+rdx]			; r11d = table[idx].distance
-	lea rsp, [rsp+r11*8]					; adjust the stack for the blocks
-	mov rax, [rdi-8]						; get the potential block return value
-	pop rdi									; Restore the param stack to the right location
-	; Put the top of the param stack in rax if we don't have a return value
-	mov r11d, [rcx+4]
-	test r11d, r11d
-	jnz .LHasRetValue
-	; Doesn't have a return value if we get here, so put the top param back in rax
-	sub rdi, 8
-	mov rax, [rdi]
-.LHasRetValue:
-	; The universe should be setup correctly for the target block so we just need to jump
-	jmp [rcx+16+rdx]
-
+global Trap
 Trap:
+	; Explicit traps from the helpers, they are all called from jitted code so [rsp] points just past the call
+	mov rcx, [rsp]
+	sub rcx, 1
+global TrapFault
+TrapFault:
+	; Resume point for faults in jitted code (see layer::RegisterTrapRange), rcx is the faulting instruction
+	;	rbp is always our control block in jitted code
+	mov [rbp + ExecutionControlBlock.trapaddr], rcx
 	mov rsp, [rbp + ExecutionControlBlock.stackrestore]
 	jmp LTrapRet
 
@@ -215,7 +179,9 @@ CallIndirectShim:
 	mov rdi, rbp	; first param the control block
 	CallCFn CompileFn
 	RestoreVMState
+	test al, al
 	pop rax
+	jz .LDoTrap		; it failed to compile
 	jmp [rax]
 	ud2
 
@@ -259,13 +225,17 @@ F32ToU64Trunc:
 	ucomiss xmm0, [rel f32_2p63]	; compare with 2^63
 	jae .LSpecialCase
 	cvttss2si rax, xmm0
+	test rax, rax			; NaN and anything <= -1 come back negative
+	js Trap
 	ret
 .LSpecialCase:
 	subss xmm0, [rel f32_2p63]	; take out the 2^63 (should reduce output by one bit)
+	cvttss2si rax, xmm0		; convert to integer
+	test rax, rax			; still >= 2^63 means the input was >= 2^64
+	js Trap
 	xor rcx, rcx
 	add rcx, 1				; set lsb of rcx
 	ror rcx, 1				; set msb of rcx (clear lsb)  at this point rcx == 2^63
-	cvttss2si rax, xmm0		; convert to integer
 	add rax, rcx			; add in the 2^63 we took out
 	ret
 
@@ -275,16 +245,61 @@ F64ToU64Trunc:
 	ucomisd xmm0, [rel f64_2p63]
 	jae .LSpecialCase
 	cvttsd2si rax, xmm0
+	test rax, rax			; NaN and anything <= -1 come back negative
+	js Trap
 	ret
 .LSpecialCase:
 	subsd xmm0, [rel f64_2p63]	; take out the 2^63 (should reduce output by one bit)
+	cvttsd2si rax, xmm0		; convert to integer
+	test rax, rax			; still >= 2^63 means the input was >= 2^64
+	js Trap
 	xor rcx, rcx
 	add rcx, 1				; set lsb of rcx
 	ror rcx, 1				; set msb of rcx (clear lsb) rcx == 2^63
-	cvttsd2si rax, xmm0		; convert to integer
 	add rax, rcx			; add back the 2^63 we removed
 	ret
 
+; Fallbacks for roundss/roundsd on CPUs without SSE4.1
+;	rax - value to round, result is returned in rax
+;	ecx - rounding mode as encoded for roundss: 0 nearest even, 1 floor, 2 ceil, 3 truncate (this is also the x87 RC field)
+global F32Round
+F32Round:
+	sub rsp, 16
+	mov [rsp], eax
+	fnstcw [rsp + 8]
+	movzx edx, word [rsp + 8]
+	and edx, 0F3FFh			; clear RC
+	shl ecx, 10
+	or edx, ecx
+	mov [rsp + 10], dx
+	fldcw [rsp + 10]
+	fld dword [rsp]
+	frndint
+	fstp dword [rsp]
+	fldcw [rsp + 8]			; restore the caller's control word
+	mov eax, [rsp]
+	add rsp, 16
+	ret
+
+global F64Round
+F64Round:
+	sub rsp, 16
+	mov [rsp], rax
+	fnstcw [rsp + 8]
+	movzx edx, word [rsp + 8]
+	and edx, 0F3FFh			; clear RC
+	shl ecx, 10
+	or edx, ecx
+	mov [rsp + 10], dx
+	fldcw [rsp + 10]
+	fld qword [rsp]
+	frndint
+	fstp qword [rsp]
+	fldcw [rsp + 8]			; restore the caller's control word
+	mov rax, [rsp]
+	add rsp, 16
+	ret
+
 global GrowMemoryOp
 GrowMemoryOp:
 	BackupVMState
@@ -295,3 +310,34 @@ GrowMemoryOp:
 	RestoreVMState
 	ret
 
+extern TierUp
+global TierUpStub
+TierUpStub:
+	; ecx - function index
+	; edx - bytecode offset of the loop we are at the head of
+	; returns where to continue in rcx (0 to stay in the baseline code), rax is preserved
+	push rax
+	BackupVMState
+	mov rdi, rbp	; first param the control block
+	mov esi, ecx	; second param the function index, the third is already in edx
+	mov rcx, [rsp + 24]	; fourth param where the check's call returns to
+	CallCFn TierUp
+	mov rcx, rax
+	RestoreVMState
+	pop rax
+	ret
+
+global LazyCompileShim
+LazyCompileShim:
+	; ecx - function index, we come from its compile stub so [rsp] points just past a direct call (call rel32) to it
+	; the register arguments in r13-r15 survive the C call
+	BackupVMState
+	mov esi, ecx	; second param is the function index
+	mov rdi, rbp	; first param the control block
+	CallCFn CompileFn
+	RestoreVMState
+	test al, al
+	jz Trap			; it failed to compile, [rsp] is still the call
+	; CompileFn patched the call to go straight to the function, back up and make it again
+	sub qword [rsp], 5
+	ret
@@ -3,6 +3,7 @@
 #include <memory>
 #include "../layer.h"
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/mman.h>
 #include <assert.h>
 #include <new>
@@ -13,15 +14,18 @@ namespace layer
 class AllocatedPageBlockUnix : public AllocatedPageBlock
 {
 public:
-	AllocatedPageBlockUnix(void *pv, size_t cb)
+	AllocatedPageBlockUnix(void *pv, size_t cb, void *pvWrite = nullptr)
 	{
 		assert(pv != nullptr && cb > 0);
 		m_pv = pv;
+		m_pvWrite = pvWrite;
 		m_cb = cb;
 	}
 	~AllocatedPageBlockUnix()
 	{
 		munmap(m_pv, m_cb);
+		if (m_pvWrite != nullptr)
+			munmap(m_pvWrite, m_cb);
 	}
 
 };
@@ -34,6 +38,38 @@ std::unique_ptr<AllocatedPageBlock> ReservePages(const void *pvBaseRequested, si
 	return std::unique_ptr<AllocatedPageBlock>(new AllocatedPageBlockUnix(pv, cb));
 }
 
+// Both views are shared mappings of one anonymous memfd, pages are only allocated once they are touched
+std::unique_ptr<AllocatedPageBlock> ReserveDualMappedPages(const void *pvBaseRequested, size_t cb)
+{
+#ifdef __linux__
+	int fd = memfd_create("wasm-jit", MFD_CLOEXEC);
+	if (fd < 0)
+		return nullptr;
+	void *pv = MAP_FAILED;
+	void *pvWrite = MAP_FAILED;
+	if (ftruncate(fd, cb) == 0)
+	{
+		pv = mmap((void*)pvBaseRequested, cb, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+		pvWrite = mmap(nullptr, cb, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);	// the mappings keep the memory alive
+	if (pv == MAP_FAILED || pvWrite == MAP_FAILED)
+	{
+		// e.g. a kernel refusing executable memfds
+		if (pv != MAP_FAILED)
+			munmap(pv, cb);
+		if (pvWrite != MAP_FAILED)
+			munmap(pvWrite, cb);
+		return nullptr;
+	}
+	return std::unique_ptr<AllocatedPageBlock>(new AllocatedPageBlockUnix(pv, cb, pvWrite));
+#else
+	(void)pvBaseRequested;
+	(void)cb;
+	return nullptr;
+#endif
+}
+
 void ProtectRange(AllocatedPageBlock &block, void *pvAddrStart, size_t cbRange, PAGE_PROTECTION prot)
 {
 	int unixprot = PROT_NONE;
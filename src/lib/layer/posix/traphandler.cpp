@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <inttypes.h>
+#include <memory>
+#include "../layer.h"
+#include "../trapranges.h"
+#include <signal.h>
+#include <ucontext.h>
+#include <new>
+
+namespace layer
+{
+
+static const int s_rgsig[] = { SIGSEGV, SIGFPE, SIGILL };
+static const size_t s_csig = sizeof(s_rgsig) / sizeof(*s_rgsig);
+static struct sigaction s_rgsigactionPrev[s_csig];
+
+static void TrapHandler(int sig, siginfo_t *psiginfo, void *pvContext)
+{
+	ucontext_t *pcontext = reinterpret_cast<ucontext_t*>(pvContext);
+	uintptr_t addrFault = reinterpret_cast<uintptr_t>(psiginfo->si_addr);
+	uintptr_t addrRip = static_cast<uintptr_t>(pcontext->uc_mcontext.gregs[REG_RIP]);
+	const TrapRange *prange = PtrapRangeFromFault(addrRip, sig == SIGSEGV, addrFault);
+	if (prange != nullptr)
+	{
+		pcontext->uc_mcontext.gregs[REG_RCX] = static_cast<greg_t>(addrRip);
+		pcontext->uc_mcontext.gregs[REG_RIP] = reinterpret_cast<greg_t>(prange->pfnTrap);
+		return;
+	}
+
+	// Not one of ours, hand it to whoever was installed before us
+	size_t isig = 0;
+	while (s_rgsig[isig] != sig)
+		++isig;
+	const struct sigaction &sigactionPrev = s_rgsigactionPrev[isig];
+	if (sigactionPrev.sa_flags & SA_SIGINFO)
+	{
+		sigactionPrev.sa_sigaction(sig, psiginfo, pvContext);
+	}
+	else if (sigactionPrev.sa_handler == SIG_DFL || sigactionPrev.sa_handler == SIG_IGN)
+	{
+		// returning re-executes the faulting instruction which now gets the default behavior
+		signal(sig, SIG_DFL);
+	}
+	else
+	{
+		sigactionPrev.sa_handler(sig);
+	}
+}
+
+void InstallTrapHandler()
+{
+	struct sigaction sa = {};
+	sa.sa_sigaction = TrapHandler;
+	sa.sa_flags = SA_SIGINFO;
+	sigemptyset(&sa.sa_mask);
+	for (size_t isig = 0; isig < s_csig; ++isig)
+	{
+		if (sigaction(s_rgsig[isig], &sa, &s_rgsigactionPrev[isig]) != 0)
+			throw std::bad_alloc();
+	}
+}
+};
@@ -0,0 +1,83 @@
+#include <memory>
+#include <mutex>
+#include "layer.h"
+#include "trapranges.h"
+
+namespace layer
+{
+
+// The fault handler can't take locks so ranges live in blocks that are only ever linked onto the end of a list and never
+//	freed, it can walk them while another thread adds one.  A slot is only read once it is Active.
+struct TrapRangeBlock
+{
+	TrapRange rgtrapRange[64];
+	std::atomic<TrapRangeBlock*> pblockNext;
+};
+static TrapRangeBlock s_blockFirst;
+static std::once_flag s_flagInstall;
+
+const TrapRange *PtrapRangeFromFault(uintptr_t addrRip, bool fAccessViolation, uintptr_t addrFault)
+{
+	for (TrapRangeBlock *pblock = &s_blockFirst; pblock != nullptr; pblock = pblock->pblockNext.load(std::memory_order_acquire))
+	{
+		for (const TrapRange &range : pblock->rgtrapRange)
+		{
+			if (range.state.load(std::memory_order_acquire) != TrapRange::Active)
+				continue;
+			if ((addrRip - range.addrCodeStart) >= range.cbCode)
+				continue;
+			if (fAccessViolation && (addrFault - range.addrStart) >= range.cb)
+				continue;
+			return &range;
+		}
+	}
+	return nullptr;
+}
+
+void RegisterTrapRange(const void *pvStart, size_t cb, const void *pvCodeStart, size_t cbCode, void (*pfnTrap)())
+{
+	std::call_once(s_flagInstall, InstallTrapHandler);
+	TrapRangeBlock *pblock = &s_blockFirst;
+	for (;;)
+	{
+		for (TrapRange &range : pblock->rgtrapRange)
+		{
+			int stateExpected = TrapRange::Free;
+			if (!range.state.compare_exchange_strong(stateExpected, TrapRange::Claimed))
+				continue;
+			range.addrStart = reinterpret_cast<uintptr_t>(pvStart);
+			range.cb = cb;
+			range.addrCodeStart = reinterpret_cast<uintptr_t>(pvCodeStart);
+			range.cbCode = cbCode;
+			range.pfnTrap = pfnTrap;
+			range.state.store(TrapRange::Active, std::memory_order_release);
+			return;
+		}
+
+		TrapRangeBlock *pblockNext = pblock->pblockNext.load(std::memory_order_acquire);
+		if (pblockNext == nullptr)
+		{
+			// All taken, add a block.  If another thread links one first we use theirs.
+			std::unique_ptr<TrapRangeBlock> spblock(new TrapRangeBlock());
+			if (pblock->pblockNext.compare_exchange_strong(pblockNext, spblock.get(), std::memory_order_acq_rel))
+				pblockNext = spblock.release();
+		}
+		pblock = pblockNext;
+	}
+}
+
+void UnregisterTrapRange(const void *pvStart)
+{
+	for (TrapRangeBlock *pblock = &s_blockFirst; pblock != nullptr; pblock = pblock->pblockNext.load(std::memory_order_acquire))
+	{
+		for (TrapRange &range : pblock->rgtrapRange)
+		{
+			if (range.state.load(std::memory_order_acquire) == TrapRange::Active && range.addrStart == reinterpret_cast<uintptr_t>(pvStart))
+			{
+				range.state.store(TrapRange::Free, std::memory_order_release);
+				return;
+			}
+		}
+	}
+}
+};
@@ -0,0 +1,28 @@
+#pragma once
+#include <atomic>
+#include <inttypes.h>
+
+namespace layer
+{
+
+// A range registered with RegisterTrapRange, the platform trap handlers look them up with PtrapRangeFromFault
+struct TrapRange
+{
+	enum State : int { Free, Claimed, Active };
+
+	std::atomic<int> state;
+	uintptr_t addrStart;
+	size_t cb;
+	uintptr_t addrCodeStart;
+	size_t cbCode;
+	void (*pfnTrap)();
+};
+
+// Implemented by each platform, installs its fault handler.  Called once, before the first range is registered.
+void InstallTrapHandler();
+
+// The range whose code raised a fault at addrRip, or nullptr if the fault isn't ours.  Divide errors and ud2 always trap,
+//	access violations (fAccessViolation) only when addrFault is inside the guarded range.  Called from the fault handler
+//	so it takes no locks.
+const TrapRange *PtrapRangeFromFault(uintptr_t addrRip, bool fAccessViolation, uintptr_t addrFault);
+};
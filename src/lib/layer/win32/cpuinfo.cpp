@@ -0,0 +1,16 @@
+#include <cstdlib>
+#include <inttypes.h>
+#include <memory>
+#include "../layer.h"
+#include <intrin.h>
+
+namespace layer
+{
+
+	bool FCpuSupportsSSE41()
+	{
+		int rgregs[4];	// eax, ebx, ecx, edx
+		__cpuid(rgregs, 1);
+		return !!(rgregs[2] & (1 << 19));
+	}
+};
@@ -25,6 +25,9 @@ ExecutionControlBlock STRUCT
 	; Outputs and Temps
 	stackrestore dq ?
 	retvalue dq ?
+	trapaddr dq ?
+
+	pctxtInstance dq ?
 ExecutionControlBlock ENDS
 
 CallCFn	MACRO fn
@@ -60,6 +63,13 @@ ExternCallFnASM PROC
 	push rsi
 	push rbx
 	push rbp
+	push r12
+	push r13
+	push r14
+	push r15
+	sub rsp, 32					; xmm6 and xmm7 are nonvolatile but hold cached floats in the jitted code
+	movdqu xmmword ptr [rsp], xmm6
+	movdqu xmmword ptr [rsp+16], xmm7
 	
 	mov rdi, (ExecutionControlBlock PTR [rcx]).operandStack
 	mov rsi, (ExecutionControlBlock PTR [rcx]).memoryBase
@@ -74,6 +84,13 @@ ExternCallFnASM PROC
 
 	mov eax, 1
 LDone:
+	movdqu xmm6, xmmword ptr [rsp]
+	movdqu xmm7, xmmword ptr [rsp+16]
+	add rsp, 32
+	pop r15
+	pop r14
+	pop r13
+	pop r12
 	pop rbp
 	pop rbx
 	pop rsi
@@ -84,58 +101,20 @@ LTrapRet::
 	jmp LDone
 ExternCallFnASM ENDP
 
-BranchTable PROC
-	; jump to an argument in the table or default
-	;	note: this is a candidate for more optimization but for now we will always perform a jump table
-	;
-	;	rax - table index
-	;	rcx - table pointer
-	;	edx - temp
-	;
-	;	Table Format:
-	;		dword count
-	;		dword fReturnVal
-	;		--default_target--
-	;		qword distance (how many blocks we're jumping)
-	;		qword target_addr
-	;		--table_targets---
-	;		.... * count
-	
-	mov edx, eax		; backup the table index
-	mov rax, [rdi]		; store the block return value (or garbage)
-
-	cmp edx, [rcx]
-	jb LNotDefault
-	xor edx, edx
-	jmp LDefault
-
-LNotDefault:
-	;else use table
-	add edx, 1						; skip the default
-	shl edx, 4						; convert table offset to a byte offset
-LDefault:
-	; at this point rdx is a byte offset into the vector table
-	; Lets adjust the stack to deal with the blocks we're leaving
-	mov r11d, dword ptr [rcx+8+rdx]			; r11d = table[idx].distance
-	lea rsp, [rsp+r11*8]					; adjust the stack for the blocks
-	mov rax, [rdi-8]						; get the potential block return value
-	pop rdi									; Restore the param stack to the right location
-	; Put the top of the param stack in rax if we don't have a return value
-	mov r11d, dword ptr [rcx+4]
-	test r11d, r11d
-	jnz LHasRetValue
-	; Doesn't have a return value if we get here, so put the top param back in rax
-	sub rdi, 8
-	mov rax, [rdi]
-LHasRetValue:
-	; The universe should be setup correctly for the target block so we just need to jump
-	jmp [rcx+16+rdx]
-BranchTable ENDP
-
 Trap PROC
+	; Explicit traps from the helpers, they are all called from jitted code so [rsp] points just past the call
+	mov rcx, [rsp]
+	sub rcx, 1
+	; fall through
+Trap ENDP
+
+TrapFault PROC
+	; Resume point for faults in jitted code (see layer::RegisterTrapRange), rcx is the faulting instruction
+	;	rbp is always our control block in jitted code
+	mov (ExecutionControlBlock PTR [rbp]).trapaddr, rcx
 	mov rsp, (ExecutionControlBlock PTR [rbp]).stackrestore
 	jmp LTrapRet
-Trap ENDP
+TrapFault ENDP
 
 WasmToC PROC
 	; Translates a wasm function call into a C function call for internal use
@@ -195,7 +174,9 @@ LCompileFn:
 	mov edx, ecx	; second param is the function index
 	mov rcx, rbp	; first param the control block
 	CallCFn CompileFn
+	test al, al
 	pop rax
+	jz LDoTrap		; it failed to compile
 	jmp qword ptr [rax]
 	ud2
 CallIndirectShim ENDP
@@ -239,13 +220,17 @@ F32ToU64Trunc PROC
 	ucomiss xmm0, dword ptr [f32_2p63]	; compare with 2^63
 	jae LSpecialCase
 	cvttss2si rax, xmm0
+	test rax, rax			; NaN and anything <= -1 come back negative
+	js Trap
 	ret
 LSpecialCase:
 	subss xmm0, dword ptr [f32_2p63]	; take out the 2^63 (should reduce output by one bit)
+	cvttss2si rax, xmm0		; convert to integer
+	test rax, rax			; still >= 2^63 means the input was >= 2^64
+	js Trap
 	xor rcx, rcx
 	add rcx, 1				; set lsb of rcx
 	ror rcx, 1				; set msb of rcx (clear lsb)  at this point rcx == 2^63
-	cvttss2si rax, xmm0		; convert to integer
 	add rax, rcx			; add in the 2^63 we took out
 	ret
 F32ToU64Trunc ENDP
@@ -255,17 +240,62 @@ F64ToU64Trunc PROC
 	ucomisd xmm0, qword ptr [f64_2p63]
 	jae LSpecialCase
 	cvttsd2si rax, xmm0
+	test rax, rax			; NaN and anything <= -1 come back negative
+	js Trap
 	ret
 LSpecialCase:
 	subsd xmm0, qword ptr [f64_2p63]	; take out the 2^63 (should reduce output by one bit)
+	cvttsd2si rax, xmm0		; convert to integer
+	test rax, rax			; still >= 2^63 means the input was >= 2^64
+	js Trap
 	xor rcx, rcx
 	add rcx, 1				; set lsb of rcx
 	ror rcx, 1				; set msb of rcx (clear lsb) rcx == 2^63
-	cvttsd2si rax, xmm0		; convert to integer
 	add rax, rcx			; add back the 2^63 we removed
 	ret
 F64ToU64Trunc ENDP
 
+; Fallbacks for roundss/roundsd on CPUs without SSE4.1
+;	rax - value to round, result is returned in rax
+;	ecx - rounding mode as encoded for roundss: 0 nearest even, 1 floor, 2 ceil, 3 truncate (this is also the x87 RC field)
+F32Round PROC
+	sub rsp, 16
+	mov dword ptr [rsp], eax
+	fnstcw word ptr [rsp + 8]
+	movzx edx, word ptr [rsp + 8]
+	and edx, 0F3FFh			; clear RC
+	shl ecx, 10
+	or edx, ecx
+	mov word ptr [rsp + 10], dx
+	fldcw word ptr [rsp + 10]
+	fld dword ptr [rsp]
+	frndint
+	fstp dword ptr [rsp]
+	fldcw word ptr [rsp + 8]	; restore the caller's control word
+	mov eax, dword ptr [rsp]
+	add rsp, 16
+	ret
+F32Round ENDP
+
+F64Round PROC
+	sub rsp, 16
+	mov qword ptr [rsp], rax
+	fnstcw word ptr [rsp + 8]
+	movzx edx, word ptr [rsp + 8]
+	and edx, 0F3FFh			; clear RC
+	shl ecx, 10
+	or edx, ecx
+	mov word ptr [rsp + 10], dx
+	fldcw word ptr [rsp + 10]
+	fld qword ptr [rsp]
+	frndint
+	fstp qword ptr [rsp]
+	fldcw word ptr [rsp + 8]	; restore the caller's control word
+	mov rax, qword ptr [rsp]
+	add rsp, 16
+	ret
+F64Round ENDP
+
 GrowMemoryOp PROC
 	mov rcx, rbp
 	mov rdx, rax
@@ -274,6 +304,35 @@ GrowMemoryOp PROC
 	ret
 GrowMemoryOp ENDP
 
+TierUp PROTO
+TierUpStub PROC
+	; ecx - function index
+	; edx - bytecode offset of the loop we are at the head of
+	; returns where to continue in rcx (0 to stay in the baseline code), rax is preserved
+	mov r9, [rsp]	; fourth param where the check's call returns to
+	push rax
+	mov r8d, edx	; third param the loop
+	mov edx, ecx	; second param the function index
+	mov rcx, rbp	; first param the control block
+	CallCFn TierUp
+	mov rcx, rax
+	pop rax
+	ret
+TierUpStub ENDP
+
+LazyCompileShim PROC
+	; ecx - function index, we come from its compile stub so [rsp] points just past a direct call (call rel32) to it
+	; the register arguments in r13-r15 survive the C call
+	mov edx, ecx	; second param is the function index
+	mov rcx, rbp	; first param the control block
+	CallCFn CompileFn
+	test al, al
+	jz Trap			; it failed to compile, [rsp] is still the call
+	; CompileFn patched the call to go straight to the function, back up and make it again
+	sub qword ptr [rsp], 5
+	ret
+LazyCompileShim ENDP
+
 _TEXT ENDS
 
 END
\ No newline at end of file
@@ -27,12 +27,17 @@ namespace layer
 
 	std::unique_ptr<AllocatedPageBlock> ReservePages(const void *pvBaseRequested, size_t cb)
 	{
-		void *pv = VirtualAlloc((void*)pvBaseRequested, cb, MEM_RESERVE | MEM_COMMIT, PAGE_NOACCESS);
+		void *pv = VirtualAlloc((void*)pvBaseRequested, cb, MEM_RESERVE, PAGE_NOACCESS);
 		if (pv == nullptr)
 			throw std::bad_alloc();
 		return std::make_unique<AllocatedPageBlockWindows>(pv, cb);
 	}
 
+	std::unique_ptr<AllocatedPageBlock> ReserveDualMappedPages(const void * /*pvBaseRequested*/, size_t /*cb*/)
+	{
+		return nullptr;	// not implemented, the exec plane flips between ReadWrite and ReadExecute instead
+	}
+
 	void ProtectRange(AllocatedPageBlock &block, void *pvAddrStart, size_t cbRange, PAGE_PROTECTION prot)
 	{
 		int winprot = PAGE_NOACCESS;
@@ -53,6 +58,16 @@ namespace layer
 		}
 		if (pvAddrStart == nullptr)
 			pvAddrStart = block.PvBaseAddr();
+		if (prot == PAGE_PROTECTION::Unallocated)
+		{
+			// Give the pages back, they will be committed again the next time they are made accessible
+			if (!VirtualFree(pvAddrStart, cbRange, MEM_DECOMMIT))
+				throw std::bad_alloc();
+			return;
+		}
+		// Pages are only committed once they are made accessible so untouched reservations are not charged
+		if (VirtualAlloc(pvAddrStart, cbRange, MEM_COMMIT, winprot) == nullptr)
+			throw std::bad_alloc();
 		DWORD dwT;
 		bool ret = VirtualProtect(pvAddrStart, cbRange, winprot, &dwT);
 		if (!ret)
@@ -0,0 +1,34 @@
+#include <cstdlib>
+#include <inttypes.h>
+#include <memory>
+#include "../layer.h"
+#include "../trapranges.h"
+#include <Windows.h>
+#include <new>
+
+namespace layer
+{
+
+	static LONG CALLBACK TrapHandler(PEXCEPTION_POINTERS pexceptionInfo)
+	{
+		DWORD code = pexceptionInfo->ExceptionRecord->ExceptionCode;
+		if (code != EXCEPTION_ACCESS_VIOLATION && code != EXCEPTION_INT_DIVIDE_BY_ZERO && code != EXCEPTION_INT_OVERFLOW && code != EXCEPTION_ILLEGAL_INSTRUCTION)
+			return EXCEPTION_CONTINUE_SEARCH;
+
+		uintptr_t addrRip = static_cast<uintptr_t>(pexceptionInfo->ContextRecord->Rip);
+		const bool fAccessViolation = (code == EXCEPTION_ACCESS_VIOLATION);
+		uintptr_t addrFault = fAccessViolation ? static_cast<uintptr_t>(pexceptionInfo->ExceptionRecord->ExceptionInformation[1]) : 0;
+		const TrapRange *prange = PtrapRangeFromFault(addrRip, fAccessViolation, addrFault);
+		if (prange == nullptr)
+			return EXCEPTION_CONTINUE_SEARCH;
+		pexceptionInfo->ContextRecord->Rcx = static_cast<DWORD64>(addrRip);
+		pexceptionInfo->ContextRecord->Rip = reinterpret_cast<DWORD64>(prange->pfnTrap);
+		return EXCEPTION_CONTINUE_EXECUTION;
+	}
+
+	void InstallTrapHandler()
+	{
+		if (AddVectoredExceptionHandler(1 /*First*/, TrapHandler) == nullptr)
+			throw std::bad_alloc();
+	}
+};
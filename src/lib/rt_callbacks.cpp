@@ -3,7 +3,7 @@
 #include "BuiltinFunctions.h"
 #include "ExecutionControlBlock.h"
 #include "JitWriter.h"
-#include "WasmContext.h"
+#include "WasmModule.h"
 #ifdef _MSC_VER
 #include <io.h>
 #else
@@ -82,8 +82,8 @@ extern "C" uint64_t CReentryFn(int ifn, uint64_t *pvArgs, uint8_t *pvMemBase, Ex
 }
 uint64_t JitWriter::CReentryFn(int ifn, uint64_t *pvArgs, uint8_t *pvMemBase, ExecutionControlBlock *pecb)
 {
-	Verify(ifn >= 0 && (size_t)ifn < m_pctxt->m_vecimports.size());
-	ifn = m_pctxt->m_vecimports[ifn];
+	Verify(ifn >= 0 && (size_t)ifn < m_pmodule->m_vecimports.size());
+	ifn = m_pmodule->m_vecimports[ifn];
 	Verify(ifn >= 0 && (size_t)ifn < _countof(BuiltinMap));
 	BuiltinMap[ifn].pfn(pvArgs, pvMemBase);
 	return 0;
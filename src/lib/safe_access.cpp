@@ -100,7 +100,7 @@ varint64 safe_read_buffer(const uint8_t **prgb, size_t *pcb)
 
 	/* sign bit of byte is second high order bit (0x40) */
 	if ((shift < 64) && (byteLast & 0x40))
-		ret |= (~0 << shift);		// sign extend
+		ret |= static_cast<int64_t>(~uint64_t(0) << shift);		// sign extend, ~0 alone is an int and can't be shifted past 31 bits
 	return ret;
 }
 
@@ -27,6 +27,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <exception>
 #include <stack>
 #include <tuple>
 #include <cstring>
@@ -9,7 +9,7 @@ int main(int argc, char *argv[])
 {
 	if (argc < 2)
 	{
-		fprintf(stderr, "Usage: module.wasm\n");
+		fprintf(stderr, "Usage: module.wasm [code cache directory]\n");
 		return EXIT_FAILURE;
 	}
 	FILE *pf = fopen(argv[1], "rb");
@@ -20,10 +20,13 @@ int main(int argc, char *argv[])
 	}
 
 	WasmContext ctxt;
+	if (argc > 2)
+		ctxt.SetCodeCacheDirectory(argv[2]);
 	ctxt.LoadModule(pf);
 	fclose(pf);
 	
 	ctxt.CallFunction("main");
+	ctxt.SaveCodeCache();
 
     return EXIT_SUCCESS;
 }
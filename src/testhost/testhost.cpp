@@ -24,28 +24,38 @@ void strcpy_s(char (&szDst)[ARRAY_SIZE], const char *szSrc)
 #define MAX_PATH 1024
 #endif
 #include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <thread>
 
 enum class ParseMode
 {
 	Whitespace,
 	Comment,
+	BlockComment,
 	Quote,
 	Escape,
 	Command,
 };
 
-std::unique_ptr<WasmContext> g_spctxtLast;
+std::vector<std::unique_ptr<WasmContext>> g_vecspctxt;	// the instances of the last module, they all run every invoke
 ExpressionService::Variant g_variantLastExec;
 ExpressionService::Variant g_variantExpectedReturn;
+bool g_fLastExecTrapped = false;
+bool g_fNoSSE41 = false;	// -nosse41: test the rounding fallback on any CPU
+uint32_t g_cthreadCompile = 0;	// -threads N: compile modules up front on N threads instead of lazily
+const char *g_szCacheDir = nullptr;	// -cache DIR: load and save compiled code in DIR
+uint32_t g_cinstance = 1;	// -instances N: run N instances of each module sharing its code, the one that loaded it is dropped
+bool g_fConcurrent = false;	// -concurrent: the instances run each invoke at the same time, each on a thread of its own
+bool g_fTierUp = false;	// -tierup N: tier functions up after N calls or loop iterations (0: optimize them on their first call)
+uint32_t g_ccountTierUp = 0;
 
 const char *rgszUnsupported[] = {
-	"assert_trap",
 	"assert_invalid",
 	"assert_malformed",
 	"assert_unlinkable",
 	"assert_exhaustion",
-	"assert_return_canonical_nan",
-	"assert_return_arithmetic_nan",
 };
 
 bool FUnsupportedCommand(const std::string &str)
@@ -91,6 +101,29 @@ int RunProgram(const char *szProgram, const char *szArgs)
 }
 #endif
 
+// canonical NaNs have only the quiet bit set in the mantissa, arithmetic NaNs have at least the quiet bit, either sign
+bool FNanMatches(const ExpressionService::Variant &variant, bool fCanonical)
+{
+	uint64_t maskQuiet;
+	uint64_t maskMagnitude;
+	switch (variant.type)
+	{
+	case value_type::f32:
+		maskQuiet = 0x7FC00000;
+		maskMagnitude = 0x7FFFFFFF;
+		break;
+	case value_type::f64:
+		maskQuiet = 0x7FF8000000000000;
+		maskMagnitude = 0x7FFFFFFFFFFFFFFF;
+		break;
+	default:
+		return false;
+	}
+	if (fCanonical)
+		return (variant.val & maskMagnitude) == maskQuiet;
+	return (variant.val & maskQuiet) == maskQuiet;
+}
+
 void ProcessInvoke(const char *rgch, size_t cch)
 {
 	size_t ichFnStart = 0;
@@ -140,7 +173,66 @@ void ProcessInvoke(const char *rgch, size_t cch)
 	}
 
 	printf("Invoke: %s\n", strFnExec.c_str());
-	g_variantLastExec = g_spctxtLast->CallFunction(strFnExec.c_str(), vecargs.data(), numeric_cast<uint32_t>(vecargs.size()));
+	Verify(!g_vecspctxt.empty(), "No module loaded");
+	std::vector<ExpressionService::Variant> vecvariant(g_vecspctxt.size());
+	std::vector<std::string> vecstrTrap(g_vecspctxt.size());
+	std::vector<std::exception_ptr> vecexptr(g_vecspctxt.size());
+	auto Invoke = [&](size_t ictxt)
+	{
+		try
+		{
+			// each instance gets its own copy of the arguments
+			std::vector<ExpressionService::Variant> vecargsT(vecargs);
+			vecvariant[ictxt] = g_vecspctxt[ictxt]->CallFunction(strFnExec.c_str(), vecargsT.data(), numeric_cast<uint32_t>(vecargsT.size()));
+		}
+		catch (RuntimeException &ex)
+		{
+			vecstrTrap[ictxt] = ex.strErr;
+		}
+		catch (...)
+		{
+			vecexptr[ictxt] = std::current_exception();
+		}
+	};
+	if (g_fConcurrent)
+	{
+		// the threads wait for each other so their calls really overlap, including compiling on first call
+		std::atomic<size_t> cthreadReady(0);
+		std::vector<std::thread> vecthread;
+		for (size_t ictxt = 0; ictxt < g_vecspctxt.size(); ++ictxt)
+		{
+			vecthread.emplace_back([&, ictxt]
+			{
+				++cthreadReady;
+				while (cthreadReady < g_vecspctxt.size())
+					std::this_thread::yield();
+				Invoke(ictxt);
+			});
+		}
+		for (std::thread &thread : vecthread)
+			thread.join();
+	}
+	else
+	{
+		for (size_t ictxt = 0; ictxt < g_vecspctxt.size(); ++ictxt)
+			Invoke(ictxt);
+	}
+	for (std::exception_ptr &exptr : vecexptr)
+	{
+		if (exptr != nullptr)
+			std::rethrow_exception(exptr);
+	}
+
+	g_fLastExecTrapped = !vecstrTrap[0].empty();
+	g_variantLastExec = vecvariant[0];
+	if (g_fLastExecTrapped)
+		printf("%s\n", vecstrTrap[0].c_str());
+	for (size_t ictxt = 1; ictxt < g_vecspctxt.size(); ++ictxt)
+	{
+		// every instance has been through the same calls so must have the same result
+		Verify(vecstrTrap[ictxt] == vecstrTrap[0]);
+		Verify(vecvariant[ictxt] == g_variantLastExec);
+	}
 }
 
 void ProcessCommand(const std::string &str, FILE *pf, off_t offsetStart, off_t offsetEnd)
@@ -189,24 +281,50 @@ void ProcessCommand(const std::string &str, FILE *pf, off_t offsetStart, off_t o
 		strcat_s(szParams, " --no-check -o ");
 		strcat_s(szParams, szPathWasm);
 		int res = RunProgram("wat2wasm", szParams);
+		g_fLastExecTrapped = false;
+		if (!g_vecspctxt.empty())
+			g_vecspctxt[0]->SaveCodeCache();	// what the last module's tests compiled
+		g_vecspctxt.clear();
 		if (res == EXIT_SUCCESS)
 		{
-			g_spctxtLast = std::unique_ptr<WasmContext>(new WasmContext);
+			std::unique_ptr<WasmContext> spctxt(new WasmContext);
+			if (g_fNoSSE41)
+				spctxt->DisableSSE41();
+			if (g_fTierUp)
+				spctxt->SetTierUpThreshold(g_ccountTierUp);
+			if (g_szCacheDir != nullptr)
+				spctxt->SetCodeCacheDirectory(g_szCacheDir);
 			FILE *pfWasm = fopen(szPathWasm, "rb");
 			try
 			{
-				g_spctxtLast->LoadModule(pfWasm);
+				spctxt->LoadModule(pfWasm, g_cthreadCompile);
+				if (g_cinstance == 1)
+				{
+					g_vecspctxt.push_back(std::move(spctxt));
+				}
+				else
+				{
+					for (uint32_t iinstance = 0; iinstance < g_cinstance; ++iinstance)
+					{
+						g_vecspctxt.push_back(std::unique_ptr<WasmContext>(new WasmContext));
+						g_vecspctxt.back()->LoadModule(*spctxt);
+					}
+					spctxt = nullptr;	// the instances keep the module alive
+				}
+			}
+			catch (RuntimeException &ex)
+			{
+				// the start function trapped
+				printf("%s\n", ex.strErr.c_str());
+				g_fLastExecTrapped = true;
+				g_vecspctxt.clear();
 			}
 			catch (Exception)
 			{
-				g_spctxtLast = nullptr;
+				g_vecspctxt.clear();
 			}
 			fclose(pfWasm);
 		}
-		else
-		{
-			g_spctxtLast = nullptr;
-		}
 	}
 	else if (str == "invoke")
 	{
@@ -219,11 +337,17 @@ void ProcessCommand(const std::string &str, FILE *pf, off_t offsetStart, off_t o
 	}
 	else if (str == "assert_return")
 	{
+		Verify(!g_fLastExecTrapped);
 		Verify(g_variantExpectedReturn == g_variantLastExec);
 	}
+	else if (str == "assert_return_canonical_nan" || str == "assert_return_arithmetic_nan")
+	{
+		Verify(!g_fLastExecTrapped);
+		Verify(FNanMatches(g_variantLastExec, str == "assert_return_canonical_nan"));
+	}
 	else if (str == "assert_trap")
 	{
-		//assert(false);
+		Verify(g_fLastExecTrapped);
 	}
 	else if (FUnsupportedCommand(str))
 	{
@@ -241,14 +365,74 @@ void ProcessCommand(const std::string &str, FILE *pf, off_t offsetStart, off_t o
 	fseek(pf, offsetCur, SEEK_SET);
 }
 
+// Parses the count given to an option, which must be a plain decimal number of at least cMin that fits in 32 bits
+bool FParseCount(const char *sz, uint32_t cMin, uint32_t *pc)
+{
+	if (!isdigit(static_cast<unsigned char>(sz[0])))
+		return false;	// strtoul would skip leading spaces and negate a '-'
+	errno = 0;
+	char *szEnd = nullptr;
+	unsigned long c = strtoul(sz, &szEnd, 10);
+	if (*szEnd != '\0' || errno == ERANGE || c < cMin || c > UINT32_MAX)
+		return false;
+	*pc = static_cast<uint32_t>(c);
+	return true;
+}
+
 int main(int argc, char *argv[])
 {
-	if (argc != 2)
+	int iarg = 1;
+	for (; iarg < argc && argv[iarg][0] == '-'; ++iarg)
+	{
+		if (strcmp(argv[iarg], "-nosse41") == 0)
+		{
+			g_fNoSSE41 = true;
+		}
+		else if (strcmp(argv[iarg], "-threads") == 0 && iarg + 1 < argc)
+		{
+			if (!FParseCount(argv[++iarg], 0, &g_cthreadCompile))
+			{
+				fprintf(stderr, "Invalid thread count %s.\n", argv[iarg]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[iarg], "-cache") == 0 && iarg + 1 < argc)
+		{
+			g_szCacheDir = argv[++iarg];
+		}
+		else if (strcmp(argv[iarg], "-instances") == 0 && iarg + 1 < argc)
+		{
+			if (!FParseCount(argv[++iarg], 1, &g_cinstance))
+			{
+				fprintf(stderr, "Invalid instance count %s.\n", argv[iarg]);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (strcmp(argv[iarg], "-tierup") == 0 && iarg + 1 < argc)
+		{
+			if (!FParseCount(argv[++iarg], 0, &g_ccountTierUp) || g_ccountTierUp > uint32_t(INT32_MAX))
+			{
+				fprintf(stderr, "Invalid tier up threshold %s.\n", argv[iarg]);
+				return EXIT_FAILURE;
+			}
+			g_fTierUp = true;
+		}
+		else if (strcmp(argv[iarg], "-concurrent") == 0)
+		{
+			g_fConcurrent = true;
+		}
+		else
+		{
+			fprintf(stderr, "Unknown option %s.\n", argv[iarg]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (iarg != argc - 1)
 	{
 		fprintf(stderr, "Expected test file.\n");
 		return EXIT_FAILURE;
 	}
-	FILE *pf = fopen(argv[1], "rb");
+	FILE *pf = fopen(argv[iarg], "rb");
 	if (pf == nullptr)
 	{
 		fprintf(stderr, "Failed to open test file.\n");
@@ -261,9 +445,11 @@ int main(int argc, char *argv[])
 	stackMode.push(ParseMode::Whitespace);
 	bool fEscapeLast = false;
 	bool fCommentLast = false;
+	bool fSemicolonLast = false;
 	int cblock = 0;
 	std::stack<off_t> stackoffsetBlockStart;
 	bool fNestCmd = false;
+	int cblockNestedModule = 0;	// the depth of a module inside an assert_trap, it is processed once it closes
 
 	std::stack<std::string> stackstrCmd;
 	while ((cch = fread(rgch, 1, 1024, pf)) > 0)
@@ -277,7 +463,16 @@ int main(int argc, char *argv[])
 			bool fCommentLastT = fCommentLast;
 			fCommentLast = false;
 
-			if (mode == ParseMode::Command)
+			if (mode == ParseMode::Command && *pch == ';' && stackstrCmd.top().empty())
+			{
+				// "(;" opens a block comment, not a command
+				stackMode.top() = ParseMode::BlockComment;
+				mode = ParseMode::BlockComment;
+				stackstrCmd.pop();
+				stackoffsetBlockStart.pop();
+				--cblock;
+			}
+			else if (mode == ParseMode::Command)
 			{
 				if ((*pch >= 'a' && *pch <= 'z') || (*pch >= 'A' && *pch <= 'Z') || (*pch >= '0' && *pch <= '9') || *pch == '_')
 				{
@@ -285,13 +480,23 @@ int main(int argc, char *argv[])
 				}
 				else
 				{
+					if (stackstrCmd.top() == "module" && fNestCmd)	// fNestCmd still refers to the enclosing command
+						cblockNestedModule = cblock;
 					fNestCmd = stackstrCmd.top() != "module" && !FUnsupportedCommand(stackstrCmd.top());
 					stackMode.pop();
 					mode = stackMode.top();
 				}
 			}
 
-			if (mode == ParseMode::Quote)
+			if (mode == ParseMode::BlockComment)
+			{
+				if (*pch == ')' && fSemicolonLast)
+				{
+					stackMode.pop();
+					mode = stackMode.top();
+				}
+			}
+			else if (mode == ParseMode::Quote)
 			{
 				if (*pch == '"' && !fEscapeLast)
 					stackMode.pop();
@@ -328,12 +533,17 @@ int main(int argc, char *argv[])
 					break;
 
 				case ')':
-					if (cblock == 1 || fNestCmd)
+					if (cblock == 1 || fNestCmd || cblock == cblockNestedModule)
 					{
 						off_t offsetCur = numeric_cast<off_t, false /*off_t varies size */>(ftell(pf) - (pchMax - (pch + 1)));
 						ProcessCommand(stackstrCmd.top(), pf, stackoffsetBlockStart.top(), offsetCur);
 						stackstrCmd.pop();
 						stackoffsetBlockStart.pop();
+						if (cblock == cblockNestedModule)
+						{
+							cblockNestedModule = 0;
+							fNestCmd = true;	// back in the assert
+						}
 						if (cblock == 1)
 							fNestCmd = false;
 					}
@@ -342,6 +552,7 @@ int main(int argc, char *argv[])
 				}
 			}
 			fEscapeLast = *pch == '\\';
+			fSemicolonLast = *pch == ';' && mode == ParseMode::BlockComment;
 			++pch;
 		}
 	}
@@ -350,6 +561,8 @@ int main(int argc, char *argv[])
 	stackMode.pop();
 	assert(stackMode.empty());
 	fclose(pf);
+	if (!g_vecspctxt.empty())
+		g_vecspctxt[0]->SaveCodeCache();
 
 	return EXIT_SUCCESS;
 }
@@ -0,0 +1,289 @@
+;; Direct calls pass their first arguments in registers and the rest in the callee's locals.  The callees take 0 to 6
+;; i64 and f64 arguments, write to their first one and are too big to inline.  The callers keep locals pinned across the
+;; calls, build arguments from them and from other calls, and loop long enough to tier up.  The callees are also
+;; invoked directly, which goes through the entry that loads the register arguments from memory.
+(module
+  (func $f0 (export "f0") (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $r (i64.const 1))
+    (loop $top
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func $f1 (export "f1") (param $p0 f64) (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $p0 (f64.mul (get_local $p0) (f64.const 2)))
+    (set_local $r (i64.const 2))
+    (loop $top
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p0))) (get_local $k)))
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func $f2 (export "f2") (param $p0 i64) (param $p1 f64) (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $p0 (i64.add (get_local $p0) (i64.const 1)))
+    (set_local $r (i64.const 3))
+    (loop $top
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p0)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p1))) (get_local $k)))
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func $f3 (export "f3") (param $p0 f64) (param $p1 i64) (param $p2 f64) (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $p0 (f64.mul (get_local $p0) (f64.const 2)))
+    (set_local $r (i64.const 4))
+    (loop $top
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p0))) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p1)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p2))) (get_local $k)))
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func $f4 (export "f4") (param $p0 i64) (param $p1 f64) (param $p2 i64) (param $p3 f64) (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $p0 (i64.add (get_local $p0) (i64.const 1)))
+    (set_local $r (i64.const 5))
+    (loop $top
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p0)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p1))) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p2)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p3))) (get_local $k)))
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func $f5 (export "f5") (param $p0 f64) (param $p1 i64) (param $p2 f64) (param $p3 i64) (param $p4 f64) (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $p0 (f64.mul (get_local $p0) (f64.const 2)))
+    (set_local $r (i64.const 6))
+    (loop $top
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p0))) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p1)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p2))) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p3)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p4))) (get_local $k)))
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func $f6 (export "f6") (param $p0 i64) (param $p1 f64) (param $p2 i64) (param $p3 f64) (param $p4 i64) (param $p5 f64) (result i64)
+    (local $r i64) (local $k i64)
+    (set_local $p0 (i64.add (get_local $p0) (i64.const 1)))
+    (set_local $r (i64.const 7))
+    (loop $top
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p0)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p1))) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p2)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p3))) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (get_local $p4)) (get_local $k)))
+      (set_local $r (i64.add (i64.add (i64.mul (get_local $r) (i64.const 31)) (i64.reinterpret/f64 (get_local $p5))) (get_local $k)))
+      (set_local $k (i64.add (get_local $k) (i64.const 1)))
+      (br_if $top (i64.lt_u (get_local $k) (i64.const 3))))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 29))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7046029254386353131)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 31))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -4658895280553007687)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 27))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -7723592293110705685)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 33))))
+    (set_local $r (i64.mul (get_local $r) (i64.const -49064778989728563)))
+    (set_local $r (i64.xor (get_local $r) (i64.shr_u (get_local $r) (i64.const 30))))
+    (set_local $r (i64.mul (get_local $r) (i64.const 2685821657736338717)))
+    (get_local $r))
+
+  (func (export "call0") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f0)))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "call1") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f1 (f64.add (get_local $y) (f64.const 0)))))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "call2") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f2 (i64.add (get_local $x) (i64.const 0)) (f64.add (get_local $y) (f64.const 1)))))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "call3") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f3 (f64.add (get_local $y) (f64.const 0)) (i64.add (get_local $x) (i64.const 1)) (f64.add (get_local $y) (f64.const 2)))))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "call4") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f4 (i64.add (get_local $x) (i64.const 0)) (f64.add (get_local $y) (f64.const 1)) (i64.add (get_local $x) (i64.const 2)) (f64.add (get_local $y) (f64.const 3)))))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "call5") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f5 (f64.add (get_local $y) (f64.const 0)) (i64.add (get_local $x) (i64.const 1)) (f64.add (get_local $y) (f64.const 2)) (i64.add (get_local $x) (i64.const 3)) (f64.add (get_local $y) (f64.const 4)))))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "call6") (param $n i32) (result i64)
+    (local $i i32) (local $x i64) (local $y f64) (local $acc i64)
+    (loop $top
+      (set_local $x (i64.add (i64.mul (get_local $x) (i64.const 3)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $y (f64.add (get_local $y) (f64.const 0.25)))
+      (set_local $acc (i64.add (get_local $acc) (call $f6 (i64.add (get_local $x) (i64.const 0)) (f64.add (get_local $y) (f64.const 1)) (i64.add (get_local $x) (i64.const 2)) (f64.add (get_local $y) (f64.const 3)) (i64.add (get_local $x) (i64.const 4)) (f64.add (get_local $y) (f64.const 5)))))
+      (set_local $acc (i64.xor (get_local $acc) (get_local $x)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $acc) (i64.reinterpret/f64 (get_local $y))))
+
+  (func (export "nested") (param $x i64) (param $y f64) (result i64)
+    (call $f6 (call $f0) (get_local $y) (call $f2 (get_local $x) (get_local $y)) (get_local $y)
+      (call $f3 (get_local $y) (get_local $x) (get_local $y)) (get_local $y))))
+
+(assert_return (invoke "f0") (i64.const -4592244552245730037))
+(assert_return (invoke "f0") (i64.const -4592244552245730037))
+(assert_return (invoke "f1" (f64.const 0.0)) (i64.const -5157744563974011221))
+(assert_return (invoke "f1" (f64.const -1.5)) (i64.const 3081296386848276427))
+(assert_return (invoke "f1" (f64.const 3.25e+100)) (i64.const -5025928023743354951))
+(assert_return (invoke "f1" (f64.const 1e-300)) (i64.const 3958735164013460189))
+(assert_return (invoke "f2" (i64.const 0) (f64.const -1.5)) (i64.const -468166062725192185))
+(assert_return (invoke "f2" (i64.const -1) (f64.const 3.25e+100)) (i64.const -4502086710214444787))
+(assert_return (invoke "f2" (i64.const 1234567890123) (f64.const 1e-300)) (i64.const 2497764271780079169))
+(assert_return (invoke "f2" (i64.const -9223372036854775808) (f64.const 0.0)) (i64.const -3032175916593228625))
+(assert_return (invoke "f3" (f64.const 0.0) (i64.const -1) (f64.const 3.25e+100)) (i64.const -2984048345972182553))
+(assert_return (invoke "f3" (f64.const -1.5) (i64.const 1234567890123) (f64.const 1e-300)) (i64.const 2257670922062090272))
+(assert_return (invoke "f3" (f64.const 3.25e+100) (i64.const -9223372036854775808) (f64.const 0.0)) (i64.const 1448253466907958457))
+(assert_return (invoke "f3" (f64.const 1e-300) (i64.const 0) (f64.const -1.5)) (i64.const 8847087219291852657))
+(assert_return (invoke "f4" (i64.const 0) (f64.const -1.5) (i64.const 1234567890123) (f64.const 1e-300)) (i64.const 5260087357099808326))
+(assert_return (invoke "f4" (i64.const -1) (f64.const 3.25e+100) (i64.const -9223372036854775808) (f64.const 0.0)) (i64.const 870989582812265882))
+(assert_return (invoke "f4" (i64.const 1234567890123) (f64.const 1e-300) (i64.const 0) (f64.const -1.5)) (i64.const -1146843859780253938))
+(assert_return (invoke "f4" (i64.const -9223372036854775808) (f64.const 0.0) (i64.const -1) (f64.const 3.25e+100)) (i64.const -2643102472273776817))
+(assert_return (invoke "f5" (f64.const 0.0) (i64.const -1) (f64.const 3.25e+100) (i64.const -9223372036854775808) (f64.const 0.0)) (i64.const -5624604377626781283))
+(assert_return (invoke "f5" (f64.const -1.5) (i64.const 1234567890123) (f64.const 1e-300) (i64.const 0) (f64.const -1.5)) (i64.const 4552764038506806565))
+(assert_return (invoke "f5" (f64.const 3.25e+100) (i64.const -9223372036854775808) (f64.const 0.0) (i64.const -1) (f64.const 3.25e+100)) (i64.const -6188857737307599902))
+(assert_return (invoke "f5" (f64.const 1e-300) (i64.const 0) (f64.const -1.5) (i64.const 1234567890123) (f64.const 1e-300)) (i64.const 8262586514921804450))
+(assert_return (invoke "f6" (i64.const 0) (f64.const -1.5) (i64.const 1234567890123) (f64.const 1e-300) (i64.const 0) (f64.const -1.5)) (i64.const -8134050691627905620))
+(assert_return (invoke "f6" (i64.const -1) (f64.const 3.25e+100) (i64.const -9223372036854775808) (f64.const 0.0) (i64.const -1) (f64.const 3.25e+100)) (i64.const -8433083258470955705))
+(assert_return (invoke "f6" (i64.const 1234567890123) (f64.const 1e-300) (i64.const 0) (f64.const -1.5) (i64.const 1234567890123) (f64.const 1e-300)) (i64.const -3962263439816591881))
+(assert_return (invoke "f6" (i64.const -9223372036854775808) (f64.const 0.0) (i64.const -1) (f64.const 3.25e+100) (i64.const -9223372036854775808) (f64.const 0.0)) (i64.const -7056962636367276915))
+(assert_return (invoke "call0" (i32.const 1)) (i64.const 5930667299546379))
+(assert_return (invoke "call0" (i32.const 3)) (i64.const -9171803037750857945))
+(assert_return (invoke "call0" (i32.const 20000)) (i64.const 8581340203981275952))
+(assert_return (invoke "call1" (i32.const 1)) (i64.const 7796353671514278972))
+(assert_return (invoke "call1" (i32.const 3)) (i64.const 7218586735186064739))
+(assert_return (invoke "call1" (i32.const 20000)) (i64.const -4463299848629104212))
+(assert_return (invoke "call2" (i32.const 1)) (i64.const -8823206215949603519))
+(assert_return (invoke "call2" (i32.const 3)) (i64.const 7049447333422008362))
+(assert_return (invoke "call2" (i32.const 20000)) (i64.const 6223294564116555063))
+(assert_return (invoke "call3" (i32.const 1)) (i64.const -150869221041518371))
+(assert_return (invoke "call3" (i32.const 3)) (i64.const -1312584998413358340))
+(assert_return (invoke "call3" (i32.const 20000)) (i64.const 4149480941384545537))
+(assert_return (invoke "call4" (i32.const 1)) (i64.const -7616066871327361365))
+(assert_return (invoke "call4" (i32.const 3)) (i64.const -6281334875856991720))
+(assert_return (invoke "call4" (i32.const 20000)) (i64.const 8849523547027169730))
+(assert_return (invoke "call5" (i32.const 1)) (i64.const -6814344820001552374))
+(assert_return (invoke "call5" (i32.const 3)) (i64.const -6882113686222861267))
+(assert_return (invoke "call5" (i32.const 20000)) (i64.const -9038810190066347732))
+(assert_return (invoke "call6" (i32.const 1)) (i64.const 8460339645139444559))
+(assert_return (invoke "call6" (i32.const 3)) (i64.const -3509084374713407563))
+(assert_return (invoke "call6" (i32.const 20000)) (i64.const -4540405193995465402))
+(assert_return (invoke "nested" (i64.const 0) (f64.const 0.0)) (i64.const -3348083937453264428))
+(assert_return (invoke "nested" (i64.const -7) (f64.const 2.5)) (i64.const -8427054081095842933))
+(assert_return (invoke "nested" (i64.const 9223372036854775807) (f64.const -10000000000.0)) (i64.const 5734375485928768862))
@@ -0,0 +1,39 @@
+;; Run with -instances N -concurrent the instances make each call at the same time on threads of their own, so they race
+;; to compile the functions on first call, go through the compile stubs together and tier up the loops while the others
+;; are still running the baseline code.  The globals are per instance so each must see only its own increments.
+(module
+  (global $g (mut i32) (i32.const 0))
+  (func $inc (param i32) (result i32) (i32.add (get_local 0) (i32.const 3)))
+  (func $dbl (param i32) (result i32) (i32.shl (get_local 0) (i32.const 1)))
+  (func $mix (param i32) (result i32) (i32.xor (call $inc (get_local 0)) (call $dbl (get_local 0))))
+
+  (func (export "loop") (param $n i32) (result i32)
+    (local $i i32) (local $s i32)
+    (block $done
+      (loop $top
+        (br_if $done (i32.ge_u (get_local $i) (get_local $n)))
+        (set_local $s (call $inc (i32.add (get_local $s) (get_local $i))))
+        (set_global $g (i32.add (get_global $g) (i32.const 1)))
+        (set_local $i (i32.add (get_local $i) (i32.const 1)))
+        (br $top)))
+    (get_local $s))
+
+  (func (export "calls") (param $n i32) (result i32)
+    (local $s i32)
+    (block $done
+      (loop $top
+        (br_if $done (i32.eqz (get_local $n)))
+        (set_local $s (i32.add (get_local $s) (call $mix (get_local $n))))
+        (set_local $s (i32.add (get_local $s) (call $dbl (get_local $n))))
+        (set_global $g (i32.add (get_global $g) (i32.const 1)))
+        (set_local $n (i32.sub (get_local $n) (i32.const 1)))
+        (br $top)))
+    (get_local $s))
+
+  (func (export "g") (result i32) (get_global $g))
+)
+(assert_return (invoke "loop" (i32.const 100000)) (i32.const 705282704))
+(assert_return (invoke "loop" (i32.const 100000)) (i32.const 705282704))
+(assert_return (invoke "g") (i32.const 200000))
+(assert_return (invoke "calls" (i32.const 50000)) (i32.const 1228080040))
+(assert_return (invoke "g") (i32.const 250000))
@@ -0,0 +1,936 @@
+;; Division by a constant that directly precedes it is lowered to shifts and multiplies.  Each function divides its
+;; argument by one constant, the dividends cover the edges of the signed and unsigned ranges, and 0 and -1 must still
+;; trap the way the hardware divide does.
+(module
+  (func (export "i32.div_s 1") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const 1)))
+  (func (export "i32.div_s 2") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const 2)))
+  (func (export "i32.div_s 3") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const 3)))
+  (func (export "i32.div_s 7") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const 7)))
+  (func (export "i32.div_s -7") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const -7)))
+  (func (export "i32.div_s -2147483648") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const -2147483648)))
+  (func (export "i32.div_s 0") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const 0)))
+  (func (export "i32.div_s -1") (param $x i32) (result i32) (i32.div_s (get_local $x) (i32.const -1)))
+
+  (func (export "i32.div_u 1") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const 1)))
+  (func (export "i32.div_u 2") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const 2)))
+  (func (export "i32.div_u 3") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const 3)))
+  (func (export "i32.div_u 7") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const 7)))
+  (func (export "i32.div_u -7") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const -7)))
+  (func (export "i32.div_u -2147483648") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const -2147483648)))
+  (func (export "i32.div_u 0") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const 0)))
+  (func (export "i32.div_u -1") (param $x i32) (result i32) (i32.div_u (get_local $x) (i32.const -1)))
+
+  (func (export "i32.rem_s 1") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const 1)))
+  (func (export "i32.rem_s 2") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const 2)))
+  (func (export "i32.rem_s 3") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const 3)))
+  (func (export "i32.rem_s 7") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const 7)))
+  (func (export "i32.rem_s -7") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const -7)))
+  (func (export "i32.rem_s -2147483648") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const -2147483648)))
+  (func (export "i32.rem_s 0") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const 0)))
+  (func (export "i32.rem_s -1") (param $x i32) (result i32) (i32.rem_s (get_local $x) (i32.const -1)))
+
+  (func (export "i32.rem_u 1") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const 1)))
+  (func (export "i32.rem_u 2") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const 2)))
+  (func (export "i32.rem_u 3") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const 3)))
+  (func (export "i32.rem_u 7") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const 7)))
+  (func (export "i32.rem_u -7") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const -7)))
+  (func (export "i32.rem_u -2147483648") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const -2147483648)))
+  (func (export "i32.rem_u 0") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const 0)))
+  (func (export "i32.rem_u -1") (param $x i32) (result i32) (i32.rem_u (get_local $x) (i32.const -1)))
+
+  (func (export "i64.div_s 1") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const 1)))
+  (func (export "i64.div_s 2") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const 2)))
+  (func (export "i64.div_s 3") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const 3)))
+  (func (export "i64.div_s 7") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const 7)))
+  (func (export "i64.div_s -7") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const -7)))
+  (func (export "i64.div_s 2147483648") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const 2147483648)))
+  (func (export "i64.div_s -9223372036854775808") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const -9223372036854775808)))
+  (func (export "i64.div_s 0") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const 0)))
+  (func (export "i64.div_s -1") (param $x i64) (result i64) (i64.div_s (get_local $x) (i64.const -1)))
+
+  (func (export "i64.div_u 1") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const 1)))
+  (func (export "i64.div_u 2") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const 2)))
+  (func (export "i64.div_u 3") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const 3)))
+  (func (export "i64.div_u 7") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const 7)))
+  (func (export "i64.div_u -7") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const -7)))
+  (func (export "i64.div_u 2147483648") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const 2147483648)))
+  (func (export "i64.div_u -9223372036854775808") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const -9223372036854775808)))
+  (func (export "i64.div_u 0") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const 0)))
+  (func (export "i64.div_u -1") (param $x i64) (result i64) (i64.div_u (get_local $x) (i64.const -1)))
+
+  (func (export "i64.rem_s 1") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const 1)))
+  (func (export "i64.rem_s 2") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const 2)))
+  (func (export "i64.rem_s 3") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const 3)))
+  (func (export "i64.rem_s 7") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const 7)))
+  (func (export "i64.rem_s -7") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const -7)))
+  (func (export "i64.rem_s 2147483648") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const 2147483648)))
+  (func (export "i64.rem_s -9223372036854775808") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const -9223372036854775808)))
+  (func (export "i64.rem_s 0") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const 0)))
+  (func (export "i64.rem_s -1") (param $x i64) (result i64) (i64.rem_s (get_local $x) (i64.const -1)))
+
+  (func (export "i64.rem_u 1") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const 1)))
+  (func (export "i64.rem_u 2") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const 2)))
+  (func (export "i64.rem_u 3") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const 3)))
+  (func (export "i64.rem_u 7") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const 7)))
+  (func (export "i64.rem_u -7") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const -7)))
+  (func (export "i64.rem_u 2147483648") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const 2147483648)))
+  (func (export "i64.rem_u -9223372036854775808") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const -9223372036854775808)))
+  (func (export "i64.rem_u 0") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const 0)))
+  (func (export "i64.rem_u -1") (param $x i64) (result i64) (i64.rem_u (get_local $x) (i64.const -1))))
+
+(assert_return (invoke "i32.div_s 1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s 1" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.div_s 1" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.div_s 1" (i32.const 7)) (i32.const 7))
+(assert_return (invoke "i32.div_s 1" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "i32.div_s 1" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.div_s 1" (i32.const -7)) (i32.const -7))
+(assert_return (invoke "i32.div_s 1" (i32.const -100)) (i32.const -100))
+(assert_return (invoke "i32.div_s 1" (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "i32.div_s 1" (i32.const -2147483648)) (i32.const -2147483648))
+(assert_return (invoke "i32.div_s 1" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.div_s 2" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s 2" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 2" (i32.const 6)) (i32.const 3))
+(assert_return (invoke "i32.div_s 2" (i32.const 7)) (i32.const 3))
+(assert_return (invoke "i32.div_s 2" (i32.const 100)) (i32.const 50))
+(assert_return (invoke "i32.div_s 2" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 2" (i32.const -7)) (i32.const -3))
+(assert_return (invoke "i32.div_s 2" (i32.const -100)) (i32.const -50))
+(assert_return (invoke "i32.div_s 2" (i32.const 2147483647)) (i32.const 1073741823))
+(assert_return (invoke "i32.div_s 2" (i32.const -2147483648)) (i32.const -1073741824))
+(assert_return (invoke "i32.div_s 2" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 3" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s 3" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 3" (i32.const 6)) (i32.const 2))
+(assert_return (invoke "i32.div_s 3" (i32.const 7)) (i32.const 2))
+(assert_return (invoke "i32.div_s 3" (i32.const 100)) (i32.const 33))
+(assert_return (invoke "i32.div_s 3" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 3" (i32.const -7)) (i32.const -2))
+(assert_return (invoke "i32.div_s 3" (i32.const -100)) (i32.const -33))
+(assert_return (invoke "i32.div_s 3" (i32.const 2147483647)) (i32.const 715827882))
+(assert_return (invoke "i32.div_s 3" (i32.const -2147483648)) (i32.const -715827882))
+(assert_return (invoke "i32.div_s 3" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s 7" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 7" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_s 7" (i32.const 7)) (i32.const 1))
+(assert_return (invoke "i32.div_s 7" (i32.const 100)) (i32.const 14))
+(assert_return (invoke "i32.div_s 7" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s 7" (i32.const -7)) (i32.const -1))
+(assert_return (invoke "i32.div_s 7" (i32.const -100)) (i32.const -14))
+(assert_return (invoke "i32.div_s 7" (i32.const 2147483647)) (i32.const 306783378))
+(assert_return (invoke "i32.div_s 7" (i32.const -2147483648)) (i32.const -306783378))
+(assert_return (invoke "i32.div_s 7" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s -7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s -7" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_s -7" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_s -7" (i32.const 7)) (i32.const -1))
+(assert_return (invoke "i32.div_s -7" (i32.const 100)) (i32.const -14))
+(assert_return (invoke "i32.div_s -7" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s -7" (i32.const -7)) (i32.const 1))
+(assert_return (invoke "i32.div_s -7" (i32.const -100)) (i32.const 14))
+(assert_return (invoke "i32.div_s -7" (i32.const 2147483647)) (i32.const -306783378))
+(assert_return (invoke "i32.div_s -7" (i32.const -2147483648)) (i32.const 306783378))
+(assert_return (invoke "i32.div_s -7" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const -2147483648)) (i32.const 1))
+(assert_return (invoke "i32.div_s -2147483648" (i32.const -1)) (i32.const 0))
+(assert_trap (invoke "i32.div_s 0" (i32.const 0)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const 1)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const 6)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const 7)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const 100)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const -1)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const -7)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const -100)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const -2147483648)) "integer divide by zero")
+(assert_trap (invoke "i32.div_s 0" (i32.const -1)) "integer divide by zero")
+(assert_return (invoke "i32.div_s -1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_s -1" (i32.const 1)) (i32.const -1))
+(assert_return (invoke "i32.div_s -1" (i32.const 6)) (i32.const -6))
+(assert_return (invoke "i32.div_s -1" (i32.const 7)) (i32.const -7))
+(assert_return (invoke "i32.div_s -1" (i32.const 100)) (i32.const -100))
+(assert_return (invoke "i32.div_s -1" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.div_s -1" (i32.const -7)) (i32.const 7))
+(assert_return (invoke "i32.div_s -1" (i32.const -100)) (i32.const 100))
+(assert_return (invoke "i32.div_s -1" (i32.const 2147483647)) (i32.const -2147483647))
+(assert_trap (invoke "i32.div_s -1" (i32.const -2147483648)) "integer overflow")
+(assert_return (invoke "i32.div_s -1" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.div_u 1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u 1" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.div_u 1" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.div_u 1" (i32.const 7)) (i32.const 7))
+(assert_return (invoke "i32.div_u 1" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "i32.div_u 1" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.div_u 1" (i32.const -7)) (i32.const -7))
+(assert_return (invoke "i32.div_u 1" (i32.const -100)) (i32.const -100))
+(assert_return (invoke "i32.div_u 1" (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "i32.div_u 1" (i32.const -2147483648)) (i32.const -2147483648))
+(assert_return (invoke "i32.div_u 1" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.div_u 2" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u 2" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_u 2" (i32.const 6)) (i32.const 3))
+(assert_return (invoke "i32.div_u 2" (i32.const 7)) (i32.const 3))
+(assert_return (invoke "i32.div_u 2" (i32.const 100)) (i32.const 50))
+(assert_return (invoke "i32.div_u 2" (i32.const -1)) (i32.const 2147483647))
+(assert_return (invoke "i32.div_u 2" (i32.const -7)) (i32.const 2147483644))
+(assert_return (invoke "i32.div_u 2" (i32.const -100)) (i32.const 2147483598))
+(assert_return (invoke "i32.div_u 2" (i32.const 2147483647)) (i32.const 1073741823))
+(assert_return (invoke "i32.div_u 2" (i32.const -2147483648)) (i32.const 1073741824))
+(assert_return (invoke "i32.div_u 2" (i32.const -1)) (i32.const 2147483647))
+(assert_return (invoke "i32.div_u 3" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u 3" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_u 3" (i32.const 6)) (i32.const 2))
+(assert_return (invoke "i32.div_u 3" (i32.const 7)) (i32.const 2))
+(assert_return (invoke "i32.div_u 3" (i32.const 100)) (i32.const 33))
+(assert_return (invoke "i32.div_u 3" (i32.const -1)) (i32.const 1431655765))
+(assert_return (invoke "i32.div_u 3" (i32.const -7)) (i32.const 1431655763))
+(assert_return (invoke "i32.div_u 3" (i32.const -100)) (i32.const 1431655732))
+(assert_return (invoke "i32.div_u 3" (i32.const 2147483647)) (i32.const 715827882))
+(assert_return (invoke "i32.div_u 3" (i32.const -2147483648)) (i32.const 715827882))
+(assert_return (invoke "i32.div_u 3" (i32.const -1)) (i32.const 1431655765))
+(assert_return (invoke "i32.div_u 7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u 7" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_u 7" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_u 7" (i32.const 7)) (i32.const 1))
+(assert_return (invoke "i32.div_u 7" (i32.const 100)) (i32.const 14))
+(assert_return (invoke "i32.div_u 7" (i32.const -1)) (i32.const 613566756))
+(assert_return (invoke "i32.div_u 7" (i32.const -7)) (i32.const 613566755))
+(assert_return (invoke "i32.div_u 7" (i32.const -100)) (i32.const 613566742))
+(assert_return (invoke "i32.div_u 7" (i32.const 2147483647)) (i32.const 306783378))
+(assert_return (invoke "i32.div_u 7" (i32.const -2147483648)) (i32.const 306783378))
+(assert_return (invoke "i32.div_u 7" (i32.const -1)) (i32.const 613566756))
+(assert_return (invoke "i32.div_u -7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.div_u -7" (i32.const -7)) (i32.const 1))
+(assert_return (invoke "i32.div_u -7" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.div_u -7" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const -7)) (i32.const 1))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const -100)) (i32.const 1))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const -2147483648)) (i32.const 1))
+(assert_return (invoke "i32.div_u -2147483648" (i32.const -1)) (i32.const 1))
+(assert_trap (invoke "i32.div_u 0" (i32.const 0)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const 1)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const 6)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const 7)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const 100)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const -1)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const -7)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const -100)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const -2147483648)) "integer divide by zero")
+(assert_trap (invoke "i32.div_u 0" (i32.const -1)) "integer divide by zero")
+(assert_return (invoke "i32.div_u -1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.div_u -1" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.div_u -1" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 2" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 2" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 2" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 2" (i32.const 7)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 2" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 2" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 2" (i32.const -7)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 2" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 2" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 2" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 2" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 3" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 3" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 3" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 3" (i32.const 7)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 3" (i32.const 100)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 3" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 3" (i32.const -7)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 3" (i32.const -100)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 3" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 3" (i32.const -2147483648)) (i32.const -2))
+(assert_return (invoke "i32.rem_s 3" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 7" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 7" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_s 7" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 7" (i32.const 100)) (i32.const 2))
+(assert_return (invoke "i32.rem_s 7" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s 7" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s 7" (i32.const -100)) (i32.const -2))
+(assert_return (invoke "i32.rem_s 7" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_s 7" (i32.const -2147483648)) (i32.const -2))
+(assert_return (invoke "i32.rem_s 7" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s -7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -7" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_s -7" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_s -7" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -7" (i32.const 100)) (i32.const 2))
+(assert_return (invoke "i32.rem_s -7" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s -7" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -7" (i32.const -100)) (i32.const -2))
+(assert_return (invoke "i32.rem_s -7" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_s -7" (i32.const -2147483648)) (i32.const -2))
+(assert_return (invoke "i32.rem_s -7" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const 7)) (i32.const 7))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const -1)) (i32.const -1))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const -7)) (i32.const -7))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const -100)) (i32.const -100))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -2147483648" (i32.const -1)) (i32.const -1))
+(assert_trap (invoke "i32.rem_s 0" (i32.const 0)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const 1)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const 6)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const 7)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const 100)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const -1)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const -7)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const -100)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const -2147483648)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_s 0" (i32.const -1)) "integer divide by zero")
+(assert_return (invoke "i32.rem_s -1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_s -1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 2" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 2" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 2" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 2" (i32.const 7)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 2" (i32.const 100)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 2" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 2" (i32.const -7)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 2" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 2" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 2" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 2" (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 3" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 3" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 3" (i32.const 6)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 3" (i32.const 7)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 3" (i32.const 100)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 3" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 3" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 3" (i32.const -100)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 3" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 3" (i32.const -2147483648)) (i32.const 2))
+(assert_return (invoke "i32.rem_u 3" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 7" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 7" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_u 7" (i32.const 7)) (i32.const 0))
+(assert_return (invoke "i32.rem_u 7" (i32.const 100)) (i32.const 2))
+(assert_return (invoke "i32.rem_u 7" (i32.const -1)) (i32.const 3))
+(assert_return (invoke "i32.rem_u 7" (i32.const -7)) (i32.const 4))
+(assert_return (invoke "i32.rem_u 7" (i32.const -100)) (i32.const 2))
+(assert_return (invoke "i32.rem_u 7" (i32.const 2147483647)) (i32.const 1))
+(assert_return (invoke "i32.rem_u 7" (i32.const -2147483648)) (i32.const 2))
+(assert_return (invoke "i32.rem_u 7" (i32.const -1)) (i32.const 3))
+(assert_return (invoke "i32.rem_u -7" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u -7" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u -7" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_u -7" (i32.const 7)) (i32.const 7))
+(assert_return (invoke "i32.rem_u -7" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "i32.rem_u -7" (i32.const -1)) (i32.const 6))
+(assert_return (invoke "i32.rem_u -7" (i32.const -7)) (i32.const 0))
+(assert_return (invoke "i32.rem_u -7" (i32.const -100)) (i32.const -100))
+(assert_return (invoke "i32.rem_u -7" (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "i32.rem_u -7" (i32.const -2147483648)) (i32.const -2147483648))
+(assert_return (invoke "i32.rem_u -7" (i32.const -1)) (i32.const 6))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const 7)) (i32.const 7))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const -1)) (i32.const 2147483647))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const -7)) (i32.const 2147483641))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const -100)) (i32.const 2147483548))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "i32.rem_u -2147483648" (i32.const -1)) (i32.const 2147483647))
+(assert_trap (invoke "i32.rem_u 0" (i32.const 0)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const 1)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const 6)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const 7)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const 100)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const -1)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const -7)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const -100)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const -2147483648)) "integer divide by zero")
+(assert_trap (invoke "i32.rem_u 0" (i32.const -1)) "integer divide by zero")
+(assert_return (invoke "i32.rem_u -1" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.rem_u -1" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "i32.rem_u -1" (i32.const 6)) (i32.const 6))
+(assert_return (invoke "i32.rem_u -1" (i32.const 7)) (i32.const 7))
+(assert_return (invoke "i32.rem_u -1" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "i32.rem_u -1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.rem_u -1" (i32.const -7)) (i32.const -7))
+(assert_return (invoke "i32.rem_u -1" (i32.const -100)) (i32.const -100))
+(assert_return (invoke "i32.rem_u -1" (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "i32.rem_u -1" (i32.const -2147483648)) (i32.const -2147483648))
+(assert_return (invoke "i32.rem_u -1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i64.div_s 1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s 1" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.div_s 1" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.div_s 1" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.div_s 1" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.div_s 1" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.div_s 1" (i64.const -7)) (i64.const -7))
+(assert_return (invoke "i64.div_s 1" (i64.const -100)) (i64.const -100))
+(assert_return (invoke "i64.div_s 1" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.div_s 1" (i64.const 2147483648)) (i64.const 2147483648))
+(assert_return (invoke "i64.div_s 1" (i64.const 4294967295)) (i64.const 4294967295))
+(assert_return (invoke "i64.div_s 1" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.div_s 1" (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.div_s 1" (i64.const 1311768467463790320)) (i64.const 1311768467463790320))
+(assert_return (invoke "i64.div_s 2" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2" (i64.const 6)) (i64.const 3))
+(assert_return (invoke "i64.div_s 2" (i64.const 7)) (i64.const 3))
+(assert_return (invoke "i64.div_s 2" (i64.const 100)) (i64.const 50))
+(assert_return (invoke "i64.div_s 2" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2" (i64.const -7)) (i64.const -3))
+(assert_return (invoke "i64.div_s 2" (i64.const -100)) (i64.const -50))
+(assert_return (invoke "i64.div_s 2" (i64.const 2147483647)) (i64.const 1073741823))
+(assert_return (invoke "i64.div_s 2" (i64.const 2147483648)) (i64.const 1073741824))
+(assert_return (invoke "i64.div_s 2" (i64.const 4294967295)) (i64.const 2147483647))
+(assert_return (invoke "i64.div_s 2" (i64.const 9223372036854775807)) (i64.const 4611686018427387903))
+(assert_return (invoke "i64.div_s 2" (i64.const -9223372036854775808)) (i64.const -4611686018427387904))
+(assert_return (invoke "i64.div_s 2" (i64.const 1311768467463790320)) (i64.const 655884233731895160))
+(assert_return (invoke "i64.div_s 3" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s 3" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 3" (i64.const 6)) (i64.const 2))
+(assert_return (invoke "i64.div_s 3" (i64.const 7)) (i64.const 2))
+(assert_return (invoke "i64.div_s 3" (i64.const 100)) (i64.const 33))
+(assert_return (invoke "i64.div_s 3" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 3" (i64.const -7)) (i64.const -2))
+(assert_return (invoke "i64.div_s 3" (i64.const -100)) (i64.const -33))
+(assert_return (invoke "i64.div_s 3" (i64.const 2147483647)) (i64.const 715827882))
+(assert_return (invoke "i64.div_s 3" (i64.const 2147483648)) (i64.const 715827882))
+(assert_return (invoke "i64.div_s 3" (i64.const 4294967295)) (i64.const 1431655765))
+(assert_return (invoke "i64.div_s 3" (i64.const 9223372036854775807)) (i64.const 3074457345618258602))
+(assert_return (invoke "i64.div_s 3" (i64.const -9223372036854775808)) (i64.const -3074457345618258602))
+(assert_return (invoke "i64.div_s 3" (i64.const 1311768467463790320)) (i64.const 437256155821263440))
+(assert_return (invoke "i64.div_s 7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s 7" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 7" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_s 7" (i64.const 7)) (i64.const 1))
+(assert_return (invoke "i64.div_s 7" (i64.const 100)) (i64.const 14))
+(assert_return (invoke "i64.div_s 7" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 7" (i64.const -7)) (i64.const -1))
+(assert_return (invoke "i64.div_s 7" (i64.const -100)) (i64.const -14))
+(assert_return (invoke "i64.div_s 7" (i64.const 2147483647)) (i64.const 306783378))
+(assert_return (invoke "i64.div_s 7" (i64.const 2147483648)) (i64.const 306783378))
+(assert_return (invoke "i64.div_s 7" (i64.const 4294967295)) (i64.const 613566756))
+(assert_return (invoke "i64.div_s 7" (i64.const 9223372036854775807)) (i64.const 1317624576693539401))
+(assert_return (invoke "i64.div_s 7" (i64.const -9223372036854775808)) (i64.const -1317624576693539401))
+(assert_return (invoke "i64.div_s 7" (i64.const 1311768467463790320)) (i64.const 187395495351970045))
+(assert_return (invoke "i64.div_s -7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s -7" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_s -7" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_s -7" (i64.const 7)) (i64.const -1))
+(assert_return (invoke "i64.div_s -7" (i64.const 100)) (i64.const -14))
+(assert_return (invoke "i64.div_s -7" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.div_s -7" (i64.const -7)) (i64.const 1))
+(assert_return (invoke "i64.div_s -7" (i64.const -100)) (i64.const 14))
+(assert_return (invoke "i64.div_s -7" (i64.const 2147483647)) (i64.const -306783378))
+(assert_return (invoke "i64.div_s -7" (i64.const 2147483648)) (i64.const -306783378))
+(assert_return (invoke "i64.div_s -7" (i64.const 4294967295)) (i64.const -613566756))
+(assert_return (invoke "i64.div_s -7" (i64.const 9223372036854775807)) (i64.const -1317624576693539401))
+(assert_return (invoke "i64.div_s -7" (i64.const -9223372036854775808)) (i64.const 1317624576693539401))
+(assert_return (invoke "i64.div_s -7" (i64.const 1311768467463790320)) (i64.const -187395495351970045))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 2147483648)) (i64.const 1))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 4294967295)) (i64.const 1))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 9223372036854775807)) (i64.const 4294967295))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const -9223372036854775808)) (i64.const -4294967296))
+(assert_return (invoke "i64.div_s 2147483648" (i64.const 1311768467463790320)) (i64.const 610839793))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const -9223372036854775808)) (i64.const 1))
+(assert_return (invoke "i64.div_s -9223372036854775808" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_trap (invoke "i64.div_s 0" (i64.const 0)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 1)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 6)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 7)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 100)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const -1)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const -7)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const -100)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 2147483648)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 4294967295)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 9223372036854775807)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const -9223372036854775808)) "integer divide by zero")
+(assert_trap (invoke "i64.div_s 0" (i64.const 1311768467463790320)) "integer divide by zero")
+(assert_return (invoke "i64.div_s -1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_s -1" (i64.const 1)) (i64.const -1))
+(assert_return (invoke "i64.div_s -1" (i64.const 6)) (i64.const -6))
+(assert_return (invoke "i64.div_s -1" (i64.const 7)) (i64.const -7))
+(assert_return (invoke "i64.div_s -1" (i64.const 100)) (i64.const -100))
+(assert_return (invoke "i64.div_s -1" (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.div_s -1" (i64.const -7)) (i64.const 7))
+(assert_return (invoke "i64.div_s -1" (i64.const -100)) (i64.const 100))
+(assert_return (invoke "i64.div_s -1" (i64.const 2147483647)) (i64.const -2147483647))
+(assert_return (invoke "i64.div_s -1" (i64.const 2147483648)) (i64.const -2147483648))
+(assert_return (invoke "i64.div_s -1" (i64.const 4294967295)) (i64.const -4294967295))
+(assert_return (invoke "i64.div_s -1" (i64.const 9223372036854775807)) (i64.const -9223372036854775807))
+(assert_trap (invoke "i64.div_s -1" (i64.const -9223372036854775808)) "integer overflow")
+(assert_return (invoke "i64.div_s -1" (i64.const 1311768467463790320)) (i64.const -1311768467463790320))
+(assert_return (invoke "i64.div_u 1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u 1" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.div_u 1" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.div_u 1" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.div_u 1" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.div_u 1" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.div_u 1" (i64.const -7)) (i64.const -7))
+(assert_return (invoke "i64.div_u 1" (i64.const -100)) (i64.const -100))
+(assert_return (invoke "i64.div_u 1" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.div_u 1" (i64.const 2147483648)) (i64.const 2147483648))
+(assert_return (invoke "i64.div_u 1" (i64.const 4294967295)) (i64.const 4294967295))
+(assert_return (invoke "i64.div_u 1" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.div_u 1" (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.div_u 1" (i64.const 1311768467463790320)) (i64.const 1311768467463790320))
+(assert_return (invoke "i64.div_u 2" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2" (i64.const 6)) (i64.const 3))
+(assert_return (invoke "i64.div_u 2" (i64.const 7)) (i64.const 3))
+(assert_return (invoke "i64.div_u 2" (i64.const 100)) (i64.const 50))
+(assert_return (invoke "i64.div_u 2" (i64.const -1)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.div_u 2" (i64.const -7)) (i64.const 9223372036854775804))
+(assert_return (invoke "i64.div_u 2" (i64.const -100)) (i64.const 9223372036854775758))
+(assert_return (invoke "i64.div_u 2" (i64.const 2147483647)) (i64.const 1073741823))
+(assert_return (invoke "i64.div_u 2" (i64.const 2147483648)) (i64.const 1073741824))
+(assert_return (invoke "i64.div_u 2" (i64.const 4294967295)) (i64.const 2147483647))
+(assert_return (invoke "i64.div_u 2" (i64.const 9223372036854775807)) (i64.const 4611686018427387903))
+(assert_return (invoke "i64.div_u 2" (i64.const -9223372036854775808)) (i64.const 4611686018427387904))
+(assert_return (invoke "i64.div_u 2" (i64.const 1311768467463790320)) (i64.const 655884233731895160))
+(assert_return (invoke "i64.div_u 3" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u 3" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u 3" (i64.const 6)) (i64.const 2))
+(assert_return (invoke "i64.div_u 3" (i64.const 7)) (i64.const 2))
+(assert_return (invoke "i64.div_u 3" (i64.const 100)) (i64.const 33))
+(assert_return (invoke "i64.div_u 3" (i64.const -1)) (i64.const 6148914691236517205))
+(assert_return (invoke "i64.div_u 3" (i64.const -7)) (i64.const 6148914691236517203))
+(assert_return (invoke "i64.div_u 3" (i64.const -100)) (i64.const 6148914691236517172))
+(assert_return (invoke "i64.div_u 3" (i64.const 2147483647)) (i64.const 715827882))
+(assert_return (invoke "i64.div_u 3" (i64.const 2147483648)) (i64.const 715827882))
+(assert_return (invoke "i64.div_u 3" (i64.const 4294967295)) (i64.const 1431655765))
+(assert_return (invoke "i64.div_u 3" (i64.const 9223372036854775807)) (i64.const 3074457345618258602))
+(assert_return (invoke "i64.div_u 3" (i64.const -9223372036854775808)) (i64.const 3074457345618258602))
+(assert_return (invoke "i64.div_u 3" (i64.const 1311768467463790320)) (i64.const 437256155821263440))
+(assert_return (invoke "i64.div_u 7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u 7" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u 7" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_u 7" (i64.const 7)) (i64.const 1))
+(assert_return (invoke "i64.div_u 7" (i64.const 100)) (i64.const 14))
+(assert_return (invoke "i64.div_u 7" (i64.const -1)) (i64.const 2635249153387078802))
+(assert_return (invoke "i64.div_u 7" (i64.const -7)) (i64.const 2635249153387078801))
+(assert_return (invoke "i64.div_u 7" (i64.const -100)) (i64.const 2635249153387078788))
+(assert_return (invoke "i64.div_u 7" (i64.const 2147483647)) (i64.const 306783378))
+(assert_return (invoke "i64.div_u 7" (i64.const 2147483648)) (i64.const 306783378))
+(assert_return (invoke "i64.div_u 7" (i64.const 4294967295)) (i64.const 613566756))
+(assert_return (invoke "i64.div_u 7" (i64.const 9223372036854775807)) (i64.const 1317624576693539401))
+(assert_return (invoke "i64.div_u 7" (i64.const -9223372036854775808)) (i64.const 1317624576693539401))
+(assert_return (invoke "i64.div_u 7" (i64.const 1311768467463790320)) (i64.const 187395495351970045))
+(assert_return (invoke "i64.div_u -7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.div_u -7" (i64.const -7)) (i64.const 1))
+(assert_return (invoke "i64.div_u -7" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.div_u -7" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const -1)) (i64.const 8589934591))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const -7)) (i64.const 8589934591))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const -100)) (i64.const 8589934591))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 2147483648)) (i64.const 1))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 4294967295)) (i64.const 1))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 9223372036854775807)) (i64.const 4294967295))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const -9223372036854775808)) (i64.const 4294967296))
+(assert_return (invoke "i64.div_u 2147483648" (i64.const 1311768467463790320)) (i64.const 610839793))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const -7)) (i64.const 1))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const -100)) (i64.const 1))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const -9223372036854775808)) (i64.const 1))
+(assert_return (invoke "i64.div_u -9223372036854775808" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_trap (invoke "i64.div_u 0" (i64.const 0)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 1)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 6)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 7)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 100)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const -1)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const -7)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const -100)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 2147483648)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 4294967295)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 9223372036854775807)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const -9223372036854775808)) "integer divide by zero")
+(assert_trap (invoke "i64.div_u 0" (i64.const 1311768467463790320)) "integer divide by zero")
+(assert_return (invoke "i64.div_u -1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.div_u -1" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.div_u -1" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 1" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 2" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const 7)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 2" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 2" (i64.const -7)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 2" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 2" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const 4294967295)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 2" (i64.const 9223372036854775807)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 2" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 3" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 3" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 3" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 3" (i64.const 7)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 3" (i64.const 100)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 3" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 3" (i64.const -7)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 3" (i64.const -100)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 3" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 3" (i64.const 2147483648)) (i64.const 2))
+(assert_return (invoke "i64.rem_s 3" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 3" (i64.const 9223372036854775807)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 3" (i64.const -9223372036854775808)) (i64.const -2))
+(assert_return (invoke "i64.rem_s 3" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 7" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 7" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_s 7" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 7" (i64.const 100)) (i64.const 2))
+(assert_return (invoke "i64.rem_s 7" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 7" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 7" (i64.const -100)) (i64.const -2))
+(assert_return (invoke "i64.rem_s 7" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 7" (i64.const 2147483648)) (i64.const 2))
+(assert_return (invoke "i64.rem_s 7" (i64.const 4294967295)) (i64.const 3))
+(assert_return (invoke "i64.rem_s 7" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 7" (i64.const -9223372036854775808)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 7" (i64.const 1311768467463790320)) (i64.const 5))
+(assert_return (invoke "i64.rem_s -7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -7" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_s -7" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_s -7" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -7" (i64.const 100)) (i64.const 2))
+(assert_return (invoke "i64.rem_s -7" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.rem_s -7" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -7" (i64.const -100)) (i64.const -2))
+(assert_return (invoke "i64.rem_s -7" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_s -7" (i64.const 2147483648)) (i64.const 2))
+(assert_return (invoke "i64.rem_s -7" (i64.const 4294967295)) (i64.const 3))
+(assert_return (invoke "i64.rem_s -7" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -7" (i64.const -9223372036854775808)) (i64.const -1))
+(assert_return (invoke "i64.rem_s -7" (i64.const 1311768467463790320)) (i64.const 5))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const -7)) (i64.const -7))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const -100)) (i64.const -100))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 4294967295)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 9223372036854775807)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_s 2147483648" (i64.const 1311768467463790320)) (i64.const 448585456))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const -7)) (i64.const -7))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const -100)) (i64.const -100))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 2147483648)) (i64.const 2147483648))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 4294967295)) (i64.const 4294967295))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -9223372036854775808" (i64.const 1311768467463790320)) (i64.const 1311768467463790320))
+(assert_trap (invoke "i64.rem_s 0" (i64.const 0)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 1)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 6)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 7)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 100)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const -1)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const -7)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const -100)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 2147483648)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 4294967295)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 9223372036854775807)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const -9223372036854775808)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_s 0" (i64.const 1311768467463790320)) "integer divide by zero")
+(assert_return (invoke "i64.rem_s -1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_s -1" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 2147483647)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 1" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const 7)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const 100)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const -7)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const 4294967295)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const 9223372036854775807)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 3" (i64.const 6)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const 7)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 3" (i64.const 100)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 3" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 3" (i64.const 2147483648)) (i64.const 2))
+(assert_return (invoke "i64.rem_u 3" (i64.const 4294967295)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 3" (i64.const 9223372036854775807)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 3" (i64.const -9223372036854775808)) (i64.const 2))
+(assert_return (invoke "i64.rem_u 3" (i64.const 1311768467463790320)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 7" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 7" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_u 7" (i64.const 7)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 7" (i64.const 100)) (i64.const 2))
+(assert_return (invoke "i64.rem_u 7" (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 7" (i64.const -7)) (i64.const 2))
+(assert_return (invoke "i64.rem_u 7" (i64.const -100)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 7" (i64.const 2147483647)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 7" (i64.const 2147483648)) (i64.const 2))
+(assert_return (invoke "i64.rem_u 7" (i64.const 4294967295)) (i64.const 3))
+(assert_return (invoke "i64.rem_u 7" (i64.const 9223372036854775807)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 7" (i64.const -9223372036854775808)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 7" (i64.const 1311768467463790320)) (i64.const 5))
+(assert_return (invoke "i64.rem_u -7" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u -7" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u -7" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_u -7" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.rem_u -7" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.rem_u -7" (i64.const -1)) (i64.const 6))
+(assert_return (invoke "i64.rem_u -7" (i64.const -7)) (i64.const 0))
+(assert_return (invoke "i64.rem_u -7" (i64.const -100)) (i64.const -100))
+(assert_return (invoke "i64.rem_u -7" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u -7" (i64.const 2147483648)) (i64.const 2147483648))
+(assert_return (invoke "i64.rem_u -7" (i64.const 4294967295)) (i64.const 4294967295))
+(assert_return (invoke "i64.rem_u -7" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.rem_u -7" (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.rem_u -7" (i64.const 1311768467463790320)) (i64.const 1311768467463790320))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const -1)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const -7)) (i64.const 2147483641))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const -100)) (i64.const 2147483548))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 2147483648)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 4294967295)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 9223372036854775807)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_u 2147483648" (i64.const 1311768467463790320)) (i64.const 448585456))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const -1)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const -7)) (i64.const 9223372036854775801))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const -100)) (i64.const 9223372036854775708))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 2147483648)) (i64.const 2147483648))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 4294967295)) (i64.const 4294967295))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const -9223372036854775808)) (i64.const 0))
+(assert_return (invoke "i64.rem_u -9223372036854775808" (i64.const 1311768467463790320)) (i64.const 1311768467463790320))
+(assert_trap (invoke "i64.rem_u 0" (i64.const 0)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 1)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 6)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 7)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 100)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const -1)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const -7)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const -100)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 2147483647)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 2147483648)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 4294967295)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 9223372036854775807)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const -9223372036854775808)) "integer divide by zero")
+(assert_trap (invoke "i64.rem_u 0" (i64.const 1311768467463790320)) "integer divide by zero")
+(assert_return (invoke "i64.rem_u -1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.rem_u -1" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.rem_u -1" (i64.const 6)) (i64.const 6))
+(assert_return (invoke "i64.rem_u -1" (i64.const 7)) (i64.const 7))
+(assert_return (invoke "i64.rem_u -1" (i64.const 100)) (i64.const 100))
+(assert_return (invoke "i64.rem_u -1" (i64.const -1)) (i64.const 0))
+(assert_return (invoke "i64.rem_u -1" (i64.const -7)) (i64.const -7))
+(assert_return (invoke "i64.rem_u -1" (i64.const -100)) (i64.const -100))
+(assert_return (invoke "i64.rem_u -1" (i64.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.rem_u -1" (i64.const 2147483648)) (i64.const 2147483648))
+(assert_return (invoke "i64.rem_u -1" (i64.const 4294967295)) (i64.const 4294967295))
+(assert_return (invoke "i64.rem_u -1" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.rem_u -1" (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.rem_u -1" (i64.const 1311768467463790320)) (i64.const 1311768467463790320))
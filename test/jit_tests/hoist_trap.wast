@@ -0,0 +1,41 @@
+;; Loads and divisions that trap must not be hoisted out of a loop ahead of its stores and global writes.  The loops run
+;; long enough to tier up first, then trap on the first trip round.
+(module
+  (memory 1)
+  (global $g (mut i32) (i32.const 0))
+
+  (func (export "div") (param $d i32) (param $n i32) (result i32)
+    (local $i i32) (local $s i32)
+    (i32.store (i32.const 0) (i32.const 0))
+    (loop $top
+      (i32.store (i32.const 0) (i32.add (get_local $i) (i32.const 1)))
+      (set_local $s (i32.add (get_local $s) (i32.div_u (i32.const 100) (get_local $d))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (get_local $s))
+
+  (func (export "load") (param $a i32) (param $n i32) (result i32)
+    (local $i i32) (local $s i32)
+    (set_global $g (i32.const 0))
+    (loop $top
+      (set_global $g (i32.add (get_local $i) (i32.const 1)))
+      (set_local $s (i32.add (get_local $s) (i32.load (get_local $a))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (get_local $s))
+
+  (func (export "mem0") (result i32) (i32.load (i32.const 0)))
+  (func (export "g") (result i32) (get_global $g))
+)
+
+(assert_return (invoke "div" (i32.const 1) (i32.const 30000)) (i32.const 3000000))
+(assert_return (invoke "div" (i32.const 1) (i32.const 30000)) (i32.const 3000000))
+(assert_return (invoke "mem0") (i32.const 30000))
+(assert_trap (invoke "div" (i32.const 0) (i32.const 5)) "integer divide by zero")
+(assert_return (invoke "mem0") (i32.const 1))
+
+(assert_return (invoke "load" (i32.const 0) (i32.const 30000)) (i32.const 30000))
+(assert_return (invoke "load" (i32.const 0) (i32.const 30000)) (i32.const 30000))
+(assert_return (invoke "g") (i32.const 30000))
+(assert_trap (invoke "load" (i32.const 65536) (i32.const 5)) "out of bounds memory access")
+(assert_return (invoke "g") (i32.const 1))
@@ -0,0 +1,192 @@
+;; Value producing if/else diamonds are compiled without branches: both arms run and a cmov picks the result.  The
+;; conditions are pending compares and constants, the arms drop values and read globals, and the loop runs long enough
+;; for the optimizing tier to convert its diamonds as well.
+(module
+  (global $g (mut i32) (i32.const 100))
+  (global $h (mut i64) (i64.const -5))
+  (global $c (mut i32) (i32.const 0))
+
+  (func (export "i32.lt") (param $a i32) (param $b i32) (result i32)
+    (if (result i32) (i32.lt_s (get_local $a) (get_local $b))
+      (then (i32.sub (get_local $b) (get_local $a)))
+      (else (i32.sub (get_local $a) (get_local $b)))))
+
+  (func (export "i32.const1") (param $a i32) (result i32)
+    (if (result i32) (i32.const 1)
+      (then (i32.add (get_local $a) (i32.const 1)))
+      (else (i32.const 7))))
+
+  (func (export "i32.const0") (param $a i32) (result i32)
+    (if (result i32) (i32.const 0)
+      (then (i32.add (get_local $a) (i32.const 1)))
+      (else (i32.const 7))))
+
+  (func (export "i32.drop") (param $a i32) (param $b i32) (result i32)
+    (set_global $g (i32.xor (get_local $a) (get_local $b)))
+    (if (result i32) (i32.ne (get_local $a) (get_local $b))
+      (then (drop (get_local $b)) (get_global $g))
+      (else (i32.add (get_global $g) (i32.const 1)))))
+
+  (func (export "i32.cmparms") (param $a i32) (param $b i32) (result i32)
+    (if (result i32) (i32.eqz (get_local $a))
+      (then (i32.lt_u (get_local $a) (get_local $b)))
+      (else (i32.ge_s (get_local $a) (get_local $b)))))
+
+  (func (export "i64.lt") (param $a i64) (param $b i64) (result i64)
+    (if (result i64) (i64.lt_s (get_local $a) (get_local $b))
+      (then (i64.sub (get_local $b) (get_local $a)))
+      (else (i64.sub (get_local $a) (get_local $b)))))
+
+  (func (export "i64.const1") (param $a i64) (result i64)
+    (if (result i64) (i32.const 1)
+      (then (get_local $a))
+      (else (i64.const 42))))
+
+  (func (export "i64.const0") (param $a i64) (result i64)
+    (if (result i64) (i32.const 0)
+      (then (i64.const 42))
+      (else (i64.mul (get_local $a) (i64.const 3)))))
+
+  (func (export "i64.drop") (param $a i64) (param $b i64) (result i64)
+    (set_global $h (i64.add (get_local $a) (get_local $b)))
+    (if (result i64) (i64.gt_u (get_local $a) (get_local $b))
+      (then (get_global $h))
+      (else (drop (i64.const 9)) (i64.xor (get_global $h) (get_local $a)))))
+
+  (func (export "i64.ext") (param $a i32) (param $b i32) (result i64)
+    (if (result i64) (i32.lt_u (get_local $a) (get_local $b))
+      (then (i64.extend_s/i32 (get_local $a)))
+      (else (i64.extend_u/i32 (get_local $b)))))
+
+  (func (export "nested") (param $a i32) (param $b i32) (result i32)
+    (if (result i32) (i32.lt_s (get_local $a) (get_local $b))
+      (then
+        (if (result i32) (i32.eqz (get_local $a))
+          (then (i32.add (get_local $a) (i32.const 1)))
+          (else (i32.sub (get_local $a) (i32.const 1)))))
+      (else
+        (if (result i32) (i32.gt_s (get_local $b) (i32.const 0))
+          (then (i32.mul (get_local $b) (i32.const 2)))
+          (else (get_local $b))))))
+
+  (func (export "loop") (param $n i32) (result i64)
+    (local $i i32) (local $t i32) (local $u i64)
+    (set_global $c (i32.const 0))
+    (block $done
+      (br_if $done (i32.eqz (get_local $n)))
+      (loop $top
+        (set_global $c (i32.add (get_global $c) (get_local $i)))
+        (set_local $t (i32.add (get_local $t)
+          (if (result i32) (i32.and (get_local $i) (i32.const 1))
+            (then (get_global $c))
+            (else (i32.xor (get_global $c) (get_local $i))))))
+        (set_local $u (i64.add (get_local $u)
+          (if (result i64) (i32.rem_u (get_local $i) (i32.const 3))
+            (then (i64.mul (i64.extend_u/i32 (get_local $i)) (i64.const 5)))
+            (else (drop (get_global $c)) (i64.sub (i64.const 0) (i64.extend_u/i32 (get_local $i)))))))
+        (set_local $i (i32.add (get_local $i) (i32.const 1)))
+        (br_if $top (i32.lt_u (get_local $i) (get_local $n)))))
+    (i64.add (i64.extend_s/i32 (get_local $t)) (get_local $u)))
+)
+
+(assert_return (invoke "i32.lt" (i32.const 0) (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.lt" (i32.const 0) (i32.const 5)) (i32.const 5))
+(assert_return (invoke "i32.lt" (i32.const 5) (i32.const 0)) (i32.const 5))
+(assert_return (invoke "i32.lt" (i32.const 3) (i32.const 9)) (i32.const 6))
+(assert_return (invoke "i32.lt" (i32.const 9) (i32.const 3)) (i32.const 6))
+(assert_return (invoke "i32.lt" (i32.const -1) (i32.const 1)) (i32.const 2))
+(assert_return (invoke "i32.lt" (i32.const 1) (i32.const -1)) (i32.const 2))
+(assert_return (invoke "i32.lt" (i32.const -2147483648) (i32.const 2147483647)) (i32.const -1))
+(assert_return (invoke "i32.lt" (i32.const 2147483647) (i32.const -2147483648)) (i32.const -1))
+(assert_return (invoke "i32.const1" (i32.const 0)) (i32.const 1))
+(assert_return (invoke "i32.const0" (i32.const 0)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const 0)) (i32.const 1))
+(assert_return (invoke "i32.const0" (i32.const 0)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const 5)) (i32.const 6))
+(assert_return (invoke "i32.const0" (i32.const 5)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const 3)) (i32.const 4))
+(assert_return (invoke "i32.const0" (i32.const 3)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const 9)) (i32.const 10))
+(assert_return (invoke "i32.const0" (i32.const 9)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "i32.const0" (i32.const -1)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const 1)) (i32.const 2))
+(assert_return (invoke "i32.const0" (i32.const 1)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const -2147483648)) (i32.const -2147483647))
+(assert_return (invoke "i32.const0" (i32.const -2147483648)) (i32.const 7))
+(assert_return (invoke "i32.const1" (i32.const 2147483647)) (i32.const -2147483648))
+(assert_return (invoke "i32.const0" (i32.const 2147483647)) (i32.const 7))
+(assert_return (invoke "i32.drop" (i32.const 0) (i32.const 0)) (i32.const 1))
+(assert_return (invoke "i32.drop" (i32.const 0) (i32.const 5)) (i32.const 5))
+(assert_return (invoke "i32.drop" (i32.const 5) (i32.const 0)) (i32.const 5))
+(assert_return (invoke "i32.drop" (i32.const 3) (i32.const 9)) (i32.const 10))
+(assert_return (invoke "i32.drop" (i32.const 9) (i32.const 3)) (i32.const 10))
+(assert_return (invoke "i32.drop" (i32.const -1) (i32.const 1)) (i32.const -2))
+(assert_return (invoke "i32.drop" (i32.const 1) (i32.const -1)) (i32.const -2))
+(assert_return (invoke "i32.drop" (i32.const -2147483648) (i32.const 2147483647)) (i32.const -1))
+(assert_return (invoke "i32.drop" (i32.const 2147483647) (i32.const -2147483648)) (i32.const -1))
+(assert_return (invoke "i32.cmparms" (i32.const 0) (i32.const 0)) (i32.const 0))
+(assert_return (invoke "i32.cmparms" (i32.const 0) (i32.const 5)) (i32.const 1))
+(assert_return (invoke "i32.cmparms" (i32.const 5) (i32.const 0)) (i32.const 1))
+(assert_return (invoke "i32.cmparms" (i32.const 3) (i32.const 9)) (i32.const 0))
+(assert_return (invoke "i32.cmparms" (i32.const 9) (i32.const 3)) (i32.const 1))
+(assert_return (invoke "i32.cmparms" (i32.const -1) (i32.const 1)) (i32.const 0))
+(assert_return (invoke "i32.cmparms" (i32.const 1) (i32.const -1)) (i32.const 1))
+(assert_return (invoke "i32.cmparms" (i32.const -2147483648) (i32.const 2147483647)) (i32.const 0))
+(assert_return (invoke "i32.cmparms" (i32.const 2147483647) (i32.const -2147483648)) (i32.const 1))
+(assert_return (invoke "i64.lt" (i64.const 0) (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.lt" (i64.const 0) (i64.const 5)) (i64.const 5))
+(assert_return (invoke "i64.lt" (i64.const 5) (i64.const 0)) (i64.const 5))
+(assert_return (invoke "i64.lt" (i64.const -1) (i64.const 1)) (i64.const 2))
+(assert_return (invoke "i64.lt" (i64.const 1) (i64.const -1)) (i64.const 2))
+(assert_return (invoke "i64.lt" (i64.const -9223372036854775808) (i64.const 9223372036854775807)) (i64.const -1))
+(assert_return (invoke "i64.lt" (i64.const 9223372036854775807) (i64.const -9223372036854775808)) (i64.const -1))
+(assert_return (invoke "i64.lt" (i64.const 4294967296) (i64.const 1)) (i64.const 4294967295))
+(assert_return (invoke "i64.const1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.const0" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.const1" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.const0" (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.const1" (i64.const 5)) (i64.const 5))
+(assert_return (invoke "i64.const0" (i64.const 5)) (i64.const 15))
+(assert_return (invoke "i64.const1" (i64.const -1)) (i64.const -1))
+(assert_return (invoke "i64.const0" (i64.const -1)) (i64.const -3))
+(assert_return (invoke "i64.const1" (i64.const 1)) (i64.const 1))
+(assert_return (invoke "i64.const0" (i64.const 1)) (i64.const 3))
+(assert_return (invoke "i64.const1" (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.const0" (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.const1" (i64.const 9223372036854775807)) (i64.const 9223372036854775807))
+(assert_return (invoke "i64.const0" (i64.const 9223372036854775807)) (i64.const 9223372036854775805))
+(assert_return (invoke "i64.const1" (i64.const 4294967296)) (i64.const 4294967296))
+(assert_return (invoke "i64.const0" (i64.const 4294967296)) (i64.const 12884901888))
+(assert_return (invoke "i64.drop" (i64.const 0) (i64.const 0)) (i64.const 0))
+(assert_return (invoke "i64.drop" (i64.const 0) (i64.const 5)) (i64.const 5))
+(assert_return (invoke "i64.drop" (i64.const 5) (i64.const 0)) (i64.const 5))
+(assert_return (invoke "i64.drop" (i64.const -1) (i64.const 1)) (i64.const 0))
+(assert_return (invoke "i64.drop" (i64.const 1) (i64.const -1)) (i64.const 1))
+(assert_return (invoke "i64.drop" (i64.const -9223372036854775808) (i64.const 9223372036854775807)) (i64.const -1))
+(assert_return (invoke "i64.drop" (i64.const 9223372036854775807) (i64.const -9223372036854775808)) (i64.const -9223372036854775808))
+(assert_return (invoke "i64.drop" (i64.const 4294967296) (i64.const 1)) (i64.const 4294967297))
+(assert_return (invoke "i64.ext" (i32.const 0) (i32.const 0)) (i64.const 0))
+(assert_return (invoke "i64.ext" (i32.const 0) (i32.const 5)) (i64.const 0))
+(assert_return (invoke "i64.ext" (i32.const 5) (i32.const 0)) (i64.const 0))
+(assert_return (invoke "i64.ext" (i32.const 3) (i32.const 9)) (i64.const 3))
+(assert_return (invoke "i64.ext" (i32.const 9) (i32.const 3)) (i64.const 3))
+(assert_return (invoke "i64.ext" (i32.const -1) (i32.const 1)) (i64.const 1))
+(assert_return (invoke "i64.ext" (i32.const 1) (i32.const -1)) (i64.const 1))
+(assert_return (invoke "i64.ext" (i32.const -2147483648) (i32.const 2147483647)) (i64.const 2147483647))
+(assert_return (invoke "i64.ext" (i32.const 2147483647) (i32.const -2147483648)) (i64.const 2147483647))
+(assert_return (invoke "nested" (i32.const 0) (i32.const 0)) (i32.const 0))
+(assert_return (invoke "nested" (i32.const 0) (i32.const 5)) (i32.const 1))
+(assert_return (invoke "nested" (i32.const 5) (i32.const 0)) (i32.const 0))
+(assert_return (invoke "nested" (i32.const 3) (i32.const 9)) (i32.const 2))
+(assert_return (invoke "nested" (i32.const 9) (i32.const 3)) (i32.const 6))
+(assert_return (invoke "nested" (i32.const -1) (i32.const 1)) (i32.const -2))
+(assert_return (invoke "nested" (i32.const 1) (i32.const -1)) (i32.const -1))
+(assert_return (invoke "nested" (i32.const -2147483648) (i32.const 2147483647)) (i32.const 2147483647))
+(assert_return (invoke "nested" (i32.const 2147483647) (i32.const -2147483648)) (i32.const -2147483648))
+(assert_return (invoke "loop" (i32.const 0)) (i64.const 0))
+(assert_return (invoke "loop" (i32.const 1)) (i64.const 0))
+(assert_return (invoke "loop" (i32.const 2)) (i64.const 6))
+(assert_return (invoke "loop" (i32.const 7)) (i64.const 107))
+(assert_return (invoke "loop" (i32.const 30000)) (i64.const 223822000))
+(assert_return (invoke "loop" (i32.const 5)) (i64.const 54))
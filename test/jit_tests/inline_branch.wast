@@ -0,0 +1,99 @@
+;; Small callees are compiled in place of their calls, with a return becoming a branch to the end of the inlined body.
+;; These callees branch out of nested blocks with br_table, br_if and return, with and without values, while the caller
+;; has operands of its own pending under the call.  The loop runs long enough to tier up and inline them there too.
+(module
+  (global $g (mut i32) (i32.const 0))
+
+  (func $pick (export "pick") (param $i i32) (result i32)
+    (block $a
+      (block $b
+        (block $c (br_table $a $b $c (get_local $i)))
+        (return (i32.const 30)))
+      (return (i32.const 20)))
+    (i32.const 10))
+
+  (func $clamp (export "clamp") (param $v i32) (result i32)
+    (block $in
+      (br_if $in (i32.ge_s (get_local $v) (i32.const 0)))
+      (return (i32.const 0)))
+    (if (i32.gt_s (get_local $v) (i32.const 100))
+      (then (return (i32.const 100))))
+    (get_local $v))
+
+  (func $sel (export "sel") (param $i i32) (result i64)
+    (block $a (result i64)
+      (block $b (result i64)
+        (br_table $a $b (i64.const 7) (get_local $i)))
+      (i64.const 100)
+      (i64.add)))
+
+  (func $minu (export "minu") (param $a i64) (param $b i64) (result i64)
+    (block $b
+      (block $c
+        (br_if $c (i64.lt_u (get_local $a) (get_local $b)))
+        (br $b))
+      (return (get_local $a)))
+    (get_local $b))
+
+  (func $setg (export "setg") (param $v i32)
+    (block
+      (block
+        (br_if 1 (i32.eqz (get_local $v)))
+        (if (i32.eq (get_local $v) (i32.const 5))
+          (then (return))))
+      (set_global $g (get_local $v))))
+
+  (func (export "getg") (result i32) (get_global $g))
+
+  (func (export "run") (param $n i32) (result i64)
+    (local $i i32) (local $s i64)
+    (set_global $g (i32.const 0))
+    (loop $top
+      (set_local $s (i64.add (get_local $s)
+        (i64.extend_u/i32 (i32.add (call $pick (i32.and (get_local $i) (i32.const 3)))
+          (call $clamp (i32.sub (i32.rem_u (get_local $i) (i32.const 150)) (i32.const 20)))))))
+      (set_local $s (i64.xor (get_local $s) (call $sel (i32.and (get_local $i) (i32.const 1)))))
+      (set_local $s (i64.add (get_local $s) (call $minu (i64.extend_u/i32 (get_local $i)) (i64.const 500))))
+      (call $setg (i32.and (get_local $i) (i32.const 7)))
+      (set_local $s (i64.add (get_local $s) (i64.extend_u/i32 (get_global $g))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (get_local $s))
+)
+
+(assert_return (invoke "pick" (i32.const 0)) (i32.const 10))
+(assert_return (invoke "pick" (i32.const 1)) (i32.const 20))
+(assert_return (invoke "pick" (i32.const 2)) (i32.const 30))
+(assert_return (invoke "pick" (i32.const 3)) (i32.const 30))
+(assert_return (invoke "pick" (i32.const -1)) (i32.const 30))
+(assert_return (invoke "clamp" (i32.const -2147483648)) (i32.const 0))
+(assert_return (invoke "clamp" (i32.const -1)) (i32.const 0))
+(assert_return (invoke "clamp" (i32.const 0)) (i32.const 0))
+(assert_return (invoke "clamp" (i32.const 1)) (i32.const 1))
+(assert_return (invoke "clamp" (i32.const 100)) (i32.const 100))
+(assert_return (invoke "clamp" (i32.const 101)) (i32.const 100))
+(assert_return (invoke "clamp" (i32.const 2147483647)) (i32.const 100))
+(assert_return (invoke "sel" (i32.const 0)) (i64.const 7))
+(assert_return (invoke "sel" (i32.const 1)) (i64.const 107))
+(assert_return (invoke "sel" (i32.const 2)) (i64.const 107))
+(assert_return (invoke "sel" (i32.const -1)) (i64.const 107))
+(assert_return (invoke "minu" (i64.const 1) (i64.const 2)) (i64.const 1))
+(assert_return (invoke "minu" (i64.const 2) (i64.const 1)) (i64.const 1))
+(assert_return (invoke "minu" (i64.const -1) (i64.const 5)) (i64.const 5))
+(assert_return (invoke "minu" (i64.const 5) (i64.const -1)) (i64.const 5))
+(assert_return (invoke "minu" (i64.const 7) (i64.const 7)) (i64.const 7))
+(invoke "setg" (i32.const 3))
+(assert_return (invoke "getg") (i32.const 3))
+(invoke "setg" (i32.const 0))
+(assert_return (invoke "getg") (i32.const 3))
+(invoke "setg" (i32.const 5))
+(assert_return (invoke "getg") (i32.const 3))
+(invoke "setg" (i32.const 7))
+(assert_return (invoke "getg") (i32.const 7))
+(invoke "setg" (i32.const 5))
+(assert_return (invoke "getg") (i32.const 7))
+(assert_return (invoke "run" (i32.const 1)) (i64.const 13))
+(assert_return (invoke "run" (i32.const 4)) (i64.const 234))
+(assert_return (invoke "run" (i32.const 9)) (i64.const 513))
+(assert_return (invoke "run" (i32.const 20000)) (i64.const 11467064))
+(assert_return (invoke "run" (i32.const 6)) (i64.const 365))
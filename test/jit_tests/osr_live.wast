@@ -0,0 +1,69 @@
+;; Baseline activations move over to the optimized code at a loop head (OSR) with the values live across the head in
+;; locals: a loop invariant computed before the loop, i64 accumulators, the locals of an outer loop while the inner one
+;; tiers up, and an address the optimized loop strength-reduces.  sumf has an f64 as well, which the SSA tier leaves to
+;; the stack machine emitter's optimized code.  The long runs tier up part way through.
+(module
+  (memory 1)
+
+  (func (export "sum") (param $n i32) (result i64)
+    (local $i i32) (local $k i32) (local $a i64) (local $b i64)
+    (set_local $a (i64.const 1))
+    (set_local $k (i32.mul (get_local $n) (i32.const 3)))
+    (loop $top
+      (set_local $a (i64.add (get_local $a) (i64.extend_u/i32 (i32.add (get_local $i) (get_local $k)))))
+      (set_local $b (i64.xor (get_local $b) (i64.shl (get_local $a) (i64.const 1))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (get_local $a) (get_local $b)))
+
+  (func (export "sumf") (param $n i32) (result i64)
+    (local $i i32) (local $k i32) (local $a i64) (local $b i64) (local $x f64)
+    (set_local $a (i64.const 1))
+    (set_local $k (i32.mul (get_local $n) (i32.const 3)))
+    (loop $top
+      (set_local $a (i64.add (get_local $a) (i64.extend_u/i32 (i32.add (get_local $i) (get_local $k)))))
+      (set_local $b (i64.xor (get_local $b) (i64.shl (get_local $a) (i64.const 1))))
+      (set_local $x (f64.add (get_local $x) (f64.const 0.5)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (i64.add (i64.add (get_local $a) (get_local $b)) (i64.trunc_s/f64 (get_local $x))))
+
+  (func (export "nested") (param $n i32) (param $m i32) (result i32)
+    (local $i i32) (local $j i32) (local $t i32) (local $u i32)
+    (set_local $u (i32.const 7))
+    (loop $outer
+      (set_local $j (i32.const 0))
+      (loop $inner
+        (set_local $t (i32.add (get_local $t) (i32.add (i32.mul (get_local $i) (get_local $j)) (get_local $u))))
+        (set_local $j (i32.add (get_local $j) (i32.const 1)))
+        (br_if $inner (i32.lt_u (get_local $j) (get_local $m))))
+      (set_local $u (i32.add (i32.mul (get_local $u) (i32.const 5)) (i32.const 1)))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $outer (i32.lt_u (get_local $i) (get_local $n))))
+    (i32.xor (get_local $t) (get_local $u)))
+
+  (func (export "stride") (param $n i32) (result i64)
+    (local $i i32) (local $s i64)
+    (loop $top
+      (i64.store (i32.shl (get_local $i) (i32.const 3))
+        (i64.mul (i64.extend_u/i32 (get_local $i)) (i64.extend_u/i32 (get_local $i))))
+      (set_local $s (i64.add (get_local $s) (i64.load (i32.shl (get_local $i) (i32.const 3)))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (get_local $s))
+)
+(assert_return (invoke "sum" (i32.const 1)) (i64.const 12))
+(assert_return (invoke "sum" (i32.const 5)) (i64.const 126))
+(assert_return (invoke "sum" (i32.const 100000)) (i64.const 43406163377))
+(assert_return (invoke "sum" (i32.const 5)) (i64.const 126))
+(assert_return (invoke "sumf" (i32.const 1)) (i64.const 12))
+(assert_return (invoke "sumf" (i32.const 5)) (i64.const 128))
+(assert_return (invoke "sumf" (i32.const 100000)) (i64.const 43406213377))
+(assert_return (invoke "sumf" (i32.const 5)) (i64.const 128))
+(assert_return (invoke "nested" (i32.const 1) (i32.const 1)) (i32.const 35))
+(assert_return (invoke "nested" (i32.const 3) (i32.const 4)) (i32.const 24))
+(assert_return (invoke "nested" (i32.const 300) (i32.const 400)) (i32.const 1843160827))
+(assert_return (invoke "nested" (i32.const 3) (i32.const 4)) (i32.const 24))
+(assert_return (invoke "stride" (i32.const 1)) (i64.const 0))
+(assert_return (invoke "stride" (i32.const 8000)) (i64.const 170634668000))
+(assert_return (invoke "stride" (i32.const 8000)) (i64.const 170634668000))
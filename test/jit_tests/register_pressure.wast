@@ -0,0 +1,125 @@
+;; More values live at once than the optimizing tier has registers for, so some of them are spilled: ten i32 and four
+;; i64 locals carried round a loop (each update reads others, so all are live across the back edge), and expressions
+;; that keep sixteen operands pending on the stack, one of them across a call.
+(module
+  (func (export "pressure") (param $n i32) (result i64)
+    (local $i i32)
+    (local $v0 i32) (local $v1 i32) (local $v2 i32) (local $v3 i32) (local $v4 i32) (local $v5 i32) (local $v6 i32) (local $v7 i32) (local $v8 i32) (local $v9 i32)
+    (local $p i64) (local $q i64) (local $r i64) (local $s i64) (local $acc i32)
+    (set_local $v0 (i32.const -1640531535))
+    (set_local $v1 (i32.const 1013904226))
+    (set_local $v2 (i32.const -626627309))
+    (set_local $v3 (i32.const 2027808452))
+    (set_local $v4 (i32.const 387276917))
+    (set_local $v5 (i32.const -1253254618))
+    (set_local $v6 (i32.const 1401181143))
+    (set_local $v7 (i32.const -239350392))
+    (set_local $v8 (i32.const -1879881927))
+    (set_local $v9 (i32.const 774553834))
+    (set_local $p (i64.const 1)) (set_local $q (i64.const 2)) (set_local $r (i64.const 3)) (set_local $s (i64.const 5))
+    (loop $top
+      (set_local $v0 (i32.xor (i32.add (get_local $v0) (i32.rotl (get_local $v1) (i32.const 1))) (get_local $v3)))
+      (set_local $v1 (i32.xor (i32.add (get_local $v1) (i32.rotl (get_local $v2) (i32.const 2))) (get_local $v4)))
+      (set_local $v2 (i32.xor (i32.add (get_local $v2) (i32.rotl (get_local $v3) (i32.const 3))) (get_local $v5)))
+      (set_local $v3 (i32.xor (i32.add (get_local $v3) (i32.rotl (get_local $v4) (i32.const 4))) (get_local $v6)))
+      (set_local $v4 (i32.xor (i32.add (get_local $v4) (i32.rotl (get_local $v5) (i32.const 5))) (get_local $v7)))
+      (set_local $v5 (i32.xor (i32.add (get_local $v5) (i32.rotl (get_local $v6) (i32.const 6))) (get_local $v8)))
+      (set_local $v6 (i32.xor (i32.add (get_local $v6) (i32.rotl (get_local $v7) (i32.const 7))) (get_local $v9)))
+      (set_local $v7 (i32.xor (i32.add (get_local $v7) (i32.rotl (get_local $v8) (i32.const 8))) (get_local $v0)))
+      (set_local $v8 (i32.xor (i32.add (get_local $v8) (i32.rotl (get_local $v9) (i32.const 9))) (get_local $v1)))
+      (set_local $v9 (i32.xor (i32.add (get_local $v9) (i32.rotl (get_local $v0) (i32.const 10))) (get_local $v2)))
+      (set_local $p (i64.add (i64.mul (get_local $p) (i64.const 3)) (i64.extend_u/i32 (get_local $v0))))
+      (set_local $q (i64.xor (i64.xor (get_local $q) (i64.shl (get_local $p) (i64.const 7))) (i64.extend_u/i32 (get_local $v9))))
+      (set_local $r (i64.add (i64.add (get_local $r) (i64.shr_u (get_local $q) (i64.const 3))) (i64.extend_u/i32 (get_local $i))))
+      (set_local $s (i64.add (get_local $s) (i64.xor (get_local $r) (get_local $p))))
+      (set_local $i (i32.add (get_local $i) (i32.const 1)))
+      (br_if $top (i32.lt_u (get_local $i) (get_local $n))))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v0)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v1)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v2)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v3)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v4)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v5)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v6)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v7)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v8)) (i32.const 31)))
+    (set_local $acc (i32.mul (i32.xor (get_local $acc) (get_local $v9)) (i32.const 31)))
+    (i64.add (i64.add (i64.add (get_local $p) (get_local $q)) (i64.add (get_local $r) (get_local $s)))
+      (i64.extend_u/i32 (get_local $acc))))
+
+  (func $tree (export "tree") (param $a i32) (result i32)
+    (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 3)) (i32.add (get_local $a) (i32.const 3)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 5)) (i32.add (get_local $a) (i32.const 5)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 7)) (i32.add (get_local $a) (i32.const 7)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 11)) (i32.add (get_local $a) (i32.const 11)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 13)) (i32.add (get_local $a) (i32.const 13)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 17)) (i32.add (get_local $a) (i32.const 17)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 19)) (i32.add (get_local $a) (i32.const 19)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 23)) (i32.add (get_local $a) (i32.const 23)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 29)) (i32.add (get_local $a) (i32.const 29)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 31)) (i32.add (get_local $a) (i32.const 31)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 37)) (i32.add (get_local $a) (i32.const 37)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 41)) (i32.add (get_local $a) (i32.const 41)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 43)) (i32.add (get_local $a) (i32.const 43)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 47)) (i32.add (get_local $a) (i32.const 47)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 53)) (i32.add (get_local $a) (i32.const 53)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 59)) (i32.add (get_local $a) (i32.const 59)))
+      (get_local $a))))))))))))))))))
+  (func $f (param i32) (result i32) (i32.add (i32.mul (get_local 0) (i32.const 7)) (i32.const 1)))
+  (func $treecall (export "treecall") (param $a i32) (result i32)
+    (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 3)) (i32.add (get_local $a) (i32.const 3)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 5)) (i32.add (get_local $a) (i32.const 5)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 7)) (i32.add (get_local $a) (i32.const 7)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 11)) (i32.add (get_local $a) (i32.const 11)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 13)) (i32.add (get_local $a) (i32.const 13)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 17)) (i32.add (get_local $a) (i32.const 17)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 19)) (i32.add (get_local $a) (i32.const 19)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 23)) (i32.add (get_local $a) (i32.const 23)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 29)) (i32.add (get_local $a) (i32.const 29)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 31)) (i32.add (get_local $a) (i32.const 31)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 37)) (i32.add (get_local $a) (i32.const 37)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 41)) (i32.add (get_local $a) (i32.const 41)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 43)) (i32.add (get_local $a) (i32.const 43)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 47)) (i32.add (get_local $a) (i32.const 47)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 53)) (i32.add (get_local $a) (i32.const 53)))
+      (i32.add (i32.xor (i32.mul (get_local $a) (i32.const 59)) (i32.add (get_local $a) (i32.const 59)))
+      (call $f (get_local $a)))))))))))))))))))
+
+;; called often enough to tier up the trees
+  (func (export "trees") (param $n i32) (result i32)
+    (local $i i32) (local $s i32)
+    (block $done
+      (loop $top
+        (br_if $done (i32.ge_u (get_local $i) (get_local $n)))
+        (set_local $s (i32.add (get_local $s) (call $tree (get_local $i))))
+        (set_local $i (i32.add (get_local $i) (i32.const 1)))
+        (br $top)))
+    (get_local $s))
+  (func (export "treecalls") (param $n i32) (result i32)
+    (local $i i32) (local $s i32)
+    (block $done
+      (loop $top
+        (br_if $done (i32.ge_u (get_local $i) (get_local $n)))
+        (set_local $s (i32.add (get_local $s) (call $treecall (get_local $i))))
+        (set_local $i (i32.add (get_local $i) (i32.const 1)))
+        (br $top)))
+    (get_local $s))
+)
+(assert_return (invoke "pressure" (i32.const 1)) (i64.const 302799636748))
+(assert_return (invoke "pressure" (i32.const 2)) (i64.const 1368603738441))
+(assert_return (invoke "pressure" (i32.const 50000)) (i64.const 1123239856280535316))
+(assert_return (invoke "pressure" (i32.const 2)) (i64.const 1368603738441))
+(assert_return (invoke "tree" (i32.const 0)) (i32.const 438))
+(assert_return (invoke "treecall" (i32.const 0)) (i32.const 439))
+(assert_return (invoke "tree" (i32.const 1)) (i32.const 181))
+(assert_return (invoke "treecall" (i32.const 1)) (i32.const 188))
+(assert_return (invoke "tree" (i32.const 123456)) (i32.const 54032758))
+(assert_return (invoke "treecall" (i32.const 123456)) (i32.const 54773495))
+(assert_return (invoke "tree" (i32.const -5)) (i32.const -2109))
+(assert_return (invoke "treecall" (i32.const -5)) (i32.const -2138))
+(assert_return (invoke "trees" (i32.const 20000)) (i32.const 1568933136))
+(assert_return (invoke "treecalls" (i32.const 20000)) (i32.const -1526074160))
+(assert_return (invoke "tree" (i32.const 123456)) (i32.const 54032758))
+(assert_return (invoke "treecall" (i32.const 123456)) (i32.const 54773495))
+(assert_return (invoke "tree" (i32.const -5)) (i32.const -2109))
+(assert_return (invoke "treecall" (i32.const -5)) (i32.const -2138))
@@ -0,0 +1,22 @@
+;; A loop the optimized code has no entry for (here the block result it sits under) keeps running in the baseline code
+;; after the function tiers up.  Its check drops itself instead of calling TierUp again each time the shared counter
+;; runs out, which must not disturb the loop or later calls.
+(module
+  (func $count (export "count") (param $n i32) (result i32)
+    (local $s i32)
+    (i32.add (i32.const 1)
+      (block (result i32)
+        (loop $top
+          (set_local $s (i32.add (get_local $s) (i32.const 3)))
+          (set_local $n (i32.sub (get_local $n) (i32.const 1)))
+          (br_if $top (i32.ne (get_local $n) (i32.const 0))))
+        (get_local $s))))
+
+  (func (export "twice") (param $n i32) (result i32)
+    (i32.add (call $count (get_local $n)) (call $count (get_local $n))))
+)
+(assert_return (invoke "count" (i32.const 1)) (i32.const 4))
+(assert_return (invoke "count" (i32.const 100000)) (i32.const 300001))
+(assert_return (invoke "count" (i32.const 50000)) (i32.const 150001))
+(assert_return (invoke "twice" (i32.const 30000)) (i32.const 180002))
+(assert_return (invoke "count" (i32.const 7)) (i32.const 22))
@@ -0,0 +1,104 @@
+import os
+import shutil
+import struct
+import subprocess
+import sys
+import tempfile
+
+# Runs spec and JIT tests through testhost in the configurations that take different paths through the JIT:
+#   python run_tests.py <path to testhost>
+# wat2wasm must be on the PATH.
+
+strTestDir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+rgstrFloat = ["spec_tests/f32.wast", "spec_tests/f64.wast", "spec_tests/float_exprs.wast", "spec_tests/float_misc.wast"]
+rgstrCore = ["spec_tests/%s.wast" % strName for strName in ["address", "br_table", "call", "fac", "globals", "i32", "i64", "if", "loop", "memory_trap", "select", "start", "traps"]]
+rgstrJit = ["jit_tests/" + strFile for strFile in sorted(os.listdir(os.path.join(strTestDir, "jit_tests"))) if strFile.endswith(".wast")]
+
+rgmode = [
+    ([], rgstrFloat + rgstrJit),
+    # the rounding ops have an x87 fallback for CPUs without SSE4.1
+    (["-nosse41"], rgstrFloat),
+    # everything compiled up front by CompileAll's worker threads rather than on first call
+    (["-threads", "4"], rgstrCore + rgstrFloat + rgstrJit),
+    # instances sharing the module and its code outlive the context that loaded it
+    (["-instances", "3"], rgstrCore + rgstrJit),
+    # ... and run every call at the same time on threads of their own, racing to compile and tier up the shared code
+    (["-instances", "4", "-concurrent"], rgstrCore + rgstrJit),
+    # more instances than a block of the trap range table holds, registering theirs at the same time
+    (["-instances", "70", "-concurrent"], ["spec_tests/memory_trap.wast", "spec_tests/traps.wast", "jit_tests/hoist_trap.wast"]),
+    # every function optimized on its first call, so the integer and control flow tests run through the optimizing tiers
+    (["-tierup", "0"], ["spec_tests/%s.wast" % strName for strName in ["i32", "i64", "loop", "block", "br", "br_if", "if", "select", "memory", "address"]] + rgstrJit),
+    # baseline loops that tier up after a few iterations and carry on in the optimized code from the loop head
+    (["-tierup", "5"], rgstrJit),
+]
+
+def FRunTest(strTesthost, rgarg, strFile):
+    rgcmd = [strTesthost] + rgarg + [os.path.join(strTestDir, strFile)]
+    with open(os.devnull, "w") as fNull:
+        res = subprocess.call(rgcmd, stdout=fNull, stderr=subprocess.STDOUT)
+    if res != 0:
+        print("FAILED (%d): %s" % (res, " ".join(rgcmd)))
+    return res == 0
+
+def MapCacheFiles(strDir):
+    mapstrfile = {}
+    for strFile in os.listdir(strDir):
+        strPath = os.path.join(strDir, strFile)
+        with open(strPath, "rb") as f:
+            mapstrfile[strFile] = (os.stat(strPath).st_ino, os.stat(strPath).st_mtime_ns, f.read())
+    return mapstrfile
+
+def TruncateCache(strPath, rgb):
+    with open(strPath, "wb") as f:
+        f.write(rgb[:len(rgb) // 2])
+
+def BumpCacheVersion(strPath, rgb):
+    # the header starts with the magic and then the version
+    version = struct.unpack_from("<I", rgb, 4)[0]
+    with open(strPath, "wb") as f:
+        f.write(rgb[:4] + struct.pack("<I", version + 1) + rgb[8:])
+
+# The first run writes the code cache, the second must load it and leave it alone.  A damaged or stale cache must be
+# ignored (the tests still pass) and replaced by a good one.
+def FTestCodeCache(strTesthost, strFile):
+    strDir = tempfile.mkdtemp()
+    try:
+        rgarg = ["-cache", strDir]
+        if not FRunTest(strTesthost, rgarg, strFile):
+            return False
+        mapstrfile = MapCacheFiles(strDir)
+        if not mapstrfile:
+            print("FAILED: no code cache written for %s" % strFile)
+            return False
+        if not FRunTest(strTesthost, rgarg, strFile):
+            return False
+        if MapCacheFiles(strDir) != mapstrfile:
+            print("FAILED: code cache for %s was not reused" % strFile)
+            return False
+        for Damage in [TruncateCache, BumpCacheVersion]:
+            for strCache, (_, _, rgb) in mapstrfile.items():
+                Damage(os.path.join(strDir, strCache), rgb)
+            if not FRunTest(strTesthost, rgarg, strFile):
+                return False
+            if {strCache: rgb for strCache, (_, _, rgb) in MapCacheFiles(strDir).items()} != {strCache: rgb for strCache, (_, _, rgb) in mapstrfile.items()}:
+                print("FAILED: damaged code cache for %s (%s) was not replaced" % (strFile, Damage.__name__))
+                return False
+        return True
+    finally:
+        shutil.rmtree(strDir)
+
+if len(sys.argv) != 2:
+    print("usage: run_tests.py <testhost>")
+    sys.exit(2)
+
+cfail = 0
+for rgarg, rgfile in rgmode:
+    for strFile in rgfile:
+        if not FRunTest(sys.argv[1], rgarg, strFile):
+            cfail += 1
+for strFile in rgstrCore + rgstrJit:
+    if not FTestCodeCache(sys.argv[1], strFile):
+        cfail += 1
+print("%d failures" % cfail)
+sys.exit(1 if cfail else 0)